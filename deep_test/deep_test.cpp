@@ -4,6 +4,7 @@
 #include <malloc.h>
 #include <memory.h>
 #include <assert.h>
+#include <utility>
 
 class MyDeepFactory : public DeepFactory
 {
@@ -222,10 +223,152 @@ int luaD_new_clonable( lua_State* L)
 // #################################################################################################
 // #################################################################################################
 
+// a full userdata that owns a native resource, and hands it over instead of duplicating it when crossing a lane/linda boundary
+struct MyMovableUserdata
+{
+    lua_Integer* resource; // nullptr once moved-from
+};
+
+// #################################################################################################
+
+[[nodiscard]] static MyMovableUserdata* movable_check(lua_State* L, bool allowMovedFrom_)
+{
+    MyMovableUserdata* self = static_cast<MyMovableUserdata*>(luaL_checkudata(L, 1, "movable"));
+    if (!allowMovedFrom_ && self->resource == nullptr) {
+        raise_luaL_error(L, "movable userdata was moved-from");
+    }
+    return self;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static int movable_set(lua_State* L)
+{
+    MyMovableUserdata* self = movable_check(L, false);
+    *self->resource = lua_tointeger(L, 2);
+    return 0;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static int movable_get(lua_State* L)
+{
+    MyMovableUserdata* self = movable_check(L, false);
+    lua_pushinteger(L, *self->resource);
+    return 1;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static int movable_ismoved(lua_State* L)
+{
+    MyMovableUserdata* self = movable_check(L, true);
+    lua_pushboolean(L, self->resource == nullptr);
+    return 1;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static int movable_setuv(lua_State* L)
+{
+    std::ignore = movable_check(L, true);
+    int uv = (int) luaL_optinteger(L, 2, 1);
+    lua_settop( L, 3);
+    lua_pushboolean( L, lua_setiuservalue( L, 1, uv) != 0);
+    return 1;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static int movable_getuv(lua_State* L)
+{
+    std::ignore = movable_check(L, true);
+    int uv = (int) luaL_optinteger(L, 2, 1);
+    lua_getiuservalue( L, 1, uv);
+    return 1;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static int movable_tostring(lua_State* L)
+{
+    MyMovableUserdata* self = movable_check(L, true);
+    if (self->resource == nullptr) {
+        lua_pushfstring(L, "%p:movable(moved-from)", lua_topointer(L, 1));
+    } else {
+        lua_pushfstring(L, "%p:movable(%d)", lua_topointer(L, 1), static_cast<int>(*self->resource));
+    }
+    return 1;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static int movable_gc(lua_State* L)
+{
+    MyMovableUserdata* self = static_cast<MyMovableUserdata*>(lua_touserdata(L, 1));
+    delete self->resource;
+    self->resource = nullptr;
+    return 0;
+}
+
+// #################################################################################################
+
+// this is all we need to make a userdata lanes-movable. no dependency on Lanes code.
+[[nodiscard]] static int movable_lanesmove(lua_State* L)
+{
+    switch( lua_gettop(L))
+    {
+        case 3:
+        {
+            MyMovableUserdata* self = static_cast<MyMovableUserdata*>(lua_touserdata(L, 1));
+            MyMovableUserdata* from = static_cast<MyMovableUserdata*>(lua_touserdata(L, 2));
+            size_t len = lua_tointeger(L, 3);
+            assert( len == sizeof(MyMovableUserdata));
+            // the resource changes owner, the source is left moved-from
+            self->resource = std::exchange(from->resource, nullptr);
+        }
+        return 0;
+
+        default:
+        raise_luaL_error(L, "Lanes called movable_lanesmove with unexpected parameters");
+    }
+    return 0;
+}
+
+// #################################################################################################
+
+static luaL_Reg const movable_mt[] =
+{
+    { "__tostring", movable_tostring},
+    { "__gc", movable_gc},
+    { "__lanesmove", movable_lanesmove},
+    { "set", movable_set},
+    { "get", movable_get},
+    { "ismoved", movable_ismoved},
+    { "setuv", movable_setuv},
+    { "getuv", movable_getuv},
+    { nullptr, nullptr }
+};
+
+// #################################################################################################
+
+int luaD_new_movable( lua_State* L)
+{
+    int const nuv{ static_cast<int>(luaL_optinteger(L, 1, 1)) };
+    MyMovableUserdata* self = static_cast<MyMovableUserdata*>(lua_newuserdatauv( L, sizeof(MyMovableUserdata), nuv));
+    self->resource = new lua_Integer{ 0 };
+    luaL_setmetatable( L, "movable");
+    return 1;
+}
+
+// #################################################################################################
+// #################################################################################################
+
 static luaL_Reg const deep_module[] =
 {
     { "new_deep", luaD_new_deep},
     { "new_clonable", luaD_new_clonable},
+    { "new_movable", luaD_new_movable},
     { nullptr, nullptr }
 };
 
@@ -244,6 +387,14 @@ LANES_API int luaopen_deep_test(lua_State* L)
     }
     lua_setfield(L, -2, "__clonableMT");                    // M
 
+    if (luaL_newmetatable( L, "movable"))                   // M mt
+    {
+        luaL_setfuncs( L, movable_mt, 0);
+        lua_pushvalue(L, -1);                               // M mt mt
+        lua_setfield(L, -2, "__index");                     // M mt
+    }
+    lua_setfield(L, -2, "__movableMT");                     // M
+
     if (luaL_newmetatable( L, "deep"))                      // mt
     {
         luaL_setfuncs( L, deep_mt, 0);
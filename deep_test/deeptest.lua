@@ -4,8 +4,19 @@ local l = lanes.linda "my linda"
 -- we will transfer userdata created by this module, so we need to make Lanes aware of it
 local dt = lanes.require "deep_test"
 
+-- the module isn't scanned in the lookup database yet: a clonable that goes through a linda must find its metatable there all the same
+do
+	local c = dt.new_clonable(0)
+	c:set(42)
+	l:set("pending", c)
+	local out = l:get("pending")
+	assert(getmetatable(out) == getmetatable(c) and tostring(out):find("clonable%(42%)"))
+	l:set("pending")
+end
+
 local test_deep = true
 local test_clonable = true
+local test_movable = true
 local test_uvtype = "string"
 local nupvals = _VERSION == "Lua 5.4" and 3 or 1
 
@@ -95,3 +106,85 @@ if test_clonable then
 	print "CLONABLE"
 	performTest( dt.new_clonable(nupvals))
 end
+
+if test_movable then
+	print "================================================================"
+	print "MOVABLE"
+	local obj = dt.new_movable(nupvals)
+	obj:set(666)
+	obj:setuv(1, makeUserValue(obj))
+	printDeep("immediate:", obj)
+
+	-- crossing a lane barrier hands the resource over to the lane, the source is left moved-from
+	local g = lanes.gen(
+		"package"
+		, {
+			required = { "deep_test"}
+		}
+		, function(arg_)
+			printDeep("in lane, as argument:", arg_)
+			return arg_:get(), arg_
+		end
+	)
+	local h = g(obj)
+	local val, back = h:join()
+	assert(val == 666 and obj:ismoved() and not pcall(obj.get, obj))
+	-- the lane moved it back to us
+	assert(back:get() == 666)
+	printDeep("moved-from:", obj)
+	printDeep("from lane:", back)
+
+	-- through a linda: moved into the keeper, then out of it by the receiver
+	l:send("move", back)
+	assert(back:ismoved())
+	local _, received = l:receive("move")
+	assert(received:get() == 666)
+	printDeep("out of linda:", received)
+
+	-- a send refused because the key is full moves nothing
+	l:limit("full", 1)
+	assert(l:send("full", "filler") == true)
+	assert(l:send(0, "full", received) == false)
+	assert(not received:ismoved() and received:get() == 666)
+	-- same thing when the values come from an array
+	if l.send_array then
+		assert(l:send_array(0, "full", { received }) == false)
+		assert(not received:ismoved())
+	end
+	-- once there is room, the move happens
+	l:receive("full")
+	assert(l:send(0, "full", received) == true)
+	assert(received:ismoved())
+	local _, last = l:receive("full")
+	assert(last:get() == 666)
+
+	-- a lane that fails to launch moves nothing either
+	assert(not pcall(g, last, coroutine.create(function() end)))
+	assert(not last:ismoved() and last:get() == 666)
+
+	-- the moves are deferred whatever the kind of __lanesmove
+	local mt = getmetatable(last)
+	local lanesmove = mt.__lanesmove
+	mt.__lanesmove = function(...) return lanesmove(...) end
+	assert(l:send(0, "full", "filler") == true)
+	assert(l:send(0, "full", last) == false)
+	assert(not last:ismoved() and last:get() == 666)
+	mt.__lanesmove = lanesmove
+
+	-- receive_into() only moves the values out of the linda once they could all be copied
+	local sender = lanes.gen("*", { required = { "deep_test" } }, function()
+		local lanes = require "lanes"
+		-- file methods aren't found by the scan of the global namespace: only this lane knows that name
+		local m = { read = io.stdout.read }
+		lanes.register("deeptest_lane_only", m)
+		local obj = require("deep_test").new_movable(0)
+		obj:set(777)
+		return l:send_array("into", { obj, m.read })
+	end)
+	assert(sender()[1] == true)
+	local into = {}
+	assert(not pcall(l.receive_into, l, 0, "into", into, 2))
+	assert(next(into) == nil and l:count("into") == 2)
+	local _, first = l:receive(0, "into")
+	assert(first:get() == 777)
+end
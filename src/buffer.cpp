@@ -0,0 +1,402 @@
+/*
+ * BUFFER.CPP                    Copyright (c) 2024-, Benoit Germain
+ *
+ * Refcounted byte buffers shared between Lua states as deep userdata
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "buffer.h"
+
+#include "tools.h"
+
+// must be a #define instead of a constexpr to work with lua_pushliteral (until I templatize it)
+#define kBufferMetatableName "Buffer"
+
+// #################################################################################################
+// #################################################################################################
+namespace {
+    // #############################################################################################
+    // #############################################################################################
+
+    // same semantics as string.sub() indices: 1-based, inclusive, negative values count from the end
+    [[nodiscard]] static std::pair<size_t, size_t> CheckRange(lua_State* const L_, int const idx_, size_t const size_)
+    {
+        auto _relative = [size_](lua_Integer pos_) -> lua_Integer {
+            if (pos_ >= 0) {
+                return pos_;
+            }
+            return (static_cast<size_t>(-pos_) > size_) ? 0 : static_cast<lua_Integer>(size_) + pos_ + 1;
+        };
+        lua_Integer _start{ _relative(luaL_optinteger(L_, idx_, 1)) };
+        lua_Integer _end{ _relative(luaL_optinteger(L_, idx_ + 1, -1)) };
+        if (_start < 1) {
+            _start = 1;
+        }
+        if (_end > static_cast<lua_Integer>(size_)) {
+            _end = static_cast<lua_Integer>(size_);
+        }
+        if (_start > _end) {
+            return { 0, 0 };
+        }
+        return { static_cast<size_t>(_start - 1), static_cast<size_t>(_end - _start + 1) };
+    }
+
+    // #############################################################################################
+
+    [[nodiscard]] static Buffer* ToBuffer(lua_State* const L_, int const idx_)
+    {
+        Buffer* const _buffer{ static_cast<Buffer*>(BufferFactory::Instance.toDeep(L_, idx_)) };
+        luaL_argcheck(L_, _buffer != nullptr, idx_, "expecting a buffer"); // doesn't return if _buffer is nullptr
+        return _buffer;
+    }
+
+    // #############################################################################################
+    // #############################################################################################
+} // namespace
+// #################################################################################################
+// #################################################################################################
+
+// #################################################################################################
+// #################################################################################################
+// ############################### BufferStorage implementation ####################################
+// #################################################################################################
+// #################################################################################################
+
+BufferStorage* BufferStorage::Create(Universe* const U_, size_t const capacity_)
+{
+    void* const _mem{ U_->internalAllocator.alloc(sizeof(BufferStorage) + capacity_) };
+    return _mem ? new (_mem) BufferStorage{ capacity_ } : nullptr;
+}
+
+// #################################################################################################
+
+BufferStorage* BufferStorage::Create(Universe* const U_, std::string_view const& bytes_)
+{
+    BufferStorage* const _storage{ Create(U_, bytes_.size()) };
+    if (_storage) {
+        std::ignore = _storage->append(bytes_);
+        _storage->seal();
+    }
+    return _storage;
+}
+
+// #################################################################################################
+
+// returns false if the storage is sealed, or too small to receive the bytes
+bool BufferStorage::append(std::string_view const& bytes_)
+{
+    std::lock_guard<std::mutex> _guard{ appendMutex };
+    size_t const _size{ size.load(std::memory_order_relaxed) };
+    if (isSealed() || capacity - _size < bytes_.size()) {
+        return false;
+    }
+    memcpy(data() + _size, bytes_.data(), bytes_.size());
+    // publish the new bytes only once they are written
+    size.store(_size + bytes_.size(), std::memory_order_release);
+    return true;
+}
+
+// #################################################################################################
+
+void BufferStorage::release(Universe* const U_)
+{
+    if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        size_t const _allocSize{ sizeof(BufferStorage) + capacity };
+        this->~BufferStorage();
+        U_->internalAllocator.free(this, _allocSize);
+    }
+}
+
+// #################################################################################################
+// #################################################################################################
+// ################################### Buffer implementation #######################################
+// #################################################################################################
+// #################################################################################################
+
+Buffer::Buffer(Universe* const U_, BufferStorage* const storage_, size_t const offset_, std::optional<size_t> const length_, bool const offloadedString_, std::string_view const& cdataType_)
+: DeepPrelude{ BufferFactory::Instance }
+, U{ U_ }
+, storage{ storage_ }
+, offset{ offset_ }
+, length{ length_ }
+, offloadedString{ offloadedString_ }
+, cdataType{ cdataType_ }
+{
+    storage->acquire();
+}
+
+// #################################################################################################
+
+Buffer::~Buffer()
+{
+    storage->release(U);
+}
+
+// #################################################################################################
+
+// push in a keeper state a proxy to a copy of the bytes of a cdata, allocated outside of the keeper's heap, tagged with the name of its ctype
+// ctype_ must remain valid as long as the Universe exists
+// returns false and pushes nothing if the copy couldn't be allocated
+[[nodiscard]] bool Buffer::PushOffloadedCData(Universe* const U_, DestState const L_, std::string_view const& ctype_, std::string_view const& bytes_)
+{
+    BufferStorage* const _storage{ BufferStorage::Create(U_, bytes_) };
+    if (_storage == nullptr) {
+        return false;
+    }
+    Buffer* const _buffer{ new (U_) Buffer{ U_, _storage, 0, bytes_.size(), false, ctype_ } };
+    // the Buffer holds its own reference
+    _storage->release(U_);
+    // can't raise an error in ToKeeper mode
+    DeepFactory::PushDeepProxy(L_, _buffer, 0, LookupMode::ToKeeper, L_);
+    return true;
+}
+
+// #################################################################################################
+
+void Buffer::PushOffloadedString(Universe* const U_, DestState const L_, std::string_view const& string_)
+{
+    BufferStorage* const _storage{ BufferStorage::Create(U_, string_) };
+    if (_storage == nullptr) {
+        // out of memory: keep the string in the keeper after all
+        std::ignore = lua_pushstringview(L_, string_);
+        return;
+    }
+    Buffer* const _buffer{ new (U_) Buffer{ U_, _storage, 0, string_.size(), true } };
+    // the Buffer holds its own reference
+    _storage->release(U_);
+    // can't raise an error in ToKeeper mode
+    DeepFactory::PushDeepProxy(L_, _buffer, 0, LookupMode::ToKeeper, L_);
+    // the keeper heap only sees a small proxy: let its GC know about the memory it actually holds, so that it collects consumed strings soon enough
+    lua_gc(L_, LUA_GCSTEP, static_cast<int>(string_.size() >> 10));
+}
+
+// #################################################################################################
+// #################################################################################################
+// ###################################### BufferFactory ############################################
+// #################################################################################################
+// #################################################################################################
+
+void BufferFactory::createMetatable(lua_State* L_) const
+{
+    STACK_CHECK_START_REL(L_, 0);
+    lua_newtable(L_);
+    // metatable is its own index
+    lua_pushvalue(L_, -1);
+    lua_setfield(L_, -2, "__index");
+
+    // protect metatable from external access
+    lua_pushliteral(L_, kBufferMetatableName);
+    lua_setfield(L_, -2, "__metatable");
+
+    luaG_registerlibfuncs(L_, mBufferMT);
+    STACK_CHECK(L_, 1);
+}
+
+// #################################################################################################
+
+void BufferFactory::deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const
+{
+    Buffer* const _buffer{ static_cast<Buffer*>(o_) };
+    LUA_ASSERT(L_, _buffer);
+    delete _buffer; // operator delete overload ensures things go as expected
+}
+
+// #################################################################################################
+
+std::string_view BufferFactory::moduleName() const
+{
+    // same as lindas: lanes is necessarily loaded by the time we get here
+    return std::string_view{};
+}
+
+// #################################################################################################
+
+// lanes.buffer(string|capacity)
+DeepPrelude* BufferFactory::newDeepObjectInternal(lua_State* L_) const
+{
+    Universe* const _U{ Universe::Get(L_) };
+    BufferStorage* const _storage{
+        (lua_type(L_, 1) == LUA_TSTRING) ? BufferStorage::Create(_U, lua_tostringview(L_, 1)) : BufferStorage::Create(_U, static_cast<size_t>(lua_tointeger(L_, 1)))
+    };
+    if (_storage == nullptr) {
+        return nullptr;
+    }
+    Buffer* const _buffer{ new (_U) Buffer{ _U, _storage, 0, std::nullopt } };
+    // the Buffer holds its own reference
+    _storage->release(_U);
+    return _buffer;
+}
+
+// #################################################################################################
+// #################################################################################################
+// ########################################## Lua API ##############################################
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * size = buffer:append(string [, ...])
+ *
+ * Append bytes at the end of the buffer. Raises an error if it is sealed or if there isn't enough room left.
+ */
+LUAG_FUNC(buffer_append)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    if (_buffer->length.has_value()) {
+        raise_luaL_error(L_, "can't append to a buffer slice");
+    }
+    int const _top{ lua_gettop(L_) };
+    for (int _i{ 2 }; _i <= _top; ++_i) {
+        if (!_buffer->storage->append(luaL_checkstringview(L_, _i))) {
+            raise_luaL_error(L_, _buffer->storage->isSealed() ? "buffer is sealed" : "buffer capacity exceeded");
+        }
+    }
+    lua_pushinteger(L_, static_cast<lua_Integer>(_buffer->storage->getSize()));
+    return 1;
+}
+
+// #################################################################################################
+
+// capacity = buffer:capacity()
+LUAG_FUNC(buffer_capacity)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    lua_pushinteger(L_, static_cast<lua_Integer>(_buffer->length.value_or(_buffer->storage->getCapacity())));
+    return 1;
+}
+
+// #################################################################################################
+
+// lightuserdata = buffer:deep()
+// the address of the buffer, for lanes_linda_send_buffer()
+LUAG_FUNC(buffer_deep)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    lua_pushlightuserdata(L_, _buffer); // just the address
+    return 1;
+}
+
+// #################################################################################################
+
+// size = #buffer
+LUAG_FUNC(buffer_len)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    lua_pushinteger(L_, static_cast<lua_Integer>(_buffer->view().size()));
+    return 1;
+}
+
+// #################################################################################################
+
+// buffer:seal(): no more appends are possible
+LUAG_FUNC(buffer_seal)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    _buffer->storage->seal();
+    lua_settop(L_, 1);
+    return 1;
+}
+
+// #################################################################################################
+
+// bool = buffer:sealed()
+LUAG_FUNC(buffer_sealed)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    lua_pushboolean(L_, _buffer->storage->isSealed() ? 1 : 0);
+    return 1;
+}
+
+// #################################################################################################
+
+/*
+ * slice = buffer:slice([i [, j]])
+ *
+ * A new buffer viewing bytes i..j of the buffer (same semantics as string.sub), without copying them
+ */
+LUAG_FUNC(buffer_slice)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    auto const [_offset, _length] = CheckRange(L_, 2, _buffer->view().size());
+    Buffer* const _slice{ new (_buffer->U) Buffer{ _buffer->U, _buffer->storage, _buffer->offset + _offset, _length } };
+    DeepFactory::PushDeepProxy(DestState{ L_ }, _slice, 0, LookupMode::LaneBody, L_);             // L_: buffer [i [j]] slice
+    return 1;
+}
+
+// #################################################################################################
+
+/*
+ * string = buffer:tostring([i [, j]])
+ *
+ * Copy the bytes i..j of the buffer (same semantics as string.sub) in a Lua string
+ */
+LUAG_FUNC(buffer_tostring)
+{
+    Buffer* const _buffer{ ToBuffer(L_, 1) };
+    std::string_view const _view{ _buffer->view() };
+    auto const [_offset, _length] = CheckRange(L_, 2, _view.size());
+    std::ignore = lua_pushstringview(L_, _view.substr(_offset, _length));
+    return 1;
+}
+
+// #################################################################################################
+
+namespace {
+    namespace local {
+        static luaL_Reg const sBufferMT[] = {
+            { "__len", LG_buffer_len },
+            { "__tostring", LG_buffer_tostring },
+            { "append", LG_buffer_append },
+            { "capacity", LG_buffer_capacity },
+            { "deep", LG_buffer_deep },
+            { "seal", LG_buffer_seal },
+            { "sealed", LG_buffer_sealed },
+            { "slice", LG_buffer_slice },
+            { "tostring", LG_buffer_tostring },
+            { nullptr, nullptr }
+        };
+    } // namespace local
+} // namespace
+/*static*/ BufferFactory BufferFactory::Instance{ local::sBufferMT };
+
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * buffer = lanes.buffer(string|capacity)
+ *
+ * returns a sealed buffer holding a copy of the string, or an empty buffer that can receive up to 'capacity' bytes
+ */
+LUAG_FUNC(buffer)
+{
+    luaL_argcheck(L_, lua_gettop(L_) == 1, 1, "expected a single argument");
+    if (lua_type(L_, 1) != LUA_TSTRING) {
+        lua_Integer const _capacity{ luaL_checkinteger(L_, 1) };
+        luaL_argcheck(L_, _capacity >= 0, 1, "capacity must be >= 0");
+    }
+    return BufferFactory::Instance.pushDeepUserdata(DestState{ L_ }, 0);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "deep.h"
+#include "universe.h"
+
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+// #################################################################################################
+
+// a refcounted byte region allocated with the internal allocator, that several Lua-side buffers can view
+// bytes are appended once and never modified, so readers never need to lock
+class BufferStorage
+{
+    private:
+    std::atomic<int> refcount{ 1 };
+    std::mutex appendMutex;
+    std::atomic<size_t> size{ 0 };
+    size_t const capacity{ 0 };
+    std::atomic<bool> sealed{ false };
+
+    BufferStorage(size_t capacity_)
+    : capacity{ capacity_ }
+    {
+    }
+    ~BufferStorage() = default;
+
+    [[nodiscard]] char* data() { return std::bit_cast<char*>(this + 1); }
+
+    public:
+    // non-copyable, non-movable
+    BufferStorage(BufferStorage const&) = delete;
+    BufferStorage(BufferStorage const&&) = delete;
+    BufferStorage& operator=(BufferStorage const&) = delete;
+    BufferStorage& operator=(BufferStorage const&&) = delete;
+
+    [[nodiscard]] static BufferStorage* Create(Universe* U_, size_t capacity_);
+    [[nodiscard]] static BufferStorage* Create(Universe* U_, std::string_view const& bytes_);
+    void acquire() { refcount.fetch_add(1, std::memory_order_relaxed); }
+    [[nodiscard]] bool append(std::string_view const& bytes_);
+    [[nodiscard]] size_t getCapacity() const { return capacity; }
+    [[nodiscard]] size_t getSize() const { return size.load(std::memory_order_acquire); }
+    [[nodiscard]] bool isSealed() const { return sealed.load(std::memory_order_acquire); }
+    void release(Universe* U_);
+    void seal() { sealed.store(true, std::memory_order_release); }
+    [[nodiscard]] std::string_view view(size_t offset_, size_t length_) { return std::string_view{ data() + offset_, length_ }; }
+};
+
+// #################################################################################################
+
+// what lanes.buffer() returns: either a whole BufferStorage, or a fixed slice of it
+class Buffer
+: public DeepPrelude // Deep userdata MUST start with this header
+{
+    public:
+    Universe* const U{ nullptr }; // the universe this buffer belongs to
+    BufferStorage* const storage{ nullptr };
+    size_t const offset{ 0 };
+    // unset for a whole buffer, that sees all bytes appended so far
+    std::optional<size_t> const length{};
+    // a large string value stored out of a keeper state, that becomes a string again when it leaves the keeper
+    bool const offloadedString{ false };
+    // a LuaJIT cdata stored in a keeper state (that doesn't load the ffi), that becomes a cdata of this ctype again when it leaves the keeper
+    std::string_view const cdataType{};
+
+    public:
+    [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept { return U_->internalAllocator.alloc(size_); }
+    // always embedded somewhere else or "in-place constructed" as a full userdata
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete(void* p_, Universe* U_) { U_->internalAllocator.free(p_, sizeof(Buffer)); }
+    // this one is for us, to make sure memory is freed by the correct allocator
+    static void operator delete(void* p_) { static_cast<Buffer*>(p_)->U->internalAllocator.free(p_, sizeof(Buffer)); }
+
+    ~Buffer();
+    Buffer(Universe* U_, BufferStorage* storage_, size_t offset_, std::optional<size_t> length_, bool offloadedString_ = false, std::string_view const& cdataType_ = {});
+    Buffer() = delete;
+    // non-copyable, non-movable
+    Buffer(Buffer const&) = delete;
+    Buffer(Buffer const&&) = delete;
+    Buffer& operator=(Buffer const&) = delete;
+    Buffer& operator=(Buffer const&&) = delete;
+
+    [[nodiscard]] static bool PushOffloadedCData(Universe* U_, DestState L_, std::string_view const& ctype_, std::string_view const& bytes_);
+    static void PushOffloadedString(Universe* U_, DestState L_, std::string_view const& string_);
+    [[nodiscard]] std::string_view view() const { return storage->view(offset, length.value_or(storage->getSize())); }
+};
+
+// #################################################################################################
+
+class BufferFactory
+: public DeepFactory
+{
+    public:
+    static BufferFactory Instance;
+
+    BufferFactory(luaL_Reg const bufferMT_[])
+    : mBufferMT{ bufferMT_ }
+    {
+    }
+
+    private:
+    luaL_Reg const* const mBufferMT{ nullptr };
+
+    void createMetatable(lua_State* L_) const override;
+    void deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const override;
+    [[nodiscard]] std::string_view moduleName() const override;
+    [[nodiscard]] DeepPrelude* newDeepObjectInternal(lua_State* L_) const override;
+};
@@ -37,6 +37,7 @@ THE SOFTWARE.
 
 #include "debugspew.h"
 #include "lane.h"
+#include "scheduler.h"
 
 // #################################################################################################
 // #################################################################################################
@@ -113,7 +114,7 @@ LUAG_FUNC(cancel_test)
     if (wakeLane_) { // wake the thread so that execution returns from any pending linda operation if desired
         std::condition_variable* const _waiting_on{ lane_->waiting_on };
         if (lane_->status == Lane::Waiting && _waiting_on != nullptr) {
-            _waiting_on->notify_all();
+            Scheduler::NotifyAll(lane_->U, *_waiting_on);
         }
     }
 
@@ -129,7 +130,7 @@ LUAG_FUNC(cancel_test)
     if (wakeLane_) { // wake the thread so that execution returns from any pending linda operation if desired
         std::condition_variable* const _waiting_on{ lane_->waiting_on };
         if (lane_->status == Lane::Waiting && _waiting_on != nullptr) {
-            _waiting_on->notify_all();
+            Scheduler::NotifyAll(lane_->U, *_waiting_on);
         }
     }
 
@@ -153,7 +154,9 @@ CancelResult thread_cancel(Lane* lane_, CancelOp op_, int hookCount_, std::chron
     if (op_ == CancelOp::Soft) {
         return thread_cancel_soft(lane_, until_, wakeLane_);
     } else if (static_cast<int>(op_) > static_cast<int>(CancelOp::Soft)) {
-        lua_sethook(lane_->L, cancel_hook, static_cast<int>(op_), hookCount_);
+        // a scheduled lane body runs in a coroutine, that inherits the hook of L when it isn't created yet
+        lua_State* const _co{ lane_->coroutine };
+        lua_sethook(_co ? _co : lane_->L, cancel_hook, static_cast<int>(op_), hookCount_);
     }
 
     return thread_cancel_hard(lane_, until_, wakeLane_);
@@ -199,45 +202,66 @@ CancelOp which_cancel_op(std::string_view const& opString_)
 
 // #################################################################################################
 
-// bool[,reason] = lane_h:cancel( [mode, hookcount] [, timeout] [, wake_lane])
-LUAG_FUNC(thread_cancel)
+// [mode, hookcount] [, timeout] [, wake_lane], starting at idx_: each argument is removed from the stack once processed
+CancelArgs read_cancel_args(lua_State* const L_, int const idx_)
 {
-    Lane* const _lane{ ToLane(L_, 1) };
-    CancelOp const _op{ which_cancel_op(L_, 2) }; // this removes the op string from the stack
+    CancelArgs _args{};
+    _args.op = which_cancel_op(L_, idx_); // this removes the op string from the stack
 
-    int _hook_count{ 0 };
-    if (static_cast<int>(_op) > static_cast<int>(CancelOp::Soft)) { // hook is requested
-        _hook_count = static_cast<int>(luaL_checkinteger(L_, 2));
-        lua_remove(L_, 2); // argument is processed, remove it
-        if (_hook_count < 1) {
+    if (static_cast<int>(_args.op) > static_cast<int>(CancelOp::Soft)) { // hook is requested
+        _args.hookCount = static_cast<int>(luaL_checkinteger(L_, idx_));
+        lua_remove(L_, idx_); // argument is processed, remove it
+        if (_args.hookCount < 1) {
             raise_luaL_error(L_, "hook count cannot be < 1");
         }
     }
 
-    std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
-    if (lua_type(L_, 2) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
-        lua_Duration const duration{ lua_tonumber(L_, 2) };
+    _args.until = std::chrono::time_point<std::chrono::steady_clock>::max();
+    if (lua_type(L_, idx_) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
+        lua_Duration const duration{ lua_tonumber(L_, idx_) };
         if (duration.count() >= 0.0) {
-            _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+            _args.until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
         } else {
-            raise_luaL_argerror(L_, 2, "duration cannot be < 0");
+            raise_luaL_argerror(L_, idx_, "duration cannot be < 0");
         }
-        lua_remove(L_, 2); // argument is processed, remove it
-    } else if (lua_isnil(L_, 2)) { // alternate explicit "infinite timeout" by passing nil before the key
-        lua_remove(L_, 2); // argument is processed, remove it
+        lua_remove(L_, idx_); // argument is processed, remove it
+    } else if (lua_isnil(L_, idx_)) { // alternate explicit "infinite timeout" by passing nil before the key
+        lua_remove(L_, idx_); // argument is processed, remove it
     }
 
     // we wake by default in "hard" mode (remember that hook is hard too), but this can be turned off if desired
-    bool _wake_lane{ _op != CancelOp::Soft };
-    if (lua_gettop(L_) >= 2) {
-        if (!lua_isboolean(L_, 2)) {
+    _args.wakeLane = (_args.op != CancelOp::Soft);
+    if (lua_gettop(L_) >= idx_) {
+        if (!lua_isboolean(L_, idx_)) {
             raise_luaL_error(L_, "wake_lindas parameter is not a boolean");
         }
-        _wake_lane = lua_toboolean(L_, 2);
-        lua_remove(L_, 2); // argument is processed, remove it
+        _args.wakeLane = lua_toboolean(L_, idx_);
+        lua_remove(L_, idx_); // argument is processed, remove it
     }
+    return _args;
+}
+
+// #################################################################################################
+
+// wakes the lane if it waits on a linda (or is parked on any condition variable), unless another lane waiting on the same one was already woken
+// many lanes often wait on the same linda: waking all its waiters once for each of them would be quadratic
+void CancelWaker::wake(Lane* const lane_)
+{
+    std::condition_variable* const _waiting_on{ lane_->waiting_on };
+    if (lane_->status == Lane::Waiting && _waiting_on != nullptr && woken.insert(_waiting_on).second) {
+        Scheduler::NotifyAll(lane_->U, *_waiting_on);
+    }
+}
+
+// #################################################################################################
+
+// bool[,reason] = lane_h:cancel( [mode, hookcount] [, timeout] [, wake_lane])
+LUAG_FUNC(thread_cancel)
+{
+    Lane* const _lane{ ToLane(L_, 1) };
+    CancelArgs const _args{ read_cancel_args(L_, 2) };
     STACK_CHECK_START_REL(L_, 0);
-    switch (thread_cancel(_lane, _op, _hook_count, _until, _wake_lane)) {
+    switch (thread_cancel(_lane, _args.op, _args.hookCount, _args.until, _args.wakeLane)) {
     default: // should never happen unless we added a case and forgot to handle it
         LUA_ASSERT(L_, false);
         break;
@@ -14,7 +14,9 @@ extern "C"
 #include "macros_and_utils.h"
 #include "uniquekey.h"
 
+#include <condition_variable>
 #include <string_view>
+#include <unordered_set>
 
 // #################################################################################################
 
@@ -51,6 +53,26 @@ enum class CancelOp
 // xxh64 of string "kCancelError" generated at https://www.pelock.com/products/hash-calculator
 static constexpr UniqueKey kCancelError{ 0x0630345FEF912746ull, "lanes.cancel_error" }; // 'raise_cancel_error' sentinel
 
+// what lane_h:cancel() and group:cancel() accept
+struct CancelArgs
+{
+    CancelOp op{ CancelOp::Hard };
+    int hookCount{ 0 };
+    std::chrono::time_point<std::chrono::steady_clock> until{};
+    bool wakeLane{ true };
+};
+
+// wakes the lanes cancelled all at once, notifying each condition variable they wait on only once
+class CancelWaker
+{
+    private:
+    std::unordered_set<std::condition_variable*> woken;
+
+    public:
+    void wake(Lane* lane_);
+};
+
+[[nodiscard]] CancelArgs read_cancel_args(lua_State* L_, int idx_);
 [[nodiscard]] CancelOp which_cancel_op(std::string_view const& opString_);
 [[nodiscard]] CancelResult thread_cancel(Lane* lane_, CancelOp op_, int hookCount_, std::chrono::time_point<std::chrono::steady_clock> until_, bool wakeLane_);
 
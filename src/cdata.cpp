@@ -0,0 +1,373 @@
+/*
+ * CDATA.CPP                    Copyright (c) 2024-, Benoit Germain
+ *
+ * Transfer of LuaJIT FFI cdata by value
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "cdata.h"
+
+#include "universe.h"
+
+#include <string>
+
+#if LUAJIT_FLAVOR() != 0
+
+// ctype string as shown by tostring(ffi.typeof()) in this state -> name of the registered ctype
+// xxh64 of string "kCTypeNamesRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kCTypeNamesRegKey{ 0x691072F3DE9620D3ull };
+
+// ctype name -> ctype object, so that each state parses a given ctype name only once
+// xxh64 of string "kCTypeCacheRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kCTypeCacheRegKey{ 0x0425E14964745F6Full };
+
+// #################################################################################################
+// #################################################################################################
+namespace {
+    namespace local {
+
+        // pushes the ffi module, loading it in the state if necessary
+        static void PushFFI(lua_State* const L_)
+        {
+            STACK_CHECK_START_REL(L_, 0);
+            std::ignore = luaL_getsubtable(L_, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);               // L_: _R._LOADED
+            if (luaG_getfield(L_, -1, LUA_FFILIBNAME) == LuaType::NIL) {                           // L_: _R._LOADED ffi|nil
+                lua_pop(L_, 1);                                                                    // L_: _R._LOADED
+                // luaL_requiref() would open the library again if it is already loaded, which resets the ctype state
+                luaL_requiref(L_, LUA_FFILIBNAME, luaopen_ffi, 0);                                 // L_: _R._LOADED ffi
+            }
+            lua_remove(L_, -2);                                                                    // L_: ffi
+            STACK_CHECK(L_, 1);
+        }
+
+        // #########################################################################################
+
+        // pushes the string describing the ctype object at idx_, returns it without the "ctype<>" decoration
+        [[nodiscard]] static std::string_view PushCTypeString(lua_State* const L_, int const idx_)
+        {
+            std::ignore = luaL_callmeta(L_, idx_, "__tostring");                                   // L_: "ctype<...>"
+            std::string_view _s{ lua_tostringview(L_, -1) };
+            static constexpr std::string_view kPrefix{ "ctype<" };
+            if (_s.starts_with(kPrefix) && _s.ends_with('>')) {
+                _s = _s.substr(kPrefix.size(), _s.size() - kPrefix.size() - 1);
+            }
+            return _s;
+        }
+
+        // #########################################################################################
+
+        // "double [4]" -> "double", "struct 102 [?]" -> "struct 102"
+        [[nodiscard]] static std::string_view ElementName(std::string_view const& ctype_)
+        {
+            std::string_view _element{ ctype_.substr(0, ctype_.find('[')) };
+            while (_element.ends_with(' ')) {
+                _element.remove_suffix(1);
+            }
+            return _element;
+        }
+
+        // #########################################################################################
+
+        // aggregates can hide pointers, and anonymous ones are only known by an id that is specific to each state
+        [[nodiscard]] static bool NeedsRegistration(std::string_view const& element_)
+        {
+            return element_.starts_with("struct ") || element_.starts_with("union ") || element_.starts_with("enum ");
+        }
+
+        // #########################################################################################
+
+        // searches the registered ctypes for the one that has the given ctype string in this state
+        // L_: ffi
+        static void ScanRegisteredCTypes(Universe* const U_, lua_State* const L_)
+        {
+            STACK_CHECK_START_REL(L_, 0);
+            std::ignore = kCTypeNamesRegKey.getSubTable(L_, 0, 0);                                 // L_: ffi {names}
+            for (std::string_view const& _name : U_->ctypeRegistry.registeredNames()) {
+                lua_getfield(L_, -2, "typeof");                                                    // L_: ffi {names} ffi.typeof
+                std::ignore = lua_pushstringview(L_, _name);                                       // L_: ffi {names} ffi.typeof "name"
+                if (ToLuaError(lua_pcall(L_, 1, 1, 0)) != LuaError::OK) {                          // L_: ffi {names} ct|err
+                    // not declared in this state, therefore it can't be the ctype of any of its cdata
+                    lua_pop(L_, 1);                                                                // L_: ffi {names}
+                    continue;
+                }
+                std::string_view const _ctype{ PushCTypeString(L_, -1) };                          // L_: ffi {names} ct "ctype<...>"
+                std::ignore = lua_pushstringview(L_, _ctype);                                      // L_: ffi {names} ct "ctype<...>" "..."
+                std::ignore = lua_pushstringview(L_, _name);                                       // L_: ffi {names} ct "ctype<...>" "..." "name"
+                lua_rawset(L_, -5);                                                                // L_: ffi {names} ct "ctype<...>"
+                lua_pop(L_, 2);                                                                    // L_: ffi {names}
+            }
+            lua_pop(L_, 1);                                                                        // L_: ffi
+            STACK_CHECK(L_, 0);
+        }
+
+        // #########################################################################################
+
+        // U, "ctype", bytes, size -> cdata
+        // runs protected, because the ctype may not be known in the destination state
+        [[nodiscard]] static int PushCData(lua_State* const L_)
+        {
+            Universe* const _U{ static_cast<Universe*>(lua_touserdata(L_, 1)) };
+            std::string_view const _ctype{ lua_tostringview(L_, 2) };
+            void const* const _bytes{ lua_touserdata(L_, 3) };
+            size_t const _size{ static_cast<size_t>(lua_tointeger(L_, 4)) };
+            lua_settop(L_, 2);                                                                     // L_: U "ctype"
+            PushFFI(L_);                                                                           // L_: U "ctype" ffi
+            std::ignore = kCTypeCacheRegKey.getSubTable(L_, 0, 0);                                 // L_: U "ctype" ffi {cache}
+            lua_pushvalue(L_, 2);                                                                  // L_: U "ctype" ffi {cache} "ctype"
+            lua_rawget(L_, -2);                                                                    // L_: U "ctype" ffi {cache} ct|nil
+            if (lua_isnil(L_, -1)) {
+                lua_pop(L_, 1);                                                                    // L_: U "ctype" ffi {cache}
+                lua_getfield(L_, 3, "typeof");                                                     // L_: U "ctype" ffi {cache} ffi.typeof
+                lua_pushvalue(L_, 2);                                                              // L_: U "ctype" ffi {cache} ffi.typeof "ctype"
+                if (ToLuaError(lua_pcall(L_, 1, 1, 0)) != LuaError::OK) {                          // L_: U "ctype" ffi {cache} ct|err
+                    lua_pop(L_, 1);                                                                // L_: U "ctype" ffi {cache}
+                    // the ctype is not known here yet: declare it if it was registered along with its declaration
+                    std::string_view const _element{ ElementName(_ctype) };
+                    std::optional<std::string_view> const _declaration{ _U->ctypeRegistry.findDeclaration(_element) };
+                    if (!_declaration.has_value() || _declaration->empty()) {
+                        raise_luaL_error(L_, "ctype '%s' is not declared in the destination state", lua_tostring(L_, 2));
+                    }
+                    lua_getfield(L_, 3, "cdef");                                                   // L_: U "ctype" ffi {cache} ffi.cdef
+                    std::ignore = lua_pushstringview(L_, _declaration.value());                    // L_: U "ctype" ffi {cache} ffi.cdef "declaration"
+                    lua_call(L_, 1, 0);                                                            // L_: U "ctype" ffi {cache}
+                    lua_getfield(L_, 3, "typeof");                                                 // L_: U "ctype" ffi {cache} ffi.typeof
+                    lua_pushvalue(L_, 2);                                                          // L_: U "ctype" ffi {cache} ffi.typeof "ctype"
+                    lua_call(L_, 1, 1);                                                            // L_: U "ctype" ffi {cache} ct
+                }
+                lua_pushvalue(L_, 2);                                                              // L_: U "ctype" ffi {cache} ct "ctype"
+                lua_pushvalue(L_, -2);                                                             // L_: U "ctype" ffi {cache} ct "ctype" ct
+                lua_rawset(L_, -4);                                                                // L_: U "ctype" ffi {cache} ct
+            }
+            lua_getfield(L_, 3, "new");                                                            // L_: U "ctype" ffi {cache} ct ffi.new
+            lua_pushvalue(L_, -2);                                                                 // L_: U "ctype" ffi {cache} ct ffi.new ct
+            int _nargs{ 1 };
+            if (_ctype.ends_with("[?]")) {
+                // variable length array: find how many elements we need
+                lua_getfield(L_, 3, "sizeof");                                                     // L_: U "ctype" ffi {cache} ct ffi.new ct ffi.sizeof
+                lua_pushvalue(L_, -2);                                                             // L_: U "ctype" ffi {cache} ct ffi.new ct ffi.sizeof ct
+                lua_pushinteger(L_, 1);                                                            // L_: U "ctype" ffi {cache} ct ffi.new ct ffi.sizeof ct 1
+                lua_call(L_, 2, 1);                                                                // L_: U "ctype" ffi {cache} ct ffi.new ct elemsize
+                lua_Integer const _elemSize{ lua_tointeger(L_, -1) };
+                lua_pop(L_, 1);                                                                    // L_: U "ctype" ffi {cache} ct ffi.new ct
+                lua_pushinteger(L_, (_elemSize > 0) ? static_cast<lua_Integer>(_size) / _elemSize : 0); // L_: U "ctype" ffi {cache} ct ffi.new ct count
+                _nargs = 2;
+            }
+            lua_call(L_, _nargs, 1);                                                               // L_: U "ctype" ffi {cache} ct cdata
+            lua_getfield(L_, 3, "sizeof");                                                         // L_: U "ctype" ffi {cache} ct cdata ffi.sizeof
+            lua_pushvalue(L_, -2);                                                                 // L_: U "ctype" ffi {cache} ct cdata ffi.sizeof cdata
+            lua_call(L_, 1, 1);                                                                    // L_: U "ctype" ffi {cache} ct cdata size
+            if (static_cast<size_t>(lua_tointeger(L_, -1)) != _size) {
+                raise_luaL_error(L_, "ctype '%s' doesn't have the same size in the source and destination states", lua_tostring(L_, 2));
+            }
+            lua_pop(L_, 1);                                                                        // L_: U "ctype" ffi {cache} ct cdata
+            std::memcpy(const_cast<void*>(lua_topointer(L_, -1)), _bytes, _size);
+            return 1;
+        }
+
+        // #########################################################################################
+
+        // walks the ctype tree with ffi.typeinfo(), that exposes LuaJIT's CType records: a type in the upper 4 bits of 'info', a child ctype id in the lower 16 bits
+        // struct and union members are chained through 'sib', starting with the aggregate's own 'sib'
+        // L_: ffi.typeinfo
+        [[nodiscard]] static bool HasPointers(lua_State* const L_, lua_Integer const cid_)
+        {
+            enum class CT : uint32_t { Struct = 1, Ptr = 2, Array = 3, Func = 6, Typedef = 7, Attrib = 8, Field = 9 };
+            STACK_GROW(L_, 3);
+            STACK_CHECK_START_REL(L_, 0);
+            lua_pushvalue(L_, -1);                                                                 // L_: ffi.typeinfo ffi.typeinfo
+            lua_pushinteger(L_, cid_);                                                             // L_: ffi.typeinfo ffi.typeinfo cid
+            lua_call(L_, 1, 1);                                                                    // L_: ffi.typeinfo {info}
+            std::ignore = luaG_getfield(L_, -1, "info");                                           // L_: ffi.typeinfo {info} info
+            uint32_t const _info{ static_cast<uint32_t>(lua_tointeger(L_, -1)) };
+            std::ignore = luaG_getfield(L_, -2, "sib");                                            // L_: ffi.typeinfo {info} info sib|nil
+            lua_Integer _member{ lua_isnil(L_, -1) ? 0 : lua_tointeger(L_, -1) };
+            lua_pop(L_, 3);                                                                        // L_: ffi.typeinfo
+            STACK_CHECK(L_, 0);
+            switch (static_cast<CT>(_info >> 28)) {
+            case CT::Ptr: // references too
+            case CT::Func:
+                return true;
+
+            case CT::Struct: // unions too
+                while (_member != 0) {
+                    if (HasPointers(L_, _member)) {
+                        return true;
+                    }
+                    lua_pushvalue(L_, -1);                                                         // L_: ffi.typeinfo ffi.typeinfo
+                    lua_pushinteger(L_, _member);                                                  // L_: ffi.typeinfo ffi.typeinfo member
+                    lua_call(L_, 1, 1);                                                            // L_: ffi.typeinfo {info}
+                    std::ignore = luaG_getfield(L_, -1, "sib");                                    // L_: ffi.typeinfo {info} sib|nil
+                    _member = lua_isnil(L_, -1) ? 0 : lua_tointeger(L_, -1);
+                    lua_pop(L_, 2);                                                                // L_: ffi.typeinfo
+                }
+                return false;
+
+            case CT::Array:
+            case CT::Typedef:
+            case CT::Attrib:
+            case CT::Field:
+                return HasPointers(L_, static_cast<lua_Integer>(_info & 0xFFFF));
+
+            default: // numbers, void, enums, bit fields, constants
+                return false;
+            }
+        }
+
+    } // namespace local
+} // namespace
+
+// #################################################################################################
+// #################################################################################################
+
+[[nodiscard]] cdata::Description cdata::Describe(Universe* const U_, lua_State* const L_, int const idx_)
+{
+    int const _idx{ lua_absindex(L_, idx_) };
+    STACK_GROW(L_, 5);
+    STACK_CHECK_START_REL(L_, 0);
+    local::PushFFI(L_);                                                                            // L_: ffi
+    lua_getfield(L_, -1, "typeof");                                                                // L_: ffi ffi.typeof
+    lua_pushvalue(L_, _idx);                                                                       // L_: ffi ffi.typeof cdata
+    lua_call(L_, 1, 1);                                                                            // L_: ffi ct
+    std::string_view const _ctype{ local::PushCTypeString(L_, -1) };                               // L_: ffi ct "ctype"
+    if (_ctype.find_first_of("*&(") != std::string_view::npos) {
+        raise_luaL_error(L_, "%s can't be transferred: pointers are meaningless in another state", lua_tostring(L_, -1));
+    }
+    std::string_view const _element{ local::ElementName(_ctype) };
+    std::string_view _name;
+    if (local::NeedsRegistration(_element)) {
+        std::ignore = kCTypeNamesRegKey.getSubTable(L_, 0, 0);                                     // L_: ffi ct "ctype" {names}
+        std::ignore = lua_pushstringview(L_, _element);                                            // L_: ffi ct "ctype" {names} "element"
+        lua_rawget(L_, -2);                                                                        // L_: ffi ct "ctype" {names} "name"|nil
+        if (lua_isnil(L_, -1)) {
+            // maybe the ctype was registered since we last looked
+            lua_pop(L_, 1);                                                                        // L_: ffi ct "ctype" {names}
+            lua_pushvalue(L_, -4);                                                                 // L_: ffi ct "ctype" {names} ffi
+            local::ScanRegisteredCTypes(U_, L_);
+            lua_pop(L_, 1);                                                                        // L_: ffi ct "ctype" {names}
+            std::ignore = lua_pushstringview(L_, _element);                                        // L_: ffi ct "ctype" {names} "element"
+            lua_rawget(L_, -2);                                                                    // L_: ffi ct "ctype" {names} "name"|nil
+            if (lua_isnil(L_, -1)) {
+                raise_luaL_error(L_, "%s can't be transferred: it must be registered with lanes.register_ctype()", lua_tostring(L_, -3));
+            }
+        }
+        // the registered name, followed by the array dimensions, if any
+        std::string const _fullName{ std::string{ lua_tostringview(L_, -1) } + std::string{ _ctype.substr(_element.size()) } };
+        _name = U_->ctypeRegistry.intern(_fullName);
+        lua_pop(L_, 2);                                                                            // L_: ffi ct "ctype"
+    } else {
+        // built-in ctypes have the same name everywhere
+        _name = U_->ctypeRegistry.intern(_ctype);
+    }
+    lua_getfield(L_, -3, "sizeof");                                                                // L_: ffi ct "ctype" ffi.sizeof
+    lua_pushvalue(L_, _idx);                                                                       // L_: ffi ct "ctype" ffi.sizeof cdata
+    lua_call(L_, 1, 1);                                                                            // L_: ffi ct "ctype" size
+    size_t const _size{ static_cast<size_t>(lua_tointeger(L_, -1)) };
+    lua_pop(L_, 4);                                                                                // L_:
+    STACK_CHECK(L_, 0);
+    return Description{ _name, std::string_view{ static_cast<char const*>(lua_topointer(L_, _idx)), _size } };
+}
+
+// #################################################################################################
+
+[[nodiscard]] bool cdata::Push(Universe* const U_, lua_State* const L_, std::string_view const& ctype_, std::string_view const& bytes_)
+{
+    STACK_GROW(L_, 5);
+    STACK_CHECK_START_REL(L_, 0);
+    lua_pushcfunction(L_, local::PushCData);                                                       // L_: PushCData
+    lua_pushlightuserdata(L_, U_);                                                                 // L_: PushCData U
+    std::ignore = lua_pushstringview(L_, ctype_);                                                  // L_: PushCData U "ctype"
+    lua_pushlightuserdata(L_, const_cast<char*>(bytes_.data()));                                   // L_: PushCData U "ctype" bytes
+    lua_pushinteger(L_, static_cast<lua_Integer>(bytes_.size()));                                  // L_: PushCData U "ctype" bytes size
+    LuaError const _rc{ ToLuaError(lua_pcall(L_, 4, 1, 0)) };                                      // L_: cdata|err
+    STACK_CHECK(L_, 1);
+    return _rc == LuaError::OK;
+}
+
+// #################################################################################################
+
+// lanes.register_ctype("name" [, "declaration"])
+// the cdata of a registered ctype are transferred by value: it must not contain pointers
+// if a declaration is provided, it is given to ffi.cdef() in the states that don't know the ctype yet, this one included
+LUAG_FUNC(register_ctype)
+{
+    std::string_view const _name{ luaL_checkstringview(L_, 1) };
+    std::string_view const _declaration{ luaL_optstringview(L_, 2, "") };
+    luaL_argcheck(L_, _name.find_first_of("*&(") == std::string_view::npos, 1, "pointer ctypes can't be transferred");
+    lua_settop(L_, 2);                                                                             // L_: "name" "declaration"|nil
+    STACK_GROW(L_, 4);
+    STACK_CHECK_START_REL(L_, 0);
+    local::PushFFI(L_);                                                                            // L_: "name" "declaration"|nil ffi
+    lua_getfield(L_, -1, "typeof");                                                                // L_: "name" "declaration"|nil ffi ffi.typeof
+    lua_pushvalue(L_, 1);                                                                          // L_: "name" "declaration"|nil ffi ffi.typeof "name"
+    if (ToLuaError(lua_pcall(L_, 1, 1, 0)) != LuaError::OK) {                                      // L_: "name" "declaration"|nil ffi ct|err
+        if (_declaration.empty()) {
+            raise_luaL_error(L_, "ctype '%s' must be declared, or registered along with its declaration", lua_tostring(L_, 1));
+        }
+        lua_pop(L_, 1);                                                                            // L_: "name" "declaration" ffi
+        lua_getfield(L_, -1, "cdef");                                                              // L_: "name" "declaration" ffi ffi.cdef
+        lua_pushvalue(L_, 2);                                                                      // L_: "name" "declaration" ffi ffi.cdef "declaration"
+        lua_call(L_, 1, 0);                                                                        // L_: "name" "declaration" ffi
+        lua_getfield(L_, -1, "typeof");                                                            // L_: "name" "declaration" ffi ffi.typeof
+        lua_pushvalue(L_, 1);                                                                      // L_: "name" "declaration" ffi ffi.typeof "name"
+        lua_call(L_, 1, 1);                                                                        // L_: "name" "declaration" ffi ct
+    }
+    // the ctype string only shows the pointers at the top level: the members of an aggregate must be inspected too
+    // LuaJIT 2.0 doesn't have ffi.typeinfo(), all we can check then is the declaration, if any
+    bool _hasPointers{ _declaration.find_first_of("*&") != std::string_view::npos };
+    if (luaG_getfield(L_, -2, "typeinfo") == LuaType::FUNCTION) {                                  // L_: "name" "declaration"|nil ffi ct ffi.typeinfo
+        // the payload of a ctype object is its id
+        lua_Integer const _cid{ static_cast<lua_Integer>(*static_cast<uint32_t const*>(lua_topointer(L_, -2))) };
+        _hasPointers = local::HasPointers(L_, _cid);
+    }
+    lua_pop(L_, 3);                                                                                // L_: "name" "declaration"|nil
+    STACK_CHECK(L_, 0);
+    if (_hasPointers) {
+        raise_luaL_error(L_, "ctype '%s' can't be registered: it contains pointers, that are meaningless in another state", lua_tostring(L_, 1));
+    }
+    Universe::Get(L_)->ctypeRegistry.add(_name, _declaration);
+    return 0;
+}
+
+#else // LUAJIT_FLAVOR()
+
+// #################################################################################################
+
+[[nodiscard]] cdata::Description cdata::Describe([[maybe_unused]] Universe* const U_, lua_State* const L_, [[maybe_unused]] int const idx_)
+{
+    raise_luaL_error(L_, "cdata can only be transferred when Lanes is built against LuaJIT");
+}
+
+// #################################################################################################
+
+[[nodiscard]] bool cdata::Push([[maybe_unused]] Universe* const U_, lua_State* const L_, [[maybe_unused]] std::string_view const& ctype_, [[maybe_unused]] std::string_view const& bytes_)
+{
+    lua_pushliteral(L_, "cdata can only be transferred when Lanes is built against LuaJIT");
+    return false;
+}
+
+#endif // LUAJIT_FLAVOR()
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "macros_and_utils.h"
+
+#include <string_view>
+
+// forwards
+class Universe;
+
+// #################################################################################################
+
+// LuaJIT FFI cdata of pointer-free ctypes are transferred by value: the destination gets a new cdata of the same ctype, holding a copy of the bytes
+// nothing here is functional when not building against LuaJIT
+namespace cdata {
+    struct Description
+    {
+        std::string_view ctype; // a name that designates the ctype in all states, valid as long as the Universe exists
+        std::string_view bytes; // the contents of the cdata, valid as long as the cdata exists
+    };
+
+    // raises an error in L_ if the cdata at idx_ can't be transferred
+    [[nodiscard]] Description Describe(Universe* U_, lua_State* L_, int idx_);
+    // pushes a new cdata on success, else the error message, without raising the error
+    [[nodiscard]] bool Push(Universe* U_, lua_State* L_, std::string_view const& ctype_, std::string_view const& bytes_);
+} // namespace cdata
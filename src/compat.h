@@ -223,6 +223,25 @@ inline int luaL_optint(lua_State* L_, int n_, lua_Integer d_)
 
 // #################################################################################################
 
+// a lane can only be parked by the scheduler if the blocking C functions can yield with a continuation
+#define HAVE_LANE_SCHEDULER() (LUA_VERSION_NUM >= 503)
+
+#if HAVE_LANE_SCHEDULER()
+// starting with Lua 5.4, lua_resume tells how many values were yielded or returned
+inline int luaG_resume(lua_State* L_, lua_State* from_, int nargs_, int* nresults_)
+{
+#if LUA_VERSION_NUM == 503
+    int const _rc{ lua_resume(L_, from_, nargs_) };
+    *nresults_ = lua_gettop(L_);
+    return _rc;
+#else // LUA_VERSION_NUM > 503
+    return lua_resume(L_, from_, nargs_, nresults_);
+#endif // LUA_VERSION_NUM > 503
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
 // a strong-typed wrapper over lua error codes to see them easier in a debugger
 enum class LuaError
 {
@@ -0,0 +1,562 @@
+/*
+ * FROZENTABLE.CPP                    Copyright (c) 2024-, Benoit Germain
+ *
+ * Immutable table trees shared between Lua states as deep userdata
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "frozentable.h"
+
+#include "tools.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+// must be a #define instead of a constexpr to work with lua_pushliteral (until I templatize it)
+#define kFrozenTableMetatableName "FrozenTable"
+
+// #################################################################################################
+// #################################################################################################
+namespace {
+    // #############################################################################################
+    // #############################################################################################
+
+    // read a number, keeping integer accuracy when the Lua flavor supports it
+    [[nodiscard]] static FrozenTable::Value ReadNumber(lua_State* const L_, int const idx_)
+    {
+#if defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        if (lua_isinteger(L_, idx_)) {
+            return FrozenTable::Value{ static_cast<lua_Integer>(lua_tointeger(L_, idx_)) };
+        }
+        // Lua normalizes float keys with an integral value, so we must do the same to find them
+        lua_Number const _n{ lua_tonumber(L_, idx_) };
+        static constexpr lua_Number kMinInteger{ static_cast<lua_Number>(std::numeric_limits<lua_Integer>::min()) };
+        if (_n >= kMinInteger && _n < -kMinInteger) {
+            lua_Integer const _i{ static_cast<lua_Integer>(_n) };
+            if (static_cast<lua_Number>(_i) == _n) {
+                return FrozenTable::Value{ _i };
+            }
+        }
+        return FrozenTable::Value{ _n };
+#else // defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        return FrozenTable::Value{ lua_tonumber(L_, idx_) };
+#endif // defined LUA_LNUM || LUA_VERSION_NUM >= 503
+    }
+
+    // #############################################################################################
+
+    // returns std::monostate if the value at idx_ can't be a frozen table key
+    [[nodiscard]] static FrozenTable::Value ReadKey(lua_State* const L_, int const idx_)
+    {
+        switch (lua_type_as_enum(L_, idx_)) {
+        case LuaType::BOOLEAN:
+            return FrozenTable::Value{ lua_toboolean(L_, idx_) ? true : false };
+
+        case LuaType::NUMBER:
+            return ReadNumber(L_, idx_);
+
+        case LuaType::STRING:
+            // the string_view points inside the Lua state: only valid as long as the string is on the stack
+            return FrozenTable::Value{ lua_tostringview(L_, idx_) };
+
+        default:
+            return FrozenTable::Value{};
+        }
+    }
+
+    // #############################################################################################
+
+    // 0 if the key doesn't index the array part, else the 1-based array index
+    [[nodiscard]] static size_t ArrayIndex(FrozenTable::Value const& key_, size_t const arraySize_)
+    {
+        if (std::holds_alternative<lua_Integer>(key_)) {
+            lua_Integer const _i{ std::get<lua_Integer>(key_) };
+            return (_i >= 1 && static_cast<size_t>(_i) <= arraySize_) ? static_cast<size_t>(_i) : 0;
+        }
+        if (std::holds_alternative<lua_Number>(key_)) {
+            lua_Number const _n{ std::get<lua_Number>(key_) };
+            return (_n >= 1 && _n <= static_cast<lua_Number>(arraySize_) && static_cast<lua_Number>(static_cast<size_t>(_n)) == _n) ? static_cast<size_t>(_n) : 0;
+        }
+        return 0;
+    }
+
+    // #############################################################################################
+
+    static void PushValue(lua_State* const L_, FrozenTable::Value const& value_)
+    {
+        std::visit(
+            [L_](auto const& v_) {
+                using T = std::decay_t<decltype(v_)>;
+                if constexpr (std::is_same_v<T, std::monostate>) {
+                    lua_pushnil(L_);
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    lua_pushboolean(L_, v_ ? 1 : 0);
+                } else if constexpr (std::is_same_v<T, lua_Integer>) {
+                    lua_pushinteger(L_, v_);
+                } else if constexpr (std::is_same_v<T, lua_Number>) {
+                    lua_pushnumber(L_, v_);
+                } else if constexpr (std::is_same_v<T, std::string_view>) {
+                    std::ignore = lua_pushstringview(L_, v_);
+                } else {
+                    // a nested frozen table: all states share the same deep object
+                    DeepFactory::PushDeepProxy(DestState{ L_ }, v_, 0, LookupMode::LaneBody, L_);
+                }
+            },
+            value_
+        );
+    }
+
+    // #############################################################################################
+
+    [[nodiscard]] static FrozenTable* ToFrozenTable(lua_State* const L_, int const idx_)
+    {
+        FrozenTable* const _frozen{ static_cast<FrozenTable*>(FrozenTableFactory::Instance.toDeep(L_, idx_)) };
+        luaL_argcheck(L_, _frozen != nullptr, idx_, "expecting a frozen table"); // doesn't return if _frozen is nullptr
+        return _frozen;
+    }
+
+    // #############################################################################################
+    // #############################################################################################
+} // namespace
+// #################################################################################################
+// #################################################################################################
+
+// #################################################################################################
+// #################################################################################################
+// ################################ FrozenTable implementation #####################################
+// #################################################################################################
+// #################################################################################################
+
+FrozenTable::FrozenTable(Universe* const U_)
+: DeepPrelude{ FrozenTableFactory::Instance }
+, U{ U_ }
+{
+}
+
+// #################################################################################################
+
+FrozenTable::~FrozenTable()
+{
+    if (storage) {
+        // all Value alternatives are trivially destructible, no need to run the destructors
+        U->internalAllocator.free(storage, storageSize);
+    }
+}
+
+// #################################################################################################
+
+void FrozenTable::allocateStorage(size_t const arraySize_, size_t const hashSize_, size_t const stringBytes_)
+{
+    static_assert(alignof(Entry) == alignof(Value));
+    arraySize = arraySize_;
+    hashSize = hashSize_;
+    storageSize = arraySize_ * sizeof(Value) + hashSize_ * sizeof(Entry) + stringBytes_;
+    if (storageSize == 0) {
+        return;
+    }
+    storage = U->internalAllocator.alloc(storageSize);
+    arrayPart = std::bit_cast<Value*>(storage);
+    std::uninitialized_default_construct_n(arrayPart, arraySize);
+    hashPart = std::bit_cast<Entry*>(arrayPart + arraySize);
+    std::uninitialized_default_construct_n(hashPart, hashSize);
+}
+
+// #################################################################################################
+
+// table to freeze at idx_, table at cacheIdx_ maps already frozen source tables to their FrozenTable*
+// the table tree must have been accepted by Validate() before, so that nothing can fail here
+FrozenTable* FrozenTable::Create(Universe* const U_, lua_State* const L_, int const idx_, int const cacheIdx_)
+{
+    STACK_GROW(L_, 3);
+    STACK_CHECK_START_REL(L_, 0);
+    int const _idx{ lua_absindex(L_, idx_) };
+
+    // a table referenced several times in the tree is only frozen once
+    lua_pushvalue(L_, _idx);                                                                       // L_: ... t
+    lua_rawget(L_, cacheIdx_);                                                                     // L_: ... frozen?
+    FrozenTable* const _cached{ lua_tolightuserdata<FrozenTable>(L_, -1) };
+    lua_pop(L_, 1);                                                                                // L_: ...
+    if (_cached) {
+        return _cached;
+    }
+
+    // count the array part, the table entries, and the bytes needed to store all the strings
+    size_t _arraySize{ 0 };
+    for (;; ++_arraySize) {
+        lua_rawgeti(L_, _idx, static_cast<lua_Integer>(_arraySize + 1));                           // L_: ... v?
+        bool const _isNil{ lua_isnil(L_, -1) ? true : false };
+        lua_pop(L_, 1);                                                                            // L_: ...
+        if (_isNil) {
+            break;
+        }
+    }
+    size_t _nbEntries{ 0 };
+    size_t _stringBytes{ 0 };
+    lua_pushnil(L_);                                                                               // L_: ... nil
+    while (lua_next(L_, _idx) != 0) {                                                              // L_: ... k v
+        if (lua_type(L_, -2) == LUA_TSTRING) {
+            _stringBytes += lua_rawlen(L_, -2);
+        }
+        if (lua_type(L_, -1) == LUA_TSTRING) {
+            _stringBytes += lua_rawlen(L_, -1);
+        }
+        ++_nbEntries;
+        lua_pop(L_, 1);                                                                            // L_: ... k
+    }                                                                                              // L_: ...
+    STACK_CHECK(L_, 0);
+
+    FrozenTable* const _frozen{ new (U_) FrozenTable{ U_ } };
+    _frozen->allocateStorage(_arraySize, _nbEntries - _arraySize, _stringBytes);
+    lua_pushvalue(L_, _idx);                                                                       // L_: ... t
+    lua_pushlightuserdata(L_, _frozen);                                                            // L_: ... t frozen
+    lua_rawset(L_, cacheIdx_);                                                                     // L_: ...
+
+    char* _strings{ std::bit_cast<char*>(_frozen->hashPart + _frozen->hashSize) };
+    auto _storeString = [&_strings](std::string_view const& s_) {
+        memcpy(_strings, s_.data(), s_.size());
+        std::string_view const _ret{ _strings, s_.size() };
+        _strings += s_.size();
+        return _ret;
+    };
+    // read the value on top of the stack, recursively freezing sub-tables
+    auto _readValue = [U_, L_, cacheIdx_, &_storeString]() -> Value {
+        switch (lua_type_as_enum(L_, -1)) {
+        case LuaType::BOOLEAN:
+            return Value{ lua_toboolean(L_, -1) ? true : false };
+
+        case LuaType::NUMBER:
+            return ReadNumber(L_, -1);
+
+        case LuaType::STRING:
+            return Value{ _storeString(lua_tostringview(L_, -1)) };
+
+        case LuaType::TABLE:
+            {
+                FrozenTable* const _child{ Create(U_, L_, -1, cacheIdx_) };
+                _child->refcount.fetch_add(1, std::memory_order_relaxed); // the parent holds a reference on its children
+                return Value{ _child };
+            }
+
+        default: // Validate() guarantees it's a frozen table proxy
+            {
+                FrozenTable* const _child{ static_cast<FrozenTable*>(FrozenTableFactory::Instance.toDeep(L_, -1)) };
+                _child->refcount.fetch_add(1, std::memory_order_relaxed);
+                return Value{ _child };
+            }
+        }
+    };
+
+    for (size_t _i{ 0 }; _i < _arraySize; ++_i) {
+        lua_rawgeti(L_, _idx, static_cast<lua_Integer>(_i + 1));                                   // L_: ... v
+        _frozen->arrayPart[_i] = _readValue();
+        lua_pop(L_, 1);                                                                            // L_: ...
+    }
+
+    size_t _h{ 0 };
+    lua_pushnil(L_);                                                                               // L_: ... nil
+    while (lua_next(L_, _idx) != 0) {                                                              // L_: ... k v
+        Value _key{ ReadKey(L_, -2) };
+        if (ArrayIndex(_key, _arraySize) == 0) {
+            if (std::holds_alternative<std::string_view>(_key)) {
+                _key = _storeString(std::get<std::string_view>(_key));
+            }
+            _frozen->hashPart[_h].key = _key;
+            _frozen->hashPart[_h].value = _readValue();
+            ++_h;
+        }
+        lua_pop(L_, 1);                                                                            // L_: ... k
+    }                                                                                              // L_: ...
+    LUA_ASSERT(L_, _h == _frozen->hashSize);
+    // sort the entries so that lookups can use a binary search
+    std::sort(_frozen->hashPart, _frozen->hashPart + _frozen->hashSize, [](Entry const& a_, Entry const& b_) { return a_.key < b_.key; });
+    STACK_CHECK(L_, 0);
+    return _frozen;
+}
+
+// #################################################################################################
+
+FrozenTable::Value const* FrozenTable::find(Value const& key_) const
+{
+    if (size_t const _i{ ArrayIndex(key_, arraySize) }; _i > 0) {
+        return &arrayPart[_i - 1];
+    }
+    Entry const* const _begin{ hashPart };
+    Entry const* const _end{ _begin + hashSize };
+    Entry const* const _entry{ std::lower_bound(_begin, _end, key_, [](Entry const& e_, Value const& k_) { return e_.key < k_; }) };
+    return (_entry != _end && _entry->key == key_) ? &_entry->value : nullptr;
+}
+
+// #################################################################################################
+
+// drop the references we hold on nested frozen tables
+void FrozenTable::releaseChildren(lua_State* const L_)
+{
+    auto _release = [L_](Value const& v_) {
+        if (std::holds_alternative<FrozenTable*>(v_)) {
+            FrozenTable* const _child{ std::get<FrozenTable*>(v_) };
+            if (_child->refcount.fetch_sub(1, std::memory_order_relaxed) == 1) {
+                DeepFactory::DeleteDeepObject(L_, _child);
+            }
+        }
+    };
+    for (size_t _i{ 0 }; _i < arraySize; ++_i) {
+        _release(arrayPart[_i]);
+    }
+    for (size_t _i{ 0 }; _i < hashSize; ++_i) {
+        _release(hashPart[_i].value);
+    }
+}
+
+// #################################################################################################
+
+// raise an error if the table tree at idx_ contains something we can't freeze
+// table at visitingIdx_ contains the tables currently being walked, to detect cycles
+void FrozenTable::Validate(lua_State* const L_, int const idx_, int const visitingIdx_)
+{
+    STACK_GROW(L_, 3);
+    STACK_CHECK_START_REL(L_, 0);
+    int const _idx{ lua_absindex(L_, idx_) };
+    lua_pushvalue(L_, _idx);                                                                       // L_: ... t
+    lua_pushboolean(L_, 1);                                                                        // L_: ... t true
+    lua_rawset(L_, visitingIdx_);                                                                  // L_: ...
+
+    lua_pushnil(L_);                                                                               // L_: ... nil
+    while (lua_next(L_, _idx) != 0) {                                                              // L_: ... k v
+        if (std::holds_alternative<std::monostate>(ReadKey(L_, -2))) {
+            raise_luaL_error(L_, "cannot freeze a table with %s keys", luaL_typename(L_, -2));
+        }
+        switch (lua_type_as_enum(L_, -1)) {
+        case LuaType::BOOLEAN:
+        case LuaType::NUMBER:
+        case LuaType::STRING:
+            break;
+
+        case LuaType::TABLE:
+            lua_pushvalue(L_, -1);                                                                 // L_: ... k v v
+            lua_rawget(L_, visitingIdx_);                                                          // L_: ... k v visiting?
+            if (lua_toboolean(L_, -1)) {
+                raise_luaL_error(L_, "cannot freeze a table with cycles");
+            }
+            lua_pop(L_, 1);                                                                        // L_: ... k v
+            Validate(L_, -1, visitingIdx_);
+            break;
+
+        case LuaType::USERDATA:
+            if (FrozenTableFactory::Instance.toDeep(L_, -1) != nullptr) {
+                break;
+            }
+            [[fallthrough]];
+
+        default:
+            raise_luaL_error(L_, "cannot freeze %s values", luaL_typename(L_, -1));
+        }
+        lua_pop(L_, 1);                                                                            // L_: ... k
+    }                                                                                              // L_: ...
+
+    lua_pushvalue(L_, _idx);                                                                       // L_: ... t
+    lua_pushnil(L_);                                                                               // L_: ... t nil
+    lua_rawset(L_, visitingIdx_);                                                                  // L_: ...
+    STACK_CHECK(L_, 0);
+}
+
+// #################################################################################################
+// #################################################################################################
+// ################################### FrozenTableFactory ##########################################
+// #################################################################################################
+// #################################################################################################
+
+void FrozenTableFactory::createMetatable(lua_State* L_) const
+{
+    STACK_CHECK_START_REL(L_, 0);
+    lua_newtable(L_);
+    // protect metatable from external access
+    lua_pushliteral(L_, kFrozenTableMetatableName);
+    lua_setfield(L_, -2, "__metatable");
+
+    luaG_registerlibfuncs(L_, mFrozenTableMT);
+    STACK_CHECK(L_, 1);
+}
+
+// #################################################################################################
+
+void FrozenTableFactory::deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const
+{
+    FrozenTable* const _frozen{ static_cast<FrozenTable*>(o_) };
+    LUA_ASSERT(L_, _frozen);
+    _frozen->releaseChildren(L_);
+    delete _frozen; // operator delete overload ensures things go as expected
+}
+
+// #################################################################################################
+
+std::string_view FrozenTableFactory::moduleName() const
+{
+    // same as lindas: lanes is necessarily loaded by the time we get here
+    return std::string_view{};
+}
+
+// #################################################################################################
+
+DeepPrelude* FrozenTableFactory::newDeepObjectInternal(lua_State* L_) const
+{
+    STACK_GROW(L_, 1);
+    STACK_CHECK_START_REL(L_, 0);
+    // make sure everything can be frozen before allocating anything, so that an error doesn't leak memory
+    lua_newtable(L_);                                                                              // L_: tbl {visiting}
+    FrozenTable::Validate(L_, 1, lua_gettop(L_));
+    lua_pop(L_, 1);                                                                                // L_: tbl
+
+    lua_newtable(L_);                                                                              // L_: tbl {cache}
+    FrozenTable* const _frozen{ FrozenTable::Create(Universe::Get(L_), L_, 1, lua_gettop(L_)) };
+    lua_pop(L_, 1);                                                                                // L_: tbl
+    STACK_CHECK(L_, 0);
+    return _frozen;
+}
+
+// #################################################################################################
+// #################################################################################################
+// ########################################## Lua API ##############################################
+// #################################################################################################
+// #################################################################################################
+
+// value = frozen[key]
+LUAG_FUNC(frozentable_index)
+{
+    FrozenTable* const _frozen{ ToFrozenTable(L_, 1) };
+    FrozenTable::Value const* const _value{ _frozen->find(ReadKey(L_, 2)) };
+    if (_value) {
+        PushValue(L_, *_value);
+    } else {
+        lua_pushnil(L_);
+    }
+    return 1;
+}
+
+// #################################################################################################
+
+// #frozen
+LUAG_FUNC(frozentable_len)
+{
+    FrozenTable* const _frozen{ ToFrozenTable(L_, 1) };
+    lua_pushinteger(L_, static_cast<lua_Integer>(_frozen->getArraySize()));
+    return 1;
+}
+
+// #################################################################################################
+
+LUAG_FUNC(frozentable_newindex)
+{
+    raise_luaL_error(L_, "attempt to modify a frozen table");
+}
+
+// #################################################################################################
+
+// upvalue 1: position of the next entry to visit
+// array part first, then sorted hash part
+LUAG_FUNC(frozentable_next)
+{
+    FrozenTable* const _frozen{ ToFrozenTable(L_, 1) };
+    size_t const _pos{ static_cast<size_t>(lua_tointeger(L_, lua_upvalueindex(1))) };
+    lua_pushinteger(L_, static_cast<lua_Integer>(_pos + 1));
+    lua_replace(L_, lua_upvalueindex(1));
+    if (_pos < _frozen->getArraySize()) {
+        lua_pushinteger(L_, static_cast<lua_Integer>(_pos + 1));
+        PushValue(L_, _frozen->getArrayValue(_pos));
+        return 2;
+    }
+    if (size_t const _h{ _pos - _frozen->getArraySize() }; _h < _frozen->getHashSize()) {
+        FrozenTable::Entry const& _entry{ _frozen->getHashEntry(_h) };
+        PushValue(L_, _entry.key);
+        PushValue(L_, _entry.value);
+        return 2;
+    }
+    return 0;
+}
+
+// #################################################################################################
+
+/*
+ * next, frozen, nil = lanes.frozen_pairs(frozen)
+ *
+ * also the __pairs metamethod, which Lua 5.1 and LuaJIT ignore
+ */
+LUAG_FUNC(frozen_pairs)
+{
+    std::ignore = ToFrozenTable(L_, 1);
+    lua_pushinteger(L_, 0);                                                                        // L_: frozen 0
+    lua_pushcclosure(L_, LG_frozentable_next, 1);                                                  // L_: frozen next
+    lua_pushvalue(L_, 1);                                                                          // L_: frozen next frozen
+    lua_pushnil(L_);                                                                               // L_: frozen next frozen nil
+    return 3;
+}
+
+// #################################################################################################
+
+LUAG_FUNC(frozentable_tostring)
+{
+    FrozenTable* const _frozen{ ToFrozenTable(L_, 1) };
+    lua_pushfstring(L_, kFrozenTableMetatableName ": %p", _frozen);
+    return 1;
+}
+
+// #################################################################################################
+
+namespace {
+    namespace local {
+        static luaL_Reg const sFrozenTableMT[] = {
+            { "__index", LG_frozentable_index },
+            { "__len", LG_frozentable_len },
+            { "__newindex", LG_frozentable_newindex },
+            { "__pairs", LG_frozen_pairs },
+            { "__tostring", LG_frozentable_tostring },
+            { nullptr, nullptr }
+        };
+    } // namespace local
+} // namespace
+/*static*/ FrozenTableFactory FrozenTableFactory::Instance{ local::sFrozenTableMT };
+
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * frozen = lanes.freeze(tbl)
+ *
+ * returns an immutable copy of the table tree, that can be shared with other lanes without copying it
+ */
+LUAG_FUNC(freeze)
+{
+    // freezing a frozen table is a no-op
+    if (FrozenTableFactory::Instance.toDeep(L_, 1) != nullptr) {
+        lua_settop(L_, 1);
+        return 1;
+    }
+    luaL_checktype(L_, 1, LUA_TTABLE);
+    lua_settop(L_, 1);
+    return FrozenTableFactory::Instance.pushDeepUserdata(DestState{ L_ }, 0);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "deep.h"
+#include "universe.h"
+
+#include <string_view>
+#include <variant>
+
+// #################################################################################################
+
+// an immutable snapshot of a Lua table tree, shared between all states that hold a proxy to it
+class FrozenTable
+: public DeepPrelude // Deep userdata MUST start with this header
+{
+    public:
+    // boolean, number and string are the only valid key types. a value can also be a nested frozen table
+    using Value = std::variant<std::monostate, bool, lua_Integer, lua_Number, std::string_view, FrozenTable*>;
+    struct Entry
+    {
+        Value key;
+        Value value;
+    };
+
+    private:
+    // everything (array part, sorted hash part, string bytes) lives in a single block allocated with the internal allocator
+    void* storage{ nullptr };
+    size_t storageSize{ 0 };
+    Value* arrayPart{ nullptr };
+    size_t arraySize{ 0 };
+    Entry* hashPart{ nullptr };
+    size_t hashSize{ 0 };
+
+    public:
+    Universe* const U{ nullptr }; // the universe this frozen table belongs to
+
+    public:
+    [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept { return U_->internalAllocator.alloc(size_); }
+    // always embedded somewhere else or "in-place constructed" as a full userdata
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete(void* p_, Universe* U_) { U_->internalAllocator.free(p_, sizeof(FrozenTable)); }
+    // this one is for us, to make sure memory is freed by the correct allocator
+    static void operator delete(void* p_) { static_cast<FrozenTable*>(p_)->U->internalAllocator.free(p_, sizeof(FrozenTable)); }
+
+    ~FrozenTable();
+    FrozenTable(Universe* U_);
+    FrozenTable() = delete;
+    // non-copyable, non-movable
+    FrozenTable(FrozenTable const&) = delete;
+    FrozenTable(FrozenTable const&&) = delete;
+    FrozenTable& operator=(FrozenTable const&) = delete;
+    FrozenTable& operator=(FrozenTable const&&) = delete;
+
+    private:
+    void allocateStorage(size_t arraySize_, size_t hashSize_, size_t stringBytes_);
+
+    public:
+    [[nodiscard]] static FrozenTable* Create(Universe* U_, lua_State* L_, int idx_, int cacheIdx_);
+    [[nodiscard]] Value const* find(Value const& key_) const;
+    [[nodiscard]] size_t getArraySize() const { return arraySize; }
+    [[nodiscard]] size_t getHashSize() const { return hashSize; }
+    [[nodiscard]] Value const& getArrayValue(size_t i_) const { return arrayPart[i_]; }
+    [[nodiscard]] Entry const& getHashEntry(size_t i_) const { return hashPart[i_]; }
+    void releaseChildren(lua_State* L_);
+    static void Validate(lua_State* L_, int idx_, int visitingIdx_);
+};
+
+// #################################################################################################
+
+class FrozenTableFactory
+: public DeepFactory
+{
+    public:
+    static FrozenTableFactory Instance;
+
+    FrozenTableFactory(luaL_Reg const frozenTableMT_[])
+    : mFrozenTableMT{ frozenTableMT_ }
+    {
+    }
+
+    private:
+    luaL_Reg const* const mFrozenTableMT{ nullptr };
+
+    void createMetatable(lua_State* L_) const override;
+    void deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const override;
+    [[nodiscard]] std::string_view moduleName() const override;
+    [[nodiscard]] DeepPrelude* newDeepObjectInternal(lua_State* L_) const override;
+};
@@ -26,6 +26,8 @@ THE SOFTWARE.
 
 #include "intercopycontext.h"
 
+#include "buffer.h"
+#include "cdata.h"
 #include "debugspew.h"
 #include "deep.h"
 #include "keeper.h"
@@ -34,6 +36,8 @@ THE SOFTWARE.
 #include "nameof.h"
 #include "universe.h"
 
+#include <limits>
+
 // #################################################################################################
 
 // Lua 5.4.3 style of dumping (see lstrlib.c)
@@ -60,6 +64,14 @@ THE SOFTWARE.
 
 // #################################################################################################
 
+// function sentinel used to transfer native functions without upvalues from/to keeper states, under their Universe-wide name
+[[nodiscard]] static int func_index_sentinel(lua_State* L_)
+{
+    raise_luaL_error(L_, "function index sentinel for %s, should never be called", lua_tostring(L_, lua_upvalueindex(1)));
+}
+
+// #################################################################################################
+
 // function sentinel used to transfer native table from/to keeper states
 [[nodiscard]] static int table_lookup_sentinel(lua_State* L_)
 {
@@ -74,17 +86,77 @@ THE SOFTWARE.
     raise_luaL_error(L_, "userdata clone sentinel for %s, should never be called", lua_tostring(L_, lua_upvalueindex(1)));
 }
 
+// #################################################################################################
+// #################################################################################################
+
+// the transfer was abandoned: forget the pending calls, the sources keep their resources
+void DeferredMoves::cancel()
+{
+    for (Move const& _move : moves) {
+        luaL_unref(L, LUA_REGISTRYINDEX, _move.moveRef); // no-op for LUA_NOREF
+    }
+    moves.clear();
+}
+
+// #################################################################################################
+
+// records the call of the __lanesmove function at the top of L_ instead of making it, and pops it
+void DeferredMoves::defer(lua_State* const L_, void* const clone_, void* const source_, size_t const size_)
+{
+    LUA_ASSERT(L_, L == nullptr || L == L_); // all the calls of a transfer happen in the same state
+    L = L_;
+    lua_CFunction const _moveF{ lua_tocfunction(L_, -1) };
+    if (_moveF != nullptr && lua_getupvalue(L_, -1, 1) == nullptr) {                               // L_: ... __lanesmove
+        moves.push_back(Move{ _moveF, LUA_NOREF, clone_, source_, size_ });
+        lua_pop(L_, 1);                                                                            // L_: ...
+        return;
+    }
+    if (_moveF != nullptr) {                                                                       // L_: ... __lanesmove upval
+        lua_pop(L_, 1);                                                                            // L_: ... __lanesmove
+    }
+    // a Lua function or a C closure can't be pushed again from a pointer
+    moves.push_back(Move{ nullptr, luaL_ref(L_, LUA_REGISTRYINDEX), clone_, source_, size_ });     // L_: ...
+}
+
+// #################################################################################################
+
+// the transfer succeeded: hand the resources over to their copies
+void DeferredMoves::finish()
+{
+    if (moves.empty()) {
+        return;
+    }
+    STACK_GROW(L, 4);
+    STACK_CHECK_START_REL(L, 0);
+    for (Move& _move : moves) {
+        if (_move.moveF != nullptr) {
+            lua_pushcfunction(L, _move.moveF);                                                     // L: ... __lanesmove
+        } else {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, _move.moveRef);                                      // L: ... __lanesmove
+            luaL_unref(L, LUA_REGISTRYINDEX, std::exchange(_move.moveRef, LUA_NOREF));
+        }
+        lua_pushlightuserdata(L, _move.clone);                                                     // L: ... __lanesmove clone
+        lua_pushlightuserdata(L, _move.source);                                                    // L: ... __lanesmove clone source
+        lua_pushinteger(L, static_cast<lua_Integer>(_move.size));                                  // L: ... __lanesmove clone source size
+        lua_call(L, 3, 0);                                                                         // L: ...
+    }
+    STACK_CHECK(L, 0);
+    moves.clear();
+}
+
+// #################################################################################################
 // #################################################################################################
 
 // retrieve the name of a function/table in the lookup database
-[[nodiscard]] std::string_view InterCopyContext::findLookupName() const
+template <LookupMode MODE>
+[[nodiscard]] std::string_view InterCopyContext<MODE>::findLookupName() const
 {
     LUA_ASSERT(L1, lua_isfunction(L1, L1_i) || lua_istable(L1, L1_i));                             // L1: ... v ...
     STACK_CHECK_START_REL(L1, 0);
     STACK_GROW(L1, 3); // up to 3 slots are necessary on error
-    if (mode == LookupMode::FromKeeper) {
+    if constexpr (MODE == LookupMode::FromKeeper) {
         lua_CFunction const _f{ lua_tocfunction(L1, L1_i) }; // should *always* be one of the function sentinels
-        if (_f == func_lookup_sentinel || _f == table_lookup_sentinel || _f == userdata_clone_sentinel) {
+        if (_f == func_lookup_sentinel || _f == func_index_sentinel || _f == table_lookup_sentinel || _f == userdata_clone_sentinel) {
             lua_getupvalue(L1, L1_i, 1);                                                           // L1: ... v ... "f.q.n"
         } else {
             // if this is not a sentinel, this is some user-created table we wanted to lookup
@@ -93,17 +165,42 @@ THE SOFTWARE.
             lua_pushnil(L1);                                                                       // L1: ... v ... nil
         }
     } else {
+        // native functions without upvalues are named by the Universe-wide index, no need to search the source state's registry
+        if (lua_CFunction const _f{ luaG_tolightcfunction(L1, L1_i) }; _f != nullptr) {
+            std::string_view _fqn{ U->funcLookupIndex.find(_f) };
+            // the index only knows the functions that some state found: on a miss, scan the modules of the source state that weren't yet
+            while (_fqn.empty() && tools::ScanNextPendingLookup(L1)) {
+                _fqn = U->funcLookupIndex.find(_f);
+            }
+            if (!_fqn.empty()) {
+                DEBUGSPEW_CODE(DebugSpew(U) << "function [C] " << _fqn << std::endl);
+                STACK_CHECK(L1, 0);
+                return _fqn;
+            }
+            // not found anywhere: the lookup below fails the same way, and reports the error
+        }
         // fetch the name from the source state's lookup table
         kLookupRegKey.pushValue(L1);                                                               // L1: ... v ... {}
         STACK_CHECK(L1, 1);
         LUA_ASSERT(L1, lua_istable(L1, -1));
         lua_pushvalue(L1, L1_i);                                                                   // L1: ... v ... {} v
         lua_rawget(L1, -2);                                                                        // L1: ... v ... {} "f.q.n"
+        // modules are scanned lazily: on a miss, scan them one at a time until we know the object or there is nothing left to scan
+        // plain data tables are never found there, they must not drain the queue: a table miss only scans if the table is a pending module
+        // but metatables and whatever goes to a keeper are often sub-tables of a module, that must be found by name (a clone in a keeper only refers to its metatable by name)
+        bool const _scan{
+            lua_isnil(L1, -1) && (!lua_istable(L1, L1_i) || MODE == LookupMode::ToKeeper || vt == VT::METATABLE || tools::IsPendingLookupModule(L1, L1_i))
+        };
+        while (_scan && lua_isnil(L1, -1) && tools::ScanNextPendingLookup(L1)) {
+            lua_pop(L1, 1);                                                                        // L1: ... v ... {}
+            lua_pushvalue(L1, L1_i);                                                               // L1: ... v ... {} v
+            lua_rawget(L1, -2);                                                                    // L1: ... v ... {} "f.q.n"
+        }
     }
     std::string_view _fqn{ lua_tostringview(L1, -1) };
     DEBUGSPEW_CODE(DebugSpew(Universe::Get(L1)) << "function [C] " << _fqn << std::endl);
     // popping doesn't invalidate the pointer since this is an interned string gotten from the lookup database
-    lua_pop(L1, (mode == LookupMode::FromKeeper) ? 1 : 2);                                         // L1: ... v ...
+    lua_pop(L1, (MODE == LookupMode::FromKeeper) ? 1 : 2);                                         // L1: ... v ...
     STACK_CHECK(L1, 0);
     if (_fqn.empty() && !lua_istable(L1, L1_i)) { // raise an error if we try to send an unknown function (but not for tables)
         _fqn = std::string_view{}; // just in case
@@ -136,9 +233,30 @@ THE SOFTWARE.
 
 /*---=== Inter-state copying ===---*/
 
+// metatable -> id, for the metatables this state knows about (either its own, or received from another state)
 // xxh64 of string "kMtIdRegKey" generated at https://www.pelock.com/products/hash-calculator
 static constexpr RegistryUniqueKey kMtIdRegKey{ 0xA8895DCF4EC3FE3Cull };
 
+// id -> metatable, the slot cache used to resolve an incoming metatable with a single array access
+// xxh64 of string "kMtSlotsRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kMtSlotsRegKey{ 0xBCC1139D458D126Full };
+
+// how many slots a new table of metatables starts with
+static constexpr lua_Integer kMtSlotsPresize{ 16 };
+
+// push the table of metatables known by L_, indexed by id
+static void push_mt_slots(Universe* U_, lua_State* L_)
+{
+    STACK_CHECK_START_REL(L_, 0);
+    // the ids allocated so far are presized up to a small cap, not all of them: a state only pays for the metatables it knows
+    // past that, Lua sizes the table itself: the ids a state sees as a dense range end up in the array part, scattered ones in the hash part
+    int const _narr{ static_cast<int>(std::min(U_->nextMetatableId.load(std::memory_order_relaxed) - 1, kMtSlotsPresize)) };
+    std::ignore = kMtSlotsRegKey.getSubTable(L_, _narr, 0);                                        // L_: ... _R[kMtSlotsRegKey]
+    STACK_CHECK(L_, 1);
+}
+
+// #################################################################################################
+
 // get a unique ID for metatable at [i].
 [[nodiscard]] static lua_Integer get_mt_id(Universe* U_, lua_State* L_, int idx_)
 {
@@ -158,14 +276,15 @@ static constexpr RegistryUniqueKey kMtIdRegKey{ 0xA8895DCF4EC3FE3Cull };
     if (_id == 0) {
         _id = U_->nextMetatableId.fetch_add(1, std::memory_order_relaxed);
 
-        // Create two-way references: id_uint <-> table
         lua_pushvalue(L_, idx_);                                                                   // L_: ... _R[kMtIdRegKey] {mt}
         lua_pushinteger(L_, _id);                                                                  // L_: ... _R[kMtIdRegKey] {mt} id
         lua_rawset(L_, -3);                                                                        // L_: ... _R[kMtIdRegKey]
 
-        lua_pushinteger(L_, _id);                                                                  // L_: ... _R[kMtIdRegKey] id
-        lua_pushvalue(L_, idx_);                                                                   // L_: ... _R[kMtIdRegKey] id {mt}
-        lua_rawset(L_, -3);                                                                        // L_: ... _R[kMtIdRegKey]
+        // also fill our own slot, so that the metatable is found if an object comes back to us
+        push_mt_slots(U_, L_);                                                                     // L_: ... _R[kMtIdRegKey] _R[kMtSlotsRegKey]
+        lua_pushvalue(L_, idx_);                                                                   // L_: ... _R[kMtIdRegKey] _R[kMtSlotsRegKey] {mt}
+        lua_rawseti(L_, -2, static_cast<int>(_id));                                                // L_: ... _R[kMtIdRegKey] _R[kMtSlotsRegKey]
+        lua_pop(L_, 1);                                                                            // L_: ... _R[kMtIdRegKey]
     }
     lua_pop(L_, 1);                                                                                // L_: ...
     STACK_CHECK(L_, 0);
@@ -177,36 +296,46 @@ static constexpr RegistryUniqueKey kMtIdRegKey{ 0xA8895DCF4EC3FE3Cull };
 
 // Copy a function over, which has not been found in the cache.
 // L2 has the cache key for this function at the top of the stack
-void InterCopyContext::copy_func() const
+template <LookupMode MODE>
+void InterCopyContext<MODE>::copy_func() const
 {
     LUA_ASSERT(L1, L2_cache_i != 0);                                                               //                                                L2: ... {cache} ... p
-    STACK_GROW(L1, 2);
+    STACK_GROW(L1, 4);
     STACK_CHECK_START_REL(L1, 0);
 
-    // 'lua_dump()' needs the function at top of stack
-    // if already on top of the stack, no need to push again
-    bool const _needToPush{ L1_i != lua_gettop(L1) };
-    if (_needToPush) {
-        lua_pushvalue(L1, L1_i);                                                                   // L1: ... f
-    }
-
-    //
-    // "value returned is the error code returned by the last call
-    // to the writer" (and we only return 0)
-    // not sure this could ever fail but for memory shortage reasons
-    // last parameter is Lua 5.4-specific (no stripping)
-    luaL_Buffer B{};
-    if (lua504_dump(L1, buf_writer, &B, U->stripFunctions) != 0) {
-        raise_luaL_error(getErrL(), "internal error: function dump failed.");
+    // lane_spawn_many() keeps the bytecode of the functions it copies, so that it doesn't dump them again for each lane
+    kFuncDumpsRegKey.pushValue(L1);                                                                // L1: ... {dumps}|nil
+    if (lua_istable(L1, -1)) {
+        lua_pushvalue(L1, L1_i);                                                                   // L1: ... {dumps} f
+        lua_rawget(L1, -2);                                                                        // L1: ... {dumps} b|nil
+    } else {
+        lua_pushnil(L1);                                                                           // L1: ... nil nil
     }
+    if (lua_isnil(L1, -1)) {
+        lua_pop(L1, 1);                                                                            // L1: ... {dumps}|nil
+        // 'lua_dump()' needs the function at top of stack
+        lua_pushvalue(L1, L1_i);                                                                   // L1: ... {dumps}|nil f
 
-    // pushes dumped string on 'L1'
-    luaL_pushresult(&B);                                                                           // L1: ... f b
+        //
+        // "value returned is the error code returned by the last call
+        // to the writer" (and we only return 0)
+        // not sure this could ever fail but for memory shortage reasons
+        // last parameter is Lua 5.4-specific (no stripping)
+        luaL_Buffer B{};
+        if (lua504_dump(L1, buf_writer, &B, U->stripFunctions) != 0) {
+            raise_luaL_error(getErrL(), "internal error: function dump failed.");
+        }
 
-    // if not pushed, no need to pop
-    if (_needToPush) {
-        lua_remove(L1, -2);                                                                        // L1: ... b
+        // pushes dumped string on 'L1'
+        luaL_pushresult(&B);                                                                       // L1: ... {dumps}|nil f b
+        lua_remove(L1, -2);                                                                        // L1: ... {dumps}|nil b
+        if (lua_istable(L1, -2)) {
+            lua_pushvalue(L1, L1_i);                                                               // L1: ... {dumps} b f
+            lua_pushvalue(L1, -2);                                                                 // L1: ... {dumps} b f b
+            lua_rawset(L1, -4);                                                                    // L1: ... {dumps} b
+        }
     }
+    lua_remove(L1, -2);                                                                            // L1: ... b
 
     // transfer the bytecode, then the upvalues, to create a similar closure
     {
@@ -260,7 +389,7 @@ void InterCopyContext::copy_func() const
          */
         int _n{ 0 };
         {
-            InterCopyContext _c{ U, L2, L1, L2_cache_i, {}, VT::NORMAL, mode, {} };
+            InterCopyContext _c{ U, L2, L1, L2_cache_i, {}, VT::NORMAL, {}, deferredMoves };
             // if we encounter an upvalue equal to the global table in the source, bind it to the destination's global table
             lua_pushglobaltable(L1);                                                               // L1: ... _G
             for (_n = 0; (_c.name = lua_getupvalue(L1, L1_i, 1 + _n)) != nullptr; ++_n) {          // L1: ... _G up[n]
@@ -298,32 +427,51 @@ void InterCopyContext::copy_func() const
 
 // #################################################################################################
 
+// what a function or a table found in the lookup database becomes in a keeper: a sentinel closure that holds its lookup name as upvalue
+static void push_lookup_sentinel(lua_State* L2_, lua_CFunction sentinel_, std::string_view const& fqn_)
+{
+    std::ignore = lua_pushstringview(L2_, fqn_);                                                   // L2_: "f.q.n"
+    lua_pushcclosure(L2_, sentinel_, 1);                                                           // L2_: sentinel
+}
+
+// #################################################################################################
+
+// fetch what fqn_ names in the lookup table at the top of L2_, scanning the modules of L2_ that weren't yet until it is found or there is nothing left to scan
+static void rawget_lookup(lua_State* L2_, std::string_view const& fqn_)
+{
+    std::ignore = lua_pushstringview(L2_, fqn_);                                                   // L2_: {} "f.q.n"
+    lua_rawget(L2_, -2);                                                                           // L2_: {} v|nil
+    while (lua_isnil(L2_, -1) && tools::ScanNextPendingLookup(L2_)) {
+        lua_pop(L2_, 1);                                                                           // L2_: {}
+        std::ignore = lua_pushstringview(L2_, fqn_);                                               // L2_: {} "f.q.n"
+        lua_rawget(L2_, -2);                                                                       // L2_: {} v|nil
+    }
+}
+
+// #################################################################################################
+
 // Push a looked-up native/LuaJIT function.
-void InterCopyContext::lookup_native_func() const
+template <LookupMode MODE>
+void InterCopyContext<MODE>::lookup_native_func() const
 {
+    // native functions without upvalues go by their Universe-wide name, that the destination finds in its part of the index
+    bool const _indexed{ (MODE == LookupMode::FromKeeper) ? (lua_tocfunction(L1, L1_i) == func_index_sentinel) : (luaG_tolightcfunction(L1, L1_i) != nullptr) };
     // get the name of the function we want to send
     std::string_view const _fqn{ findLookupName() };
     // push the equivalent function in the destination's stack, retrieved from the lookup table
     STACK_CHECK_START_REL(L2, 0);
     STACK_GROW(L2, 3); // up to 3 slots are necessary on error
-    switch (mode) {
-    default: // shouldn't happen, in theory...
-        raise_luaL_error(getErrL(), "internal error: unknown lookup mode");
-        break;
-
-    case LookupMode::ToKeeper:
-        // push a sentinel closure that holds the lookup name as upvalue
-        std::ignore = lua_pushstringview(L2, _fqn);                                                // L1: ... f ...                                  L2: "f.q.n"
-        lua_pushcclosure(L2, func_lookup_sentinel, 1);                                             // L1: ... f ...                                  L2: f
-        break;
-
-    case LookupMode::LaneBody:
-    case LookupMode::FromKeeper:
-        kLookupRegKey.pushValue(L2);                                                               // L1: ... f ...                                  L2: {}
+    if constexpr (MODE == LookupMode::ToKeeper) {
+        push_lookup_sentinel(L2, _indexed ? func_index_sentinel : func_lookup_sentinel, _fqn);     // L1: ... f ...                                  L2: f
+    } else { // LookupMode::LaneBody or LookupMode::FromKeeper
+        if (_indexed) {
+            std::ignore = kLookupIndexRegKey.getSubTable(L2, 0, 0);                                // L1: ... f ...                                  L2: {}
+        } else {
+            kLookupRegKey.pushValue(L2);                                                           // L1: ... f ...                                  L2: {}
+        }
         STACK_CHECK(L2, 1);
         LUA_ASSERT(L1, lua_istable(L2, -1));
-        std::ignore = lua_pushstringview(L2, _fqn);                                                // L1: ... f ...                                  L2: {} "f.q.n"
-        lua_rawget(L2, -2);                                                                        // L1: ... f ...                                  L2: {} f
+        rawget_lookup(L2, _fqn);                                                                   // L1: ... f ...                                  L2: {} f
         // nil means we don't know how to transfer stuff: user should do something
         // anything other than function or table should not happen!
         if (!lua_isfunction(L2, -1) && !lua_istable(L2, -1)) {
@@ -344,7 +492,6 @@ void InterCopyContext::lookup_native_func() const
             return;
         }
         lua_remove(L2, -2);                                                                        // L2: f
-        break;
 
         /* keep it in case I need it someday, who knows...
         case LookupMode::RawFunctions:
@@ -368,7 +515,8 @@ void InterCopyContext::lookup_native_func() const
 
 // Check if we've already copied the same function from 'L1', and reuse the old copy.
 // Always pushes a function to 'L2'.
-void InterCopyContext::copy_cached_func() const
+template <LookupMode MODE>
+void InterCopyContext<MODE>::copy_cached_func() const
 {
     FuncSubType const _funcSubType{ luaG_getfuncsubtype(L1, L1_i) };
     if (_funcSubType == FuncSubType::Bytecode) {
@@ -416,7 +564,8 @@ void InterCopyContext::copy_cached_func() const
 // #################################################################################################
 
 // Push a looked-up table, or nothing if we found nothing
-[[nodiscard]] bool InterCopyContext::lookup_table() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::lookup_table() const
 {
     // get the name of the table we want to send
     std::string_view const _fqn{ findLookupName() };
@@ -426,27 +575,16 @@ void InterCopyContext::copy_cached_func() const
     // push the equivalent table in the destination's stack, retrieved from the lookup table
     STACK_CHECK_START_REL(L2, 0);
     STACK_GROW(L2, 3); // up to 3 slots are necessary on error
-    switch (mode) {
-    default: // shouldn't happen, in theory...
-        raise_luaL_error(getErrL(), "internal error: unknown lookup mode");
-        break;
-
-    case LookupMode::ToKeeper:
-        // push a sentinel closure that holds the lookup name as upvalue
-        std::ignore = lua_pushstringview(L2, _fqn);                                                // L1: ... t ...                                  L2: "f.q.n"
-        lua_pushcclosure(L2, table_lookup_sentinel, 1);                                            // L1: ... t ...                                  L2: f
-        break;
-
-    case LookupMode::LaneBody:
-    case LookupMode::FromKeeper:
+    if constexpr (MODE == LookupMode::ToKeeper) {
+        push_lookup_sentinel(L2, table_lookup_sentinel, _fqn);                                     // L1: ... t ...                                  L2: f
+    } else { // LookupMode::LaneBody or LookupMode::FromKeeper
         kLookupRegKey.pushValue(L2);                                                               // L1: ... t ...                                  L2: {}
         STACK_CHECK(L2, 1);
         LUA_ASSERT(L1, lua_istable(L2, -1));
-        std::ignore = lua_pushstringview(L2, _fqn);                                                //                                                L2: {} "f.q.n"
-        lua_rawget(L2, -2);                                                                        //                                                L2: {} t
+        rawget_lookup(L2, _fqn);                                                                   //                                                L2: {} t
         // we accept destination lookup failures in the case of transfering the Lanes body function (this will result in the source table being cloned instead)
         // but not when we extract something out of a keeper, as there is nothing to clone!
-        if (lua_isnil(L2, -1) && mode == LookupMode::LaneBody) {
+        if (MODE == LookupMode::LaneBody && lua_isnil(L2, -1)) {
             lua_pop(L2, 2);                                                                        // L1: ... t ...                                  L2:
             STACK_CHECK(L2, 0);
             return false;
@@ -466,7 +604,6 @@ void InterCopyContext::copy_cached_func() const
                 _to ? _to : "main");
         }
         lua_remove(L2, -2);                                                                        // L1: ... t ...                                  L2: t
-        break;
     }
     STACK_CHECK(L2, 1);
     return true;
@@ -474,13 +611,14 @@ void InterCopyContext::copy_cached_func() const
 
 // #################################################################################################
 
-void InterCopyContext::inter_copy_keyvaluepair() const
+template <LookupMode MODE>
+void InterCopyContext<MODE>::inter_copy_keyvaluepair() const
 {
     SourceIndex const _val_i{ lua_gettop(L1) };
     SourceIndex const _key_i{ _val_i - 1 };
 
     // For the key, only basic key types are copied over. others ignored
-    InterCopyContext _c{ U, L2, L1, L2_cache_i, _key_i, VT::KEY, mode, name };
+    InterCopyContext _c{ U, L2, L1, L2_cache_i, _key_i, VT::KEY, name, deferredMoves };
     if (!_c.inter_copy_one()) {
         return;
         // we could raise an error instead of ignoring the table entry, like so:
@@ -532,7 +670,65 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::push_cached_metatable() const
+// string values at least that long are offloaded when copied into a keeper, never in the other modes
+template <LookupMode MODE>
+[[nodiscard]] size_t InterCopyContext<MODE>::offloadThreshold() const
+{
+    if constexpr (MODE == LookupMode::ToKeeper) {
+        int const _threshold{ U->keepers.offload_threshold };
+        return (_threshold > 0) ? static_cast<size_t>(_threshold) : std::numeric_limits<size_t>::max();
+    } else {
+        return std::numeric_limits<size_t>::max();
+    }
+}
+
+// #################################################################################################
+
+// what inter_copy_table() copies without going through inter_copy_one()
+[[nodiscard]] static constexpr bool is_scalar_type(int const type_)
+{
+    return type_ == LUA_TBOOLEAN || type_ == LUA_TNUMBER || type_ == LUA_TSTRING;
+}
+
+// push a copy of the boolean, number or string at idx_ in L1_
+// only the string values copied into a keeper can be offloaded: for keys, and in the other modes, this compiles to plain pushes
+template <LookupMode MODE, VT VT_>
+static void push_scalar(Universe* const U_, lua_State* const L2_, lua_State* const L1_, int const idx_, int const type_, size_t const offloadThreshold_)
+{
+    switch (type_) {
+    case LUA_TBOOLEAN:
+        lua_pushboolean(L2_, lua_toboolean(L1_, idx_));
+        return;
+
+    case LUA_TNUMBER:
+#if defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        if (lua_isinteger(L1_, idx_)) {
+            lua_pushinteger(L2_, lua_tointeger(L1_, idx_));
+            return;
+        }
+#endif // defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        lua_pushnumber(L2_, lua_tonumber(L1_, idx_));
+        return;
+
+    default:
+        {
+            std::string_view const _s{ lua_tostringview(L1_, idx_) };
+            if constexpr (MODE == LookupMode::ToKeeper && VT_ != VT::KEY) {
+                if (_s.size() >= offloadThreshold_) {
+                    Buffer::PushOffloadedString(U_, DestState{ L2_ }, _s);
+                    return;
+                }
+            }
+            std::ignore = lua_pushstringview(L2_, _s);
+        }
+        return;
+    }
+}
+
+// #################################################################################################
+
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::push_cached_metatable() const
 {
     STACK_CHECK_START_REL(L1, 0);
     if (!lua_getmetatable(L1, L1_i)) {                                                             // L1: ... mt
@@ -546,28 +742,28 @@ void InterCopyContext::inter_copy_keyvaluepair() const
     STACK_CHECK_START_REL(L2, 0);
     STACK_GROW(L2, 4);
     // do we already know this metatable?
-    std::ignore = kMtIdRegKey.getSubTable(L2, 0, 0);                                               //                                                L2: _R[kMtIdRegKey]
-    lua_pushinteger(L2, _mt_id);                                                                   //                                                L2: _R[kMtIdRegKey] id
-    lua_rawget(L2, -2);                                                                            //                                                L2: _R[kMtIdRegKey] mt|nil
+    push_mt_slots(U, L2);                                                                          //                                                L2: _R[kMtSlotsRegKey]
+    lua_rawgeti(L2, -1, static_cast<int>(_mt_id));                                                 //                                                L2: _R[kMtSlotsRegKey] mt|nil
     STACK_CHECK(L2, 2);
 
     if (lua_isnil(L2, -1)) { // L2 did not know the metatable
-        lua_pop(L2, 1);                                                                            //                                                L2: _R[kMtIdRegKey]
-        InterCopyContext const c{ U, L2, L1, L2_cache_i, SourceIndex{ lua_gettop(L1) }, VT::METATABLE, mode, name };
-        if (!c.inter_copy_one()) {                                                                 //                                                L2: _R[kMtIdRegKey] mt?
+        lua_pop(L2, 1);                                                                            //                                                L2: _R[kMtSlotsRegKey]
+        InterCopyContext const c{ U, L2, L1, L2_cache_i, SourceIndex{ lua_gettop(L1) }, VT::METATABLE, name, deferredMoves };
+        if (!c.inter_copy_one()) {                                                                 //                                                L2: _R[kMtSlotsRegKey] mt?
             raise_luaL_error(getErrL(), "Error copying a metatable");
         }
 
-        STACK_CHECK(L2, 2);                                                                        //                                                L2: _R[kMtIdRegKey] mt
+        STACK_CHECK(L2, 2);                                                                        //                                                L2: _R[kMtSlotsRegKey] mt
         // mt_id -> metatable
-        lua_pushinteger(L2, _mt_id);                                                               //                                                L2: _R[kMtIdRegKey] mt id
-        lua_pushvalue(L2, -2);                                                                     //                                                L2: _R[kMtIdRegKey] mt id mt
-        lua_rawset(L2, -4);                                                                        //                                                L2: _R[kMtIdRegKey] mt
-
-        // metatable -> mt_id
-        lua_pushvalue(L2, -1);                                                                     //                                                L2: _R[kMtIdRegKey] mt mt
-        lua_pushinteger(L2, _mt_id);                                                               //                                                L2: _R[kMtIdRegKey] mt mt id
-        lua_rawset(L2, -4);                                                                        //                                                L2: _R[kMtIdRegKey] mt
+        lua_pushvalue(L2, -1);                                                                     //                                                L2: _R[kMtSlotsRegKey] mt mt
+        lua_rawseti(L2, -3, static_cast<int>(_mt_id));                                             //                                                L2: _R[kMtSlotsRegKey] mt
+
+        // metatable -> mt_id, so that the metatable keeps its id if L2 forwards it to yet another state
+        std::ignore = kMtIdRegKey.getSubTable(L2, 0, 0);                                           //                                                L2: _R[kMtSlotsRegKey] mt _R[kMtIdRegKey]
+        lua_pushvalue(L2, -2);                                                                     //                                                L2: _R[kMtSlotsRegKey] mt _R[kMtIdRegKey] mt
+        lua_pushinteger(L2, _mt_id);                                                               //                                                L2: _R[kMtSlotsRegKey] mt _R[kMtIdRegKey] mt id
+        lua_rawset(L2, -3);                                                                        //                                                L2: _R[kMtSlotsRegKey] mt _R[kMtIdRegKey]
+        lua_pop(L2, 1);                                                                            //                                                L2: _R[kMtSlotsRegKey] mt
         STACK_CHECK(L2, 2);
     }
     lua_remove(L2, -2);                                                                            //                                                L2: mt
@@ -584,7 +780,8 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 // local functions to point to the same table, also in the target.
 // Always pushes a table to 'L2'.
 // Returns true if the table was cached (no need to fill it!); false if it's a virgin.
-[[nodiscard]] bool InterCopyContext::push_cached_table() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::push_cached_table() const
 {
     void const* const _p{ lua_topointer(L1, L1_i) };
 
@@ -604,7 +801,8 @@ void InterCopyContext::inter_copy_keyvaluepair() const
     if (_not_found_in_cache) {
         // create a new entry in the cache
         lua_pop(L2, 1);                                                                            // L1: ... t ...                                  L2: ...
-        lua_newtable(L2);                                                                          // L1: ... t ...                                  L2: ... {}
+        // presize the array part, the hash part will grow as needed
+        lua_createtable(L2, static_cast<int>(lua_rawlen(L1, L1_i)), 0);                            // L1: ... t ...                                  L2: ... {}
         lua_pushlightuserdata(L2, const_cast<void*>(_p));                                          // L1: ... t ...                                  L2: ... {} p
         lua_pushvalue(L2, -2);                                                                     // L1: ... t ...                                  L2: ... {} p {}
         lua_rawset(L2, L2_cache_i);                                                                // L1: ... t ...                                  L2: ... {}
@@ -616,7 +814,8 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::tryCopyClonable() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::tryCopyClonable() const
 {
     SourceIndex const _L1_i{ lua_absindex(L1, L1_i) };
     void* const _source{ lua_touserdata(L1, _L1_i) };
@@ -641,11 +840,16 @@ void InterCopyContext::inter_copy_keyvaluepair() const
         return false;
     }
 
-    // no __lanesclone? -> not clonable
-    if (luaG_getfield(L1, -1, "__lanesclone") == LuaType::NIL) {                                   // L1: ... mt nil
-        lua_pop(L1, 2);                                                                            // L1: ...
-        STACK_CHECK(L1, 0);
-        return false;
+    // __lanesmove hands the native resource over to the copy, and takes precedence over __lanesclone
+    bool const _moving{ luaG_getfield(L1, -1, "__lanesmove") != LuaType::NIL };                    // L1: ... mt __lanesmove|nil
+    if (!_moving) {                                                                                // L1: ... mt nil
+        lua_pop(L1, 1);                                                                            // L1: ... mt
+        // no __lanesclone either? -> not clonable
+        if (luaG_getfield(L1, -1, "__lanesclone") == LuaType::NIL) {                               // L1: ... mt nil
+            lua_pop(L1, 2);                                                                        // L1: ...
+            STACK_CHECK(L1, 0);
+            return false;
+        }
     }
 
     // we need to copy over the uservalues of the userdata as well
@@ -661,10 +865,13 @@ void InterCopyContext::inter_copy_keyvaluepair() const
         // create the clone userdata with the required number of uservalue slots
         void* const _clone{ lua_newuserdatauv(L2, userdata_size, _uvi) };                          //                                                L2: ... u
         // copy the metatable in the target state, and give it to the clone we put there
-        InterCopyContext _c{ U, L2, L1, L2_cache_i, SourceIndex{ mt }, VT::NORMAL, mode, name };
+        InterCopyContext _c{ U, L2, L1, L2_cache_i, SourceIndex{ mt }, VT::METATABLE, name, deferredMoves };
         if (_c.inter_copy_one()) {                                                                 //                                                L2: ... u mt|sentinel
-            if (LookupMode::ToKeeper == mode) {                                                    //                                                L2: ... u sentinel
-                LUA_ASSERT(L1, lua_tocfunction(L2, -1) == table_lookup_sentinel);
+            if constexpr (MODE == LookupMode::ToKeeper) {                                          //                                                L2: ... u sentinel
+                // the keeper can only store the name of the metatable: one that isn't in the lookup database was copied as a plain table
+                if (lua_tocfunction(L2, -1) != table_lookup_sentinel) {
+                    raise_luaL_error(getErrL(), "the metatable of a clonable userdata must be known by the lookup database to go through a linda");
+                }
                 // we want to create a new closure with a 'clone sentinel' function, where the upvalues are the userdata and the metatable fqn
                 lua_getupvalue(L2, -1, 1);                                                         //                                                L2: ... u sentinel fqn
                 lua_remove(L2, -2);                                                                //                                                L2: ... u fqn
@@ -683,10 +890,11 @@ void InterCopyContext::inter_copy_keyvaluepair() const
         lua_pushvalue(L2, -2);                                                                     //                                                L2: ... u source u
         lua_rawset(L2, L2_cache_i);                                                                //                                                L2: ... u
         // make sure we have the userdata now
-        if (LookupMode::ToKeeper == mode) {                                                        //                                                L2: ... userdata_clone_sentinel
+        if constexpr (MODE == LookupMode::ToKeeper) {                                              //                                                L2: ... userdata_clone_sentinel
             lua_getupvalue(L2, -1, 2);                                                             //                                                L2: ... userdata_clone_sentinel u
         }
         // assign uservalues
+        _c.vt = VT::NORMAL;
         while (_uvi > 0) {
             _c.L1_i = SourceIndex{ lua_absindex(L1, -1) };
             if (!_c.inter_copy_one()) {                                                            //                                                L2: ... u uv
@@ -698,16 +906,23 @@ void InterCopyContext::inter_copy_keyvaluepair() const
             --_uvi;
         }
         // when we are done, all uservalues are popped from the source stack, and we want only the single transferred value in the destination
-        if (LookupMode::ToKeeper == mode) {                                                        //                                                L2: ... userdata_clone_sentinel u
+        if constexpr (MODE == LookupMode::ToKeeper) {                                              //                                                L2: ... userdata_clone_sentinel u
             lua_pop(L2, 1);                                                                        //                                                L2: ... userdata_clone_sentinel
         }
         STACK_CHECK(L2, 1);
         STACK_CHECK(L1, 2);
-        // call cloning function in source state to perform the actual memory cloning
-        lua_pushlightuserdata(L1, _clone);                                                         // L1: ... mt __lanesclone clone
-        lua_pushlightuserdata(L1, _source);                                                        // L1: ... mt __lanesclone clone source
-        lua_pushinteger(L1, static_cast<lua_Integer>(userdata_size));                              // L1: ... mt __lanesclone clone source size
-        lua_call(L1, 3, 0);                                                                        // L1: ... mt
+        // call cloning function in source state to perform the actual memory cloning (or moving)
+        // a move can wait until the whole transfer has succeeded: the clone is never used before that
+        if (_moving && deferredMoves != nullptr) {
+            // if the transfer is abandoned, the __gc of the clone must not see uninitialized memory
+            std::memset(_clone, 0, userdata_size);
+            deferredMoves->defer(L1, _clone, _source, userdata_size);                              // L1: ... mt
+        } else {
+            lua_pushlightuserdata(L1, _clone);                                                     // L1: ... mt __lanesclone clone
+            lua_pushlightuserdata(L1, _source);                                                    // L1: ... mt __lanesclone clone source
+            lua_pushinteger(L1, static_cast<lua_Integer>(userdata_size));                          // L1: ... mt __lanesclone clone source size
+            lua_call(L1, 3, 0);                                                                    // L1: ... mt
+        }
         STACK_CHECK(L1, 1);
     }
 
@@ -721,9 +936,10 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // Copy deep userdata between two separate Lua states (from L1 to L2)
 // Returns false if not a deep userdata, else true (unless an error occured)
-[[nodiscard]] bool InterCopyContext::tryCopyDeep() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::tryCopyDeep() const
 {
-    DeepFactory* const _factory{ DeepFactory::LookupFactory(L1, L1_i, mode) };
+    DeepFactory* const _factory{ DeepFactory::LookupFactory(L1, L1_i, MODE) };
     if (_factory == nullptr) {
         return false; // not a deep userdata
     }
@@ -731,6 +947,24 @@ void InterCopyContext::inter_copy_keyvaluepair() const
     STACK_CHECK_START_REL(L1, 0);
     STACK_CHECK_START_REL(L2, 0);
 
+    // large string values offloaded by inter_copy_string() are materialized directly from the shared storage
+    if (MODE == LookupMode::FromKeeper && _factory == &BufferFactory::Instance) {
+        Buffer const* const _buffer{ static_cast<Buffer const*>(*lua_tofulluserdata<DeepPrelude*>(L1, L1_i)) };
+        if (_buffer->offloadedString) {
+            std::ignore = lua_pushstringview(L2, _buffer->view());
+            STACK_CHECK(L2, 1);
+            return true;
+        }
+        // same for cdata copied into the keeper by inter_copy_cdata()
+        if (!_buffer->cdataType.empty()) {
+            if (!cdata::Push(U, L2, _buffer->cdataType, _buffer->view())) {                        //                                                L2: err
+                raise_lua_error(L2);
+            }
+            STACK_CHECK(L2, 1);
+            return true;
+        }
+    }
+
     // extract all uservalues of the source. unfortunately, the only way to know their count is to iterate until we fail
     int _nuv{ 0 };
     while (lua_getiuservalue(L1, L1_i, _nuv + 1) != LUA_TNONE) {                                   // L1: ... u [uv]* nil
@@ -741,11 +975,11 @@ void InterCopyContext::inter_copy_keyvaluepair() const
     STACK_CHECK(L1, _nuv);
 
     DeepPrelude* const _u{ *lua_tofulluserdata<DeepPrelude*>(L1, L1_i) };
-    DeepFactory::PushDeepProxy(L2, _u, _nuv, mode, getErrL());                                     // L1: ... u [uv]*                               L2: u
+    DeepFactory::PushDeepProxy(L2, _u, _nuv, MODE, getErrL());                                     // L1: ... u [uv]*                               L2: u
 
     // transfer all uservalues of the source in the destination
     {
-        InterCopyContext _c{ U, L2, L1, L2_cache_i, {}, VT::NORMAL, mode, name };
+        InterCopyContext _c{ U, L2, L1, L2_cache_i, {}, VT::NORMAL, name, deferredMoves };
         int const _clone_i{ lua_gettop(L2) };
         while (_nuv) {
             _c.L1_i = SourceIndex{ lua_absindex(L1, -1) };
@@ -767,7 +1001,8 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_boolean() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_boolean() const
 {
     int const _v{ lua_toboolean(L1, L1_i) };
     DEBUGSPEW_CODE(DebugSpew(nullptr) << (_v ? "true" : "false") << std::endl);
@@ -777,7 +1012,41 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_function() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_cdata() const
+{
+    if (vt == VT::KEY) {
+        return false;
+    }
+    STACK_CHECK_START_REL(L1, 0);
+    STACK_CHECK_START_REL(L2, 0);
+    DEBUGSPEW_CODE(DebugSpew(nullptr) << "CDATA" << std::endl);
+    cdata::Description const _cdata{ cdata::Describe(U, L1, L1_i) };
+    if constexpr (MODE == LookupMode::ToKeeper) {
+        // keepers don't load the ffi: the bytes wait in a Buffer until they leave the keeper
+        if (!Buffer::PushOffloadedCData(U, L2, _cdata.ctype, _cdata.bytes)) {
+            std::ignore = lua_pushstringview(L1, _cdata.ctype);
+            raise_luaL_error(L1, "not enough memory to copy cdata<%s>", lua_tostring(L1, -1));
+        }
+    } else {
+        if (!cdata::Push(U, L2, _cdata.ctype, _cdata.bytes)) {                                     //                                                L2: err
+            lua_State* const _errL{ getErrL() };
+            if (_errL != L2) {
+                std::ignore = lua_pushstringview(_errL, lua_tostringview(L2, -1));
+                lua_pop(L2, 1);                                                                    //                                                L2:
+            }
+            raise_lua_error(_errL);
+        }
+    }
+    STACK_CHECK(L2, 1);
+    STACK_CHECK(L1, 0);
+    return true;
+}
+
+// #################################################################################################
+
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_function() const
 {
     if (vt == VT::KEY) {
         return false;
@@ -851,14 +1120,24 @@ void InterCopyContext::inter_copy_keyvaluepair() const
         }
         // perform the custom cloning part
         lua_insert(L2, -2);                                                                        //                                                L2: ... u mt
-        // __lanesclone should always exist because we wouldn't be restoring data from a userdata_clone_sentinel closure to begin with
-        std::ignore = luaG_getfield(L2, -1, "__lanesclone");                                       //                                                L2: ... u mt __lanesclone
+        // __lanesmove or __lanesclone should always exist because we wouldn't be restoring data from a userdata_clone_sentinel closure to begin with
+        bool const _moving{ luaG_getfield(L2, -1, "__lanesmove") != LuaType::NIL };                //                                                L2: ... u mt __lanesmove|nil
+        if (!_moving) {                                                                            //                                                L2: ... u mt nil
+            lua_pop(L2, 1);                                                                        //                                                L2: ... u mt
+            std::ignore = luaG_getfield(L2, -1, "__lanesclone");                                   //                                                L2: ... u mt __lanesclone
+        }
         lua_remove(L2, -2);                                                                        //                                                L2: ... u __lanesclone
-        lua_pushlightuserdata(L2, _clone);                                                         //                                                L2: ... u __lanesclone clone
-        lua_pushlightuserdata(L2, _source);                                                        //                                                L2: ... u __lanesclone clone source
-        lua_pushinteger(L2, userdata_size);                                                        //                                                L2: ... u __lanesclone clone source size
-        // clone:__lanesclone(dest, source, size)
-        lua_call(L2, 3, 0);                                                                        //                                                L2: ... u
+        if (_moving && deferredMoves != nullptr) {
+            // if the transfer is abandoned, the __gc of the clone must not see uninitialized memory
+            std::memset(_clone, 0, userdata_size);
+            deferredMoves->defer(L2, _clone, _source, userdata_size);                              //                                                L2: ... u
+        } else {
+            lua_pushlightuserdata(L2, _clone);                                                     //                                                L2: ... u __lanesclone clone
+            lua_pushlightuserdata(L2, _source);                                                    //                                                L2: ... u __lanesclone clone source
+            lua_pushinteger(L2, userdata_size);                                                    //                                                L2: ... u __lanesclone clone source size
+            // clone:__lanesclone(dest, source, size) or clone:__lanesmove(dest, source, size)
+            lua_call(L2, 3, 0);                                                                    //                                                L2: ... u
+        }
     } else { // regular function
         DEBUGSPEW_CODE(DebugSpew(U) << "FUNCTION " << name << std::endl);
         DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ U });
@@ -871,7 +1150,8 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_lightuserdata() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_lightuserdata() const
 {
     void* const _p{ lua_touserdata(L1, L1_i) };
     // recognize and print known UniqueKey names here
@@ -890,7 +1170,7 @@ void InterCopyContext::inter_copy_keyvaluepair() const
         }
     }
     // when copying a nil sentinel in a non-keeper, write a nil in the destination
-    if (mode != LookupMode::ToKeeper && kNilSentinel.equals(L1, L1_i)) {
+    if (MODE != LookupMode::ToKeeper && kNilSentinel.equals(L1, L1_i)) {
         DEBUGSPEW_CODE(DebugSpew(nullptr) << " as nil" << std::endl);
         lua_pushnil(L2);
     } else {
@@ -902,13 +1182,14 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_nil() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_nil() const
 {
     if (vt == VT::KEY) {
         return false;
     }
     // when copying a nil in a keeper, write a nil sentinel in the destination
-    if (mode == LookupMode::ToKeeper) {
+    if constexpr (MODE == LookupMode::ToKeeper) {
         kNilSentinel.pushKey(L2);
     } else {
         lua_pushnil(L2);
@@ -918,7 +1199,8 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_number() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_number() const
 {
     // LNUM patch support (keeping integer accuracy)
 #if defined LUA_LNUM || LUA_VERSION_NUM >= 503
@@ -938,17 +1220,26 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_string() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_string() const
 {
     std::string_view const _s{ lua_tostringview(L1, L1_i) };
     DEBUGSPEW_CODE(DebugSpew(nullptr) << "'" << _s << "'" << std::endl);
+    // large string values don't go into the keeper's heap, keys are always kept as is
+    if constexpr (MODE == LookupMode::ToKeeper) {
+        if (vt != VT::KEY && _s.size() >= offloadThreshold()) {
+            Buffer::PushOffloadedString(U, L2, _s);
+            return true;
+        }
+    }
     std::ignore = lua_pushstringview(L2, _s);
     return true;
 }
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_table() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_table() const
 {
     if (vt == VT::KEY) {
         return false;
@@ -985,10 +1276,20 @@ void InterCopyContext::inter_copy_keyvaluepair() const
     STACK_GROW(L1, 2);
     STACK_GROW(L2, 2);
 
+    // entries made of a scalar key and a scalar value are pushed directly, the offload threshold is read once for the whole table
+    size_t const _offloadThreshold{ offloadThreshold() };
     lua_pushnil(L1); // start iteration
     while (lua_next(L1, L1_i)) {
-        // need a function to prevent overflowing the stack with verboseErrors-induced alloca()
-        inter_copy_keyvaluepair();
+        int const _key_type{ lua_type(L1, -2) };
+        int const _val_type{ lua_type(L1, -1) };
+        if (is_scalar_type(_key_type) && is_scalar_type(_val_type)) {
+            push_scalar<MODE, VT::KEY>(U, L2, L1, -2, _key_type, _offloadThreshold);              //                                                L2: ... t k
+            push_scalar<MODE, VT::NORMAL>(U, L2, L1, -1, _val_type, _offloadThreshold);           //                                                L2: ... t k v
+            lua_rawset(L2, -3);                                                                    //                                                L2: ... t
+        } else {
+            // need a function to prevent overflowing the stack with verboseErrors-induced alloca()
+            inter_copy_keyvaluepair();
+        }
         lua_pop(L1, 1); // pop value (next round)
     }
     STACK_CHECK(L1, 0);
@@ -1005,7 +1306,8 @@ void InterCopyContext::inter_copy_keyvaluepair() const
 
 // #################################################################################################
 
-[[nodiscard]] bool InterCopyContext::inter_copy_userdata() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_userdata() const
 {
     STACK_CHECK_START_REL(L1, 0);
     STACK_CHECK_START_REL(L2, 0);
@@ -1084,7 +1386,8 @@ namespace {
  *
  * Returns true if value was pushed, false if its type is non-supported.
  */
-[[nodiscard]] bool InterCopyContext::inter_copy_one() const
+template <LookupMode MODE>
+[[nodiscard]] bool InterCopyContext<MODE>::inter_copy_one() const
 {
     static constexpr int kPODmask = (1 << LUA_TNIL) | (1 << LUA_TBOOLEAN) | (1 << LUA_TLIGHTUSERDATA) | (1 << LUA_TNUMBER) | (1 << LUA_TSTRING);
     STACK_GROW(L2, 1);
@@ -1141,9 +1444,12 @@ namespace {
         _ret = inter_copy_table();
         break;
 
+    case LuaType::CDATA:
+        _ret = inter_copy_cdata();
+        break;
+
     // The following types cannot be copied
     case LuaType::NONE:
-    case LuaType::CDATA:
         [[fallthrough]];
     case LuaType::THREAD:
         _ret = false;
@@ -1161,7 +1467,8 @@ namespace {
 // returns InterCopyResult::Success if everything is fine
 // returns InterCopyResult::Error if pushed an error message in L1
 // else raise an error in whichever state is not a keeper
-[[nodiscard]] InterCopyResult InterCopyContext::inter_copy_package() const
+template <LookupMode MODE>
+[[nodiscard]] InterCopyResult InterCopyContext<MODE>::inter_copy_package() const
 {
     DEBUGSPEW_CODE(DebugSpew(U) << "InterCopyContext::inter_copy_package()" << std::endl);
 
@@ -1191,7 +1498,7 @@ namespace {
         lua_pushfstring(L1, "expected package as table, got %s", luaL_typename(L1, L1_i));
         STACK_CHECK(L1, 1);
         // raise the error when copying from lane to lane, else just leave it on the stack to be raised later
-        if (mode == LookupMode::LaneBody) {
+        if constexpr (MODE == LookupMode::LaneBody) {
             raise_lua_error(getErrL()); // that's ok, getErrL() is L1 in that case
         }
         return InterCopyResult::Error;
@@ -1207,7 +1514,7 @@ namespace {
     // but don't copy it anyway, as the function names change depending on the slot index!
     // users should provide an on_state_create function to setup custom loaders instead
     // don't copy package.preload in keeper states (they don't know how to translate functions)
-    std::string_view const _entries[] = { "path", "cpath", (mode == LookupMode::LaneBody) ? "preload" : "" /*, (LUA_VERSION_NUM == 501) ? "loaders" : "searchers"*/, "" };
+    std::string_view const _entries[] = { "path", "cpath", (MODE != LookupMode::ToKeeper) ? "preload" : "" /*, (LUA_VERSION_NUM == 501) ? "loaders" : "searchers"*/, "" };
     for (std::string_view const& _entry : _entries) {
         if (_entry.empty()) {
             continue;
@@ -1226,7 +1533,7 @@ namespace {
             } else {
                 lua_pushfstring(L1, "failed to copy package entry %s", _entry);
                 // raise the error when copying from lane to lane, else just leave it on the stack to be raised later
-                if (mode == LookupMode::LaneBody) {
+                if constexpr (MODE == LookupMode::LaneBody) {
                     raise_lua_error(getErrL());
                 }
                 lua_pop(L1, 1);
@@ -1242,7 +1549,8 @@ namespace {
 
 // Akin to 'lua_xmove' but copies values between _any_ Lua states.
 // NOTE: Both the states must be solely in the current OS thread's possession.
-[[nodiscard]] InterCopyResult InterCopyContext::inter_copy(int n_) const
+template <LookupMode MODE>
+[[nodiscard]] InterCopyResult InterCopyContext<MODE>::inter_copy(int n_) const
 {
     LUA_ASSERT(L1, vt == VT::NORMAL);
 
@@ -1269,7 +1577,7 @@ namespace {
 
     char _tmpBuf[16];
     char const* const _pBuf{ U->verboseErrors ? _tmpBuf : "?" };
-    InterCopyContext _c{ U, L2, L1, CacheIndex{ _top_L2 + 1 }, {}, VT::NORMAL, mode, _pBuf };
+    InterCopyContext _c{ U, L2, L1, CacheIndex{ _top_L2 + 1 }, {}, VT::NORMAL, _pBuf, deferredMoves };
     bool _copyok{ true };
     STACK_CHECK_START_REL(L1, 0);
     for (int _i{ _top_L1 - n_ + 1 }, _j{ 1 }; _i <= _top_L1; ++_i, ++_j) {
@@ -1300,9 +1608,16 @@ namespace {
 
 // #################################################################################################
 
-[[nodiscard]] InterCopyResult InterCopyContext::inter_move(int n_) const
+template <LookupMode MODE>
+[[nodiscard]] InterCopyResult InterCopyContext<MODE>::inter_move(int n_) const
 {
     InterCopyResult const _ret{ inter_copy(n_) };
     lua_pop(L1, n_);
     return _ret;
 }
+
+// #################################################################################################
+
+template class InterCopyContext<LookupMode::LaneBody>;
+template class InterCopyContext<LookupMode::ToKeeper>;
+template class InterCopyContext<LookupMode::FromKeeper>;
@@ -3,6 +3,7 @@
 #include "tools.h"
 
 #include <string_view>
+#include <vector>
 
 // forwards
 class Universe;
@@ -25,25 +26,74 @@ enum class InterCopyResult
 
 // #################################################################################################
 
+// the __lanesmove calls of a transfer, postponed until the whole transfer has succeeded
+// that way, a linda:send() that is refused because the key is full, or a lane that fails to launch, doesn't leave the source moved-from
+// the sources must stay alive until finish() or cancel()
+class DeferredMoves
+{
+    private:
+    struct Move
+    {
+        lua_CFunction moveF; // a C function without upvalues is simply pushed again
+        int moveRef; // else the __lanesmove value is anchored in the registry until the call
+        void* clone;
+        void* source;
+        size_t size;
+    };
+    lua_State* L{ nullptr }; // where the __lanesmove calls happen
+    std::vector<Move> moves;
+
+    public:
+    DeferredMoves() = default;
+    ~DeferredMoves() { cancel(); }
+    // non-copyable, non-movable
+    DeferredMoves(DeferredMoves const&) = delete;
+    DeferredMoves(DeferredMoves const&&) = delete;
+    DeferredMoves& operator=(DeferredMoves const&) = delete;
+    DeferredMoves& operator=(DeferredMoves const&&) = delete;
+
+    void cancel();
+    void defer(lua_State* L_, void* clone_, void* source_, size_t size_);
+    void finish();
+};
+
+// xxh64 of string "kFuncDumpsRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kFuncDumpsRegKey{ 0xB2853D04E35F303Cull }; // while lane_spawn_many() runs: the bytecode of the functions copied from its state, dumped only once for all its lanes
+
+// #################################################################################################
+
 using CacheIndex = Unique<int>;
 using SourceIndex = Unique<int>;
+// the lookup mode is a template parameter so that each kind of transfer compiles without the branches that don't concern it
+// all 3 specializations are explicitly instantiated in intercopycontext.cpp
+template <LookupMode MODE>
 class InterCopyContext
 {
     public:
+    static constexpr LookupMode mode{ MODE };
+
     Universe* const U;
     DestState const L2;
     SourceState const L1;
     CacheIndex const L2_cache_i;
     SourceIndex L1_i; // that one can change when we reuse the context
     VT vt; // that one can change when we reuse the context
-    LookupMode const mode;
     char const* name; // that one can change when we reuse the context
+    DeferredMoves* deferredMoves{ nullptr }; // where __lanesmove calls wait for the whole transfer to succeed, else they happen immediately
 
     private:
     // when mode == LookupMode::FromKeeper, L1 is a keeper state and L2 is not, therefore L2 is the state where we want to raise the error
     // whon mode != LookupMode::FromKeeper, L1 is not a keeper state, therefore L1 is the state where we want to raise the error
-    lua_State* getErrL() const { return (mode == LookupMode::FromKeeper) ? L2 : L1; }
+    lua_State* getErrL() const
+    {
+        if constexpr (MODE == LookupMode::FromKeeper) {
+            return L2;
+        } else {
+            return L1;
+        }
+    }
     [[nodiscard]] std::string_view findLookupName() const;
+    [[nodiscard]] size_t offloadThreshold() const;
 
     // for use in copy_cached_func
     void copy_func() const;
@@ -64,6 +114,7 @@ class InterCopyContext
 
     // copying a single Lua stack item
     [[nodiscard]] bool inter_copy_boolean() const;
+    [[nodiscard]] bool inter_copy_cdata() const;
     [[nodiscard]] bool inter_copy_function() const;
     [[nodiscard]] bool inter_copy_lightuserdata() const;
     [[nodiscard]] bool inter_copy_nil() const;
@@ -39,6 +39,7 @@
  */
 #include "keeper.h"
 
+#include "buffer.h"
 #include "intercopycontext.h"
 #include "lane.h"
 #include "linda.h"
@@ -46,6 +47,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <ranges>
 
 // There is a table at _R[kLindasRegKey] (aka LindasDB)
@@ -53,6 +55,139 @@
 // Each KeysDB contains entries of the form [key] = KeyUD
 // where key is a key used in the Lua Linda API to exchange data, and KeyUD is a full userdata with a table uservalue
 // the table uservalue is the actual fifo, where elements are added and removed.
+// the most recent elements can also be stored natively in the KeyUD itself (see ScalarValue), until something needs to see the fifo as a table.
+
+// #################################################################################################
+// #################################################################################################
+// ######################################### ScalarValue ###########################################
+// #################################################################################################
+// #################################################################################################
+
+// a nil, boolean, number or short string value, stored without any Lua object in the keeper
+struct ScalarValue
+{
+    static constexpr size_t kMaxLength{ 22 };
+    enum class Kind : unsigned char
+    {
+        Nil,
+        Boolean,
+        Integer,
+        Number,
+        String
+    };
+
+    union
+    {
+        bool boolean;
+        lua_Integer integer;
+        lua_Number number;
+        char string[kMaxLength];
+    };
+    Kind kind;
+    unsigned char length;
+
+    [[nodiscard]] static bool IsStorable(lua_State* L_, int idx_, int offloadThreshold_);
+    void push(lua_State* L_, bool inKeeper_) const;
+    void store(lua_State* L_, int idx_);
+};
+static_assert(std::is_trivially_copyable_v<ScalarValue>);
+
+// #################################################################################################
+
+// string values long enough to be offloaded must go through the regular copy
+bool ScalarValue::IsStorable(lua_State* const L_, int const idx_, int const offloadThreshold_)
+{
+    switch (lua_type_as_enum(L_, idx_)) {
+    case LuaType::NIL:
+    case LuaType::BOOLEAN:
+    case LuaType::NUMBER:
+        return true;
+
+    case LuaType::STRING:
+        {
+            size_t const _len{ lua_rawlen(L_, idx_) };
+            return _len <= kMaxLength && (offloadThreshold_ <= 0 || _len < static_cast<size_t>(offloadThreshold_));
+        }
+
+    default:
+        return false;
+    }
+}
+
+// #################################################################################################
+
+// inKeeper_: in a keeper, nil is stored as a nil sentinel, as inter_copy_nil() does
+void ScalarValue::push(lua_State* const L_, bool const inKeeper_) const
+{
+    switch (kind) {
+    case Kind::Nil:
+        if (inKeeper_) {
+            kNilSentinel.pushKey(L_);
+        } else {
+            lua_pushnil(L_);
+        }
+        break;
+
+    case Kind::Boolean:
+        lua_pushboolean(L_, boolean ? 1 : 0);
+        break;
+
+#if defined LUA_LNUM || LUA_VERSION_NUM >= 503
+    case Kind::Integer:
+        lua_pushinteger(L_, integer);
+        break;
+#endif // defined LUA_LNUM || LUA_VERSION_NUM >= 503
+
+    case Kind::Number:
+        lua_pushnumber(L_, number);
+        break;
+
+    case Kind::String:
+        std::ignore = lua_pushstringview(L_, std::string_view{ string, length });
+        break;
+
+    default:
+        break;
+    }
+}
+
+// #################################################################################################
+
+// the value at idx_ must be storable
+void ScalarValue::store(lua_State* const L_, int const idx_)
+{
+    switch (lua_type_as_enum(L_, idx_)) {
+    case LuaType::BOOLEAN:
+        kind = Kind::Boolean;
+        boolean = lua_toboolean(L_, idx_) ? true : false;
+        break;
+
+    case LuaType::NUMBER:
+#if defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        if (lua_isinteger(L_, idx_)) {
+            kind = Kind::Integer;
+            integer = lua_tointeger(L_, idx_);
+            break;
+        }
+#endif // defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        kind = Kind::Number;
+        number = lua_tonumber(L_, idx_);
+        break;
+
+    case LuaType::STRING:
+        {
+            std::string_view const _s{ lua_tostringview(L_, idx_) };
+            kind = Kind::String;
+            length = static_cast<unsigned char>(_s.size());
+            std::memcpy(string, _s.data(), _s.size());
+        }
+        break;
+
+    default:
+        kind = Kind::Nil;
+        break;
+    }
+}
 
 // #################################################################################################
 // #################################################################################################
@@ -60,13 +195,23 @@
 // #################################################################################################
 // #################################################################################################
 
+// KeyUD -> slab full userdata, so that the slab lives as long as the KeyUD that points to it
+// xxh64 of string "kSlabsRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kSlabsRegKey{ 0x2ABCC1724F7901EDull };
+
 // the full userdata associated to a given Linda key to store its contents
 class KeyUD
 {
     public:
+    // the slab holds the last slabCount elements of the fifo, that come after those of the fifo table
+    // it is only allocated when the first scalar is sent, so that keys that never see one don't pay for it
+    static constexpr int kSlabSize{ 16 };
     int first{ 1 };
-    int count{ 0 };
+    int count{ 0 }; // fifo table and slab elements
     int limit{ -1 };
+    int slabFirst{ 0 };
+    int slabCount{ 0 };
+    ScalarValue* slab{ nullptr };
 
     // a fifo full userdata has one uservalue, the table that holds the actual fifo contents
     [[nodiscard]] static void* operator new([[maybe_unused]] size_t size_, KeeperState L_) noexcept { return lua_newuserdatauv<KeyUD>(L_, 1); }
@@ -77,9 +222,14 @@ class KeyUD
     [[nodiscard]] static KeyUD* GetPtr(KeeperState K_, int idx_);
     [[nodiscard]] static KeyUD* Create(KeeperState K_);
     [[nodiscard]] static KeyUD* PrepareAccess(KeeperState K_, int idx_);
+    void allocateSlab(KeeperState K_, int idx_);
+    void flattenSlab(KeeperState K_, int idx_);
     void peek(KeeperState K_, int count_);
     void pop(KeeperState K_, int count_);
+    void popScalar(lua_State* L_);
     void push(KeeperState K_, int count_);
+    void pushScalars(KeeperState K_, int idx_, lua_State* L_, int start_, int count_);
+    void reset(KeeperState K_);
 };
 
 static constexpr int kContentsTableIndex{ 1 };
@@ -110,12 +260,13 @@ KeyUD* KeyUD::GetPtr(KeeperState const K_, int idx_)
 
 // #################################################################################################
 
-// replaces the fifo ud by its uservalue on the stack
+// replaces the fifo ud by its uservalue on the stack, after moving the slab contents in it
 KeyUD* KeyUD::PrepareAccess(KeeperState const K_, int const idx_)
 {
     KeyUD* const _key{ KeyUD::GetPtr(K_, idx_) };
     if (_key) {
         int const _idx{ lua_absindex(K_, idx_) };
+        _key->flattenSlab(K_, _idx);
         STACK_GROW(K_, 1);
         // we can replace the key userdata in the stack without fear of it being GCed, there are other references around
         lua_getiuservalue(K_, _idx, kContentsTableIndex);
@@ -126,6 +277,45 @@ KeyUD* KeyUD::PrepareAccess(KeeperState const K_, int const idx_)
 
 // #################################################################################################
 
+// in: nothing (KeyUD at idx_)
+// out: nothing, the slab is allocated
+void KeyUD::allocateSlab(KeeperState const K_, int const idx_)
+{
+    STACK_GROW(K_, 3);
+    STACK_CHECK_START_REL(K_, 0);
+    kSlabsRegKey.getSubTableMode(K_, "k");                                                         // K_: {slabs}
+    lua_pushvalue(K_, idx_);                                                                       // K_: {slabs} KeyUD
+    slab = static_cast<ScalarValue*>(lua_newuserdatauv(K_, sizeof(ScalarValue) * kSlabSize, 0));  // K_: {slabs} KeyUD slab
+    lua_rawset(K_, -3);                                                                            // K_: {slabs}
+    lua_pop(K_, 1);                                                                                // K_:
+    STACK_CHECK(K_, 0);
+}
+
+// #################################################################################################
+
+// in: nothing (KeyUD at idx_)
+// out: nothing, the slab elements are appended to the fifo table
+void KeyUD::flattenSlab(KeeperState const K_, int const idx_)
+{
+    if (slabCount == 0) {
+        return;
+    }
+    STACK_GROW(K_, 2);
+    STACK_CHECK_START_REL(K_, 0);
+    lua_getiuservalue(K_, idx_, kContentsTableIndex);                                              // K_: fifo
+    int const _start{ first + count - slabCount };
+    for (int const _i : std::ranges::iota_view{ 0, slabCount }) {
+        slab[(slabFirst + _i) % kSlabSize].push(K_, true);                                         // K_: fifo val
+        lua_rawseti(K_, -2, _start + _i);                                                          // K_: fifo
+    }
+    lua_pop(K_, 1);                                                                                // K_:
+    STACK_CHECK(K_, 0);
+    slabFirst = 0;
+    slabCount = 0;
+}
+
+// #################################################################################################
+
 // in: fifo
 // out: ...|nothing
 // expects exactly 1 value on the stack!
@@ -191,6 +381,54 @@ void KeyUD::push(KeeperState const K_, int const count_)
     count += count_;
 }
 
+// the fifo table must be empty, and the slab must not
+// out: the first slab element is pushed in L_
+void KeyUD::popScalar(lua_State* const L_)
+{
+    slab[slabFirst].push(L_, false);
+    slabFirst = (slabFirst + 1) % kSlabSize;
+    --slabCount;
+    if (--count == 0) {
+        first = 1;
+    }
+}
+
+// #################################################################################################
+
+// in: nothing (KeyUD at idx_)
+// out: nothing, the count_ storable values starting at start_ in L_ are appended to the fifo
+void KeyUD::pushScalars(KeeperState const K_, int const idx_, lua_State* const L_, int const start_, int const count_)
+{
+    if (slab == nullptr) {
+        allocateSlab(K_, idx_);
+    }
+    for (int const _i : std::ranges::iota_view{ start_, start_ + count_ }) {
+        // no more room in the slab: move its contents in the fifo table, that's where older elements go
+        if (slabCount == kSlabSize) {
+            flattenSlab(K_, idx_);
+        }
+        slab[(slabFirst + slabCount) % kSlabSize].store(L_, _i);
+        ++slabCount;
+        ++count;
+    }
+}
+
+// #################################################################################################
+
+// in: KeyUD
+// out: KeyUD
+// empties the fifo: replace uservalue with a virgin table, reset counters, but leave limit unchanged!
+void KeyUD::reset(KeeperState const K_)
+{
+    STACK_GROW(K_, 1);
+    lua_newtable(K_);                                                                              // K_: KeyUD {}
+    lua_setiuservalue(K_, -2, kContentsTableIndex);                                                // K_: KeyUD
+    first = 1;
+    count = 0;
+    slabFirst = 0;
+    slabCount = 0;
+}
+
 // #################################################################################################
 // #################################################################################################
 
@@ -244,7 +482,7 @@ int keeper_push_linda_storage(Linda& linda_, DestState L_)
     STACK_GROW(L_, 5);
     STACK_CHECK_START_REL(L_, 0);
     lua_newtable(L_);                                                                              // _K: KeysDB                                         L_: out
-    InterCopyContext _c{ linda_.U, L_, SourceState{ _K }, {}, {}, {}, LookupMode::FromKeeper, {} };
+    InterCopyContext<LookupMode::FromKeeper> _c{ linda_.U, L_, SourceState{ _K }, {}, {}, {}, {} };
     lua_pushnil(_K);                                                                               // _K: KeysDB nil                                     L_: out
     while (lua_next(_K, -2)) {                                                                     // _K: KeysDB key KeyUD                               L_: out
         KeyUD* const _keyUD{ KeyUD::PrepareAccess(_K, -1) };                                       // _K: KeysDB key fifo                                L_: out
@@ -402,6 +640,56 @@ int keepercall_receive_batched(lua_State* const L_)
 
 // #################################################################################################
 
+// in: linda key type [maxlen]
+// out: val if the first value stored under key is of the requested LuaType (a buffer stands for a string), else nothing if there is no value
+// else false if the value is of another type, or false len if it is a string longer than maxlen (in both cases the value is kept)
+int keepercall_receive_typed(lua_State* const L_)
+{
+    KeeperState const _K{ L_ };
+    LuaType const _type{ static_cast<LuaType>(lua_tointeger(_K, 3)) };
+    lua_Integer const _maxlen{ luaL_optinteger(_K, 4, -1) };
+    lua_settop(_K, 2);                                                                             // _K: linda key
+    PushKeysDB(_K, 1);                                                                             // _K: linda key KeysDB
+    lua_replace(_K, 1);                                                                            // _K: KeysDB key
+    lua_rawget(_K, 1);                                                                             // _K: KeysDB KeyUD|nil
+    KeyUD* const _key{ KeyUD::PrepareAccess(_K, 2) };                                              // _K: KeysDB fifo|nil
+    if (_key == nullptr || _key->count == 0) {
+        return 0;
+    }
+    lua_remove(_K, 1);                                                                             // _K: fifo
+    _key->peek(_K, 1);                                                                             // _K: fifo val
+    std::optional<size_t> _len;
+    switch (lua_type_as_enum(_K, -1)) {
+    case LuaType::STRING:
+        _len = lua_rawlen(_K, -1);
+        break;
+
+    case LuaType::USERDATA:
+        if (Buffer const* const _buffer{ static_cast<Buffer const*>(BufferFactory::Instance.toDeep(_K, -1)) }; _buffer != nullptr) {
+            _len = _buffer->view().size();
+        }
+        break;
+
+    default:
+        break;
+    }
+    bool const _match{ (_type == LuaType::STRING) ? _len.has_value() : (lua_type_as_enum(_K, -1) == _type) };
+    lua_pop(_K, 1);                                                                                // _K: fifo
+    if (!_match) {
+        lua_pushboolean(_K, 0);                                                                    // _K: fifo false
+        return 1;
+    }
+    if (_maxlen >= 0 && _len.value_or(0) > static_cast<size_t>(_maxlen)) {
+        lua_pushboolean(_K, 0);                                                                    // _K: fifo false
+        lua_pushinteger(_K, static_cast<lua_Integer>(_len.value()));                               // _K: fifo false len
+        return 2;
+    }
+    _key->pop(_K, 1);                                                                              // _K: val
+    return 1;
+}
+
+// #################################################################################################
+
 // in: linda_ud key [n|nil]
 // out: true or nil
 int keepercall_limit(lua_State* const L_)
@@ -464,10 +752,7 @@ int keepercall_set(lua_State* const L_)
                 // we create room if the KeyUD was full but it is no longer the case
                 _should_wake_writers = (_key->limit > 0) && (_key->count >= _key->limit);
                 lua_remove(_K, -2);                                                                // _K: KeysDB KeyUD
-                lua_newtable(_K);                                                                  // _K: KeysDB KeyUD {}
-                lua_setiuservalue(_K, -2, kContentsTableIndex);                                    // _K: KeysDB KeyUD
-                _key->first = 1;
-                _key->count = 0;
+                _key->reset(_K);                                                                   // _K: KeysDB KeyUD
             }
         }
     } else { // set/replace contents stored at the specified key?
@@ -486,12 +771,7 @@ int keepercall_set(lua_State* const L_)
             // the KeyUD exists, we just want to update its contents
             // we create room if the KeyUD was full but it is no longer the case
             _should_wake_writers = (_key->limit > 0) && (_key->count >= _key->limit) && (_count < _key->limit);
-            // TODO: turn this into a KeyUD::reset() method
-            // empty the KeyUD for the specified key: replace uservalue with a virgin table, reset counters, but leave limit unchanged!
-            lua_newtable(_K);                                                                      // _K: KeysDB key val... KeyUD {}
-            lua_setiuservalue(_K, -2, kContentsTableIndex);                                        // _K: KeysDB key val... KeyUD
-            _key->first = 1;
-            _key->count = 0;
+            _key->reset(_K);                                                                       // _K: KeysDB key val... KeyUD
         }
         _key = KeyUD::PrepareAccess(_K, -1);                                                       // _K: KeysDB key val... fifo
         // move the fifo below the values we want to store
@@ -593,6 +873,26 @@ int keepercall_count(lua_State* const L_)
 
 // #################################################################################################
 
+// since keeper state GC is stopped, let's run a step once in a while if required
+static void StepGC(KeeperState const K_, lua_State* const L_, Universe* const U_)
+{
+    int const _gc_threshold{ U_->keepers.gc_threshold };
+    if (_gc_threshold == 0) [[unlikely]] {
+        lua_gc(K_, LUA_GCSTEP, 0);
+    } else if (_gc_threshold > 0) [[likely]] {
+        int const _gc_usage{ lua_gc(K_, LUA_GCCOUNT, 0) };
+        if (_gc_usage >= _gc_threshold) {
+            lua_gc(K_, LUA_GCCOLLECT, 0);
+            int const _gc_usage_after{ lua_gc(K_, LUA_GCCOUNT, 0) };
+            if (_gc_usage_after > _gc_threshold) [[unlikely]] {
+                raise_luaL_error(L_, "Keeper GC threshold is too low, need at least %d", _gc_usage_after);
+            }
+        }
+    }
+}
+
+// #################################################################################################
+
 /*
  * Call a function ('func_name') in the keeper state, and pass on the returned
  * values to 'L'.
@@ -605,27 +905,51 @@ int keepercall_count(lua_State* const L_)
 KeeperCallResult keeper_call(KeeperState K_, keeper_api_t func_, lua_State* L_, Linda* linda_, int starting_index_)
 {
     KeeperCallResult _result;
+    // only send() and set() carry a payload. the other operations take optional numbers after their key(s):
+    // trailing nils stand for omitted arguments, they must not reach the keeper as nil sentinels
+    if (starting_index_ && func_ != KEEPER_API(send) && func_ != KEEPER_API(set)) {
+        int _top{ lua_gettop(L_) };
+        while (_top >= starting_index_ && lua_isnil(L_, _top)) {
+            --_top;
+        }
+        lua_settop(L_, _top);                                                                      // L: ... args...
+    }
     int const _args{ starting_index_ ? (lua_gettop(L_) - starting_index_ + 1) : 0 };               // L: ... args...                                  K_:
     int const _top_K{ lua_gettop(K_) };
     // if we didn't do anything wrong, the keeper stack should be clean
     LUA_ASSERT(L_, _top_K == 0);
 
-    STACK_GROW(K_, 2);
+    STACK_GROW(K_, 2 + _args);
     PUSH_KEEPER_FUNC(K_, func_);                                                                   // L: ... args...                                  K_: func_
     lua_pushlightuserdata(K_, linda_);                                                             // L: ... args...                                  K_: func_ linda
+    // linda keys are copied as table keys, so that they are never offloaded out of the keeper. count() and receive() take only keys, the other operations a single one followed by their own arguments
+    int const _nbKeys{ (func_ == KEEPER_API(count) || func_ == KEEPER_API(receive)) ? _args : std::min(_args, 1) };
+    InterCopyContext<LookupMode::ToKeeper> _keysCopy{ linda_->U, DestState{ K_ }, SourceState{ L_ }, {}, {}, VT::KEY, {} };
+    bool _keysCopied{ true };
+    DeferredMoves _moves;
+    for (int _i{ 0 }; _keysCopied && _i < _nbKeys; ++_i) {
+        _keysCopy.L1_i = SourceIndex{ starting_index_ + _i };
+        _keysCopied = _keysCopy.inter_copy_one();                                                  // L: ... args...                                  K_: func_ linda keys...
+    }
     if (
-        (_args == 0) ||
-        (InterCopyContext{ linda_->U, DestState{ K_ }, SourceState{ L_ }, {}, {}, {}, LookupMode::ToKeeper, {} }.inter_copy(_args) == InterCopyResult::Success)
+        _keysCopied && (
+            (_args == _nbKeys) ||
+            (InterCopyContext<LookupMode::ToKeeper>{ linda_->U, DestState{ K_ }, SourceState{ L_ }, {}, {}, {}, {}, &_moves }.inter_copy(_args - _nbKeys) == InterCopyResult::Success)
+        )
     ) {                                                                                            // L: ... args...                                  K_: func_ linda args...
         lua_call(K_, 1 + _args, LUA_MULTRET);                                                      // L: ... args...                                  K_: result...
         int const _retvals{ lua_gettop(K_) - _top_K };
+        // send() tells if the values were stored, or refused because the key is full. only then are movable userdata moved-from
+        if (func_ != KEEPER_API(send) || lua_toboolean(K_, _top_K + 1)) {
+            _moves.finish();
+        }
         // note that this can raise a lua error while the keeper state (and its mutex) is acquired
         // this may interrupt a lane, causing the destruction of the underlying OS thread
         // after this, another lane making use of this keeper can get an error code from the mutex-locking function
         // when attempting to grab the mutex again (WINVER <= 0x400 does this, but locks just fine, I don't know about pthread)
         if (
             (_retvals == 0) ||
-            (InterCopyContext{ linda_->U, DestState{ L_ }, SourceState{ K_ }, {}, {}, {}, LookupMode::FromKeeper, {} }.inter_move(_retvals) == InterCopyResult::Success)
+            (InterCopyContext<LookupMode::FromKeeper>{ linda_->U, DestState{ L_ }, SourceState{ K_ }, {}, {}, {}, {} }.inter_move(_retvals) == InterCopyResult::Success)
         ) {                                                                                        // L: ... args... result...                        K_: result...
             _result.emplace(_retvals);
         }
@@ -635,25 +959,406 @@ KeeperCallResult keeper_call(KeeperState K_, keeper_api_t func_, lua_State* L_,
 
     // don't do this for this particular function, as it is only called during Linda destruction, and we don't want to raise an error, ever
     if (func_ != KEEPER_API(clear)) [[unlikely]] {
-        // since keeper state GC is stopped, let's run a step once in a while if required
-        int const _gc_threshold{ linda_->U->keepers.gc_threshold };
-        if (_gc_threshold == 0) [[unlikely]] {
-            lua_gc(K_, LUA_GCSTEP, 0);
-        } else if (_gc_threshold > 0) [[likely]] {
-            int const _gc_usage{ lua_gc(K_, LUA_GCCOUNT, 0) };
-            if (_gc_usage >= _gc_threshold) {
-                lua_gc(K_, LUA_GCCOLLECT, 0);
-                int const _gc_usage_after{ lua_gc(K_, LUA_GCCOUNT, 0) };
-                if (_gc_usage_after > _gc_threshold) [[unlikely]] {
-                    raise_luaL_error(L_, "Keeper GC threshold is too low, need at least %d", _gc_usage_after);
+        StepGC(K_, L_, linda_->U);
+    }
+
+    return _result;
+}
+
+// #################################################################################################
+
+// in: nothing
+// out: nothing
+// pushes in the keeper a copy of the key at key_index_ in L_, which has been validated already
+static void PushKeyFrom(KeeperState const K_, lua_State* const L_, int const key_index_)
+{
+    switch (lua_type_as_enum(L_, key_index_)) {
+    case LuaType::BOOLEAN:
+        lua_pushboolean(K_, lua_toboolean(L_, key_index_));
+        break;
+
+    case LuaType::NUMBER:
+#if defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        if (lua_isinteger(L_, key_index_)) {
+            lua_pushinteger(K_, lua_tointeger(L_, key_index_));
+            break;
+        }
+#endif // defined LUA_LNUM || LUA_VERSION_NUM >= 503
+        lua_pushnumber(K_, lua_tonumber(L_, key_index_));
+        break;
+
+    case LuaType::STRING:
+        std::ignore = lua_pushstringview(K_, lua_tostringview(L_, key_index_));
+        break;
+
+    default: // LuaType::LIGHTUSERDATA
+        lua_pushlightuserdata(K_, lua_touserdata(L_, key_index_));
+        break;
+    }
+}
+
+// #################################################################################################
+
+// in: nothing
+// out: linda KeysDB KeyUD
+// the KeyUD of the key at key_index_ in L_ is created if it doesn't exist yet
+[[nodiscard]] static KeyUD* PushOrCreateKeyUD(KeeperState const K_, lua_State* const L_, Linda* const linda_, int const key_index_)
+{
+    STACK_GROW(K_, 5);
+    STACK_CHECK_START_REL(K_, 0);
+    lua_pushlightuserdata(K_, linda_);                                                             // K_: linda
+    PushKeysDB(K_, -1);                                                                            // K_: linda KeysDB
+    PushKeyFrom(K_, L_, key_index_);                                                               // K_: linda KeysDB key
+    lua_rawget(K_, -2);                                                                            // K_: linda KeysDB KeyUD|nil
+    KeyUD* _key{ KeyUD::GetPtr(K_, -1) };
+    if (_key == nullptr) {
+        lua_pop(K_, 1);                                                                            // K_: linda KeysDB
+        _key = KeyUD::Create(K_);                                                                  // K_: linda KeysDB KeyUD
+        PushKeyFrom(K_, L_, key_index_);                                                           // K_: linda KeysDB KeyUD key
+        lua_pushvalue(K_, -2);                                                                     // K_: linda KeysDB KeyUD key KeyUD
+        lua_rawset(K_, -4);                                                                        // K_: linda KeysDB KeyUD
+    }
+    STACK_CHECK(K_, 3);
+    return _key;
+}
+
+// #################################################################################################
+
+// same as keeper_call(K_, KEEPER_API(send), L_, linda_, starting_index_), when all values are nil, boolean, number or short string
+// they are stored in the slab of the key, without any Lua object created in the keeper, and without calling into the keeper
+// returns unset if the values don't qualify, in which case the caller must use keeper_call()
+KeeperCallResult keeper_send_scalars(KeeperState const K_, lua_State* const L_, Linda* const linda_, int const starting_index_)
+{
+    KeeperCallResult _result;
+    int const _top{ lua_gettop(L_) };
+    int const _n{ _top - starting_index_ };
+    int const _threshold{ linda_->U->keepers.offload_threshold };
+    for (int const _i : std::ranges::iota_view{ starting_index_ + 1, _top + 1 }) {
+        if (!ScalarValue::IsStorable(L_, _i, _threshold)) {
+            return _result;
+        }
+    }
+    LUA_ASSERT(L_, lua_gettop(K_) == 0);
+    STACK_CHECK_START_REL(K_, 0);
+    KeyUD* const _key{ PushOrCreateKeyUD(K_, L_, linda_, starting_index_) };                       // L_: ... key args...                             K_: linda KeysDB KeyUD
+    bool const _room{ _key->limit < 0 || _key->count + _n <= _key->limit };
+    if (_room) {
+        _key->pushScalars(K_, lua_gettop(K_), L_, starting_index_ + 1, _n);
+    }
+    lua_settop(K_, 0);                                                                             // L_: ... key args...                             K_:
+    STACK_CHECK(K_, 0);
+    lua_pushboolean(L_, _room ? 1 : 0);                                                            // L_: ... key args... bool                        K_:
+    _result.emplace(1);
+    return _result;
+}
+
+// #################################################################################################
+
+// same as keeper_call(K_, KEEPER_API(receive), L_, linda_, key_index_) for a single key whose fifo table is empty, without calling into the keeper
+// returns unset if the older elements are not in the slab, in which case the caller must use keeper_call()
+KeeperCallResult keeper_receive_scalar(KeeperState const K_, lua_State* const L_, Linda* const linda_, int const key_index_)
+{
+    KeeperCallResult _result;
+    LUA_ASSERT(L_, lua_gettop(K_) == 0);
+    STACK_GROW(K_, 4);
+    STACK_GROW(L_, 2);
+    lua_pushlightuserdata(K_, linda_);                                                             // L_: ... key                                     K_: linda
+    PushKeysDB(K_, -1);                                                                            // L_: ... key                                     K_: linda KeysDB
+    PushKeyFrom(K_, L_, key_index_);                                                               // L_: ... key                                     K_: linda KeysDB key
+    lua_rawget(K_, -2);                                                                            // L_: ... key                                     K_: linda KeysDB KeyUD|nil
+    KeyUD* const _key{ KeyUD::GetPtr(K_, -1) };
+    if (_key == nullptr || _key->count == 0) {
+        _result.emplace(0);
+    } else if (_key->count == _key->slabCount) {
+        lua_pushvalue(L_, key_index_);                                                             // L_: ... key key                                 K_: linda KeysDB KeyUD
+        _key->popScalar(L_);                                                                       // L_: ... key key val                             K_: linda KeysDB KeyUD
+        _result.emplace(2);
+    }
+    lua_settop(K_, 0);                                                                             // L_: ... key [key val]                           K_:
+    return _result;
+}
+
+// #################################################################################################
+
+// copies the value at the top of L1_ to L2_ as a message of its own: it doesn't share a cache table with any other value
+template <LookupMode MODE>
+[[nodiscard]] static bool CopyMessage(Universe* const U_, lua_State* const L2_, lua_State* const L1_, DeferredMoves* const moves_ = nullptr)
+{
+    switch (lua_type(L1_, -1)) {
+    case LUA_TTABLE:
+    case LUA_TFUNCTION:
+    case LUA_TUSERDATA:
+        return InterCopyContext<MODE>{ U_, DestState{ L2_ }, SourceState{ L1_ }, {}, {}, {}, {}, moves_ }.inter_copy(1) == InterCopyResult::Success;
+
+    default: // values that never need a cache
+        return InterCopyContext<MODE>{ U_, DestState{ L2_ }, SourceState{ L1_ }, {}, SourceIndex{ lua_gettop(L1_) }, VT::NORMAL, {} }.inter_copy_one();
+    }
+}
+
+// #################################################################################################
+
+// same as keeper_call(K_, KEEPER_API(send), L_, linda_, key_index_) with the elements of the array at key_index_ + 1 as the values, without unpacking it on the stack
+// all elements must fit under the limit of the key, else nothing is sent
+KeeperCallResult keeper_send_array(KeeperState const K_, lua_State* const L_, Linda* const linda_, int const key_index_)
+{
+    KeeperCallResult _result;
+    int const _tbl_i{ key_index_ + 1 };
+    int const _n{ static_cast<int>(lua_rawlen(L_, _tbl_i)) };
+    LUA_ASSERT(L_, lua_gettop(K_) == 0);
+    STACK_GROW(K_, 2);
+    STACK_GROW(L_, 2);
+    STACK_CHECK_START_REL(K_, 0);
+    KeyUD* const _key{ PushOrCreateKeyUD(K_, L_, linda_, key_index_) };                            // L_: ... key tbl                                 K_: linda KeysDB KeyUD
+    bool const _room{ _key->limit < 0 || _key->count + _n <= _key->limit };
+    bool _copied{ true };
+    DeferredMoves _moves;
+    if (_room && _n > 0) {
+        // the elements go after those of the slab: flatten it first
+        std::ignore = KeyUD::PrepareAccess(K_, -1);                                                // L_: ... key tbl                                 K_: linda KeysDB fifo
+        int const _fifo_i{ lua_gettop(K_) };
+        int const _start{ _key->first + _key->count };
+        for (int const _i : std::ranges::iota_view{ 0, _n }) {
+            lua_rawgeti(L_, _tbl_i, _i + 1);                                                       // L_: ... key tbl val                             K_: linda KeysDB fifo
+            _copied = CopyMessage<LookupMode::ToKeeper>(linda_->U, K_, L_, &_moves);               // L_: ... key tbl val                             K_: linda KeysDB fifo val
+            lua_pop(L_, 1);                                                                        // L_: ... key tbl                                 K_: linda KeysDB fifo val
+            if (!_copied) {
+                // remove what was already stored
+                lua_settop(K_, _fifo_i);                                                           // L_: ... key tbl                                 K_: linda KeysDB fifo
+                for (int const _j : std::ranges::iota_view{ _start, _start + _i }) {
+                    lua_pushnil(K_);                                                               // L_: ... key tbl                                 K_: linda KeysDB fifo nil
+                    lua_rawseti(K_, _fifo_i, _j);                                                  // L_: ... key tbl                                 K_: linda KeysDB fifo
                 }
+                break;
+            }
+            lua_rawseti(K_, _fifo_i, _start + _i);                                                 // L_: ... key tbl                                 K_: linda KeysDB fifo
+        }
+        if (_copied) {
+            _key->count += _n;
+            // all the elements are stored: movable userdata can be moved-from
+            _moves.finish();
+        }
+    }
+    lua_settop(K_, 0);                                                                             // L_: ... key tbl                                 K_:
+    STACK_CHECK(K_, 0);
+    if (_copied) {
+        lua_pushboolean(L_, _room ? 1 : 0);                                                        // L_: ... key tbl bool                            K_:
+        _result.emplace(1);
+    }
+    StepGC(K_, L_, linda_->U);
+    return _result;
+}
+
+// #################################################################################################
+
+// same as keeper_call(K_, KEEPER_API(receive_batched), L_, linda_, key_index_) with up to max values stored in the table at key_index_ + 1 instead of being pushed
+// in L_: key tbl max
+// returns 0 if the key is empty, else 1 after pushing the number of values stored in the table at indices [1, n]
+// tbl is only written once all the values are copied: if one of them can't be, tbl is left untouched and the values remain in the linda
+// movable userdata are only moved out of the keeper at that point too
+KeeperCallResult keeper_receive_into(KeeperState const K_, lua_State* const L_, Linda* const linda_, int const key_index_)
+{
+    // only the values that need a cache in CopyMessage() can fail to copy: scalars are copied once we know the others made it
+    auto const _canFail = [](int const type_) { return type_ == LUA_TTABLE || type_ == LUA_TFUNCTION || type_ == LUA_TUSERDATA; };
+
+    KeeperCallResult _result;
+    int const _tbl_i{ key_index_ + 1 };
+    int const _max{ static_cast<int>(lua_tointeger(L_, key_index_ + 2)) };
+    LUA_ASSERT(L_, lua_gettop(K_) == 0);
+    STACK_GROW(K_, 5);
+    STACK_GROW(L_, 4);
+    STACK_CHECK_START_REL(K_, 0);
+    lua_pushlightuserdata(K_, linda_);                                                             // L_: ... key tbl max                             K_: linda
+    PushKeysDB(K_, -1);                                                                            // L_: ... key tbl max                             K_: linda KeysDB
+    PushKeyFrom(K_, L_, key_index_);                                                               // L_: ... key tbl max                             K_: linda KeysDB key
+    lua_rawget(K_, -2);                                                                            // L_: ... key tbl max                             K_: linda KeysDB KeyUD|nil
+    KeyUD* const _key{ KeyUD::PrepareAccess(K_, -1) };                                             // L_: ... key tbl max                             K_: linda KeysDB fifo|nil
+    int const _n{ _key ? std::min(_key->count, _max) : 0 };
+    int const _fifo_i{ lua_gettop(K_) };
+    // the copies of the values that can fail are staged in a scratch table, only created if there are some
+    lua_pushnil(L_);                                                                               // L_: ... key tbl max nil                         K_: linda KeysDB fifo
+    int const _scratch_i{ lua_gettop(L_) };
+    bool _copied{ true };
+    DeferredMoves _moves;
+    for (int const _i : std::ranges::iota_view{ 0, _n }) {
+        lua_rawgeti(K_, _fifo_i, _key->first + _i);                                                // L_: ... key tbl max scratch                     K_: linda KeysDB fifo val
+        if (!_canFail(lua_type(K_, -1))) {
+            lua_settop(K_, _fifo_i);                                                               // L_: ... key tbl max scratch                     K_: linda KeysDB fifo
+            continue;
+        }
+        _copied = CopyMessage<LookupMode::FromKeeper>(linda_->U, L_, K_, &_moves);                 // L_: ... key tbl max scratch val                 K_: linda KeysDB fifo val
+        lua_settop(K_, _fifo_i);                                                                   // L_: ... key tbl max scratch val                 K_: linda KeysDB fifo
+        if (!_copied) {
+            // the values remain in the linda, and tbl wasn't touched
+            break;
+        }
+        if (lua_isnil(L_, _scratch_i)) {
+            lua_newtable(L_);                                                                      // L_: ... key tbl max nil val {}                  K_: linda KeysDB fifo
+            lua_replace(L_, _scratch_i);                                                           // L_: ... key tbl max {} val                      K_: linda KeysDB fifo
+        }
+        lua_rawseti(L_, _scratch_i, _i + 1);                                                       // L_: ... key tbl max scratch                     K_: linda KeysDB fifo
+    }
+    if (_copied) {
+        // the sources are still in the fifo: hand their resources over to the copies before removing them
+        _moves.finish();
+        for (int const _i : std::ranges::iota_view{ 0, _n }) {
+            lua_rawgeti(K_, _fifo_i, _key->first + _i);                                            // L_: ... key tbl max scratch                     K_: linda KeysDB fifo val
+            if (_canFail(lua_type(K_, -1))) {
+                lua_rawgeti(L_, _scratch_i, _i + 1);                                               // L_: ... key tbl max scratch val                 K_: linda KeysDB fifo val
+            } else {
+                [[maybe_unused]] bool const _ok{ CopyMessage<LookupMode::FromKeeper>(linda_->U, L_, K_) };
+                LUA_ASSERT(L_, _ok);                                                               // L_: ... key tbl max scratch val                 K_: linda KeysDB fifo val
             }
+            lua_rawseti(L_, _tbl_i, _i + 1);                                                       // L_: ... key tbl max scratch                     K_: linda KeysDB fifo val
+            // remove the value from the fifo, the same way KeyUD::pop() does
+            lua_pushnil(K_);                                                                       // L_: ... key tbl max scratch                     K_: linda KeysDB fifo val nil
+            lua_rawseti(K_, _fifo_i, _key->first + _i);                                            // L_: ... key tbl max scratch                     K_: linda KeysDB fifo val
+            lua_settop(K_, _fifo_i);                                                               // L_: ... key tbl max scratch                     K_: linda KeysDB fifo
+        }
+    }
+    lua_settop(L_, _scratch_i - 1);                                                                // L_: ... key tbl max                             K_: linda KeysDB fifo
+    if (_copied) {
+        if (_n > 0) {
+            int const _new_count{ _key->count - _n };
+            _key->first = (_new_count == 0) ? 1 : (_key->first + _n);
+            _key->count = _new_count;
+            lua_pushinteger(L_, _n);                                                               // L_: ... key tbl max n                           K_: linda KeysDB fifo
+        }
+        _result.emplace((_n > 0) ? 1 : 0);
+    }
+    lua_settop(K_, 0);                                                                             // L_: ... key tbl max [n]                         K_:
+    STACK_CHECK(K_, 0);
+    StepGC(K_, L_, linda_->U);
+    return _result;
+}
+
+// #################################################################################################
+// #################################################################################################
+// ###################################### lanes.yield() channels ###################################
+// #################################################################################################
+// #################################################################################################
+
+// the values a lane sends with lanes.yield() are stored in _R[kLaneChannelsRegKey][lane] as a sequence of batches, each one being its value count followed by the values
+// channel.first is the index of the count of the oldest batch, channel.next the index where the next batch goes
+// xxh64 of string "kLaneChannelsRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kLaneChannelsRegKey{ 0x5F68319CA922589Full };
+
+// #################################################################################################
+
+// pushes the channel of the lane, creating it if it doesn't exist yet
+static void PushChannel(KeeperState const K_, void* const lane_)
+{
+    STACK_GROW(K_, 3);
+    STACK_CHECK_START_REL(K_, 0);
+    kLaneChannelsRegKey.pushValue(K_);                                                             // K_: channels
+    lua_pushlightuserdata(K_, lane_);                                                              // K_: channels lane
+    lua_rawget(K_, -2);                                                                            // K_: channels channel|nil
+    if (lua_isnil(K_, -1)) {
+        lua_pop(K_, 1);                                                                            // K_: channels
+        lua_createtable(K_, 0, 2);                                                                 // K_: channels channel
+        lua_pushinteger(K_, 1);                                                                    // K_: channels channel 1
+        lua_setfield(K_, -2, "first");                                                             // K_: channels channel
+        lua_pushinteger(K_, 1);                                                                    // K_: channels channel 1
+        lua_setfield(K_, -2, "next");                                                              // K_: channels channel
+        lua_pushlightuserdata(K_, lane_);                                                          // K_: channels channel lane
+        lua_pushvalue(K_, -2);                                                                     // K_: channels channel lane channel
+        lua_rawset(K_, -4);                                                                        // K_: channels channel
+    }
+    lua_remove(K_, -2);                                                                            // K_: channel
+    STACK_CHECK(K_, 1);
+}
+
+// #################################################################################################
+
+// copies the n_ values at the top of L_ at the end of the channel of the lane, as a single batch
+// returns 0 once they are stored, unset if some of them can't be copied, in which case the channel is left untouched
+KeeperCallResult keeper_channel_send(KeeperState const K_, lua_State* const L_, Universe* const U_, void* const lane_, int const n_)
+{
+    KeeperCallResult _result;
+    LUA_ASSERT(L_, lua_gettop(K_) == 0);
+    STACK_CHECK_START_REL(K_, 0);
+    PushChannel(K_, lane_);                                                                        // L_: ... vals                                    K_: channel
+    DeferredMoves _moves;
+    if (InterCopyContext<LookupMode::ToKeeper>{ U_, DestState{ K_ }, SourceState{ L_ }, {}, {}, {}, {}, &_moves }.inter_copy(n_) == InterCopyResult::Success) {
+        std::ignore = luaG_getfield(K_, 1, "next");                                                // L_: ... vals                                    K_: channel vals next
+        int const _next{ static_cast<int>(lua_tointeger(K_, -1)) };
+        lua_pop(K_, 1);                                                                            // L_: ... vals                                    K_: channel vals
+        for (int _i{ n_ }; _i > 0; --_i) {
+            lua_rawseti(K_, 1, _next + _i);                                                        // L_: ... vals                                    K_: channel
         }
+        lua_pushinteger(K_, n_);                                                                   // L_: ... vals                                    K_: channel n
+        lua_rawseti(K_, 1, _next);                                                                 // L_: ... vals                                    K_: channel
+        lua_pushinteger(K_, _next + n_ + 1);                                                       // L_: ... vals                                    K_: channel next
+        lua_setfield(K_, 1, "next");                                                               // L_: ... vals                                    K_: channel
+        // all the values are stored: movable userdata can be moved-from
+        _moves.finish();
+        _result.emplace(0);
     }
+    lua_settop(K_, 0);                                                                             // L_: ... vals                                    K_:
+    STACK_CHECK(K_, 0);
+    StepGC(K_, L_, U_);
+    return _result;
+}
 
+// #################################################################################################
+
+// moves the values of the oldest batch of the channel of the lane to L_, there must be one
+// returns their count, unset if some of them can't be copied
+// the batch is removed from the channel either way, since the caller has already claimed it
+KeeperCallResult keeper_channel_receive(KeeperState const K_, lua_State* const L_, Universe* const U_, void* const lane_)
+{
+    KeeperCallResult _result;
+    LUA_ASSERT(L_, lua_gettop(K_) == 0);
+    STACK_CHECK_START_REL(K_, 0);
+    PushChannel(K_, lane_);                                                                        // L_: ...                                         K_: channel
+    std::ignore = luaG_getfield(K_, 1, "first");                                                   // L_: ...                                         K_: channel first
+    int const _first{ static_cast<int>(lua_tointeger(K_, -1)) };
+    lua_rawgeti(K_, 1, _first);                                                                    // L_: ...                                         K_: channel first n
+    int const _n{ static_cast<int>(lua_tointeger(K_, -1)) };
+    LUA_ASSERT(L_, _n > 0);
+    lua_settop(K_, 1);                                                                             // L_: ...                                         K_: channel
+    STACK_GROW(K_, _n);
+    for (int _i{ 1 }; _i <= _n; ++_i) {
+        lua_rawgeti(K_, 1, _first + _i);                                                           // L_: ...                                         K_: channel vals
+    }
+    if (InterCopyContext<LookupMode::FromKeeper>{ U_, DestState{ L_ }, SourceState{ K_ }, {}, {}, {}, {} }.inter_move(_n) == InterCopyResult::Success) {
+        _result.emplace(_n);                                                                       // L_: ... vals                                    K_: channel
+    }
+    lua_settop(K_, 1);                                                                             // L_: ... [vals]                                  K_: channel
+    for (int _i{ 0 }; _i <= _n; ++_i) {
+        lua_pushnil(K_);                                                                           // L_: ... [vals]                                  K_: channel nil
+        lua_rawseti(K_, 1, _first + _i);                                                           // L_: ... [vals]                                  K_: channel
+    }
+    // an emptied channel starts over at 1, the same way an emptied linda key does
+    std::ignore = luaG_getfield(K_, 1, "next");                                                    // L_: ... [vals]                                  K_: channel next
+    bool const _empty{ lua_tointeger(K_, -1) == _first + _n + 1 };
+    lua_pop(K_, 1);                                                                                // L_: ... [vals]                                  K_: channel
+    lua_pushinteger(K_, _empty ? 1 : _first + _n + 1);                                             // L_: ... [vals]                                  K_: channel first
+    lua_setfield(K_, 1, "first");                                                                  // L_: ... [vals]                                  K_: channel
+    if (_empty) {
+        lua_pushinteger(K_, 1);                                                                    // L_: ... [vals]                                  K_: channel 1
+        lua_setfield(K_, 1, "next");                                                               // L_: ... [vals]                                  K_: channel
+    }
+    lua_settop(K_, 0);                                                                             // L_: ... [vals]                                  K_:
+    STACK_CHECK(K_, 0);
+    StepGC(K_, L_, U_);
     return _result;
 }
 
+// #################################################################################################
+
+// forgets the channel of the lane, along with the batches nobody read
+void keeper_channel_clear(KeeperState const K_, void* const lane_)
+{
+    STACK_GROW(K_, 3);
+    STACK_CHECK_START_REL(K_, 0);
+    kLaneChannelsRegKey.pushValue(K_);                                                             // K_: channels
+    lua_pushlightuserdata(K_, lane_);                                                              // K_: channels lane
+    lua_pushnil(K_);                                                                               // K_: channels lane nil
+    lua_rawset(K_, -3);                                                                            // K_: channels
+    lua_pop(K_, 1);                                                                                // K_:
+    STACK_CHECK(K_, 0);
+}
+
 // #################################################################################################
 // #################################################################################################
 // ########################################## Keeper ###############################################
@@ -821,7 +1526,7 @@ void Keepers::initialize(Universe& U_, lua_State* L_, int const nbKeepers_, int
         // copy package.path and package.cpath from the source state
         if (luaG_getmodule(L, LUA_LOADLIBNAME) != LuaType::NIL) {                                  // L_: settings package                           _K:
             // when copying with mode LookupMode::ToKeeper, error message is pushed at the top of the stack, not raised immediately
-            InterCopyContext _c{ U, DestState{ _K }, SourceState{ L }, {}, SourceIndex{ lua_absindex(L, -1) }, {}, LookupMode::ToKeeper, {} };
+            InterCopyContext<LookupMode::ToKeeper> _c{ U, DestState{ _K }, SourceState{ L }, {}, SourceIndex{ lua_absindex(L, -1) }, {}, {} };
             if (_c.inter_copy_package() != InterCopyResult::Success) {                             // L_: settings ... error_msg                     _K:
                 // if something went wrong, the error message is at the top of the stack
                 lua_remove(L, -2);                                                                 // L_: settings error_msg
@@ -839,6 +1544,9 @@ void Keepers::initialize(Universe& U_, lua_State* L_, int const nbKeepers_, int
 
         // _R[kLindasRegKey] = {}
         kLindasRegKey.setValue(_K, [](lua_State* L_) { lua_newtable(L_); });
+
+        // _R[kLaneChannelsRegKey] = {}
+        kLaneChannelsRegKey.setValue(_K, [](lua_State* L_) { lua_newtable(L_); });
         STACK_CHECK(_K, 0);
 
         // configure GC last
@@ -66,6 +66,8 @@ struct Keepers
 
     public:
     int gc_threshold{ 0 };
+    // string values at least that long are stored outside of the keeper states (<= 0 to disable)
+    int offload_threshold{ 4096 };
 
     public:
     // can only be instanced as a data member
@@ -93,6 +95,7 @@ using keeper_api_t = lua_CFunction;
 [[nodiscard]] int keepercall_send(lua_State* L_);
 [[nodiscard]] int keepercall_receive(lua_State* L_);
 [[nodiscard]] int keepercall_receive_batched(lua_State* L_);
+[[nodiscard]] int keepercall_receive_typed(lua_State* L_);
 [[nodiscard]] int keepercall_limit(lua_State* L_);
 [[nodiscard]] int keepercall_get(lua_State* L_);
 [[nodiscard]] int keepercall_set(lua_State* L_);
@@ -100,3 +103,12 @@ using keeper_api_t = lua_CFunction;
 
 using KeeperCallResult = Unique<std::optional<int>>;
 [[nodiscard]] KeeperCallResult keeper_call(KeeperState K_, keeper_api_t func_, lua_State* L_, Linda* linda_, int starting_index_);
+// fast paths for messages made of nil, boolean, number and short string values, unset if they don't apply
+[[nodiscard]] KeeperCallResult keeper_send_scalars(KeeperState K_, lua_State* L_, Linda* linda_, int starting_index_);
+[[nodiscard]] KeeperCallResult keeper_receive_scalar(KeeperState K_, lua_State* L_, Linda* linda_, int key_index_);
+[[nodiscard]] KeeperCallResult keeper_send_array(KeeperState K_, lua_State* L_, Linda* linda_, int key_index_);
+[[nodiscard]] KeeperCallResult keeper_receive_into(KeeperState K_, lua_State* L_, Linda* linda_, int key_index_);
+// the batches of values a lane sends to its handle with lanes.yield(), the keeper being locked by the caller
+[[nodiscard]] KeeperCallResult keeper_channel_send(KeeperState K_, lua_State* L_, Universe* U_, void* lane_, int n_);
+[[nodiscard]] KeeperCallResult keeper_channel_receive(KeeperState K_, lua_State* L_, Universe* U_, void* lane_);
+void keeper_channel_clear(KeeperState K_, void* lane_);
@@ -28,7 +28,11 @@ THE SOFTWARE.
 
 #include "debugspew.h"
 #include "intercopycontext.h"
+#include "state.h"
+#include "statepool.h"
+#include "statereaper.h"
 #include "threading.h"
+#include "threadpool.h"
 #include "tools.h"
 
 // #################################################################################################
@@ -91,6 +95,35 @@ static LUAG_FUNC(set_debug_threadname)
 
 // #################################################################################################
 
+#if HAVE_LANE_SCHEDULER()
+[[nodiscard]] static int ThreadJoinK(lua_State* L_, int status_, lua_KContext ctx_);
+[[nodiscard]] static int WaitLanesK(lua_State* L_, int status_, lua_KContext ctx_);
+[[nodiscard]] static int YieldK(lua_State* L_, int status_, lua_KContext ctx_);
+[[nodiscard]] static int LaneIteratorK(lua_State* L_, int status_, lua_KContext ctx_);
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
+// converts an optional [wait_secs=-1] argument into a deadline
+std::chrono::time_point<std::chrono::steady_clock> ReadDeadline(lua_State* const L_, int const idx_)
+{
+    std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
+    if (lua_type(L_, idx_) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
+        lua_Duration const duration{ lua_tonumber(L_, idx_) };
+        if (duration.count() >= 0.0) {
+            _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+        } else {
+            raise_luaL_argerror(L_, idx_, "duration cannot be < 0");
+        }
+
+    } else if (!lua_isnoneornil(L_, idx_)) { // alternate explicit "infinite timeout" by passing nil before the key
+        raise_luaL_argerror(L_, idx_, "incorrect duration type");
+    }
+    return _until;
+}
+
+// #################################################################################################
+
 //---
 // [...] | [nil, err_any, stack_tbl]= thread_join( lane_ud [, wait_secs=-1] )
 //
@@ -102,21 +135,28 @@ static LUAG_FUNC(set_debug_threadname)
 static LUAG_FUNC(thread_join)
 {
     Lane* const _lane{ ToLane(L_, 1) };
+    std::chrono::time_point<std::chrono::steady_clock> const _until{ ReadDeadline(L_, 2) };
 
-    std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
-    if (lua_type(L_, 2) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
-        lua_Duration const duration{ lua_tonumber(L_, 2) };
-        if (duration.count() >= 0.0) {
-            _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
-        } else {
-            raise_luaL_argerror(L_, 2, "duration cannot be < 0");
+#if HAVE_LANE_SCHEDULER()
+    // a scheduled lane parks until the joined lane is done, instead of blocking its worker thread
+    if (Lane* const _self{ Scheduler::ParkableLane(L_) }; _self != nullptr && _lane->isLaunched()) {
+        bool _parked{ false };
+        {
+            std::lock_guard _guard{ _lane->doneMutex };
+            if (_lane->status < Lane::Done && std::chrono::steady_clock::now() < _until) {
+                _self->status = Lane::Waiting;
+                _self->waiting_on = &_lane->doneCondVar;
+                Scheduler::Park(_self, _lane->doneCondVar, _until);
+                _parked = true;
+            }
+        }
+        if (_parked) {
+            return lua_yieldk(L_, 0, 0, ThreadJoinK);
         }
-
-    } else if (!lua_isnoneornil(L_, 2)) { // alternate explicit "infinite timeout" by passing nil before the key
-        raise_luaL_argerror(L_, 2, "incorrect duration type");
     }
+#endif // HAVE_LANE_SCHEDULER()
 
-    bool const _done{ !_lane->thread.joinable() || _lane->waitForCompletion(_until) };
+    bool const _done{ !_lane->isLaunched() || _lane->waitForCompletion(_until) };
     lua_settop(L_, 1);                                                                             // L_: lane
     lua_State* const _L2{ _lane->L };
     if (!_done || !_L2) {
@@ -138,7 +178,7 @@ static LUAG_FUNC(thread_join)
             int const _n{ lua_gettop(_L2) }; // whole L2 stack
             if (
                 (_n > 0) &&
-                (InterCopyContext{ _lane->U, DestState{ L_ }, SourceState{ _L2 }, {}, {}, {}, {}, {} }.inter_move(_n) != InterCopyResult::Success)
+                (InterCopyContext<LookupMode::LaneBody>{ _lane->U, DestState{ L_ }, SourceState{ _L2 }, {}, {}, {}, {} }.inter_move(_n) != InterCopyResult::Success)
             ) {                                                                                    // L_: lane results                                L2:
                 raise_luaL_error(L_, "tried to copy unsupported types");
             }
@@ -152,7 +192,7 @@ static LUAG_FUNC(thread_join)
             STACK_GROW(L_, 3);
             lua_pushnil(L_);                                                                       // L_: lane nil
             // even when _lane->errorTraceLevel != Minimal, if the error is not LUA_ERRRUN, the handler wasn't called, and we only have 1 error message on the stack ...
-            InterCopyContext _c{ _lane->U, DestState{ L_ }, SourceState{ _L2 }, {}, {}, {}, {}, {} };
+            InterCopyContext<LookupMode::LaneBody> _c{ _lane->U, DestState{ L_ }, SourceState{ _L2 }, {}, {}, {}, {} };
             if (_c.inter_move(_n) != InterCopyResult::Success) {                                   // L_: lane nil "err" [trace]                      L2:
                 raise_luaL_error(L_, "tried to copy unsupported types: %s", lua_tostring(L_, -_n));
             }
@@ -176,6 +216,324 @@ static LUAG_FUNC(thread_join)
 
 // #################################################################################################
 
+#if HAVE_LANE_SCHEDULER()
+// a scheduled lane that parked in a join is resumed: try again with what remains of the timeout
+[[nodiscard]] static int ThreadJoinK(lua_State* L_, [[maybe_unused]] int status_, [[maybe_unused]] lua_KContext ctx_)
+{
+    Scheduler::AdjustTimeout(L_, 2);
+    return LG_thread_join(L_);
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
+// {indices} [, "timeout"] = wait_any|wait_all(lanes_tbl [, wait_secs=-1])
+//
+// waits until at least one (or all) of the lanes have ended, and returns the indices of those that have
+// their results are left in place, until they are read through their handle
+[[nodiscard]] static int WaitLanes(lua_State* const L_, bool const all_)
+{
+    static constexpr int kLanes{ 1 };
+    static constexpr int kTimeout{ 2 };
+
+    luaL_checktype(L_, kLanes, LUA_TTABLE);
+    std::chrono::time_point<std::chrono::steady_clock> const _until{ ReadDeadline(L_, kTimeout) };
+    int const _count{ static_cast<int>(lua_rawlen(L_, kLanes)) };
+    std::vector<Lane*> _lanes;
+    _lanes.reserve(_count);
+    STACK_CHECK_START_REL(L_, 0);
+    for (int _i{ 1 }; _i <= _count; ++_i) {
+        lua_rawgeti(L_, kLanes, _i);                                                               // L_: lanes [wait_secs] lane
+        Lane** const _ud{ static_cast<Lane**>(lua_touserdata(L_, -1)) };
+        if (_ud == nullptr || !lua_getmetatable(L_, -1)) {
+            raise_luaL_error(L_, "lanes[%d] is not a lane", _i);
+        }
+        luaL_getmetatable(L_, kLaneMetatableName);                                                 // L_: lanes [wait_secs] lane mt mt
+        if (!lua_rawequal(L_, -1, -2)) {
+            raise_luaL_error(L_, "lanes[%d] is not a lane", _i);
+        }
+        lua_pop(L_, 3);                                                                            // L_: lanes [wait_secs]
+        _lanes.push_back(*_ud);
+    }
+    STACK_CHECK(L_, 0);
+
+    // the lanes are all still alive as long as their handles are in the table
+    auto const _nbDone = [&_lanes]() {
+        int _done{ 0 };
+        for (Lane* const _lane : _lanes) {
+            if (!_lane->isLaunched() || _lane->status >= Lane::Done) {
+                ++_done;
+            }
+        }
+        return _done;
+    };
+    auto const _satisfied = [&_nbDone, _count, all_]() {
+        int const _done{ _nbDone() };
+        return all_ ? (_done == _count) : (_done > 0 || _count == 0);
+    };
+
+    Universe* const _U{ Universe::Get(L_) };
+    bool _ready{ false };
+#if HAVE_LANE_SCHEDULER()
+    // a scheduled lane parks until another lane ends, instead of blocking its worker thread
+    if (Lane* const _self{ Scheduler::ParkableLane(L_) }) {
+        bool _parked{ false };
+        {
+            std::lock_guard _guard{ _U->completionMutex };
+            if (!_satisfied() && std::chrono::steady_clock::now() < _until) {
+                _self->status = Lane::Waiting;
+                _self->waiting_on = &_U->completionCondVar;
+                Scheduler::Park(_self, _U->completionCondVar, _until);
+                _parked = true;
+            }
+        }
+        if (_parked) {
+            return lua_yieldk(L_, 0, all_ ? 1 : 0, WaitLanesK);
+        }
+    }
+#endif // HAVE_LANE_SCHEDULER()
+    {
+        std::unique_lock _guard{ _U->completionMutex };
+        _ready = _U->completionCondVar.wait_until(_guard, _until, _satisfied);
+    }
+
+    lua_settop(L_, kLanes);
+    lua_createtable(L_, _nbDone(), 0);                                                             // L_: lanes {indices}
+    int _n{ 0 };
+    for (int _i{ 0 }; _i < _count; ++_i) {
+        if (!_lanes[_i]->isLaunched() || _lanes[_i]->status >= Lane::Done) {
+            lua_pushinteger(L_, _i + 1);                                                           // L_: lanes {indices} i
+            lua_rawseti(L_, -2, ++_n);                                                             // L_: lanes {indices}
+        }
+    }
+    if (_ready) {
+        return 1;
+    }
+    lua_pushliteral(L_, "timeout");                                                                // L_: lanes {indices} "timeout"
+    return 2;
+}
+
+// #################################################################################################
+
+#if HAVE_LANE_SCHEDULER()
+// a scheduled lane that parked in a wait is resumed: try again with what remains of the timeout
+[[nodiscard]] static int WaitLanesK(lua_State* L_, [[maybe_unused]] int status_, lua_KContext ctx_)
+{
+    Scheduler::AdjustTimeout(L_, 2);
+    return WaitLanes(L_, ctx_ != 0);
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
+LUAG_FUNC(wait_all)
+{
+    return WaitLanes(L_, true);
+}
+
+// #################################################################################################
+
+LUAG_FUNC(wait_any)
+{
+    return WaitLanes(L_, false);
+}
+
+// #################################################################################################
+
+// [lanes.cancel_error] = lanes.yield(...)
+//
+// sends the values to whoever iterates on the lane's handle, waiting for it to read some if the lane's channel is full
+LUAG_FUNC(yield)
+{
+    Lane* const _lane{ kLanePointerRegKey.readLightUserDataValue<Lane>(L_) };
+    if (_lane == nullptr) {
+        raise_luaL_error(L_, "lanes.yield() can only be called from inside a lane");
+    }
+    if (_lane->detached) {
+        raise_luaL_error(L_, "a detached lane has no handle to yield to");
+    }
+    // the generic for stops at the first nil the iterator returns: such a call would end the loop of the parent
+    if (lua_isnoneornil(L_, 1)) {
+        raise_luaL_argerror(L_, 1, "the first value can't be nil, it would end the iteration");
+    }
+    Universe* const _U{ _lane->U };
+    int const _n{ lua_gettop(L_) };
+    CancelRequest _cancel{ CancelRequest::None };
+    InterCopyResult _copied{ InterCopyResult::Success };
+    {
+        // wait until there is some room in the channel
+        std::unique_lock _guard{ _lane->doneMutex };
+        while (_lane->channelCount >= _U->yieldCapacity) {
+            _cancel = _lane->cancelRequest;
+            if (_cancel != CancelRequest::None) {
+                break;
+            }
+            _lane->status = Lane::Waiting;
+            _lane->waiting_on = &_lane->doneCondVar;
+#if HAVE_LANE_SCHEDULER()
+            // a scheduled lane gives its worker back until the iterator has read something
+            if (Scheduler::ParkableLane(L_) != nullptr) {
+                Scheduler::Park(_lane, _lane->doneCondVar, Scheduler::TimePoint::max());
+                _guard.unlock();
+                return lua_yieldk(L_, 0, 0, YieldK);
+            }
+#endif // HAVE_LANE_SCHEDULER()
+            _lane->doneCondVar.wait(_guard);
+            _lane->waiting_on = nullptr;
+            _lane->status = Lane::Running;
+        }
+    }
+    if (_cancel == CancelRequest::None) {
+        // only the iterator can take something out of the channel meanwhile, so there is still room when we get there
+        // values of any transferable type need a Lua state to live in between both ends: they wait in a keeper, like the contents of a linda
+        Keeper* const _K{ _lane->channelKeeper() };
+        if (_K == nullptr) {
+            raise_luaL_error(L_, "lanes.yield() can't be used while the keepers are shutting down");
+        }
+        _lane->yielded = true;
+        {
+            std::lock_guard _guard{ _K->mutex };
+            if (!keeper_channel_send(_K->L, L_, _U, _lane, _n).has_value()) {
+                _copied = InterCopyResult::Error;
+            }
+        }
+        if (_copied == InterCopyResult::Success) {
+            std::lock_guard _guard{ _lane->doneMutex };
+            ++_lane->channelCount;
+            Scheduler::NotifyAll(_U, _lane->doneCondVar);
+        }
+    }
+
+    switch (_cancel) {
+    case CancelRequest::Soft:
+        // if user wants to soft-cancel, the call returns lanes.cancel_error
+        kCancelError.pushKey(L_);
+        return 1;
+
+    case CancelRequest::Hard:
+        // raise an error interrupting execution only in case of hard cancel
+        raise_cancel_error(L_); // raises an error and doesn't return
+
+    default:
+        if (_copied != InterCopyResult::Success) {
+            raise_luaL_error(L_, "tried to copy unsupported types");
+        }
+        return 0;
+    }
+}
+
+// #################################################################################################
+
+#if HAVE_LANE_SCHEDULER()
+// a scheduled lane that parked in a lanes.yield() is resumed: try again
+[[nodiscard]] static int YieldK(lua_State* L_, [[maybe_unused]] int status_, [[maybe_unused]] lua_KContext ctx_)
+{
+    return LG_yield(L_);
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
+// ... = iterator()
+//
+// upvalue #1 is the lane handle
+// returns the values of the next lanes.yield() of the lane, or nothing once it has ended and they were all read
+// if the lane ended with an error, it is raised instead
+[[nodiscard]] static int LaneIterator(lua_State* L_)
+{
+    Lane* const _lane{ ToLane(L_, lua_upvalueindex(1)) };
+    lua_settop(L_, 0);
+
+#if HAVE_LANE_SCHEDULER()
+    // a scheduled lane parks until the iterated lane yields or ends, instead of blocking its worker thread
+    if (Lane* const _self{ Scheduler::ParkableLane(L_) }; _self != nullptr && _lane->isLaunched()) {
+        bool _parked{ false };
+        {
+            std::lock_guard _guard{ _lane->doneMutex };
+            if (_lane->channelCount == 0 && _lane->status < Lane::Done) {
+                _self->status = Lane::Waiting;
+                _self->waiting_on = &_lane->doneCondVar;
+                Scheduler::Park(_self, _lane->doneCondVar, Scheduler::TimePoint::max());
+                _parked = true;
+            }
+        }
+        if (_parked) {
+            return lua_yieldk(L_, 0, 0, LaneIteratorK);
+        }
+    }
+#endif // HAVE_LANE_SCHEDULER()
+
+    int _n{ -1 };
+    InterCopyResult _copied{ InterCopyResult::Success };
+    if (_lane->isLaunched()) {
+        bool _claimed{ false };
+        {
+            std::unique_lock _guard{ _lane->doneMutex };
+            _lane->doneCondVar.wait(_guard, [_lane]() { return _lane->channelCount > 0 || _lane->status >= Lane::Done; });
+            if (_lane->channelCount > 0) {
+                // claim the oldest batch, so that we can copy it without holding the lock
+                --_lane->channelCount;
+                _claimed = true;
+                // the lane might be waiting for some room in its channel
+                Scheduler::NotifyAll(_lane->U, _lane->doneCondVar);
+            }
+        }
+        if (_claimed) {
+            Keeper* const _K{ _lane->channelKeeper() };
+            if (_K == nullptr) {
+                raise_luaL_error(L_, "can't iterate on a lane while the keepers are shutting down");
+            }
+            std::lock_guard _guard{ _K->mutex };
+            KeeperCallResult const _received{ keeper_channel_receive(_K->L, L_, _lane->U, _lane) };
+            if (_received.has_value()) {
+                _n = _received.value();
+            } else {
+                _copied = InterCopyResult::Error;
+            }
+        }
+    }
+
+    if (_copied != InterCopyResult::Success) {
+        raise_luaL_error(L_, "tried to copy unsupported types");
+    }
+    if (_n >= 0) {
+        return _n;
+    }
+    // the lane has ended and everything it yielded was read: reading its first result raises its error, if any
+    if (_lane->status == Lane::Error) {
+        lua_pushvalue(L_, lua_upvalueindex(1));                                                    // L_: lane
+        lua_pushinteger(L_, 1);                                                                    // L_: lane 1
+        lua_gettable(L_, -2); // lane[1] -> doesn't return                                         // L_: lane nil
+    }
+    return 0;
+}
+
+// #################################################################################################
+
+#if HAVE_LANE_SCHEDULER()
+// a scheduled lane that parked in an iteration is resumed: try again
+[[nodiscard]] static int LaneIteratorK(lua_State* L_, [[maybe_unused]] int status_, [[maybe_unused]] lua_KContext ctx_)
+{
+    return LaneIterator(L_);
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
+//---
+// iterator = lane:iter()
+//
+// for ... in lane:iter() do ... end loops on the values sent by the lane with lanes.yield()
+static LUAG_FUNC(thread_iter)
+{
+    std::ignore = ToLane(L_, 1);
+    lua_settop(L_, 1);                                                                             // L_: lane
+    lua_pushcclosure(L_, LaneIterator, 1);                                                         // L_: iterator
+    return 1;
+}
+
+// #################################################################################################
+
 // key is numeric, wait until the thread returns and populate the environment with the return values
 // If the return values signal an error, propagate it
 // Else If key is found in the environment, return it
@@ -596,11 +954,44 @@ static void push_stack_trace(lua_State* L_, Lane::ErrorTraceLevel errorTraceLeve
  */
 static void selfdestruct_add(Lane* lane_)
 {
-    std::lock_guard<std::mutex> _guard{ lane_->U->selfdestructMutex };
+    Universe* const _U{ lane_->U };
+    std::lock_guard<std::mutex> _guard{ _U->selfdestructMutex };
     assert(lane_->selfdestruct_next == nullptr);
 
-    lane_->selfdestruct_next = lane_->U->selfdestructFirst;
-    lane_->U->selfdestructFirst = lane_;
+    lane_->selfdestruct_prev = nullptr;
+    lane_->selfdestruct_next = _U->selfdestructFirst;
+    if (lane_->selfdestruct_next != SELFDESTRUCT_END) {
+        lane_->selfdestruct_next->selfdestruct_prev = lane_;
+    }
+    _U->selfdestructFirst = lane_;
+}
+
+// #################################################################################################
+
+// A lane has left the selfdestruct or detached chain (under selfdestructMutex)
+static void selfdestruct_unlisted(Lane* lane_)
+{
+    Universe* const _U{ lane_->U };
+    // the terminal shutdown should wait until the lane is done with its lua_close()
+    _U->selfdestructingCount.fetch_add(1, std::memory_order_release);
+    // the lanes of the chains have no handle, so their cancel request can't change once the terminal shutdown has counted them
+    if (_U->terminating && lane_->cancelRequest != CancelRequest::None) {
+        if (--_U->terminatingPendingCount == 0) {
+            _U->selfdestructCondVar.notify_all();
+        }
+    }
+}
+
+// #################################################################################################
+
+// A lane that left its chain is done cleaning after itself
+static void selfdestruct_done(Universe* U_)
+{
+    std::lock_guard<std::mutex> _guard{ U_->selfdestructMutex };
+    // terminal shutdown sequence may proceed
+    if (U_->selfdestructingCount.fetch_sub(1, std::memory_order_release) == 1) {
+        U_->selfdestructCondVar.notify_all();
+    }
 }
 
 // #################################################################################################
@@ -608,29 +999,55 @@ static void selfdestruct_add(Lane* lane_)
 // A free-running lane has ended; remove it from selfdestruct chain
 [[nodiscard]] static bool selfdestruct_remove(Lane* lane_)
 {
-    bool _found{ false };
-    std::lock_guard<std::mutex> _guard{ lane_->U->selfdestructMutex };
+    Universe* const _U{ lane_->U };
+    std::lock_guard<std::mutex> _guard{ _U->selfdestructMutex };
     // Make sure (within the MUTEX) that we actually are in the chain
     // still (at process exit they will remove us from chain and then
     // cancel/kill).
     //
-    if (lane_->selfdestruct_next != nullptr) {
-        Lane* volatile* _ref = static_cast<Lane* volatile*>(&lane_->U->selfdestructFirst);
-
-        while (*_ref != SELFDESTRUCT_END) {
-            if (*_ref == lane_) {
-                *_ref = lane_->selfdestruct_next;
-                lane_->selfdestruct_next = nullptr;
-                // the terminal shutdown should wait until the lane is done with its lua_close()
-                lane_->U->selfdestructingCount.fetch_add(1, std::memory_order_release);
-                _found = true;
-                break;
-            }
-            _ref = static_cast<Lane* volatile*>(&((*_ref)->selfdestruct_next));
+    if (lane_->selfdestruct_next == nullptr) {
+        return false;
+    }
+    if (lane_->selfdestruct_prev != nullptr) {
+        lane_->selfdestruct_prev->selfdestruct_next = lane_->selfdestruct_next;
+    } else {
+        assert(_U->selfdestructFirst == lane_);
+        _U->selfdestructFirst = lane_->selfdestruct_next;
+    }
+    if (lane_->selfdestruct_next != SELFDESTRUCT_END) {
+        lane_->selfdestruct_next->selfdestruct_prev = lane_->selfdestruct_prev;
+    }
+    lane_->selfdestruct_next = nullptr;
+    lane_->selfdestruct_prev = nullptr;
+    selfdestruct_unlisted(lane_);
+    return true;
+}
+
+// #################################################################################################
+
+// A detached lane has ended: nobody will read its results, so they go away with its state right now
+static void detached_end(Lane* lane_)
+{
+    Universe* const _U{ lane_->U };
+    {
+        std::lock_guard<std::mutex> _guard{ _U->selfdestructMutex };
+        if (lane_->detached_prev != nullptr) {
+            lane_->detached_prev->detached_next = lane_->detached_next;
+        } else {
+            _U->detachedFirst = lane_->detached_next;
+        }
+        if (lane_->detached_next != nullptr) {
+            lane_->detached_next->detached_prev = lane_->detached_prev;
         }
-        assert(_found);
+        selfdestruct_unlisted(lane_);
     }
-    return _found;
+    lane_->close();
+    // (a scheduled or pooled lane has no thread of its own)
+    if (lane_->thread.joinable()) {
+        lane_->thread.detach();
+    }
+    delete lane_;
+    selfdestruct_done(_U);
 }
 
 // #################################################################################################
@@ -659,6 +1076,178 @@ static void PrepareLaneHelpers(Lane* lane_)
 
 // #################################################################################################
 
+// what Lane::stagePreparation() stores in the staging state of a lane launched with the 'async' option
+static constexpr int kStagedLibsIdx{ 1 };
+static constexpr int kStagedPackIdx{ 2 };
+static constexpr int kStagedRequIdx{ 3 };
+static constexpr int kStagedGlobIdx{ 4 };
+static constexpr int kStagedBaseIdx{ 5 };
+static constexpr int kStagedFuncIdx{ 6 }; // followed by the lane body arguments
+
+// does on the lane's own thread what lane_new() does for the other lanes, then returns the lane body and its arguments
+// L_: the lane's state
+[[nodiscard]] static int LaneStagedPreparation(lua_State* L_)
+{
+    Lane* const _lane{ kLanePointerRegKey.readLightUserDataValue<Lane>(L_) };
+    Universe* const _U{ _lane->U };
+    lua_State* const _S{ _lane->staging };                                                         // L_:                                            S: libs package required globals baseline func args...
+    int const _nargs{ lua_gettop(_S) - kStagedFuncIdx };
+    STACK_CHECK_START_REL(L_, 0);
+
+    // libraries, on_state_create(), and the lookup database
+    std::optional<std::string_view> const _libs{ lua_isnil(_S, kStagedLibsIdx) ? std::nullopt : std::make_optional(lua_tostringview(_S, kStagedLibsIdx)) };
+    state::InitializeLaneState(_U, L_, L_, _libs);
+
+    // package
+    if (!lua_isnil(_S, kStagedPackIdx)) {
+        InterCopyContext<LookupMode::FromKeeper> _c{ _U, DestState{ L_ }, SourceState{ _S }, {}, SourceIndex{ kStagedPackIdx }, {}, {} };
+        if (_c.inter_copy_package() != InterCopyResult::Success) {
+            raise_luaL_error(L_, "failed to copy package");
+        }
+    }
+
+    // modules to require *before* the globals and the function are transferred
+    if (!lua_isnil(_S, kStagedRequIdx)) {
+        int const _nbRequired{ static_cast<int>(lua_rawlen(_S, kStagedRequIdx)) };
+        for (int _i{ 1 }; _i <= _nbRequired; ++_i) {
+            lua_rawgeti(_S, kStagedRequIdx, _i);                                                   // L_:                                            S: ... "modname"
+            state::RequireModule(_U, L_, L_, lua_tostringview(_S, -1));
+            lua_pop(_S, 1);                                                                        // L_:                                            S: ...
+        }
+    }
+    STACK_CHECK(L_, 0);
+
+    // globals
+    if (!lua_isnil(_S, kStagedGlobIdx)) {
+        InterCopyContext<LookupMode::FromKeeper> _c{ _U, DestState{ L_ }, SourceState{ _S }, {}, {}, {}, {} };
+        lua_pushglobaltable(L_);                                                                   // L_: _G                                         S: ...
+        lua_pushnil(_S);                                                                           // L_: _G                                         S: ... nil
+        while (lua_next(_S, kStagedGlobIdx)) {                                                     // L_: _G                                         S: ... k v
+            std::ignore = _c.inter_copy(2);                                                        // L_: _G k v                                     S: ... k v
+            lua_rawset(L_, -3);                                                                    // L_: _G                                         S: ... k v
+            lua_pop(_S, 1);                                                                        // L_: _G                                         S: ... k
+        }
+        lua_pop(L_, 1);                                                                            // L_:                                            S: ...
+    }
+    STACK_CHECK(L_, 0);
+
+    // the state is ready to run a lane body: that's the point where it goes back when recycled
+    if (lua_toboolean(_S, kStagedBaseIdx)) {
+        StatePoolStorage::SaveBaseline(L_);
+    }
+
+    // lane body
+    if (lua_type(_S, kStagedFuncIdx) == LUA_TSTRING) {
+        if (luaL_loadstring(L_, lua_tostring(_S, kStagedFuncIdx)) != 0) {                          // L_: func|err                                   S: ...
+            raise_luaL_error(L_, "error when parsing lane function code");
+        }
+        lua_remove(_S, kStagedFuncIdx);                                                            // L_: func                                       S: ... args...
+    } else {
+        lua_pushvalue(_S, kStagedFuncIdx);                                                         // L_:                                            S: ... func args... func
+        lua_remove(_S, kStagedFuncIdx);                                                            // L_:                                            S: ... args... func
+        InterCopyContext<LookupMode::FromKeeper> _c{ _U, DestState{ L_ }, SourceState{ _S }, {}, {}, {}, {} };
+        if (_c.inter_move(1) != InterCopyResult::Success) {                                        // L_: func                                       S: ... args...
+            raise_luaL_error(L_, "tried to copy unsupported types");
+        }
+    }
+    // and its arguments
+    if (_nargs > 0) {
+        STACK_GROW(L_, _nargs);
+        InterCopyContext<LookupMode::FromKeeper> _c{ _U, DestState{ L_ }, SourceState{ _S }, {}, {}, {}, {} };
+        if (_c.inter_move(_nargs) != InterCopyResult::Success) {                                   // L_: func args...                               S: ...
+            raise_luaL_error(L_, "tried to copy unsupported types");
+        }
+    }
+    STACK_CHECK(L_, 1 + _nargs);
+    return 1 + _nargs;
+}
+
+// #################################################################################################
+
+// finishes the preparation of a lane launched with the 'async' option, the staging state is closed afterwards
+// L: eh? -> eh? func args...|eh? err
+[[nodiscard]] static LuaError PrepareStagedLane(Lane* lane_)
+{
+    if (lane_->staging == nullptr) {
+        return LuaError::OK;
+    }
+    lua_State* const _L{ lane_->L };
+    int const _errorHandlerCount{ lane_->errorTraceLevel == Lane::Minimal ? 0 : 1 };
+    lua_pushcfunction(_L, LaneStagedPreparation);                                                  // L: eh? LaneStagedPreparation
+    LuaError const _rc{ ToLuaError(lua_pcall(_L, 0, LUA_MULTRET, _errorHandlerCount)) };           // L: eh? func args...|err
+    lua_close(std::exchange(lane_->staging, nullptr));
+    return _rc;
+}
+
+// #################################################################################################
+
+// the lane body has returned: run the finalizers, and clean up after a free-running lane
+// returns nullptr if the lane deleted itself
+[[nodiscard]] static Lane* LaneBodyEnded(Lane* lane_, LuaError& rc_)
+{
+    lua_State* const _L{ lane_->L };
+    Universe* const _U{ lane_->U };
+    // in case of error and if it exists, fetch stack trace from registry and push it
+    push_stack_trace(_L, lane_->errorTraceLevel, rc_, 1);                                          // L: retvals|error [trace]
+
+    DEBUGSPEW_CODE(DebugSpew(_U) << "Lane " << _L << " body: " << GetErrcodeName(rc_) << " (" << (kCancelError.equals(_L, 1) ? "cancelled" : lua_typename(_L, lua_type(_L, 1))) << ")" << std::endl);
+    //  Call finalizers, if the script has set them up.
+    //
+    LuaError const _rc2{ run_finalizers(_L, lane_->errorTraceLevel, rc_) };
+    DEBUGSPEW_CODE(DebugSpew(_U) << "Lane " << _L << " finalizer: " << GetErrcodeName(_rc2) << std::endl);
+    if (_rc2 != LuaError::OK) { // Error within a finalizer!
+        // the finalizer generated an error, and left its own error message [and stack trace] on the stack
+        rc_ = _rc2; // we're overruling the earlier script error or normal return
+    }
+    lane_->waiting_on = nullptr;  // just in case
+    if (selfdestruct_remove(lane_)) { // check and remove (under lock!)
+        // We're a free-running thread and no-one's there to clean us up.
+        lane_->close();
+
+        // we destroy our jthread member from inside the thread body, so we have to detach so that we don't try to join, as this doesn't seem a good idea
+        // (a scheduled or pooled lane has no thread of its own)
+        if (lane_->thread.joinable()) {
+            lane_->thread.detach();
+        }
+        // the Lane is freed with the universe's allocator, so the terminal shutdown has to wait for that too
+        delete lane_;
+        selfdestruct_done(_U);
+        return nullptr;
+    }
+    return lane_;
+}
+
+// #################################################################################################
+
+static void LaneDone(Lane* lane_, LuaError rc_)
+{
+    lua_State* const _L{ lane_->L };
+    // leave results (1..top) or error message + stack trace (1..2) on the stack - master will copy them
+
+    Lane::Status const _st{ (rc_ == LuaError::OK) ? Lane::Done : kCancelError.equals(_L, 1) ? Lane::Cancelled : Lane::Error };
+
+    // no handle, no-one to signal
+    if (lane_->detached) {
+        lane_->status = _st;
+        detached_end(lane_);
+        return;
+    }
+
+    {
+        // 'doneMutex' protects the -> Done|Error|Cancelled state change
+        std::lock_guard _guard{ lane_->doneMutex };
+        lane_->completionOrder = lane_->U->completionCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        lane_->status = _st;
+        // wake up master (while 'lane_->doneMutex' is on), and the scheduled lanes parked in a join
+        Scheduler::NotifyAll(lane_->U, lane_->doneCondVar);
+        // as well as those waiting for any or all of several lanes: locking the mutex makes sure they can't miss the status change
+        { std::lock_guard _completionGuard{ lane_->U->completionMutex }; }
+        Scheduler::NotifyAll(lane_->U, lane_->U->completionCondVar);
+    }
+}
+
+// #################################################################################################
+
 static void lane_main(Lane* lane_)
 {
     lua_State* const _L{ lane_->L };
@@ -666,63 +1255,57 @@ static void lane_main(Lane* lane_)
     lane_->ready.wait();
     LuaError _rc{ LuaError::ERRRUN };
     if (lane_->status == Lane::Pending) { // nothing wrong happened during preparation, we can work
-        // At this point, the lane function and arguments are on the stack, possibly preceded by the error handler
         int const _errorHandlerCount{ lane_->errorTraceLevel == Lane::Minimal ? 0 : 1};
-        int const _nargs{ lua_gettop(_L) - 1 - _errorHandlerCount };
-        DEBUGSPEW_CODE(Universe* _U = Universe::Get(_L));
         lane_->status = Lane::Running; // Pending -> Running
 
-        PrepareLaneHelpers(lane_);
+        // a preparation error is reported like an error raised by the lane body
+        _rc = PrepareStagedLane(lane_);
+        if (_rc == LuaError::OK) {
+            // At this point, the lane function and arguments are on the stack, possibly preceded by the error handler
+            int const _nargs{ lua_gettop(_L) - 1 - _errorHandlerCount };
 
-        _rc = ToLuaError(lua_pcall(_L, _nargs, LUA_MULTRET, _errorHandlerCount));                  // L: eh? retvals|err
+            PrepareLaneHelpers(lane_);
 
-        if (_errorHandlerCount) {
-            lua_remove(_L, 1);                                                                     // L: retvals|error
+            _rc = ToLuaError(lua_pcall(_L, _nargs, LUA_MULTRET, _errorHandlerCount));              // L: eh? retvals|err
         }
 
-        // in case of error and if it exists, fetch stack trace from registry and push it
-        push_stack_trace(_L, lane_->errorTraceLevel, _rc, 1);                                      // L: retvals|error [trace]
-
-        DEBUGSPEW_CODE(DebugSpew(_U) << "Lane " << _L << " body: " << GetErrcodeName(_rc) << " (" << (kCancelError.equals(_L, 1) ? "cancelled" : lua_typename(_L, lua_type(_L, 1))) << ")" << std::endl);
-        //  Call finalizers, if the script has set them up.
-        //
-        LuaError const _rc2{ run_finalizers(_L, lane_->errorTraceLevel, _rc) };
-        DEBUGSPEW_CODE(DebugSpew(_U) << "Lane " << _L << " finalizer: " << GetErrcodeName(_rc2) << std::endl);
-        if (_rc2 != LuaError::OK) { // Error within a finalizer!
-            // the finalizer generated an error, and left its own error message [and stack trace] on the stack
-            _rc = _rc2; // we're overruling the earlier script error or normal return
-        }
-        lane_->waiting_on = nullptr;  // just in case
-        if (selfdestruct_remove(lane_)) { // check and remove (under lock!)
-            // We're a free-running thread and no-one's there to clean us up.
-            lane_->close();
-            lane_->U->selfdestructMutex.lock();
-            // done with lua_close(), terminal shutdown sequence may proceed
-            lane_->U->selfdestructingCount.fetch_sub(1, std::memory_order_release);
-            lane_->U->selfdestructMutex.unlock();
-
-            // we destroy our jthread member from inside the thread body, so we have to detach so that we don't try to join, as this doesn't seem a good idea
-            lane_->thread.detach();
-            delete lane_;
-            lane_ = nullptr;
+        if (_errorHandlerCount) {
+            lua_remove(_L, 1);                                                                     // L: retvals|error
         }
+        lane_ = LaneBodyEnded(lane_, _rc);
     }
     if (lane_) {
-        // leave results (1..top) or error message + stack trace (1..2) on the stack - master will copy them
+        LaneDone(lane_, _rc);
+    }
+}
 
-        Lane::Status const _st{ (_rc == LuaError::OK) ? Lane::Done : kCancelError.equals(_L, 1) ? Lane::Cancelled : Lane::Error };
+// #################################################################################################
 
-        {
-            // 'doneMutex' protects the -> Done|Error|Cancelled state change
-            std::lock_guard _guard{ lane_->doneMutex };
-            lane_->status = _st;
-            lane_->doneCondVar.notify_one(); // wake up master (while 'lane_->doneMutex' is on)
-        }
-    }
+#if HAVE_LANE_SCHEDULER()
+
+// a scheduled lane body is called from inside a coroutine, so that the blocking operations can yield
+// L_: eh? func args...
+[[nodiscard]] static int LaneBodyK(lua_State* L_, int status_, [[maybe_unused]] lua_KContext ctx_)
+{
+    // after a yield, we get LUA_YIELD if the body returned normally
+    lua_pushinteger(L_, (status_ == LUA_YIELD) ? LUA_OK : status_);                                // L_: eh? retvals|err status
+    return lua_gettop(L_);
 }
 
 // #################################################################################################
 
+// upvalue[1]: the number of error handlers before the lane body
+[[nodiscard]] static int LaneBody(lua_State* L_)
+{
+    int const _errorHandlerCount{ static_cast<int>(lua_tointeger(L_, lua_upvalueindex(1))) };
+    int const _nargs{ lua_gettop(L_) - 1 - _errorHandlerCount };
+    return LaneBodyK(L_, lua_pcallk(L_, _nargs, LUA_MULTRET, _errorHandlerCount, 0, LaneBodyK), 0);
+}
+
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
 // = thread_gc( lane_ud )
 //
 // Cleanup for a thread userdata. If the thread is still executing, leave it
@@ -783,13 +1366,17 @@ static void lane_main(Lane* lane_)
 // #################################### Lane implementation ########################################
 // #################################################################################################
 
-Lane::Lane(Universe* U_, lua_State* L_, ErrorTraceLevel errorTraceLevel_)
+Lane::Lane(Universe* U_, lua_State* L_, ErrorTraceLevel errorTraceLevel_, StatePoolStorage* statePool_)
 : U{ U_ }
 , L{ L_ }
 , errorTraceLevel{ errorTraceLevel_ }
+, statePool{ statePool_ }
 {
     assert(errorTraceLevel == ErrorTraceLevel::Minimal || errorTraceLevel == ErrorTraceLevel::Basic || errorTraceLevel == ErrorTraceLevel::Extended);
     kExtendedStackTraceRegKey.setValue(L_, [yes = errorTraceLevel == ErrorTraceLevel::Extended ? 1 : 0](lua_State* L_) { lua_pushboolean(L_, yes); });
+    if (statePool) {
+        statePool->acquire();
+    }
     U->tracker.tracking_add(this);
 }
 
@@ -797,7 +1384,26 @@ Lane::Lane(Universe* U_, lua_State* L_, ErrorTraceLevel errorTraceLevel_)
 
 Lane::~Lane()
 {
+    // in case the lane never got to run
+    if (staging) {
+        lua_close(staging);
+    }
+    // whatever the lane yielded and nobody read
+    if (yielded) {
+        if (Keeper* const _K{ channelKeeper() }; _K != nullptr) {
+            std::lock_guard _guard{ _K->mutex };
+            keeper_channel_clear(_K->L, this);
+        }
+    }
+    // in case the state was never closed
+    if (statePool) {
+        std::exchange(statePool, nullptr)->release(U);
+    }
     std::ignore = U->tracker.tracking_remove(this);
+    // without a thread to join, make sure whoever ran the lane is done signalling its completion
+    if (!thread.joinable()) {
+        std::lock_guard _guard{ doneMutex };
+    }
 }
 
 // #################################################################################################
@@ -816,13 +1422,59 @@ void Lane::changeDebugName(int const nameIdx_)
         lua_pushvalue(L, _nameIdx);                                                                // L: ... "name" ... "name"
         lua_setglobal(L, "decoda_name");                                                           // L: ... "name" ...
     }
-    // and finally set the OS thread name
-    THREAD_SETNAME(debugName.data());
+    // and finally set the OS thread name (not for a scheduled lane, whose worker runs other lanes too)
+    if (!scheduled) {
+        THREAD_SETNAME(debugName.data());
+    }
     STACK_CHECK(L, 0);
 }
 
 // #################################################################################################
 
+// the keeper that stores what the lane sends with lanes.yield(), nullptr once the keepers are gone
+// lanes are spread over the keepers according to their address, the same way lindas are according to their group
+[[nodiscard]] Keeper* Lane::channelKeeper() const
+{
+    int const _nbKeepers{ U->keepers.getNbKeepers() };
+    if (_nbKeepers == 0) {
+        return nullptr;
+    }
+    return U->keepers.getKeeper(static_cast<int>((reinterpret_cast<uintptr_t>(this) / alignof(std::max_align_t)) % _nbKeepers));
+}
+
+// #################################################################################################
+
+void Lane::close()
+{
+    lua_State* const _L{ std::exchange(L, nullptr) };
+    coroutine = nullptr;
+    if (statePool == nullptr) {
+        if (U->stateReaper != nullptr) {
+            // the reaper can close the state after the lane is gone: finalizers that run then must not see it anymore
+            lua_sethook(_L, nullptr, 0, 0);
+            kLanePointerRegKey.setValue(_L, [](lua_State* L_) { lua_pushnil(L_); });
+        }
+        StateReaper::Close(U, _L);
+        return;
+    }
+    // only a state that ran the lane body to its end is in a known condition
+    bool const _reusable{ status == Lane::Done || status == Lane::Error };
+    if (_reusable) {
+        // forget everything about this lane before another one gets the state
+        auto _pushNil = [](lua_State* L_) { lua_pushnil(L_); };
+        lua_sethook(_L, nullptr, 0, 0);
+        kFinalizerRegKey.setValue(_L, _pushNil);
+        kStackTraceRegKey.setValue(_L, _pushNil);
+        kLanePointerRegKey.setValue(_L, _pushNil);
+        kLaneNameRegKey.setValue(_L, _pushNil);
+        kLaneCoroutineRegKey.setValue(_L, _pushNil);
+    }
+    statePool->giveState(_L, _reusable);
+    std::exchange(statePool, nullptr)->release(U);
+}
+
+// #################################################################################################
+
 //---
 // str= thread_status( lane )
 //
@@ -853,13 +1505,14 @@ namespace {
             { "__index", LG_thread_index },
             { "cancel", LG_thread_cancel },
             { "get_debug_threadname", LG_get_debug_threadname },
+            { "iter", LG_thread_iter },
             { "join", LG_thread_join },
             { nullptr, nullptr }
         };
     } // namespace local
 } // namespace
 
-  // contains keys: { __gc, __index, cached_error, cached_tostring, cancel, join, get_debug_threadname }
+  // contains keys: { __gc, __index, cached_error, cached_tostring, cancel, join, get_debug_threadname, iter }
 void Lane::PushMetatable(lua_State* L_)
 {
     STACK_CHECK_START_REL(L_, 0);
@@ -912,6 +1565,85 @@ void Lane::PushMetatable(lua_State* L_)
 
 // #################################################################################################
 
+// runs a scheduled lane on the calling worker thread, until it parks or ends
+// returns true when the lane has ended (in which case it may already be gone)
+bool Lane::resume()
+{
+#if HAVE_LANE_SCHEDULER()
+    lua_State* const _L{ L };
+    int _nargs{ 0 };
+    if (coroutine == nullptr) { // first run
+        if (status != Lane::Pending) { // something went wrong during preparation
+            LaneDone(this, LuaError::ERRRUN);
+            return true;
+        }
+        int const _errorHandlerCount{ errorTraceLevel == Lane::Minimal ? 0 : 1 };
+        status = Lane::Running; // Pending -> Running
+
+        // a preparation error is reported like an error raised by the lane body
+        if (LuaError _rc{ PrepareStagedLane(this) }; _rc != LuaError::OK) {
+            if (_errorHandlerCount) {
+                lua_remove(_L, 1);                                                                 // L: err
+            }
+            if (Lane* const _lane{ LaneBodyEnded(this, _rc) }) {
+                LaneDone(_lane, _rc);
+            }
+            return true;
+        }
+
+        // At this point, the lane function and arguments are on the stack, possibly preceded by the error handler
+        PrepareLaneHelpers(this);
+
+        // move the whole stack in a coroutine, anchored in the registry for the lifetime of the lane
+        STACK_GROW(_L, 2);
+        lua_State* const _co{ lua_newthread(_L) };                                                 // L: eh? func args... co
+        kLaneCoroutineRegKey.setValue(_L, [](lua_State* L_) { lua_pushvalue(L_, -2); });
+        lua_pop(_L, 1);                                                                            // L: eh? func args...
+        _nargs = lua_gettop(_L);
+        STACK_GROW(_co, _nargs + 1);
+        lua_pushinteger(_co, _errorHandlerCount);                                                  // L: eh? func args...                            co: n
+        lua_pushcclosure(_co, LaneBody, 1);                                                        // L: eh? func args...                            co: LaneBody
+        lua_xmove(_L, _co, _nargs);                                                                // L:                                             co: LaneBody eh? func args...
+        coroutine = _co;
+    } else if (status == Lane::Waiting) { // back from a parked operation
+        waiting_on = nullptr;
+        status = Lane::Running;
+    }
+
+    lua_State* const _co{ coroutine };
+    int _nres{ 0 };
+    int const _rc{ luaG_resume(_co, _L, _nargs, &_nres) };
+    if (_rc == LUA_YIELD) {
+        // parked by a blocking operation, or a plain coroutine.yield(): whatever was yielded is dropped
+        lua_pop(_co, _nres);
+        return false;
+    }
+
+    LuaError _bodyRc{ LuaError::OK };
+    if (_rc == LUA_OK) {
+        lua_xmove(_co, _L, _nres);                                                                 // L: eh? retvals|err status                      co:
+        _bodyRc = ToLuaError(static_cast<int>(lua_tointeger(_L, -1)));
+        lua_pop(_L, 1);                                                                            // L: eh? retvals|err
+        if (errorTraceLevel != Lane::Minimal) {
+            lua_remove(_L, 1);                                                                     // L: retvals|err
+        }
+    } else { // LaneBody itself failed, most likely out of memory
+        lua_xmove(_co, _L, 1);                                                                     // L: err                                         co:
+        _bodyRc = ToLuaError(_rc);
+    }
+    if (Lane* const _lane{ LaneBodyEnded(this, _bodyRc) }) {
+        LaneDone(_lane, _bodyRc);
+    }
+    return true;
+#else // HAVE_LANE_SCHEDULER()
+    // lane_new() refuses to create scheduled lanes
+    assert(false);
+    return true;
+#endif // HAVE_LANE_SCHEDULER()
+}
+
+// #################################################################################################
+
 // intern the debug name in the caller lua state so that the pointer remains valid after the lane's state is closed
 void Lane::securizeDebugName(lua_State* L_)
 {
@@ -930,8 +1662,162 @@ void Lane::securizeDebugName(lua_State* L_)
 
 // #################################################################################################
 
+// the lane's preparation failed, or was abandoned: the lane ends with "cancelled" status without running its body
+void Lane::cancelLaunch()
+{
+    // leave a single cancel_error on the stack for the caller
+    lua_settop(L, 0);
+    kCancelError.pushKey(L);
+    {
+        std::lock_guard _guard{ doneMutex };
+        // this will cause lane_main to skip actual running (because we are not Pending anymore)
+        status = Lane::Running;
+    }
+    release();
+}
+
+// #################################################################################################
+
+// a detached lane is listed apart from the selfdestruct chain, so that the shutdown can cancel it if it still runs
+void Lane::detach()
+{
+    std::lock_guard<std::mutex> _guard{ U->selfdestructMutex };
+    detached_next = U->detachedFirst;
+    if (detached_next != nullptr) {
+        detached_next->detached_prev = this;
+    }
+    U->detachedFirst = this;
+}
+
+// #################################################################################################
+
+// the lane is ready: let its thread, or the scheduler, run it
+void Lane::release()
+{
+    // a detached lane can be gone as soon as its thread starts working
+    bool const _scheduled{ scheduled };
+    Universe* const _U{ U };
+    ready.count_down();
+    // a scheduled lane has no thread waiting for it, the scheduler runs it from now on
+    if (_scheduled) {
+        Scheduler::Get(_U)->schedule(this);
+    }
+}
+
+// #################################################################################################
+
+// for a lane launched with the 'async' option, lane_new() only takes a snapshot of what the lane needs to finish preparing its state
+// the snapshot is stored in a staging state the same way lindas store data in a keeper, so it doesn't depend on the libraries L doesn't have yet
+// the arguments are left on L_'s stack, and the __lanesmove calls are deferred in moves_: lane_new() finishes them once the lane is ready
+// L_: [fixed] args...
+void Lane::stagePreparation(lua_State* const L_, std::optional<std::string_view> const& libs_, int const packageIdx_, int const requiredIdx_, int const globalsIdx_, int const funcIdx_, int const nargs_, bool const saveBaseline_, DeferredMoves* const moves_)
+{
+    STACK_CHECK_START_REL(L_, 0);
+    lua_State* const _S{ state::CreateState(U, L_) };
+    // from now on, closed with the lane if something goes wrong
+    staging = _S;
+    Universe::Store(_S, U);
+    STACK_GROW(_S, kStagedFuncIdx + nargs_);
+    STACK_CHECK_START_ABS(_S, 0);
+    InterCopyContext<LookupMode::ToKeeper> _c{ U, DestState{ _S }, SourceState{ L_ }, {}, {}, {}, {}, moves_ };
+
+    // libraries
+    if (libs_.has_value()) {
+        std::ignore = lua_pushstringview(_S, libs_.value());                                       // L_: [fixed] args...                            S: libs
+    } else {
+        lua_pushnil(_S);                                                                           // L_: [fixed] args...                            S: nil
+    }
+
+    // package: only what InterCopyContext::inter_copy_package() transfers
+    if (packageIdx_ != 0) {
+        if (!lua_istable(L_, packageIdx_)) {
+            raise_luaL_error(L_, "expected package as table, got %s", luaL_typename(L_, packageIdx_));
+        }
+        lua_createtable(_S, 0, 3);                                                                 // L_: [fixed] args...                            S: libs {}
+        for (std::string_view const _entry : { "path", "cpath", "preload" }) {
+            if (luaG_getfield(L_, packageIdx_, _entry) == LuaType::NIL) {                          // L_: [fixed] args... v                          S: libs {}
+                lua_pop(L_, 1);                                                                    // L_: [fixed] args...                            S: libs {}
+                continue;
+            }
+            if (_c.inter_move(1) != InterCopyResult::Success) {                                    // L_: [fixed] args...                            S: libs {} v
+                raise_luaL_error(L_, "failed to copy package entry %s", _entry.data());
+            }
+            lua_setfield(_S, -2, _entry.data());                                                   // L_: [fixed] args...                            S: libs {}
+        }
+    } else {
+        lua_pushnil(_S);                                                                           // L_: [fixed] args...                            S: libs nil
+    }
+
+    // modules to require
+    if (requiredIdx_ != 0) {
+        if (lua_type(L_, requiredIdx_) != LUA_TTABLE) {
+            raise_luaL_error(L_, "expected required module list as a table, got %s", luaL_typename(L_, requiredIdx_));
+        }
+        lua_newtable(_S);                                                                          // L_: [fixed] args...                            S: libs package {}
+        int _nbRequired{ 1 };
+        lua_pushnil(L_);                                                                           // L_: [fixed] args... nil                        S: libs package {}
+        while (lua_next(L_, requiredIdx_) != 0) {                                                  // L_: [fixed] args... n "modname"                S: libs package {}
+            if (lua_type(L_, -1) != LUA_TSTRING || lua_type(L_, -2) != LUA_TNUMBER || lua_tonumber(L_, -2) != _nbRequired) {
+                raise_luaL_error(L_, "required module list should be a list of strings");
+            }
+            std::ignore = lua_pushstringview(_S, lua_tostringview(L_, -1));                        // L_: [fixed] args... n "modname"                S: libs package {} "modname"
+            lua_rawseti(_S, -2, _nbRequired);                                                      // L_: [fixed] args... n "modname"                S: libs package {}
+            lua_pop(L_, 1);                                                                        // L_: [fixed] args... n                          S: libs package {}
+            ++_nbRequired;
+        }                                                                                          // L_: [fixed] args...                            S: libs package {}
+    } else {
+        lua_pushnil(_S);                                                                           // L_: [fixed] args...                            S: libs package nil
+    }
+
+    // globals
+    if (globalsIdx_ != 0) {
+        if (!lua_istable(L_, globalsIdx_)) {
+            raise_luaL_error(L_, "Expected table, got %s", luaL_typename(L_, globalsIdx_));
+        }
+        lua_pushvalue(L_, globalsIdx_);                                                            // L_: [fixed] args... globals                    S: libs package required
+        if (_c.inter_move(1) != InterCopyResult::Success) {                                        // L_: [fixed] args...                            S: libs package required globals
+            raise_luaL_error(L_, "tried to copy unsupported types");
+        }
+    } else {
+        lua_pushnil(_S);                                                                           // L_: [fixed] args...                            S: libs package required nil
+    }
+
+    lua_pushboolean(_S, saveBaseline_ ? 1 : 0);                                                    // L_: [fixed] args...                            S: libs package required globals baseline
+
+    // lane body
+    LuaType const _func_type{ lua_type_as_enum(L_, funcIdx_) };
+    if (_func_type == LuaType::FUNCTION) {
+        lua_pushvalue(L_, funcIdx_);                                                               // L_: [fixed] args... func                       S: libs package required globals baseline
+        if (_c.inter_move(1) != InterCopyResult::Success) {                                        // L_: [fixed] args...                            S: libs package required globals baseline func
+            raise_luaL_error(L_, "tried to copy unsupported types");
+        }
+    } else if (_func_type == LuaType::STRING) {
+        // compiled by the lane
+        std::ignore = lua_pushstringview(_S, lua_tostringview(L_, funcIdx_));                      // L_: [fixed] args...                            S: libs package required globals baseline "func"
+    } else {
+        raise_luaL_error(L_, "Expected function, got %s", lua_typename(L_, _func_type));
+    }
+    STACK_CHECK(_S, kStagedFuncIdx);
+
+    // and its arguments
+    if (nargs_ > 0) {
+        if (_c.inter_copy(nargs_) != InterCopyResult::Success) {                                   // L_: [fixed] args...                            S: libs package required globals baseline func args...
+            raise_luaL_error(L_, "tried to copy unsupported types");
+        }
+    }
+    STACK_CHECK(_S, kStagedFuncIdx + nargs_);
+    STACK_CHECK(L_, 0);
+}
+
+// #################################################################################################
+
 void Lane::startThread(int priority_)
 {
+    if (U->threadPool) {
+        U->threadPool->launch(lane_main, this, priority_);
+        pooled = true;
+        return;
+    }
     thread = std::jthread([this]() { lane_main(this); });
     if (priority_ != kThreadPrioDefault) {
         JTHREAD_SET_PRIORITY(thread, priority_, U->sudo);
@@ -1,16 +1,22 @@
 #pragma once
 
 #include "cancel.h"
+#include "scheduler.h"
 #include "uniquekey.h"
 #include "universe.h"
 
 #include <chrono>
 #include <condition_variable>
 #include <latch>
+#include <optional>
 #include <stop_token>
 #include <string_view>
 #include <thread>
 
+// forwards
+class DeferredMoves;
+class StatePoolStorage;
+
 // #################################################################################################
 
 // xxh64 of string "kExtendedStackTraceRegKey" generated at https://www.pelock.com/products/hash-calculator
@@ -36,6 +42,9 @@ static constexpr RegistryUniqueKey kLanePointerRegKey{ 0x2D8CF03FE9F0A51Aull };
     // xxh64 of string "debugName" generated at https://www.pelock.com/products/hash-calculator
 static constexpr RegistryUniqueKey kLaneNameRegKey{ 0xA194E2645C57F6DDull };
 
+// xxh64 of string "kLaneCoroutineRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kLaneCoroutineRegKey{ 0x55DA058034BB8DA6ull }; // anchors the coroutine a scheduled lane runs in
+
 // #################################################################################################
 
 // The chain is ended by '(Lane*)(-1)', not nullptr: 'selfdestructFirst -> ... -> ... -> (-1)'
@@ -98,6 +107,10 @@ class Lane
     // M: sets to Pending (before launching)
     // S: updates -> Running/Waiting -> Done/Error/Cancelled
 
+    lua_Integer completionOrder{ 0 };
+    //
+    // S: set with the Done/Error/Cancelled status change, under doneMutex: how many lanes of the universe ended before this one, plus 1
+
     std::condition_variable* volatile waiting_on{ nullptr };
     //
     // When status is Waiting, points on the linda's signal the thread waits on, else nullptr
@@ -108,33 +121,83 @@ class Lane
     // S: reads to see if cancel is requested
 
     Lane* volatile selfdestruct_next{ nullptr };
+    Lane* selfdestruct_prev{ nullptr };
     //
     // M: sets to non-nullptr if facing lane handle '__gc' cycle but the lane
     //    is still running
     // S: cleans up after itself if non-nullptr at lane exit
+    // selfdestruct_prev is nullptr for the head of the chain, so that a lane can unlink itself without walking it
 
     // For tracking only
     Lane* volatile tracking_next{ nullptr };
 
+    bool detached{ false };
+    Lane* detached_prev{ nullptr };
+    Lane* detached_next{ nullptr };
+    //
+    // a detached lane has no handle: it discards its results and deletes itself when it ends
+    // until then, it is listed in the universe's detached chain (protected by selfdestructMutex) so that the shutdown can cancel it
+
     ErrorTraceLevel const errorTraceLevel{ Basic };
 
+    StatePoolStorage* statePool{ nullptr };
+    //
+    // when not nullptr, L goes back in that pool instead of being closed
+
+    bool scheduled{ false };
+    //
+    // when true, the lane is run by the scheduler's workers instead of its own thread
+
+    bool pooled{ false };
+    //
+    // when true, the lane runs on a thread borrowed from the universe's thread pool
+
+    lua_State* staging{ nullptr };
+    //
+    // for a lane launched with the 'async' option, what the lane needs to finish preparing L on its own thread
+
+    bool yielded{ false };
+    int channelCount{ 0 };
+    //
+    // the batches of values sent by lanes.yield() that the handle's iterator hasn't claimed yet
+    // they are stored in one of the keepers, like the contents of a linda, the number of batches it can hold is the universe's yieldCapacity
+    // channelCount is protected by doneMutex, the contents of the channel by the keeper's mutex, so that copying the values doesn't hold the lane's status lock
+
+    lua_State* volatile coroutine{ nullptr };
+    //
+    // the coroutine of L in which a scheduled lane body runs, created when a worker runs it for the first time
+
+    Scheduler::ParkState parkState{ Scheduler::ParkState::Running };
+    Scheduler::TimePoint parkUntil{};
+    Scheduler::ParkedOn::iterator parkedOnIt{};
+    Scheduler::ParkedUntil::iterator parkedUntilIt{};
+    //
+    // where a scheduled lane is parked, protected by the scheduler's mutex
+
     [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept { return U_->internalAllocator.alloc(size_); }
     // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
     static void operator delete(void* p_, Universe* U_) { U_->internalAllocator.free(p_, sizeof(Lane)); }
     // this one is for us, to make sure memory is freed by the correct allocator
     static void operator delete(void* p_) { static_cast<Lane*>(p_)->U->internalAllocator.free(p_, sizeof(Lane)); }
 
-    Lane(Universe* U_, lua_State* L_, ErrorTraceLevel errorTraceLevel_);
+    Lane(Universe* U_, lua_State* L_, ErrorTraceLevel errorTraceLevel_, StatePoolStorage* statePool_);
     ~Lane();
 
     void changeDebugName(int const nameIdx_);
-    void close() { lua_State* _L{ L }; L = nullptr; lua_close(_L); }
+    void cancelLaunch();
+    [[nodiscard]] Keeper* channelKeeper() const;
+    void close();
+    void detach();
     [[nodiscard]] std::string_view errorTraceLevelString() const;
+    [[nodiscard]] bool isLaunched() const { return scheduled || pooled || thread.joinable(); }
     [[nodiscard]] int pushErrorHandler() const;
     [[nodiscard]] std::string_view pushErrorTraceLevel(lua_State* L_) const;
     static void PushMetatable(lua_State* L_);
     [[nodiscard]] std::string_view pushThreadStatus(lua_State* L_) const;
+    void release();
+    [[nodiscard]] bool resume();
     void securizeDebugName(lua_State* L_);
+    void stagePreparation(lua_State* L_, std::optional<std::string_view> const& libs_, int packageIdx_, int requiredIdx_, int globalsIdx_, int funcIdx_, int nargs_, bool saveBaseline_, DeferredMoves* moves_);
     void startThread(int priority_);
     [[nodiscard]] std::string_view threadStatusString() const;
     [[nodiscard]] bool waitForCompletion(std::chrono::time_point<std::chrono::steady_clock> until_);
@@ -150,3 +213,6 @@ class Lane
 {
     return *(static_cast<Lane**>(luaL_checkudata(L_, i_, kLaneMetatableName)));
 }
+
+// converts an optional [wait_secs=-1] argument into a deadline
+[[nodiscard]] std::chrono::time_point<std::chrono::steady_clock> ReadDeadline(lua_State* L_, int idx_);
@@ -0,0 +1,290 @@
+/*
+ * LANEGROUP.CPP               Copyright (c) 2024-, Benoit Germain
+ *
+ * Lanes that are cancelled and joined together
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "lanegroup.h"
+
+#include "cancel.h"
+#include "lane.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+// #################################################################################################
+
+[[nodiscard]] static LaneGroup* ToLaneGroup(lua_State* L_, int i_)
+{
+    return static_cast<LaneGroup*>(luaL_checkudata(L_, i_, kLaneGroupMetatableName));
+}
+
+// #################################################################################################
+
+// pushes an array of the member handles of the group at idx_, and returns their lanes in the same order
+[[nodiscard]] static std::vector<Lane*> PushMembers(lua_State* const L_, int const idx_)
+{
+    LaneGroup* const _group{ ToLaneGroup(L_, idx_) };
+    std::vector<Lane*> _lanes;
+    _lanes.reserve(_group->count);
+    STACK_CHECK_START_REL(L_, 0);
+    lua_createtable(L_, _group->count, 0);                                                         // L_: ... {handles}
+    lua_getiuservalue(L_, idx_, LaneGroup::kMembersIndex);                                         // L_: ... {handles} {members}
+    lua_pushnil(L_);                                                                               // L_: ... {handles} {members} nil
+    while (lua_next(L_, -2)) {                                                                     // L_: ... {handles} {members} h true
+        lua_pop(L_, 1);                                                                            // L_: ... {handles} {members} h
+        _lanes.push_back(ToLane(L_, -1));
+        lua_pushvalue(L_, -1);                                                                     // L_: ... {handles} {members} h h
+        lua_rawseti(L_, -4, static_cast<int>(_lanes.size()));                                      // L_: ... {handles} {members} h
+    }
+    lua_pop(L_, 1);                                                                                // L_: ... {handles}
+    STACK_CHECK(L_, 1);
+    return _lanes;
+}
+
+// #################################################################################################
+
+[[nodiscard]] static bool HasEnded(Lane const* const lane_)
+{
+    return !lane_->isLaunched() || lane_->status >= Lane::Done;
+}
+
+// #################################################################################################
+
+// h... = group:add(h...)
+//
+// the lanes become members of the group, that keeps their handles until they are joined
+LUAG_FUNC(group_add)
+{
+    static constexpr int kSelf{ 1 };
+    LaneGroup* const _group{ ToLaneGroup(L_, kSelf) };
+    int const _n{ lua_gettop(L_) };
+    STACK_GROW(L_, 3);
+    STACK_CHECK_START_REL(L_, 0);
+    lua_getiuservalue(L_, kSelf, LaneGroup::kMembersIndex);                                        // L_: group h... {members}
+    for (int _i{ kSelf + 1 }; _i <= _n; ++_i) {
+        std::ignore = ToLane(L_, _i);
+        lua_pushvalue(L_, _i);                                                                     // L_: group h... {members} h
+        lua_rawget(L_, -2);                                                                        // L_: group h... {members} true|nil
+        if (lua_isnil(L_, -1)) {                                                                   // L_: group h... {members} nil
+            lua_pushvalue(L_, _i);                                                                 // L_: group h... {members} nil h
+            lua_pushboolean(L_, 1);                                                                // L_: group h... {members} nil h true
+            lua_rawset(L_, -4);                                                                    // L_: group h... {members} nil
+            ++_group->count;
+        }
+        lua_pop(L_, 1);                                                                            // L_: group h... {members}
+    }
+    lua_pop(L_, 1);                                                                                // L_: group h...
+    STACK_CHECK(L_, 0);
+    return _n - kSelf;
+}
+
+// #################################################################################################
+
+// bool[, "timeout"] = group:cancel([mode, hookcount] [, timeout] [, wake_lane])
+//
+// same arguments as lane_h:cancel(), but all the members are signalled at once, and the timeout is the one for them all to end
+LUAG_FUNC(group_cancel)
+{
+    static constexpr int kSelf{ 1 };
+    std::ignore = ToLaneGroup(L_, kSelf);
+    CancelArgs const _args{ read_cancel_args(L_, kSelf + 1) };
+    lua_settop(L_, kSelf);
+    std::vector<Lane*> const _lanes{ PushMembers(L_, kSelf) };                                     // L_: group {handles}
+
+    // signal them all without waiting for any
+    for (Lane* const _lane : _lanes) {
+        if (_lane->isLaunched()) {
+            std::ignore = thread_cancel(_lane, _args.op, _args.hookCount, std::chrono::steady_clock::now(), false);
+        }
+    }
+    // then wake those that wait on a linda, now that they will all see their cancel request
+    if (_args.wakeLane) {
+        CancelWaker _waker;
+        for (Lane* const _lane : _lanes) {
+            _waker.wake(_lane);
+        }
+    }
+
+    // a single deadline for all of them
+    Universe* const _U{ Universe::Get(L_) };
+    bool _ended{ false };
+    {
+        std::unique_lock _guard{ _U->completionMutex };
+        _ended = _U->completionCondVar.wait_until(_guard, _args.until, [&_lanes]() { return std::ranges::all_of(_lanes, HasEnded); });
+    }
+    lua_pushboolean(L_, _ended ? 1 : 0);                                                           // L_: group {handles} bool
+    if (_ended) {
+        return 1;
+    }
+    lua_pushliteral(L_, "timeout");                                                                // L_: group {handles} false "timeout"
+    return 2;
+}
+
+// #################################################################################################
+
+#if HAVE_LANE_SCHEDULER()
+LUAG_FUNC(group_join);
+
+// a scheduled lane that parked in a group join is resumed: try again with what remains of the timeout
+[[nodiscard]] static int GroupJoinK(lua_State* L_, [[maybe_unused]] int status_, [[maybe_unused]] lua_KContext ctx_)
+{
+    Scheduler::AdjustTimeout(L_, 2);
+    return LG_group_join(L_);
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
+// {h...} [, "timeout"] = group:join([wait_secs=-1])
+//
+// waits until all the members have ended, and returns the handles of those that have, in the order they ended
+// they leave the group, their results are left in place until they are read through their handle
+LUAG_FUNC(group_join)
+{
+    static constexpr int kSelf{ 1 };
+    static constexpr int kTimeout{ 2 };
+    LaneGroup* const _group{ ToLaneGroup(L_, kSelf) };
+    std::chrono::time_point<std::chrono::steady_clock> const _until{ ReadDeadline(L_, kTimeout) };
+    lua_settop(L_, kTimeout);
+    std::vector<Lane*> const _lanes{ PushMembers(L_, kSelf) };                                     // L_: group timeout {handles}
+    auto const _satisfied = [&_lanes]() { return std::ranges::all_of(_lanes, HasEnded); };
+
+    Universe* const _U{ Universe::Get(L_) };
+    bool _ready{ false };
+#if HAVE_LANE_SCHEDULER()
+    // a scheduled lane parks until another lane ends, instead of blocking its worker thread
+    if (Lane* const _self{ Scheduler::ParkableLane(L_) }) {
+        bool _parked{ false };
+        {
+            std::lock_guard _guard{ _U->completionMutex };
+            if (!_satisfied() && std::chrono::steady_clock::now() < _until) {
+                _self->status = Lane::Waiting;
+                _self->waiting_on = &_U->completionCondVar;
+                Scheduler::Park(_self, _U->completionCondVar, _until);
+                _parked = true;
+            }
+        }
+        if (_parked) {
+            return lua_yieldk(L_, 0, 0, GroupJoinK);
+        }
+    }
+#endif // HAVE_LANE_SCHEDULER()
+    {
+        std::unique_lock _guard{ _U->completionMutex };
+        _ready = _U->completionCondVar.wait_until(_guard, _until, _satisfied);
+    }
+
+    // the lanes that have ended, in the order they did
+    std::vector<int> _ended;
+    _ended.reserve(_lanes.size());
+    for (int _i{ 0 }; _i < static_cast<int>(_lanes.size()); ++_i) {
+        if (HasEnded(_lanes[_i])) {
+            _ended.push_back(_i);
+        }
+    }
+    std::ranges::stable_sort(_ended, {}, [&_lanes](int const i_) { return _lanes[i_]->completionOrder; });
+
+    STACK_GROW(L_, 4);
+    lua_getiuservalue(L_, kSelf, LaneGroup::kMembersIndex);                                        // L_: group timeout {handles} {members}
+    lua_createtable(L_, static_cast<int>(_ended.size()), 0);                                       // L_: group timeout {handles} {members} {ended}
+    int _n{ 0 };
+    for (int const _i : _ended) {
+        lua_rawgeti(L_, kTimeout + 1, _i + 1);                                                     // L_: group timeout {handles} {members} {ended} h
+        lua_pushvalue(L_, -1);                                                                     // L_: group timeout {handles} {members} {ended} h h
+        lua_pushnil(L_);                                                                           // L_: group timeout {handles} {members} {ended} h h nil
+        lua_rawset(L_, -5);                                                                        // L_: group timeout {handles} {members} {ended} h
+        lua_rawseti(L_, -2, ++_n);                                                                 // L_: group timeout {handles} {members} {ended}
+    }
+    _group->count -= _n;
+    if (_ready) {
+        return 1;
+    }
+    lua_pushliteral(L_, "timeout");                                                                // L_: group timeout {handles} {members} {ended} "timeout"
+    return 2;
+}
+
+// #################################################################################################
+
+// n = #group
+LUAG_FUNC(group_len)
+{
+    lua_pushinteger(L_, ToLaneGroup(L_, 1)->count);
+    return 1;
+}
+
+// #################################################################################################
+
+namespace {
+    namespace local {
+        static luaL_Reg const sLaneGroupFunctions[] = {
+            { "__len", LG_group_len },
+            { "add", LG_group_add },
+            { "cancel", LG_group_cancel },
+            { "join", LG_group_join },
+            { nullptr, nullptr }
+        };
+    } // namespace local
+} // namespace
+
+// contains keys: { __index, __len, __metatable, add, cancel, join }
+void LaneGroup::PushMetatable(lua_State* L_)
+{
+    STACK_CHECK_START_REL(L_, 0);
+    if (luaL_newmetatable(L_, kLaneGroupMetatableName)) {                                          // L_: mt
+        luaG_registerlibfuncs(L_, local::sLaneGroupFunctions);
+        lua_pushvalue(L_, -1);                                                                     // L_: mt mt
+        lua_setfield(L_, -2, "__index");                                                           // L_: mt
+        // hide the actual metatable from getmetatable()
+        lua_pushliteral(L_, kLaneGroupMetatableName);                                              // L_: mt "LaneGroup"
+        lua_setfield(L_, -2, "__metatable");                                                       // L_: mt
+    }
+    STACK_CHECK(L_, 1);
+}
+
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * group = lanes.group()
+ *
+ * returns an empty group, that lanes join with group:add(h...) or through the 'group' option of their generator
+ */
+LUAG_FUNC(group)
+{
+    STACK_CHECK_START_REL(L_, 0);
+    [[maybe_unused]] LaneGroup* const _group{ new (L_) LaneGroup{} };                                               // L_: group
+    lua_newtable(L_);                                                                              // L_: group {members}
+    lua_setiuservalue(L_, -2, LaneGroup::kMembersIndex);                                           // L_: group
+    LaneGroup::PushMetatable(L_);                                                                  // L_: group mt
+    lua_setmetatable(L_, -2);                                                                      // L_: group
+    STACK_CHECK(L_, 1);
+    return 1;
+}
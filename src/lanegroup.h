@@ -0,0 +1,36 @@
+#pragma once
+
+#include "compat.h"
+#include "macros_and_utils.h"
+
+// must be a #define instead of a constexpr to work with lua_pushliteral (until I templatize it)
+#define kLaneGroupMetatableName "LaneGroup"
+
+// #################################################################################################
+
+// what lanes.group() returns: a set of lanes that are cancelled and joined together
+// the member handles are kept in the uservalue of the full userdata, so that the lanes stay alive until they are joined
+class LaneGroup
+{
+    public:
+    static constexpr int kMembersIndex{ 1 }; // uservalue index of the { handle = true } table
+    int count{ 0 }; // number of members
+
+    public:
+    [[nodiscard]] static void* operator new([[maybe_unused]] size_t size_, lua_State* L_) noexcept { return lua_newuserdatauv<LaneGroup>(L_, 1); }
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete([[maybe_unused]] void* p_, [[maybe_unused]] lua_State* L_) {} // nothing to do, as nothing is allocated independently
+
+    LaneGroup() = default;
+    // non-copyable, non-movable
+    LaneGroup(LaneGroup const&) = delete;
+    LaneGroup(LaneGroup const&&) = delete;
+    LaneGroup& operator=(LaneGroup const&) = delete;
+    LaneGroup& operator=(LaneGroup const&&) = delete;
+
+    static void PushMetatable(lua_State* L_);
+};
+
+// #################################################################################################
+
+LUAG_FUNC(group);
@@ -87,6 +87,8 @@ THE SOFTWARE.
 #include "lane.h"
 #include "nameof.h"
 #include "state.h"
+#include "statepool.h"
+#include "statetemplate.h"
 #include "threading.h"
 #include "tools.h"
 
@@ -100,7 +102,9 @@ THE SOFTWARE.
 #include <sys/types.h>
 #endif
 
+#include <array>
 #include <atomic>
+#include <limits>
 
 // #################################################################################################
 // ########################################### Threads #############################################
@@ -161,6 +165,16 @@ LUAG_FUNC(set_thread_affinity)
 
 // #################################################################################################
 
+#if HAVE_LANE_SCHEDULER()
+// L_: duration? result...
+[[nodiscard]] static int SleepK(lua_State* L_, [[maybe_unused]] int status_, [[maybe_unused]] lua_KContext ctx_)
+{
+    return lua_gettop(L_) - 1;
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
 LUAG_FUNC(sleep)
 {
     extern LUAG_FUNC(linda_receive);
@@ -182,8 +196,14 @@ LUAG_FUNC(sleep)
     }
     std::ignore = lua_pushstringview(L_, "ac100de1-a696-4619-b2f0-a26de9d58ab8");                  // L_: duration? receive() timerLinda duration key
     STACK_CHECK(L_, 3); // 3 arguments ready
+#if HAVE_LANE_SCHEDULER()
+    // a scheduled lane parks in the receive(), so we need a continuation to get back here
+    lua_callk(L_, 3, LUA_MULTRET, 0, SleepK); // timerLinda:receive(duration,key)                  // L_: duration? result...
+    return SleepK(L_, LUA_OK, 0);
+#else // HAVE_LANE_SCHEDULER()
     lua_call(L_, 3, LUA_MULTRET); // timerLinda:receive(duration,key)                              // L_: duration? result...
     return lua_gettop(L_) - 1;
+#endif // HAVE_LANE_SCHEDULER()
 }
 
 // #################################################################################################
@@ -243,6 +263,12 @@ LUAG_FUNC(register)
 //                   , [gc_cb_func]
 //                   , [name]
 //                   , error_trace_level
+//                   , [state_pool]
+//                   , [state_template]
+//                   , [scheduled]
+//                   , [async]
+//                   , [detached]
+//                   , [held]
 //                  [, ... args ...])
 //
 // Upvalues: metatable to use for 'lane_ud'
@@ -258,7 +284,13 @@ LUAG_FUNC(lane_new)
     static constexpr int kGcCbIdx{ 7 };
     static constexpr int kNameIdx{ 8 };
     static constexpr int kErTlIdx{ 9 };
-    static constexpr int kFixedArgsIdx{ 9 };
+    static constexpr int kPoolIdx{ 10 };
+    static constexpr int kTmplIdx{ 11 };
+    static constexpr int kSchdIdx{ 12 };
+    static constexpr int kAsynIdx{ 13 };
+    static constexpr int kDtchIdx{ 14 };
+    static constexpr int kHeldIdx{ 15 };
+    static constexpr int kFixedArgsIdx{ 15 };
 
     int const _nargs{ lua_gettop(L_) - kFixedArgsIdx };
     LUA_ASSERT(L_, _nargs >= 0);
@@ -266,15 +298,36 @@ LUAG_FUNC(lane_new)
     Universe* const _U{ Universe::Get(L_) };
     DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: setup" << std::endl);
 
+    StatePool* const _pool{ lua_isnoneornil(L_, kPoolIdx) ? nullptr : static_cast<StatePool*>(StatePoolFactory::Instance.toDeep(L_, kPoolIdx)) };
+    if (_pool == nullptr && !lua_isnoneornil(L_, kPoolIdx)) {
+        raise_luaL_error(L_, "expected a state pool, got %s", luaL_typename(L_, kPoolIdx));
+    }
+    StateTemplate* const _template{ lua_isnoneornil(L_, kTmplIdx) ? nullptr : static_cast<StateTemplate*>(StateTemplateFactory::Instance.toDeep(L_, kTmplIdx)) };
+    if (_template == nullptr && !lua_isnoneornil(L_, kTmplIdx)) {
+        raise_luaL_error(L_, "expected a state template, got %s", luaL_typename(L_, kTmplIdx));
+    }
+    bool const _scheduled{ lua_toboolean(L_, kSchdIdx) ? true : false };
+    if (_scheduled && !HAVE_LANE_SCHEDULER()) {
+        raise_luaL_error(L_, "scheduled lanes require Lua 5.3 or later");
+    }
+    if (_template && lua_toboolean(L_, kAsynIdx)) {
+        raise_luaL_error(L_, "async lanes can't use a state template");
+    }
+    // a pooled state already has its libraries, package, required modules and globals
+    lua_State* const _pooledL2{ _pool ? _pool->storage->takeState() : nullptr };
+    // an async lane prepares its own state, we only create it here
+    bool const _async{ lua_toboolean(L_, kAsynIdx) && !_pooledL2 };
     std::optional<std::string_view> _libs_str{ lua_isnil(L_, kLibsIdx) ? std::nullopt : std::make_optional(lua_tostringview(L_, kLibsIdx)) };
-    lua_State* const _L2{ state::NewLaneState(_U, SourceState{ L_ }, _libs_str) };                 // L_: [fixed] ...                                L2:
+    lua_State* const _L2{ _pooledL2 ? _pooledL2 : _async ? state::CreateLaneState(_U, SourceState{ L_ }, _libs_str) : state::NewLaneState(_U, SourceState{ L_ }, _libs_str) };
     STACK_CHECK_START_REL(_L2, 0);
 
     // 'lane' is allocated from heap, not Lua, since its life span may surpass the handle's (if free running thread)
-    Lane* const _lane{ new (_U) Lane{ _U, _L2, static_cast<Lane::ErrorTraceLevel>(lua_tointeger(L_, kErTlIdx)) } };
+    Lane* const _lane{ new (_U) Lane{ _U, _L2, static_cast<Lane::ErrorTraceLevel>(lua_tointeger(L_, kErTlIdx)), _pool ? _pool->storage : nullptr } };
     if (_lane == nullptr) {
         raise_luaL_error(L_, "could not create lane: out of memory");
     }
+    _lane->scheduled = _scheduled;
+    _lane->detached = lua_toboolean(L_, kDtchIdx) ? true : false;
 
     class OnExit
     {
@@ -295,25 +348,44 @@ LUAG_FUNC(lane_new)
         {
             if (lane) {
                 STACK_CHECK_START_REL(L, 0);
-                // we still need a full userdata so that garbage collection can do its thing
-                prepareUserData();
-                // remove it immediately from the stack so that the error that landed us here is at the top
-                lua_pop(L, 1);
-                STACK_CHECK(L, 0);
-                // leave a single cancel_error on the stack for the caller
-                lua_settop(lane->L, 0);
-                kCancelError.pushKey(lane->L);
-                {
-                    std::lock_guard _guard{ lane->doneMutex };
-                    // this will cause lane_main to skip actual running (because we are not Pending anymore)
-                    lane->status = Lane::Running;
+                if (lane->detached) {
+                    // the lane deletes itself when it ends, but shutdown must know about it until then
+                    lane->detach();
+                } else {
+                    // we still need a full userdata so that garbage collection can do its thing
+                    prepareUserData();
+                    // remove it immediately from the stack so that the error that landed us here is at the top
+                    lua_pop(L, 1);
                 }
+                STACK_CHECK(L, 0);
                 // unblock the thread so that it can terminate gracefully
-                lane->ready.count_down();
+                lane->cancelLaunch();
             }
         }
 
         private:
+        void prepareDebugName()
+        {
+            lua_State* _L2{ lane->L };
+            STACK_CHECK_START_REL(_L2, 0);
+            int const _name_idx{ lua_isnoneornil(L, kNameIdx) ? 0 : kNameIdx };
+            std::string_view const _debugName{ (_name_idx > 0) ? lua_tostringview(L, _name_idx) : std::string_view{} };
+            if (!_debugName.empty())
+            {
+                if (_debugName != "auto") {
+                    std::ignore = lua_pushstringview(_L2, _debugName);                             // L: ...                                         L2: "<name>"
+                } else {
+                    lua_Debug _ar;
+                    lua_pushvalue(L, 1);                                                           // L: ... func
+                    lua_getinfo(L, ">S", &_ar);                                                    // L: ...
+                    lua_pushfstring(_L2, "%s:%d", _ar.short_src, _ar.linedefined);                 // L: ...                                         L2: "<name>"
+                }
+                lane->changeDebugName(-1);
+                lua_pop(_L2, 1);                                                                   // L: ...                                         L2:
+            }
+            STACK_CHECK(_L2, 0);
+        }
+
         void prepareUserData()
         {
             DEBUGSPEW_CODE(DebugSpew(lane->U) << "lane_new: preparing lane userdata" << std::endl);
@@ -342,32 +414,24 @@ LUAG_FUNC(lane_new)
 
             lua_setiuservalue(L, -2, 1);                                                           // L: ... lane
 
-            lua_State* _L2{ lane->L };
-            STACK_CHECK_START_REL(_L2, 0);
-            int const _name_idx{ lua_isnoneornil(L, kNameIdx) ? 0 : kNameIdx };
-            std::string_view const _debugName{ (_name_idx > 0) ? lua_tostringview(L, _name_idx) : std::string_view{} };
-            if (!_debugName.empty())
-            {
-                if (_debugName != "auto") {
-                    std::ignore = lua_pushstringview(_L2, _debugName);                             // L: ... lane                                    L2: "<name>"
-                } else {
-                    lua_Debug _ar;
-                    lua_pushvalue(L, 1);                                                           // L: ... lane func
-                    lua_getinfo(L, ">S", &_ar);                                                    // L: ... lane
-                    lua_pushfstring(_L2, "%s:%d", _ar.short_src, _ar.linedefined);                 // L: ... lane                                    L2: "<name>"
-                }
-                lane->changeDebugName(-1);
-                lua_pop(_L2, 1);                                                                   // L: ... lane                                    L2:
-            }
-            STACK_CHECK(_L2, 0);
+            prepareDebugName();
             STACK_CHECK(L, 1);
         }
 
         public:
-        void success()
+        void success(bool const held_)
         {
-            prepareUserData();
-            lane->ready.count_down();
+            // a detached lane has no handle, nobody will read its results
+            if (lane->detached) {
+                prepareDebugName();
+                lane->detach();
+            } else {
+                prepareUserData();
+            }
+            // a held lane is released by whoever asked for it, once it has launched all the others
+            if (!held_) {
+                lane->release();
+            }
             lane = nullptr;
         }
     } _onExit{ L_, _lane};
@@ -390,24 +454,29 @@ LUAG_FUNC(lane_new)
         })
     };
 
-    _lane->startThread(_priority);
+    // a scheduled lane is handed over to the scheduler once it is ready
+    if (!_lane->scheduled) {
+        _lane->startThread(_priority);
+    }
 
     STACK_GROW(_L2, _nargs + 3);
     STACK_GROW(L_, 3);
     STACK_CHECK_START_REL(L_, 0);
+    // __lanesmove calls wait until the lane is fully prepared, so that a failed launch leaves the sources untouched
+    DeferredMoves _moves;
 
     // package
-    int const _package_idx{ lua_isnoneornil(L_, kPackIdx) ? 0 : kPackIdx };
+    int const _package_idx{ (_pooledL2 || _async || lua_isnoneornil(L_, kPackIdx)) ? 0 : kPackIdx };
     if (_package_idx != 0) {
         DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: update 'package'" << std::endl);
         // when copying with mode LookupMode::LaneBody, should raise an error in case of problem, not leave it one the stack
-        InterCopyContext c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, SourceIndex{ _package_idx }, {}, {}, {} };
+        InterCopyContext<LookupMode::LaneBody> c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, SourceIndex{ _package_idx }, {}, {} };
         [[maybe_unused]] InterCopyResult const ret{ c.inter_copy_package() };
         LUA_ASSERT(L_, ret == InterCopyResult::Success); // either all went well, or we should not even get here
     }
 
     // modules to require in the target lane *before* the function is transfered!
-    int const _required_idx{ lua_isnoneornil(L_, kRequIdx) ? 0 : kRequIdx };
+    int const _required_idx{ (_pooledL2 || _async || lua_isnoneornil(L_, kRequIdx)) ? 0 : kRequIdx };
     if (_required_idx != 0) {
         int _nbRequired{ 1 };
         DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: process 'required' list" << std::endl);
@@ -416,34 +485,22 @@ LUAG_FUNC(lane_new)
         if (lua_type(L_, _required_idx) != LUA_TTABLE) {
             raise_luaL_error(L_, "expected required module list as a table, got %s", luaL_typename(L_, _required_idx));
         }
+        // a generator with a template lends one of its template states to the lane until all modules are there, preparing a new one if none is available
+        std::optional<StateTemplate::Lease> _lease;
+        if (_template) {
+            _lease.emplace(*_template, L_, _L2, _libs_str, _package_idx, _required_idx);           // L_: [fixed] args...                            L2: {cache}
+        }
 
         lua_pushnil(L_);                                                                           // L_: [fixed] args... nil                        L2:
         while (lua_next(L_, _required_idx) != 0) {                                                 // L_: [fixed] args... n "modname"                L2:
             if (lua_type(L_, -1) != LUA_TSTRING || lua_type(L_, -2) != LUA_TNUMBER || lua_tonumber(L_, -2) != _nbRequired) {
                 raise_luaL_error(L_, "required module list should be a list of strings");
             } else {
-                // require the module in the target state, and populate the lookup table there too
-                std::string_view const _name{ lua_tostringview(L_, -1) };
-                DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: require '" << _name << "'" << std::endl);
-
-                // require the module in the target lane
-                lua_getglobal(_L2, "require");                                                     // L_: [fixed] args... n "modname"                L2: require()?
-                if (lua_isnil(_L2, -1)) {
-                    lua_pop(_L2, 1);                                                               // L_: [fixed] args... n "modname"                L2:
-                    raise_luaL_error(L_, "cannot pre-require modules without loading 'package' library first");
+                // require the module in the target state (or clone it from the template), and populate the lookup table there too
+                if (_lease) {
+                    _lease->requireModule(L_, lua_tostringview(L_, -1));
                 } else {
-                    std::ignore = lua_pushstringview(_L2, _name);                                  // L_: [fixed] args... n "modname"                L2: require() name
-                    LuaError const _rc{ lua_pcall(_L2, 1, 1, 0) };                                 // L_: [fixed] args... n "modname"                L2: ret/errcode
-                    if (_rc != LuaError::OK) {
-                        // propagate error to main state if any
-                        InterCopyContext _c{ _U, DestState{ L_ }, SourceState{ _L2 }, {}, {}, {}, {}, {} };
-                        std::ignore = _c.inter_move(1);                                            // L_: [fixed] args... n "modname" error          L2:
-                        raise_lua_error(L_);
-                    }
-                    // here the module was successfully required                                   // L_: [fixed] args... n "modname"                L2: ret
-                    // after requiring the module, register the functions it exported in our name<->function database
-                    tools::PopulateFuncLookupTable(_L2, -1, _name);
-                    lua_pop(_L2, 1);                                                               // L_: [fixed] args... n "modname"                L2:
+                    state::RequireModule(_U, L_, _L2, lua_tostringview(L_, -1));
                 }
             }
             lua_pop(L_, 1);                                                                        // L_: [fixed] args... n                          L2:
@@ -456,7 +513,7 @@ LUAG_FUNC(lane_new)
     // Appending the specified globals to the global environment
     // *after* stdlibs have been loaded and modules required, in case we transfer references to native functions they exposed...
     //
-    int const _globals_idx{ lua_isnoneornil(L_, kGlobIdx) ? 0 : kGlobIdx };
+    int const _globals_idx{ (_pooledL2 || _async || lua_isnoneornil(L_, kGlobIdx)) ? 0 : kGlobIdx };
     if (_globals_idx != 0) {
         DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: transfer globals" << std::endl);
         if (!lua_istable(L_, _globals_idx)) {
@@ -466,7 +523,7 @@ LUAG_FUNC(lane_new)
         DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
         lua_pushnil(L_);                                                                           // L_: [fixed] args... nil                        L2:
         // Lua 5.2 wants us to push the globals table on the stack
-        InterCopyContext _c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, {}, {}, {}, {} };
+        InterCopyContext<LookupMode::LaneBody> _c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, {}, {}, {}, &_moves };
         lua_pushglobaltable(_L2);                                                                  // L_: [fixed] args... nil                        L2: _G
         while (lua_next(L_, _globals_idx)) {                                                       // L_: [fixed] args... k v                        L2: _G
             std::ignore = _c.inter_copy(2);                                                        // L_: [fixed] args... k v                        L2: _G k v
@@ -479,41 +536,66 @@ LUAG_FUNC(lane_new)
     STACK_CHECK(L_, 0);
     STACK_CHECK(_L2, 0);
 
+    // the state is ready to run a lane body: that's the point where it goes back when recycled
+    if (_pool && !_pooledL2 && !_async) {
+        StatePoolStorage::SaveBaseline(_L2);
+    }
+
     // Lane main function
     [[maybe_unused]] int const errorHandlerCount{ _lane->pushErrorHandler() };                     // L_: [fixed] args...                            L2: eh?
-    LuaType const _func_type{ lua_type_as_enum(L_, kFuncIdx) };
-    if (_func_type == LuaType::FUNCTION) {
-        DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: transfer lane body" << std::endl);
-        DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
-        lua_pushvalue(L_, kFuncIdx);                                                               // L_: [fixed] args... func                       L2: eh?
-        InterCopyContext _c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, {}, {}, {}, {} };
-        InterCopyResult const _res{ _c.inter_move(1) };                                            // L_: [fixed] args...                            L2: eh? func
-        if (_res != InterCopyResult::Success) {
-            raise_luaL_error(L_, "tried to copy unsupported types");
+    if (_async) {
+        DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: stage lane preparation" << std::endl);
+        // package, required modules, globals, lane body and arguments are snapshotted for the lane to finish its own preparation
+        _lane->stagePreparation(
+            L_,
+            _libs_str,
+            lua_isnoneornil(L_, kPackIdx) ? 0 : kPackIdx,
+            lua_isnoneornil(L_, kRequIdx) ? 0 : kRequIdx,
+            lua_isnoneornil(L_, kGlobIdx) ? 0 : kGlobIdx,
+            kFuncIdx,
+            _nargs,
+            _pool != nullptr,
+            &_moves
+        );                                                                                         // L_: [fixed] args...                            L2: eh?
+    } else {
+        LuaType const _func_type{ lua_type_as_enum(L_, kFuncIdx) };
+        if (_func_type == LuaType::FUNCTION) {
+            DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: transfer lane body" << std::endl);
+            DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
+            lua_pushvalue(L_, kFuncIdx);                                                          // L_: [fixed] args... func                       L2: eh?
+            InterCopyContext<LookupMode::LaneBody> _c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, {}, {}, {}, &_moves };
+            InterCopyResult const _res{ _c.inter_move(1) };                                       // L_: [fixed] args...                            L2: eh? func
+            if (_res != InterCopyResult::Success) {
+                raise_luaL_error(L_, "tried to copy unsupported types");
+            }
+        } else if (_func_type == LuaType::STRING) {
+            DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: compile lane body" << std::endl);
+            // compile the string
+            if (luaL_loadstring(_L2, lua_tostring(L_, kFuncIdx)) != 0) {                          // L_: [fixed] args...                            L2: eh? func
+                raise_luaL_error(L_, "error when parsing lane function code");
+            }
+        } else {
+            raise_luaL_error(L_, "Expected function, got %s", lua_typename(L_, _func_type));
         }
-    } else if (_func_type == LuaType::STRING) {
-        DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: compile lane body" << std::endl);
-        // compile the string
-        if (luaL_loadstring(_L2, lua_tostring(L_, kFuncIdx)) != 0) {                               // L_: [fixed] args...                            L2: eh? func
-            raise_luaL_error(L_, "error when parsing lane function code");
+        STACK_CHECK(L_, 0);
+        STACK_CHECK(_L2, errorHandlerCount + 1);
+        LUA_ASSERT(L_, lua_isfunction(_L2, errorHandlerCount + 1));
+
+        // revive arguments
+        if (_nargs > 0) {
+            DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: transfer lane arguments" << std::endl);
+            DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
+            InterCopyContext<LookupMode::LaneBody> _c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, {}, {}, {}, &_moves };
+            InterCopyResult const res{ _c.inter_copy(_nargs) };                                   // L_: [fixed] args...                            L2: eh? func args...
+            if (res != InterCopyResult::Success) {
+                raise_luaL_error(L_, "tried to copy unsupported types");
+            }
         }
-    } else {
-        raise_luaL_error(L_, "Expected function, got %s", lua_typename(L_, _func_type));
     }
     STACK_CHECK(L_, 0);
-    STACK_CHECK(_L2, errorHandlerCount + 1);
-    LUA_ASSERT(L_, lua_isfunction(_L2, errorHandlerCount + 1));
-
-    // revive arguments
-    if (_nargs > 0) {
-        DEBUGSPEW_CODE(DebugSpew(_U) << "lane_new: transfer lane arguments" << std::endl);
-        DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
-        InterCopyContext _c{ _U, DestState{ _L2 }, SourceState{ L_ }, {}, {}, {}, {}, {} };
-        InterCopyResult const res{ _c.inter_move(_nargs) };                                        // L_: [fixed]                                    L2: eh? func args...
-        if (res != InterCopyResult::Success) {
-            raise_luaL_error(L_, "tried to copy unsupported types");
-        }
-    }
+    // everything was transferred: the movable userdata can hand their resources over to their copies
+    _moves.finish();
+    lua_pop(L_, _nargs);                                                                           // L_: [fixed]                                    L2: eh? func args...
     STACK_CHECK(L_, -_nargs);
     LUA_ASSERT(L_, lua_gettop(L_) == kFixedArgsIdx);
 
@@ -521,12 +603,201 @@ LUAG_FUNC(lane_new)
     kLanePointerRegKey.setValue(
         _L2, [lane = _lane](lua_State* L_) { lua_pushlightuserdata(L_, lane); }                    // L_: [fixed]                                    L2: eh? func args...
     );
-    STACK_CHECK(_L2, errorHandlerCount + 1 + _nargs);
+    STACK_CHECK(_L2, errorHandlerCount + (_async ? 0 : 1 + _nargs));
 
     STACK_CHECK_RESET_REL(L_, 0);
     // all went well, the lane's thread can start working
-    _onExit.success();                                                                             // L_: [fixed] lane                               L2: <living its own life>
-    // we should have the lane userdata on top of the stack
+    bool const _detached{ _lane->detached };
+    _onExit.success(lua_toboolean(L_, kHeldIdx) ? true : false);                                   // L_: [fixed] lane?                              L2: <living its own life>
+    // we should have the lane userdata on top of the stack, unless the lane is detached
+    int const _ret{ _detached ? 0 : 1 };
+    STACK_CHECK(L_, _ret);
+    return _ret;
+}
+
+// #################################################################################################
+
+// launches the lanes of lane_spawn_many(), each one held until they are all ready
+// L_: handles n args|nil fixed...
+// Upvalues: lane_new
+[[nodiscard]] static int SpawnManyLanes(lua_State* L_)
+{
+    static constexpr int kHandlesIdx{ 1 };
+    static constexpr int kCountIdx{ 2 };
+    static constexpr int kArgsIdx{ 3 };
+    static constexpr int kFixedIdx{ 4 }; // lane_new() arguments, up to 'detached'
+
+    int const _nbFixed{ lua_gettop(L_) - kArgsIdx };
+    int const _count{ static_cast<int>(lua_tointeger(L_, kCountIdx)) };
+    LuaType const _args_type{ lua_type_as_enum(L_, kArgsIdx) };
+    STACK_CHECK_START_REL(L_, 0);
+    for (int _i{ 1 }; _i <= _count; ++_i) {
+        STACK_GROW(L_, _nbFixed + 4);
+        int const _funcIdx{ lua_gettop(L_) + 1 };
+        lua_pushvalue(L_, lua_upvalueindex(1));                                                    // L_: handles n args fixed... lane_new
+        for (int _j{ 0 }; _j < _nbFixed; ++_j) {
+            lua_pushvalue(L_, kFixedIdx + _j);                                                     // L_: handles n args fixed... lane_new fixed...
+        }
+        lua_pushboolean(L_, 1);                                                                    // L_: handles n args fixed... lane_new fixed... held
+        if (_args_type == LuaType::FUNCTION) {
+            lua_pushvalue(L_, kArgsIdx);                                                           // L_: handles n args fixed... lane_new fixed... held argsFn
+            lua_pushinteger(L_, _i);                                                               // L_: handles n args fixed... lane_new fixed... held argsFn i
+            lua_call(L_, 1, LUA_MULTRET);                                                          // L_: handles n args fixed... lane_new fixed... held args...
+        } else if (_args_type == LuaType::TABLE) {
+            lua_rawgeti(L_, kArgsIdx, _i);                                                         // L_: handles n args fixed... lane_new fixed... held {args}|arg|nil
+            if (lua_istable(L_, -1)) {
+                // a table.pack() result tells how many arguments there are, including nils
+                int const _listIdx{ lua_gettop(L_) };
+                int const _nargs{ (luaG_getfield(L_, _listIdx, "n") == LuaType::NUMBER) ? static_cast<int>(lua_tointeger(L_, -1)) : static_cast<int>(lua_rawlen(L_, _listIdx)) };
+                lua_pop(L_, 1);                                                                    // L_: handles n args fixed... lane_new fixed... held {args}
+                STACK_GROW(L_, _nargs);
+                for (int _k{ 1 }; _k <= _nargs; ++_k) {
+                    lua_rawgeti(L_, _listIdx, _k);                                                 // L_: handles n args fixed... lane_new fixed... held {args} args...
+                }
+                lua_remove(L_, _listIdx);                                                          // L_: handles n args fixed... lane_new fixed... held args...
+            } else if (lua_isnil(L_, -1)) {
+                lua_pop(L_, 1);                                                                    // L_: handles n args fixed... lane_new fixed... held
+            }
+        }
+        lua_call(L_, lua_gettop(L_) - _funcIdx, 1);                                                // L_: handles n args fixed... lane
+        lua_rawseti(L_, kHandlesIdx, _i);                                                          // L_: handles n args fixed...
+        STACK_CHECK(L_, 0);
+    }
+    return 0;
+}
+
+// #################################################################################################
+
+// the arguments of lane_new() that a generator fixes, in order, as named in the descriptor built by lanes.gen()
+static constexpr std::array<std::string_view, 14> kGenFixedArgs{
+    "func", "libs", "priority", "globals", "package", "required", "gc_cb", "name", "error_trace_level", "pool", "template", "scheduled", "async", "detached"
+};
+
+// a generator keeps lane_new() and the arguments it fixes in a descriptor table, that is its only upvalue
+// pushes the descriptor of the generator at idx_ and returns true, or pushes nothing and returns false if it isn't a generator
+[[nodiscard]] static bool PushGeneratorDescriptor(lua_State* const L_, int const idx_)
+{
+    STACK_GROW(L_, 2);
+    STACK_CHECK_START_REL(L_, 0);
+    if (lua_type(L_, idx_) != LUA_TFUNCTION || lua_getupvalue(L_, idx_, 1) == nullptr) {
+        return false;
+    }                                                                                              // L_: ... desc
+    if (lua_istable(L_, -1)) {
+        std::ignore = lua_pushstringview(L_, "lane_new");                                          // L_: ... desc "lane_new"
+        lua_rawget(L_, -2);                                                                        // L_: ... desc lane_new
+        bool const _isLaneNew{ lua_tocfunction(L_, -1) == LG_lane_new };
+        lua_pop(L_, 1);                                                                            // L_: ... desc
+        if (_isLaneNew) {
+            STACK_CHECK(L_, 1);
+            return true;
+        }
+    }
+    lua_pop(L_, 1);                                                                                // L_: ...
+    STACK_CHECK(L_, 0);
+    return false;
+}
+
+// #################################################################################################
+
+// handles = lane_spawn_many( generator
+//                          , n
+//                          , [args_func|args_tbl])
+//
+// lanes.spawn_many(): launches n lanes of a generator at once, they start running only once they are all ready
+// the arguments of the i-th lane are returned by args_func(i), or found in args_tbl[i]: a table is the list of arguments, anything else is the single argument
+//
+// Upvalues: lane_new
+//
+LUAG_FUNC(lane_spawn_many)
+{
+    static constexpr int kGenIdx{ 1 };
+    static constexpr int kCountIdx{ 2 };
+    static constexpr int kArgsIdx{ 3 };
+    static constexpr int kDescIdx{ 4 };
+    static constexpr int kGenNbFixed{ static_cast<int>(kGenFixedArgs.size()) };
+
+    lua_settop(L_, kArgsIdx);                                                                      // L_: gen n args
+    // a generator is recognized by its descriptor, so that one transferred from another lane is also known
+    STACK_GROW(L_, kGenNbFixed + 6);
+    if (!PushGeneratorDescriptor(L_, kGenIdx)) {
+        raise_luaL_error(L_, "Not a lane generator: %s", luaL_typename(L_, kGenIdx));
+    }                                                                                              // L_: gen n args desc
+    lua_Integer const _count{ luaL_checkinteger(L_, kCountIdx) };
+    if (_count < 0 || _count > std::numeric_limits<int>::max()) {
+        raise_luaL_error(L_, "invalid lane count");
+    }
+    LuaType const _args_type{ lua_type_as_enum(L_, kArgsIdx) };
+    if (_args_type != LuaType::FUNCTION && _args_type != LuaType::TABLE && _args_type != LuaType::NIL) {
+        raise_luaL_error(L_, "expected lane arguments as a function or a table, got %s", lua_typename(L_, _args_type));
+    }
+    std::ignore = luaG_getfield(L_, kDescIdx, "detached");                                         // L_: gen n args desc detached
+    if (lua_toboolean(L_, -1)) {
+        // spawn_many() releases the lanes it launched through their handles
+        raise_luaL_error(L_, "lanes.spawn_many() can't launch detached lanes");
+    }
+    lua_pop(L_, 1);                                                                                // L_: gen n args desc
+
+    STACK_CHECK_START_REL(L_, 0);
+    lua_createtable(L_, static_cast<int>(_count), 0);                                              // L_: gen n args desc handles
+    int const _handlesIdx{ lua_gettop(L_) };
+    lua_pushvalue(L_, lua_upvalueindex(1));                                                        // L_: gen n args desc handles lane_new
+    lua_pushcclosure(L_, SpawnManyLanes, 1);                                                       // L_: gen n args desc handles SpawnManyLanes
+    lua_pushvalue(L_, _handlesIdx);                                                                // L_: gen n args desc handles SpawnManyLanes handles
+    lua_pushvalue(L_, kCountIdx);                                                                  // L_: gen n args desc handles SpawnManyLanes handles n
+    lua_pushvalue(L_, kArgsIdx);                                                                   // L_: gen n args desc handles SpawnManyLanes handles n args
+    for (std::string_view const& _arg : kGenFixedArgs) {
+        std::ignore = lua_pushstringview(L_, _arg);                                                // L_: gen n args desc handles SpawnManyLanes handles n args fixed... "arg"
+        lua_rawget(L_, kDescIdx);                                                                  // L_: gen n args desc handles SpawnManyLanes handles n args fixed...
+    }
+    // the functions copied in all the lanes (body, arguments, globals) are dumped only once
+    // an args_func that calls spawn_many() again uses the dumps of the outer call
+    bool const _ownDumps{ std::invoke([L = L_]() {
+        kFuncDumpsRegKey.pushValue(L);                                                             // L: ... {dumps}|nil
+        bool const _none{ lua_isnil(L, -1) };
+        lua_pop(L, 1);                                                                             // L: ...
+        return _none;
+    }) };
+    if (_ownDumps) {
+        kFuncDumpsRegKey.setValue(L_, [](lua_State* L_) { lua_newtable(L_); });
+    }
+    // the lanes launched so far must be released even if we fail to launch the others
+    LuaError const _rc{ ToLuaError(lua_pcall(L_, 2 + kGenNbFixed + 1, 0, 0)) };                    // L_: gen n args desc handles [err]
+    if (_ownDumps) {
+        kFuncDumpsRegKey.setValue(L_, [](lua_State* L_) { lua_pushnil(L_); });
+    }
+
+    // now that they are all ready, let them run together
+    int const _nbLanes{ static_cast<int>(lua_rawlen(L_, _handlesIdx)) };
+    for (int _i{ 1 }; _i <= _nbLanes; ++_i) {
+        lua_rawgeti(L_, _handlesIdx, _i);                                                          // L_: gen n args desc handles [err] lane
+        Lane* const _lane{ ToLane(L_, -1) };
+        lua_pop(L_, 1);                                                                            // L_: gen n args desc handles [err]
+        if (_rc == LuaError::OK) {
+            _lane->release();
+        } else {
+            _lane->cancelLaunch();
+            // make sure they are done before their handles are collected, else they'd be kept as free-running lanes
+            std::ignore = _lane->waitForCompletion(std::chrono::time_point<std::chrono::steady_clock>::max());
+        }
+    }
+    if (_rc != LuaError::OK) {
+        raise_lua_error(L_);
+    }
+    STACK_CHECK(L_, 1);
+
+    // the lanes of a generator created with a group join it
+    std::ignore = lua_pushstringview(L_, "group");                                                 // L_: gen n args desc handles "group"
+    lua_rawget(L_, kDescIdx);                                                                      // L_: gen n args desc handles group|nil
+    if (!lua_isnil(L_, -1)) {
+        int const _groupIdx{ lua_gettop(L_) };
+        for (int _i{ 1 }; _i <= _nbLanes; ++_i) {
+            std::ignore = luaG_getfield(L_, _groupIdx, "add");                                     // L_: gen n args desc handles group add
+            lua_pushvalue(L_, _groupIdx);                                                          // L_: gen n args desc handles group add group
+            lua_rawgeti(L_, _handlesIdx, _i);                                                      // L_: gen n args desc handles group add group lane
+            lua_call(L_, 2, 0);                                                                    // L_: gen n args desc handles group
+        }
+    }
+    lua_settop(L_, _handlesIdx);                                                                   // L_: gen n args desc handles
     STACK_CHECK(L_, 1);
     return 1;
 }
@@ -614,21 +885,55 @@ LUAG_FUNC(wakeup_conv)
 // ######################################## Module linkage #########################################
 // #################################################################################################
 
+extern LUAG_FUNC(buffer);
+extern LUAG_FUNC(freeze);
+extern LUAG_FUNC(frozen_pairs);
+extern LUAG_FUNC(group);
 extern LUAG_FUNC(linda);
+#if LUAJIT_FLAVOR() != 0
+extern LUAG_FUNC(linda_ffi);
+extern LUAG_FUNC(register_ctype);
+#endif // LUAJIT_FLAVOR()
+extern LUAG_FUNC(reaper_stats);
+extern LUAG_FUNC(state_pool);
+extern LUAG_FUNC(state_pool_bind);
+extern LUAG_FUNC(state_template);
+extern LUAG_FUNC(thread_pool_stats);
+extern LUAG_FUNC(wait_all);
+extern LUAG_FUNC(wait_any);
+extern LUAG_FUNC(yield);
 
 namespace {
     namespace local {
         static struct luaL_Reg const sLanesFunctions[] = {
             { Universe::kFinally, Universe::InitializeFinalizer },
+            { "buffer", LG_buffer },
+            { "freeze", LG_freeze },
+            { "frozen_pairs", LG_frozen_pairs },
+            { "group", LG_group },
             { "linda", LG_linda },
+#if LUAJIT_FLAVOR() != 0
+            { "linda_ffi", LG_linda_ffi },
+#endif // LUAJIT_FLAVOR()
             { "nameof", LG_nameof },
             { "now_secs", LG_now_secs },
+            { "reaper_stats", LG_reaper_stats },
             { "register", LG_register },
+#if LUAJIT_FLAVOR() != 0
+            { "register_ctype", LG_register_ctype },
+#endif // LUAJIT_FLAVOR()
             { "set_singlethreaded", LG_set_singlethreaded },
             { "set_thread_priority", LG_set_thread_priority },
             { "set_thread_affinity", LG_set_thread_affinity },
             { "sleep", LG_sleep },
+            { "state_pool", LG_state_pool },
+            { "state_pool_bind", LG_state_pool_bind },
+            { "state_template", LG_state_template },
+            { "thread_pool_stats", LG_thread_pool_stats },
+            { "wait_all", LG_wait_all },
+            { "wait_any", LG_wait_any },
             { "wakeup_conv", LG_wakeup_conv },
+            { "yield", LG_yield },
             { nullptr, nullptr }
         };
     } // namespace local
@@ -699,6 +1004,9 @@ LUAG_FUNC(configure)
     // contains keys: { __gc, __index, cancel, join, get_debug_threadname }
     Lane::PushMetatable(L_);                                                                       // L_: settings M {lane_mt}
     lua_pushcclosure(L_, LG_lane_new, 1);                                                          // L_: settings M lane_new
+    lua_pushvalue(L_, -1);                                                                         // L_: settings M lane_new lane_new
+    lua_pushcclosure(L_, LG_lane_spawn_many, 1);                                                   // L_: settings M lane_new lane_spawn_many
+    lua_setfield(L_, -3, "lane_spawn_many");                                                       // L_: settings M lane_new
     lua_setfield(L_, -2, "lane_new");                                                              // L_: settings M
 
     // we can't register 'lanes.require' normally because we want to create an upvalued closure
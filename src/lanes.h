@@ -29,3 +29,20 @@ LANES_API [[nodiscard]] int luaopen_lanes_core(lua_State* L_);
 LANES_API void luaopen_lanes_embedded(lua_State* L_, lua_CFunction _luaopen_lanes);
 using luaopen_lanes_embedded_t = void (*)(lua_State* L_, lua_CFunction luaopen_lanes_);
 static_assert(std::is_same_v<decltype(&luaopen_lanes_embedded), luaopen_lanes_embedded_t>, "signature changed: check all uses of luaopen_lanes_embedded_t");
+
+// Linda entry points that don't go through the Lua C API of the calling state, so that LuaJIT can call them through the FFI from compiled traces (see lanes.linda_ffi())
+// linda_ is what linda:deep() returns, buffer_ what buffer:deep() returns: the caller must keep the corresponding Lua objects alive during the call
+// keys are strings, a negative timeout waits forever
+// while blocked, these calls only wake up on linda cancellation, not on cancellation of the calling lane
+#define LANES_LINDA_OK 0
+#define LANES_LINDA_TIMEOUT 1
+#define LANES_LINDA_CANCELLED 2
+#define LANES_LINDA_MISMATCH 3 // the next value is not of the requested type, and is left in the linda
+#define LANES_LINDA_TOO_SMALL 4 // the next string doesn't fit in the provided storage, and is left in the linda (*len_ is its length)
+#define LANES_LINDA_ERROR 5 // out of memory, keeper failure, or Lanes is shutting down
+LANES_API [[nodiscard]] int lanes_linda_send_number(void* linda_, char const* key_, double value_, double timeout_);
+LANES_API [[nodiscard]] int lanes_linda_send_string(void* linda_, char const* key_, char const* data_, size_t len_, double timeout_);
+LANES_API [[nodiscard]] int lanes_linda_send_buffer(void* linda_, char const* key_, void* buffer_, double timeout_);
+LANES_API [[nodiscard]] int lanes_linda_receive_number(void* linda_, char const* key_, double* value_, double timeout_);
+// also receives buffers, as a copy of their contents
+LANES_API [[nodiscard]] int lanes_linda_receive_string(void* linda_, char const* key_, char* data_, size_t capacity_, size_t* len_, double timeout_);
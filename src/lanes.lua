@@ -51,6 +51,7 @@ local lanes = {}
 --
 local assert = assert(assert)
 local error = assert(error)
+local getmetatable = assert(getmetatable)
 local pairs = assert(pairs)
 local string = assert(string, "'string' library not available")
 local string_gmatch = assert(string.gmatch)
@@ -96,14 +97,26 @@ local default_params =
     -- it looks also like LuaJIT allocator may not appreciate direct use of its allocator for other purposes than the VM operation
     internal_allocator = isLuaJIT and "libc" or "allocator",
     keepers_gc_threshold = -1,
+    -- string values this long and above are stored outside of the keeper states (0 to disable)
+    keepers_offload_threshold = 4096,
+    -- 0 means as many scheduler worker threads as the hardware can run concurrently
+    nb_scheduler_threads = 0,
     nb_user_keepers = 0,
     on_state_create = nil,
+    -- 0 means the states of the lanes that have ended are closed by whoever joins or collects them
+    reaper_queue_size = 0,
     shutdown_mode = "hard",
     shutdown_timeout = 0.25,
     strip_functions = true,
+    -- seconds an idle pooled thread waits for a lane to run before it exits
+    thread_pool_idle_timeout = 1,
+    -- 0 means each lane gets a thread of its own that exits with it
+    thread_pool_size = 0,
     track_lanes = false,
     verbose_errors = false,
     with_timers = false,
+    -- number of lanes.yield() a lane can do before it waits for its handle's iterator to read them
+    yield_capacity = 16,
 }
 
 -- #################################################################################################
@@ -116,8 +129,8 @@ end
 local param_checkers =
 {
     allocator = function(val_)
-        -- can be nil, "protected", or a function
-        return val_ and (type(val_) == "function" or val_ == "protected") or true
+        -- can be nil, "protected", "threadcache", or a function
+        return val_ and (type(val_) == "function" or val_ == "protected" or val_ == "threadcache") or true
     end,
     demote_full_userdata = boolean_param_checker,
     internal_allocator = function(val_)
@@ -128,6 +141,14 @@ local param_checkers =
         -- keepers_gc_threshold should be a number
         return type(val_) == "number"
     end,
+    keepers_offload_threshold = function(val_)
+        -- keepers_offload_threshold should be a number
+        return type(val_) == "number"
+    end,
+    nb_scheduler_threads = function(val_)
+        -- nb_scheduler_threads should be a number in [0,1024]
+        return type(val_) == "number" and val_ >= 0 and val_ <= 1024
+    end,
     nb_user_keepers = function(val_)
         -- nb_user_keepers should be a number in [0,100] (so that nobody tries to run OOM by specifying a huge amount)
         return type(val_) == "number" and val_ >= 0 and val_ <= 100
@@ -136,6 +157,10 @@ local param_checkers =
         -- on_state_create may be nil or a function
         return val_ and type(val_) == "function" or true
     end,
+    reaper_queue_size = function(val_)
+        -- reaper_queue_size should be a number in [0,65536]
+        return type(val_) == "number" and val_ >= 0 and val_ <= 65536
+    end,
     shutdown_mode = function(val_)
         local valid_hooks = { soft = true, hard = true, call = true, ret = true, line = true, count = true }
         -- shutdown_mode should be a known hook mask
@@ -146,9 +171,21 @@ local param_checkers =
         return type(val_) == "number" and val_ >= 0
     end,
     strip_functions = boolean_param_checker,
+    thread_pool_idle_timeout = function(val_)
+        -- thread_pool_idle_timeout should be a number >= 0
+        return type(val_) == "number" and val_ >= 0
+    end,
+    thread_pool_size = function(val_)
+        -- thread_pool_size should be a number in [0,1024]
+        return type(val_) == "number" and val_ >= 0 and val_ <= 1024
+    end,
     track_lanes = boolean_param_checker,
     verbose_errors = boolean_param_checker,
     with_timers = boolean_param_checker,
+    yield_capacity = function(val_)
+        -- yield_capacity should be a number in [1,1024]
+        return type(val_) == "number" and val_ >= 1 and val_ <= 1024
+    end,
 }
 
 -- #################################################################################################
@@ -224,6 +261,22 @@ local error_trace_levels = {
 
 local opt_validators =
 {
+    async = function(v_)
+        local tv = type(v_)
+        -- can't use the 'and/or' idiom with a boolean
+        if tv ~= "boolean" then
+            raise_option_error("async", tv, v_)
+        end
+        return v_
+    end,
+    detached = function(v_)
+        local tv = type(v_)
+        -- can't use the 'and/or' idiom with a boolean
+        if tv ~= "boolean" then
+            raise_option_error("detached", tv, v_)
+        end
+        return v_
+    end,
     gc_cb = function(v_)
         local tv = type(v_)
         return (tv == "function") and v_ or raise_option_error("gc_cb", tv, v_)
@@ -236,6 +289,10 @@ local opt_validators =
         local tv = type(v_)
         return (tv == "table") and v_ or raise_option_error("globals", tv, v_)
     end,
+    group = function(v_)
+        local tv = type(v_)
+        return (getmetatable(v_) == "LaneGroup") and v_ or raise_option_error("group", tv, v_)
+    end,
     name = function(v_)
         local tv = type(v_)
         return (tv == "string") and v_ or raise_option_error("name", tv, v_)
@@ -244,6 +301,10 @@ local opt_validators =
         local tv = type(v_)
         return (tv == "table") and v_ or raise_option_error("package", tv, v_)
     end,
+    pool = function(v_)
+        local tv = type(v_)
+        return (getmetatable(v_) == "StatePool") and v_ or raise_option_error("pool", tv, v_)
+    end,
     priority = function(v_)
         local tv = type(v_)
         return (tv == "number") and v_ or raise_option_error("priority", tv, v_)
@@ -251,6 +312,22 @@ local opt_validators =
     required = function(v_)
         local tv = type(v_)
         return (tv == "table") and v_ or raise_option_error("required", tv, v_)
+    end,
+    scheduled = function(v_)
+        local tv = type(v_)
+        -- can't use the 'and/or' idiom with a boolean
+        if tv ~= "boolean" then
+            raise_option_error("scheduled", tv, v_)
+        end
+        return v_
+    end,
+    template = function(v_)
+        local tv = type(v_)
+        -- can't use the 'and/or' idiom with a boolean
+        if tv ~= "boolean" then
+            raise_option_error("template", tv, v_)
+        end
+        return v_
     end
 }
 
@@ -291,6 +368,18 @@ local opt_validators =
 --
 --        .gc_cb:    function called when the lane handle is collected
 --
+--        .pool:     a lanes.state_pool() where the states of finished lanes are kept to run later lanes of this generator
+--
+--        .group:    a lanes.group() the lanes of this generator are added to when they are launched
+--
+--        .template: if true, the required modules are loaded once in a template state, and cloned from there in each lane
+--
+--        .scheduled: if true, the lanes run on the scheduler's worker threads instead of an OS thread of their own
+--
+--        .async:    if true, the lane prepares its own state (libraries, package, required modules, globals) instead of the caller
+--
+--        .detached: if true, the generator returns no handle: the lane's results are discarded and it cleans up after itself when it ends
+--
 --        ... (more options may be introduced later) ...
 --
 -- Calling with a function parameter ('lane_func') ends the string/table
@@ -362,11 +451,36 @@ local gen = function(...)
     end
 
     local core_lane_new = assert(core.lane_new)
-    local priority, globals, package, required, gc_cb, name, error_trace_level = opt.priority, opt.globals, opt.package or package, opt.required, opt.gc_cb, opt.name, error_trace_levels[opt.error_trace_level]
-    return function(...)
+    local priority, globals, package, required, gc_cb, name, error_trace_level, pool = opt.priority, opt.globals, opt.package or package, opt.required, opt.gc_cb, opt.name, error_trace_levels[opt.error_trace_level], opt.pool
+    -- the template is built by the first lane, and shared by all the others
+    local template = (opt.template and required) and core.state_template() or nil
+    local scheduled, async, detached, group = opt.scheduled, opt.async, opt.detached, opt.group
+    if detached and gc_cb then
+        error("A detached lane has no handle to collect, it can't have a gc_cb", 2)
+    end
+    if detached and group then
+        error("A detached lane has no handle to join, it can't be in a group", 2)
+    end
+    -- a pooled state keeps what the lanes of its generator were prepared with: it can't run the lanes of another one
+    if pool and not core.state_pool_bind(pool) then
+        error("This state pool already belongs to another generator", 2)
+    end
+    -- the descriptor of the generator: lane_new and the arguments it fixes, that lanes.spawn_many() reads by name
+    -- it is the only upvalue of the generator, so that it comes along when the generator is transferred to another lane
+    local desc = {
+        lane_new = core_lane_new, func = func, libs = libs, priority = priority, globals = globals, package = package, required = required, gc_cb = gc_cb, name = name,
+        error_trace_level = error_trace_level, pool = pool, template = template, scheduled = scheduled, async = async, detached = detached, group = group
+    }
+    local generator = group and function(...)
+        local d = desc
+        local h = d.lane_new(d.func, d.libs, d.priority, d.globals, d.package, d.required, d.gc_cb, d.name, d.error_trace_level, d.pool, d.template, d.scheduled, d.async, d.detached, nil, ...)
+        return d.group:add(h)
+    end or function(...)
+        local d = desc
         -- must pass functions args last else they will be truncated to the first one
-        return core_lane_new(func, libs, priority, globals, package, required, gc_cb, name, error_trace_level, ...)
+        return d.lane_new(d.func, d.libs, d.priority, d.globals, d.package, d.required, d.gc_cb, d.name, d.error_trace_level, d.pool, d.template, d.scheduled, d.async, d.detached, nil, ...)
     end
+    return generator
 end -- gen()
 
 -- #################################################################################################
@@ -780,18 +894,39 @@ local configure = function(settings_)
     end
 
     -- activate full interface
+    lanes.buffer = core.buffer
     lanes.cancel_error = core.cancel_error
     lanes.finally = core.finally
+    lanes.freeze = core.freeze
+    lanes.frozen_pairs = core.frozen_pairs
+    lanes.group = core.group
     lanes.linda = core.linda
+    lanes.linda_ffi = core.linda_ffi and function() -- core.linda_ffi only exists when built against LuaJIT
+        local ffi = require "ffi"
+        local api = {}
+        for name, entry in pairs(core.linda_ffi()) do
+            -- entry points are { address, ctype }, status codes are plain numbers
+            api[name] = (type(entry) == "table") and ffi.cast(entry[2], entry[1]) or entry
+        end
+        return api
+    end or function() error "linda FFI entry points require LuaJIT" end
     lanes.nameof = core.nameof
     lanes.now_secs = core.now_secs
     lanes.null = core.null
     lanes.register = core.register
+    lanes.reaper_stats = core.reaper_stats
+    lanes.register_ctype = core.register_ctype or function() error "cdata transfer requires LuaJIT" end -- core.register_ctype only exists when built against LuaJIT
     lanes.require = core.require
     lanes.set_singlethreaded = core.set_singlethreaded
     lanes.set_thread_affinity = core.set_thread_affinity
     lanes.set_thread_priority = core.set_thread_priority
     lanes.sleep = core.sleep
+    lanes.spawn_many = core.lane_spawn_many
+    lanes.state_pool = core.state_pool
+    lanes.thread_pool_stats = core.thread_pool_stats
+    lanes.wait_all = core.wait_all
+    lanes.wait_any = core.wait_any
+    lanes.yield = core.yield
     lanes.threads = core.threads or function() error "lane tracking is not available" end -- core.threads isn't registered if settings.track_lanes is false
 
     lanes.gen = gen
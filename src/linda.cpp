@@ -34,12 +34,18 @@ THE SOFTWARE.
 
 #include "lane.h"
 #include "lindafactory.h"
+#include "scheduler.h"
 #include "tools.h"
 
 #include <functional>
 
 // #################################################################################################
 
+// xxh64 of string "kLaneParked" generated at https://www.pelock.com/products/hash-calculator
+static constexpr UniqueKey kLaneParked{ 0xF44F196A95239D8Aull }; // returned by a linda operation that parked the calling lane
+
+// #################################################################################################
+
 static void check_key_types(lua_State* L_, int start_, int end_)
 {
     for (int _i{ start_ }; _i <= end_; ++_i) {
@@ -166,6 +172,17 @@ std::string_view Linda::getName() const
 
 // #################################################################################################
 
+#if HAVE_LANE_SCHEDULER()
+// a scheduled lane parked by a linda operation is resumed: the operation starts over with what remains of its timeout
+[[nodiscard]] static int ProtectedCallK(lua_State* const L_, [[maybe_unused]] int const status_, lua_KContext const ctx_)
+{
+    Scheduler::AdjustTimeout(L_, 2);
+    return Linda::ProtectedCall(L_, reinterpret_cast<lua_CFunction>(ctx_));
+}
+#endif // HAVE_LANE_SCHEDULER()
+
+// #################################################################################################
+
 // used to perform all linda operations that access keepers
 int Linda::ProtectedCall(lua_State* L_, lua_CFunction f_)
 {
@@ -179,11 +196,24 @@ int Linda::ProtectedCall(lua_State* L_, lua_CFunction f_)
     // if we didn't do anything wrong, the keeper stack should be clean
     LUA_ASSERT(L_, lua_gettop(_KL) == 0);
 
+    // a scheduled lane parks instead of waiting: keep the arguments to perform the operation again when it is resumed
+    bool const _mayPark{ Scheduler::ParkableLane(L_) != nullptr };
+    int const _nargs{ lua_gettop(L_) };
     // push the function to be called and move it before the arguments
-    lua_pushcfunction(L_, f_);
-    lua_insert(L_, 1);
+    if (_mayPark) {
+        STACK_GROW(L_, _nargs + 2);
+        // the upvalue tells the operation that it can park
+        lua_pushboolean(L_, 1);                                                                    // L_: args... true
+        lua_pushcclosure(L_, f_, 1);                                                               // L_: args... f_
+        for (int _i{ 1 }; _i <= _nargs; ++_i) {
+            lua_pushvalue(L_, _i);                                                                 // L_: args... f_ args...
+        }
+    } else {
+        lua_pushcfunction(L_, f_);
+        lua_insert(L_, 1);
+    }
     // do a protected call
-    LuaError const _rc{ lua_pcall(L_, lua_gettop(L_) - 1, LUA_MULTRET, 0) };
+    LuaError const _rc{ lua_pcall(L_, _nargs, LUA_MULTRET, 0) };
     // whatever happens, the keeper state stack must be empty when we are done
     lua_settop(_KL, 0);
 
@@ -194,8 +224,14 @@ int Linda::ProtectedCall(lua_State* L_, lua_CFunction f_)
     if (_rc != LuaError::OK) {
         raise_lua_error(L_);
     }
+#if HAVE_LANE_SCHEDULER()
+    if (_mayPark && lua_gettop(L_) == _nargs + 1 && kLaneParked.equals(L_, -1)) {
+        lua_settop(L_, _nargs);                                                                    // L_: args...
+        return lua_yieldk(L_, 0, reinterpret_cast<lua_KContext>(f_), ProtectedCallK);
+    }
+#endif // HAVE_LANE_SCHEDULER()
     // return whatever the actual operation provided
-    return lua_gettop(L_);
+    return lua_gettop(L_) - (_mayPark ? _nargs : 0);
 }
 
 // #################################################################################################
@@ -253,14 +289,14 @@ LUAG_FUNC(linda_cancel)
 
     _linda->cancelRequest = CancelRequest::Soft;
     if (_who == "both") { // tell everyone writers to wake up
-        _linda->writeHappened.notify_all();
-        _linda->readHappened.notify_all();
+        Scheduler::NotifyAll(_linda->U, _linda->writeHappened);
+        Scheduler::NotifyAll(_linda->U, _linda->readHappened);
     } else if (_who == "none") { // reset flag
         _linda->cancelRequest = CancelRequest::None;
     } else if (_who == "read") { // tell blocked readers to wake up
-        _linda->writeHappened.notify_all();
+        Scheduler::NotifyAll(_linda->U, _linda->writeHappened);
     } else if (_who == "write") { // tell blocked writers to wake up
-        _linda->readHappened.notify_all();
+        Scheduler::NotifyAll(_linda->U, _linda->readHappened);
     } else {
         raise_luaL_error(L_, "unknown wake hint '%s'", _who);
     }
@@ -413,7 +449,7 @@ LUAG_FUNC(linda_limit)
             LUA_ASSERT(L_, _pushed.has_value() && (_pushed.value() == 0 || _pushed.value() == 1)); // no error, optional boolean value saying if we should wake blocked writer threads
             if (_pushed.value() == 1) {
                 LUA_ASSERT(L_, lua_type(L_, -1) == LUA_TBOOLEAN && lua_toboolean(L_, -1) == 1);
-                _linda->readHappened.notify_all(); // To be done from within the 'K' locking area
+                Scheduler::NotifyAll(_linda->U, _linda->readHappened); // To be done from within the 'K' locking area
             }
         } else { // linda is cancelled
             // do nothing and return lanes.cancel_error
@@ -428,6 +464,175 @@ LUAG_FUNC(linda_limit)
 
 // #################################################################################################
 
+// INTO: receive_into() instead of receive()
+template <bool INTO>
+[[nodiscard]] static int LindaReceive(lua_State* const L_)
+{
+    Linda* const _linda{ ToLinda<false>(L_, 1) };
+    int _key_i{ 2 }; // index of first key, if timeout not there
+
+    std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
+    if (lua_type(L_, 2) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
+        lua_Duration const _duration{ lua_tonumber(L_, 2) };
+        if (_duration.count() >= 0.0) {
+            _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(_duration);
+        } else {
+            raise_luaL_argerror(L_, 2, "duration cannot be < 0");
+        }
+        ++_key_i;
+    } else if (lua_isnil(L_, 2)) { // alternate explicit "infinite timeout" by passing nil before the key
+        ++_key_i;
+    }
+
+    keeper_api_t _selected_keeper_receive{ nullptr };
+    int _expected_pushed_min{ 0 }, _expected_pushed_max{ 0 };
+    // are we in batched mode?
+    kLindaBatched.pushKey(L_);
+    int const _is_batched{ lua501_equal(L_, _key_i, -1) };
+    lua_pop(L_, 1);
+    if constexpr (INTO) {
+        // make sure the key is of a valid type
+        check_key_types(L_, _key_i, _key_i);
+        luaL_checktype(L_, _key_i + 1, LUA_TTABLE);
+        luaL_argcheck(L_, luaL_checkinteger(L_, _key_i + 2) > 0, _key_i + 2, "max count must be > 0");
+        lua_settop(L_, _key_i + 2);
+        // we expect the number of values stored in the table
+        _expected_pushed_min = _expected_pushed_max = 1;
+    } else if (_is_batched) {
+        // no need to pass linda.batched in the keeper state
+        ++_key_i;
+        // make sure the keys are of a valid type
+        check_key_types(L_, _key_i, _key_i);
+        // receive multiple values from a single slot
+        _selected_keeper_receive = KEEPER_API(receive_batched);
+        // we expect a user-defined amount of return value
+        _expected_pushed_min = (int) luaL_checkinteger(L_, _key_i + 1);
+        _expected_pushed_max = (int) luaL_optinteger(L_, _key_i + 2, _expected_pushed_min);
+        // don't forget to count the key in addition to the values
+        ++_expected_pushed_min;
+        ++_expected_pushed_max;
+        if (_expected_pushed_min > _expected_pushed_max) {
+            raise_luaL_error(L_, "batched min/max error");
+        }
+    } else {
+        // make sure the keys are of a valid type
+        check_key_types(L_, _key_i, lua_gettop(L_));
+        // receive a single value, checking multiple slots
+        _selected_keeper_receive = KEEPER_API(receive);
+        // we expect a single (value, key) pair of returned values
+        _expected_pushed_min = _expected_pushed_max = 2;
+    }
+
+    Lane* const _lane{ kLanePointerRegKey.readLightUserDataValue<Lane>(L_) };
+    Keeper* const _K{ _linda->whichKeeper() };
+    KeeperState const _KL{ _K ? _K->L : nullptr };
+    if (_KL == nullptr)
+        return 0;
+
+    CancelRequest _cancel{ CancelRequest::None };
+    KeeperCallResult _pushed;
+    STACK_CHECK_START_REL(_KL, 0);
+    for (bool _try_again{ true };;) {
+        if (_lane != nullptr) {
+            _cancel = _lane->cancelRequest;
+        }
+        _cancel = (_cancel != CancelRequest::None) ? _cancel : _linda->cancelRequest;
+        // if user wants to cancel, or looped because of a timeout, the call returns without sending anything
+        if (!_try_again || _cancel != CancelRequest::None) {
+            _pushed.emplace(0);
+            break;
+        }
+
+        if constexpr (INTO) {
+            _pushed = keeper_receive_into(_KL, L_, _linda, _key_i);
+        } else {
+            // a single key can be served straight from its slab
+            bool const _single_key{ _selected_keeper_receive == KEEPER_API(receive) && lua_gettop(L_) == _key_i };
+            _pushed = _single_key ? keeper_receive_scalar(_KL, L_, _linda, _key_i) : KeeperCallResult{};
+            if (!_pushed.has_value()) {
+                // all arguments of receive() but the first are passed to the keeper's receive function
+                _pushed = keeper_call(_KL, _selected_keeper_receive, L_, _linda, _key_i);
+            }
+        }
+        if (!_pushed.has_value()) {
+            break;
+        }
+        if (_pushed.value() > 0) {
+            LUA_ASSERT(L_, _pushed.value() >= _expected_pushed_min && _pushed.value() <= _expected_pushed_max);
+            Scheduler::NotifyAll(_linda->U, _linda->readHappened);
+            break;
+        }
+
+        if (std::chrono::steady_clock::now() >= _until) {
+            break; /* instant timeout */
+        }
+
+        // nothing received, wait until timeout or signalled that we should try again
+        {
+            Lane::Status _prev_status{ Lane::Status::Error }; // prevent 'might be used uninitialized' warnings
+            if (_lane != nullptr) {
+                // change status of lane to "waiting"
+                _prev_status = _lane->status; // Running, most likely
+                LUA_ASSERT(L_, _prev_status == Lane::Status::Running); // but check, just in case
+                _lane->status = Lane::Status::Waiting;
+                LUA_ASSERT(L_, _lane->waiting_on == nullptr);
+                _lane->waiting_on = &_linda->writeHappened;
+            }
+#if HAVE_LANE_SCHEDULER()
+            // a scheduled lane gives its worker back, ProtectedCall() yields and we'll try again when resumed
+            if (lua_toboolean(L_, lua_upvalueindex(1))) {
+                Scheduler::Park(_lane, _linda->writeHappened, _until);
+                kLaneParked.pushKey(L_);
+                return 1;
+            }
+#endif // HAVE_LANE_SCHEDULER()
+            // not enough data to read: wakeup when data was sent, or when timeout is reached
+            std::unique_lock<std::mutex> _keeper_lock{ _K->mutex, std::adopt_lock };
+            std::cv_status const _status{ _linda->writeHappened.wait_until(_keeper_lock, _until) };
+            _keeper_lock.release();                              // we don't want to release the lock!
+            _try_again = (_status == std::cv_status::no_timeout); // detect spurious wakeups
+            if (_lane != nullptr) {
+                _lane->waiting_on = nullptr;
+                _lane->status = _prev_status;
+            }
+        }
+    }
+    STACK_CHECK(_KL, 0);
+
+    if (!_pushed.has_value()) {
+        raise_luaL_error(L_, "tried to copy unsupported types");
+    }
+
+    switch (_cancel) {
+    case CancelRequest::None:
+        {
+            int const _nbPushed{ _pushed.value() };
+            if (_nbPushed == 0) {
+                // not enough data in the linda slot to fulfill the request, return nil, "timeout"
+                lua_pushnil(L_);
+                std::ignore = lua_pushstringview(L_, "timeout");
+                return 2;
+            }
+            return _nbPushed;
+        }
+
+    case CancelRequest::Soft:
+        // if user wants to soft-cancel, the call returns nil, kCancelError
+        lua_pushnil(L_);
+        kCancelError.pushKey(L_);
+        return 2;
+
+    case CancelRequest::Hard:
+        // raise an error interrupting execution only in case of hard cancel
+        raise_cancel_error(L_); // raises an error and doesn't return
+
+    default:
+        raise_luaL_error(L_, "internal error: unknown cancel request");
+    }
+}
+
+// #################################################################################################
+
 /*
  * 2 modes of operation
  * [val, key]= linda_receive( linda_ud, [timeout_secs_num=nil], key_num|str|bool|lightuserdata [, ...] )
@@ -441,62 +646,70 @@ LUAG_FUNC(linda_limit)
  */
 LUAG_FUNC(linda_receive)
 {
-    auto _receive = [](lua_State* L_) {
-        Linda* const _linda{ ToLinda<false>(L_, 1) };
-        int _key_i{ 2 }; // index of first key, if timeout not there
+    return Linda::ProtectedCall(L_, LindaReceive<false>);
+}
 
-        std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
-        if (lua_type(L_, 2) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
-            lua_Duration const _duration{ lua_tonumber(L_, 2) };
-            if (_duration.count() >= 0.0) {
-                _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(_duration);
-            } else {
-                raise_luaL_argerror(L_, 2, "duration cannot be < 0");
-            }
-            ++_key_i;
-        } else if (lua_isnil(L_, 2)) { // alternate explicit "infinite timeout" by passing nil before the key
-            ++_key_i;
-        }
+// #################################################################################################
 
-        keeper_api_t _selected_keeper_receive{ nullptr };
-        int _expected_pushed_min{ 0 }, _expected_pushed_max{ 0 };
-        // are we in batched mode?
-        kLindaBatched.pushKey(L_);
-        int const _is_batched{ lua501_equal(L_, _key_i, -1) };
-        lua_pop(L_, 1);
-        if (_is_batched) {
-            // no need to pass linda.batched in the keeper state
-            ++_key_i;
-            // make sure the keys are of a valid type
-            check_key_types(L_, _key_i, _key_i);
-            // receive multiple values from a single slot
-            _selected_keeper_receive = KEEPER_API(receive_batched);
-            // we expect a user-defined amount of return value
-            _expected_pushed_min = (int) luaL_checkinteger(L_, _key_i + 1);
-            _expected_pushed_max = (int) luaL_optinteger(L_, _key_i + 2, _expected_pushed_min);
-            // don't forget to count the key in addition to the values
-            ++_expected_pushed_min;
-            ++_expected_pushed_max;
-            if (_expected_pushed_min > _expected_pushed_max) {
-                raise_luaL_error(L_, "batched min/max error");
-            }
+/*
+ * count = linda:receive_into([timeout_secs_num=nil,] key_num|str|bool|lightuserdata, tbl, max_COUNT)
+ * Consumes between 1 and max_COUNT values from a single key, stored in tbl[1..count] without going through the stack.
+ * Entries of tbl beyond count are left untouched.
+ * Returns: the number of consumed values, or nil, "timeout" if there was nothing to consume
+ */
+LUAG_FUNC(linda_receive_into)
+{
+    return Linda::ProtectedCall(L_, LindaReceive<true>);
+}
+
+// #################################################################################################
+
+// ARRAY: send_array() instead of send()
+template <bool ARRAY>
+[[nodiscard]] static int LindaSend(lua_State* const L_)
+{
+    Linda* const _linda{ ToLinda<false>(L_, 1) };
+    int _key_i{ 2 }; // index of first key, if timeout not there
+
+    std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
+    if (lua_type(L_, 2) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
+        lua_Duration const _duration{ lua_tonumber(L_, 2) };
+        if (_duration.count() >= 0.0) {
+            _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(_duration);
         } else {
-            // make sure the keys are of a valid type
-            check_key_types(L_, _key_i, lua_gettop(L_));
-            // receive a single value, checking multiple slots
-            _selected_keeper_receive = KEEPER_API(receive);
-            // we expect a single (value, key) pair of returned values
-            _expected_pushed_min = _expected_pushed_max = 2;
+            raise_luaL_argerror(L_, 2, "duration cannot be < 0");
         }
+        ++_key_i;
+    } else if (lua_isnil(L_, 2)) { // alternate explicit "infinite timeout" by passing nil before the key
+        ++_key_i;
+    }
+
+    // make sure the key is of a valid type
+    check_key_types(L_, _key_i, _key_i);
+
+    STACK_GROW(L_, 1);
 
+    if constexpr (ARRAY) {
+        // the values to send are the elements of the array
+        luaL_checktype(L_, _key_i + 1, LUA_TTABLE);
+        lua_settop(L_, _key_i + 1);
+    } else {
+        // make sure there is something to send
+        if (lua_gettop(L_) == _key_i) {
+            raise_luaL_error(L_, "no data to send");
+        }
+    }
+
+    bool _ret{ false };
+    CancelRequest _cancel{ CancelRequest::None };
+    KeeperCallResult _pushed;
+    {
         Lane* const _lane{ kLanePointerRegKey.readLightUserDataValue<Lane>(L_) };
         Keeper* const _K{ _linda->whichKeeper() };
         KeeperState const _KL{ _K ? _K->L : nullptr };
         if (_KL == nullptr)
             return 0;
 
-        CancelRequest _cancel{ CancelRequest::None };
-        KeeperCallResult _pushed;
         STACK_CHECK_START_REL(_KL, 0);
         for (bool _try_again{ true };;) {
             if (_lane != nullptr) {
@@ -509,37 +722,58 @@ LUAG_FUNC(linda_receive)
                 break;
             }
 
-            // all arguments of receive() but the first are passed to the keeper's receive function
-            _pushed = keeper_call(_KL, _selected_keeper_receive, L_, _linda, _key_i);
+            STACK_CHECK(_KL, 0);
+            if constexpr (ARRAY) {
+                _pushed = keeper_send_array(_KL, L_, _linda, _key_i);
+            } else {
+                _pushed = keeper_send_scalars(_KL, L_, _linda, _key_i);
+                if (!_pushed.has_value()) {
+                    _pushed = keeper_call(_KL, KEEPER_API(send), L_, _linda, _key_i);
+                }
+            }
             if (!_pushed.has_value()) {
                 break;
             }
-            if (_pushed.value() > 0) {
-                LUA_ASSERT(L_, _pushed.value() >= _expected_pushed_min && _pushed.value() <= _expected_pushed_max);
-                _linda->readHappened.notify_all();
+            LUA_ASSERT(L_, _pushed.value() == 1);
+
+            _ret = lua_toboolean(L_, -1) ? true : false;
+            lua_pop(L_, 1);
+
+            if (_ret) {
+                // Wake up ALL waiting threads
+                Scheduler::NotifyAll(_linda->U, _linda->writeHappened);
                 break;
             }
 
+            // instant timout to bypass the wait syscall
             if (std::chrono::steady_clock::now() >= _until) {
-                break; /* instant timeout */
+                break; /* no wait; instant timeout */
             }
 
-            // nothing received, wait until timeout or signalled that we should try again
+            // storage limit hit, wait until timeout or signalled that we should try again
             {
-                Lane::Status _prev_status{ Lane::Error }; // prevent 'might be used uninitialized' warnings
+                Lane::Status _prev_status{ Lane::Status::Error }; // prevent 'might be used uninitialized' warnings
                 if (_lane != nullptr) {
                     // change status of lane to "waiting"
                     _prev_status = _lane->status; // Running, most likely
-                    LUA_ASSERT(L_, _prev_status == Lane::Running); // but check, just in case
-                    _lane->status = Lane::Waiting;
+                    LUA_ASSERT(L_, _prev_status == Lane::Status::Running); // but check, just in case
+                    _lane->status = Lane::Status::Waiting;
                     LUA_ASSERT(L_, _lane->waiting_on == nullptr);
-                    _lane->waiting_on = &_linda->writeHappened;
+                    _lane->waiting_on = &_linda->readHappened;
+                }
+#if HAVE_LANE_SCHEDULER()
+                // a scheduled lane gives its worker back, ProtectedCall() yields and we'll try again when resumed
+                if (lua_toboolean(L_, lua_upvalueindex(1))) {
+                    Scheduler::Park(_lane, _linda->readHappened, _until);
+                    kLaneParked.pushKey(L_);
+                    return 1;
                 }
-                // not enough data to read: wakeup when data was sent, or when timeout is reached
+#endif // HAVE_LANE_SCHEDULER()
+                // could not send because no room: wait until some data was read before trying again, or until timeout is reached
                 std::unique_lock<std::mutex> _keeper_lock{ _K->mutex, std::adopt_lock };
-                std::cv_status const _status{ _linda->writeHappened.wait_until(_keeper_lock, _until) };
-                _keeper_lock.release();                              // we don't want to release the lock!
-                _try_again = (_status == std::cv_status::no_timeout); // detect spurious wakeups
+                std::cv_status const status{ _linda->readHappened.wait_until(_keeper_lock, _until) };
+                _keeper_lock.release(); // we don't want to release the lock!
+                _try_again = (status == std::cv_status::no_timeout); // detect spurious wakeups
                 if (_lane != nullptr) {
                     _lane->waiting_on = nullptr;
                     _lane->status = _prev_status;
@@ -547,39 +781,26 @@ LUAG_FUNC(linda_receive)
             }
         }
         STACK_CHECK(_KL, 0);
+    }
 
-        if (!_pushed.has_value()) {
-            raise_luaL_error(L_, "tried to copy unsupported types");
-        }
-
-        switch (_cancel) {
-        case CancelRequest::None:
-            {
-                int const _nbPushed{ _pushed.value() };
-                if (_nbPushed == 0) {
-                    // not enough data in the linda slot to fulfill the request, return nil, "timeout"
-                    lua_pushnil(L_);
-                    std::ignore = lua_pushstringview(L_, "timeout");
-                    return 2;
-                }
-                return _nbPushed;
-            }
+    if (!_pushed.has_value()) {
+        raise_luaL_error(L_, "tried to copy unsupported types");
+    }
 
-        case CancelRequest::Soft:
-            // if user wants to soft-cancel, the call returns nil, kCancelError
-            lua_pushnil(L_);
-            kCancelError.pushKey(L_);
-            return 2;
+    switch (_cancel) {
+    case CancelRequest::Soft:
+        // if user wants to soft-cancel, the call returns lanes.cancel_error
+        kCancelError.pushKey(L_);
+        return 1;
 
-        case CancelRequest::Hard:
-            // raise an error interrupting execution only in case of hard cancel
-            raise_cancel_error(L_); // raises an error and doesn't return
+    case CancelRequest::Hard:
+        // raise an error interrupting execution only in case of hard cancel
+        raise_cancel_error(L_); // raises an error and doesn't return
 
-        default:
-            raise_luaL_error(L_, "internal error: unknown cancel request");
-        }
-    };
-    return Linda::ProtectedCall(L_, _receive);
+    default:
+        lua_pushboolean(L_, _ret); // true (success) or false (timeout)
+        return 1;
+    }
 }
 
 // #################################################################################################
@@ -595,121 +816,21 @@ LUAG_FUNC(linda_receive)
  */
 LUAG_FUNC(linda_send)
 {
-    auto _send = [](lua_State* L_) {
-        Linda* const _linda{ ToLinda<false>(L_, 1) };
-        int _key_i{ 2 }; // index of first key, if timeout not there
-
-        std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
-        if (lua_type(L_, 2) == LUA_TNUMBER) { // we don't want to use lua_isnumber() because of autocoercion
-            lua_Duration const _duration{ lua_tonumber(L_, 2) };
-            if (_duration.count() >= 0.0) {
-                _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(_duration);
-            } else {
-                raise_luaL_argerror(L_, 2, "duration cannot be < 0");
-            }
-            ++_key_i;
-        } else if (lua_isnil(L_, 2)) { // alternate explicit "infinite timeout" by passing nil before the key
-            ++_key_i;
-        }
-
-        // make sure the key is of a valid type
-        check_key_types(L_, _key_i, _key_i);
-
-        STACK_GROW(L_, 1);
-
-        // make sure there is something to send
-        if (lua_gettop(L_) == _key_i) {
-            raise_luaL_error(L_, "no data to send");
-        }
-
-        bool _ret{ false };
-        CancelRequest _cancel{ CancelRequest::None };
-        KeeperCallResult _pushed;
-        {
-            Lane* const _lane{ kLanePointerRegKey.readLightUserDataValue<Lane>(L_) };
-            Keeper* const _K{ _linda->whichKeeper() };
-            KeeperState const _KL{ _K ? _K->L : nullptr };
-            if (_KL == nullptr)
-                return 0;
-
-            STACK_CHECK_START_REL(_KL, 0);
-            for (bool _try_again{ true };;) {
-                if (_lane != nullptr) {
-                    _cancel = _lane->cancelRequest;
-                }
-                _cancel = (_cancel != CancelRequest::None) ? _cancel : _linda->cancelRequest;
-                // if user wants to cancel, or looped because of a timeout, the call returns without sending anything
-                if (!_try_again || _cancel != CancelRequest::None) {
-                    _pushed.emplace(0);
-                    break;
-                }
-
-                STACK_CHECK(_KL, 0);
-                _pushed = keeper_call(_KL, KEEPER_API(send), L_, _linda, _key_i);
-                if (!_pushed.has_value()) {
-                    break;
-                }
-                LUA_ASSERT(L_, _pushed.value() == 1);
-
-                _ret = lua_toboolean(L_, -1) ? true : false;
-                lua_pop(L_, 1);
-
-                if (_ret) {
-                    // Wake up ALL waiting threads
-                    _linda->writeHappened.notify_all();
-                    break;
-                }
-
-                // instant timout to bypass the wait syscall
-                if (std::chrono::steady_clock::now() >= _until) {
-                    break; /* no wait; instant timeout */
-                }
-
-                // storage limit hit, wait until timeout or signalled that we should try again
-                {
-                    Lane::Status _prev_status{ Lane::Error }; // prevent 'might be used uninitialized' warnings
-                    if (_lane != nullptr) {
-                        // change status of lane to "waiting"
-                        _prev_status = _lane->status; // Running, most likely
-                        LUA_ASSERT(L_, _prev_status == Lane::Running); // but check, just in case
-                        _lane->status = Lane::Waiting;
-                        LUA_ASSERT(L_, _lane->waiting_on == nullptr);
-                        _lane->waiting_on = &_linda->readHappened;
-                    }
-                    // could not send because no room: wait until some data was read before trying again, or until timeout is reached
-                    std::unique_lock<std::mutex> _keeper_lock{ _K->mutex, std::adopt_lock };
-                    std::cv_status const status{ _linda->readHappened.wait_until(_keeper_lock, _until) };
-                    _keeper_lock.release(); // we don't want to release the lock!
-                    _try_again = (status == std::cv_status::no_timeout); // detect spurious wakeups
-                    if (_lane != nullptr) {
-                        _lane->waiting_on = nullptr;
-                        _lane->status = _prev_status;
-                    }
-                }
-            }
-            STACK_CHECK(_KL, 0);
-        }
-
-        if (!_pushed.has_value()) {
-            raise_luaL_error(L_, "tried to copy unsupported types");
-        }
-
-        switch (_cancel) {
-        case CancelRequest::Soft:
-            // if user wants to soft-cancel, the call returns lanes.cancel_error
-            kCancelError.pushKey(L_);
-            return 1;
+    return Linda::ProtectedCall(L_, LindaSend<false>);
+}
 
-        case CancelRequest::Hard:
-            // raise an error interrupting execution only in case of hard cancel
-            raise_cancel_error(L_); // raises an error and doesn't return
+// #################################################################################################
 
-        default:
-            lua_pushboolean(L_, _ret); // true (success) or false (timeout)
-            return 1;
-        }
-    };
-    return Linda::ProtectedCall(L_, _send);
+/*
+ * bool= linda:send_array([timeout_secs=nil,] key_num|str|bool|lightuserdata, tbl)
+ *
+ * Send the elements tbl[1..#tbl] to a Linda as separate values, without unpacking them on the stack. If there is a limit, all values must fit.
+ *
+ * Returns: same as linda:send()
+ */
+LUAG_FUNC(linda_send_array)
+{
+    return Linda::ProtectedCall(L_, LindaSend<true>);
 }
 
 // #################################################################################################
@@ -738,12 +859,12 @@ LUAG_FUNC(linda_set)
 
                 if (_has_value) {
                     // we put some data in the slot, tell readers that they should wake
-                    _linda->writeHappened.notify_all(); // To be done from within the 'K' locking area
+                    Scheduler::NotifyAll(_linda->U, _linda->writeHappened); // To be done from within the 'K' locking area
                 }
                 if (_pushed.value() == 1) {
                     // the key was full, but it is no longer the case, tell writers they should wake
                     LUA_ASSERT(L_, lua_type(L_, -1) == LUA_TBOOLEAN && lua_toboolean(L_, -1) == 1);
-                    _linda->readHappened.notify_all(); // To be done from within the 'K' locking area
+                    Scheduler::NotifyAll(_linda->U, _linda->readHappened); // To be done from within the 'K' locking area
                 }
             }
         } else { // linda is cancelled
@@ -802,7 +923,9 @@ namespace {
             { "get", LG_linda_get },
             { "limit", LG_linda_limit },
             { "receive", LG_linda_receive },
+            { "receive_into", LG_linda_receive_into },
             { "send", LG_linda_send },
+            { "send_array", LG_linda_send_array },
             { "set", LG_linda_set },
             { nullptr, nullptr }
         };
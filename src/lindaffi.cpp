@@ -0,0 +1,319 @@
+/*
+ * LINDAFFI.CPP                 Copyright (c) 2024-, Benoit Germain
+ *
+ * Linda entry points callable without going through the Lua C API of the caller
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "lanes.h"
+
+#include "buffer.h"
+#include "keeper.h"
+#include "linda.h"
+#include "scheduler.h"
+#include "tools.h"
+
+#include <cstring>
+#include <limits>
+
+// #################################################################################################
+// #################################################################################################
+namespace {
+    namespace local {
+
+        // everything an attempt at an operation needs inside the keeper, so that it can run protected
+        template <typename PUSH>
+        struct Attempt
+        {
+            Linda* const linda;
+            char const* const key;
+            keeper_api_t const op;
+            PUSH const& push;
+        };
+
+        // #########################################################################################
+
+        // in: Attempt*
+        // out: whatever the keeper operation returns
+        template <typename ATTEMPT>
+        [[nodiscard]] static int RunAttempt(lua_State* const L_)
+        {
+            KeeperState const _K{ L_ };
+            ATTEMPT const& _attempt{ *lua_tolightuserdata<ATTEMPT>(_K, 1) };
+            lua_settop(_K, 0);                                                                     // _K:
+            STACK_GROW(_K, 4);
+            lua_pushlightuserdata(_K, _attempt.linda);                                             // _K: linda
+            lua_pushstring(_K, _attempt.key);                                                      // _K: linda key
+            _attempt.push(_K);                                                                     // _K: linda key args...
+            return _attempt.op(_K);
+        }
+
+        // #########################################################################################
+
+        // calls op_ in the keeper of the linda until accept_ is satisfied with its results, the timeout expires, or the linda is cancelled
+        // this is the same loop as linda:send() and linda:receive(), minus everything that needs the Lua state of the caller
+        // push_ pushes the arguments of op_ after the linda and the key
+        // accept_ returns a LANES_LINDA_XXX status from the results of op_, or std::nullopt to wait and try again
+        template <typename PUSH, typename ACCEPT>
+        [[nodiscard]] static int Run(void* const linda_, char const* const key_, double const timeout_, keeper_api_t const op_, bool const isSend_, PUSH const& push_, ACCEPT const& accept_)
+        {
+            Linda* const _linda{ static_cast<Linda*>(linda_) };
+            if (_linda == nullptr || key_ == nullptr) {
+                return LANES_LINDA_ERROR;
+            }
+            std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::time_point<std::chrono::steady_clock>::max() };
+            if (timeout_ >= 0.0) {
+                _until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(lua_Duration{ timeout_ });
+            }
+
+            Keeper* const _K{ _linda->acquireKeeper() };
+            KeeperState const _KL{ _K ? _K->L : nullptr };
+            if (_KL == nullptr) {
+                return LANES_LINDA_ERROR;
+            }
+            Attempt<PUSH> _attempt{ _linda, key_, op_, push_ };
+            int _status{ LANES_LINDA_TIMEOUT };
+            for (bool _try_again{ true };;) {
+                if (_linda->cancelRequest != CancelRequest::None) {
+                    _status = LANES_LINDA_CANCELLED;
+                    break;
+                }
+                if (!_try_again) {
+                    break;
+                }
+
+                STACK_GROW(_KL, 2);
+                lua_pushcfunction(_KL, RunAttempt<Attempt<PUSH>>);                                 // _K: RunAttempt
+                lua_pushlightuserdata(_KL, &_attempt);                                             // _K: RunAttempt attempt
+                if (ToLuaError(lua_pcall(_KL, 1, LUA_MULTRET, 0)) != LuaError::OK) {               // _K: results...|err
+                    lua_settop(_KL, 0);                                                            // _K:
+                    _status = LANES_LINDA_ERROR;
+                    break;
+                }
+                std::optional<int> const _accepted{ accept_(_KL) };
+                lua_settop(_KL, 0);                                                                // _K:
+                if (_accepted.has_value()) {
+                    _status = _accepted.value();
+                    if (_status == LANES_LINDA_OK) {
+                        // Wake up ALL waiting threads
+                        Scheduler::NotifyAll(_linda->U, isSend_ ? _linda->writeHappened : _linda->readHappened);
+                    }
+                    break;
+                }
+
+                // instant timout to bypass the wait syscall
+                if (std::chrono::steady_clock::now() >= _until) {
+                    break;
+                }
+
+                // a sender waits until some data is read, a receiver until some data is written
+                std::unique_lock<std::mutex> _keeper_lock{ _K->mutex, std::adopt_lock };
+                std::cv_status const _cv_status{ (isSend_ ? _linda->readHappened : _linda->writeHappened).wait_until(_keeper_lock, _until) };
+                _keeper_lock.release(); // we don't want to release the lock!
+                _try_again = (_cv_status == std::cv_status::no_timeout); // detect spurious wakeups
+            }
+
+            // since keeper state GC is stopped, let's run a step once in a while if required (same as keeper_call(), without the error report)
+            int const _gc_threshold{ _linda->U->keepers.gc_threshold };
+            if (_gc_threshold == 0) {
+                lua_gc(_KL, LUA_GCSTEP, 0);
+            } else if (_gc_threshold > 0 && lua_gc(_KL, LUA_GCCOUNT, 0) >= _gc_threshold) {
+                lua_gc(_KL, LUA_GCCOLLECT, 0);
+            }
+            _linda->releaseKeeper(_K);
+            return _status;
+        }
+
+        // #########################################################################################
+
+        [[nodiscard]] static std::optional<int> AcceptSent(KeeperState const K_)
+        {
+            return lua_toboolean(K_, 1) ? std::make_optional(LANES_LINDA_OK) : std::nullopt;
+        }
+
+        // #########################################################################################
+
+        // pushes a string value in the keeper, offloading it like a regular linda:send() would
+        static void PushString(Linda* const linda_, KeeperState const K_, std::string_view const& string_)
+        {
+            int const _threshold{ linda_->U->keepers.offload_threshold };
+            if (_threshold > 0 && string_.size() >= static_cast<size_t>(_threshold)) {
+                Buffer::PushOffloadedString(linda_->U, DestState{ K_ }, string_);
+            } else {
+                std::ignore = lua_pushstringview(K_, string_);
+            }
+        }
+
+    } // namespace local
+} // namespace
+// #################################################################################################
+// #################################################################################################
+
+LANES_API int lanes_linda_send_number(void* const linda_, char const* const key_, double const value_, double const timeout_)
+{
+    auto _push = [value_](KeeperState const K_) { lua_pushnumber(K_, static_cast<lua_Number>(value_)); };
+    return local::Run(linda_, key_, timeout_, KEEPER_API(send), true, _push, local::AcceptSent);
+}
+
+// #################################################################################################
+
+LANES_API int lanes_linda_send_string(void* const linda_, char const* const key_, char const* const data_, size_t const len_, double const timeout_)
+{
+    if (data_ == nullptr && len_ > 0) {
+        return LANES_LINDA_ERROR;
+    }
+    Linda* const _linda{ static_cast<Linda*>(linda_) };
+    auto _push = [_linda, _string = std::string_view{ data_, len_ }](KeeperState const K_) { local::PushString(_linda, K_, _string); };
+    return local::Run(linda_, key_, timeout_, KEEPER_API(send), true, _push, local::AcceptSent);
+}
+
+// #################################################################################################
+
+LANES_API int lanes_linda_send_buffer(void* const linda_, char const* const key_, void* const buffer_, double const timeout_)
+{
+    if (buffer_ == nullptr) {
+        return LANES_LINDA_ERROR;
+    }
+    auto _push = [_buffer = static_cast<Buffer*>(buffer_)](KeeperState const K_) { DeepFactory::PushDeepProxy(DestState{ K_ }, _buffer, 0, LookupMode::ToKeeper, K_); };
+    return local::Run(linda_, key_, timeout_, KEEPER_API(send), true, _push, local::AcceptSent);
+}
+
+// #################################################################################################
+
+LANES_API int lanes_linda_receive_number(void* const linda_, char const* const key_, double* const value_, double const timeout_)
+{
+    if (value_ == nullptr) {
+        return LANES_LINDA_ERROR;
+    }
+    auto _push = [](KeeperState const K_) { lua_pushinteger(K_, static_cast<lua_Integer>(LuaType::NUMBER)); };
+    auto _accept = [value_](KeeperState const K_) -> std::optional<int> {
+        switch (lua_type_as_enum(K_, 1)) {
+        case LuaType::NONE: // nothing to receive yet
+            return std::nullopt;
+
+        case LuaType::NUMBER:
+            *value_ = static_cast<double>(lua_tonumber(K_, 1));
+            return LANES_LINDA_OK;
+
+        default: // false
+            return LANES_LINDA_MISMATCH;
+        }
+    };
+    return local::Run(linda_, key_, timeout_, KEEPER_API(receive_typed), false, _push, _accept);
+}
+
+// #################################################################################################
+
+LANES_API int lanes_linda_receive_string(void* const linda_, char const* const key_, char* const data_, size_t const capacity_, size_t* const len_, double const timeout_)
+{
+    if ((data_ == nullptr && capacity_ > 0) || len_ == nullptr) {
+        return LANES_LINDA_ERROR;
+    }
+    auto _push = [capacity_](KeeperState const K_) {
+        lua_pushinteger(K_, static_cast<lua_Integer>(LuaType::STRING));
+        lua_pushinteger(K_, static_cast<lua_Integer>(std::min(capacity_, static_cast<size_t>(std::numeric_limits<lua_Integer>::max()))));
+    };
+    auto _accept = [data_, len_](KeeperState const K_) -> std::optional<int> {
+        std::string_view _string;
+        switch (lua_type_as_enum(K_, 1)) {
+        case LuaType::NONE: // nothing to receive yet
+            return std::nullopt;
+
+        case LuaType::BOOLEAN: // false [len]
+            if (lua_isnoneornil(K_, 2)) {
+                return LANES_LINDA_MISMATCH;
+            }
+            *len_ = static_cast<size_t>(lua_tointeger(K_, 2));
+            return LANES_LINDA_TOO_SMALL;
+
+        case LuaType::STRING:
+            _string = lua_tostringview(K_, 1);
+            break;
+
+        default: // a buffer
+            _string = static_cast<Buffer const*>(*lua_tofulluserdata<DeepPrelude*>(K_, 1))->view();
+            break;
+        }
+        if (!_string.empty()) {
+            std::memcpy(data_, _string.data(), _string.size());
+        }
+        *len_ = _string.size();
+        return LANES_LINDA_OK;
+    };
+    return local::Run(linda_, key_, timeout_, KEEPER_API(receive_typed), false, _push, _accept);
+}
+
+// #################################################################################################
+
+#if LUAJIT_FLAVOR() != 0
+
+// returns { name = { address, "function pointer ctype" } | status code }, for lanes.linda_ffi() to turn into callable cdata
+LUAG_FUNC(linda_ffi)
+{
+    struct Entry
+    {
+        char const* name;
+        void* address;
+        std::string_view ctype;
+    };
+    static Entry const sEntries[] = {
+        { "send_number", std::bit_cast<void*>(&lanes_linda_send_number), "int (*)(void*, const char*, double, double)" },
+        { "send_string", std::bit_cast<void*>(&lanes_linda_send_string), "int (*)(void*, const char*, const char*, size_t, double)" },
+        { "send_buffer", std::bit_cast<void*>(&lanes_linda_send_buffer), "int (*)(void*, const char*, void*, double)" },
+        { "receive_number", std::bit_cast<void*>(&lanes_linda_receive_number), "int (*)(void*, const char*, double*, double)" },
+        { "receive_string", std::bit_cast<void*>(&lanes_linda_receive_string), "int (*)(void*, const char*, char*, size_t, size_t*, double)" },
+    };
+    static std::pair<char const*, int> const sStatuses[] = {
+        { "OK", LANES_LINDA_OK },
+        { "TIMEOUT", LANES_LINDA_TIMEOUT },
+        { "CANCELLED", LANES_LINDA_CANCELLED },
+        { "MISMATCH", LANES_LINDA_MISMATCH },
+        { "TOO_SMALL", LANES_LINDA_TOO_SMALL },
+        { "ERROR", LANES_LINDA_ERROR },
+    };
+
+    STACK_GROW(L_, 4);
+    STACK_CHECK_START_REL(L_, 0);
+    lua_createtable(L_, 0, static_cast<int>(std::size(sEntries) + std::size(sStatuses)));          // L_: api
+    for (Entry const& _entry : sEntries) {
+        lua_createtable(L_, 2, 0);                                                                 // L_: api {}
+        lua_pushlightuserdata(L_, _entry.address);                                                 // L_: api {} address
+        lua_rawseti(L_, -2, 1);                                                                    // L_: api {address}
+        std::ignore = lua_pushstringview(L_, _entry.ctype);                                        // L_: api {address} ctype
+        lua_rawseti(L_, -2, 2);                                                                    // L_: api {address, ctype}
+        lua_setfield(L_, -2, _entry.name);                                                         // L_: api
+    }
+    for (auto const& [_name, _status] : sStatuses) {
+        lua_pushinteger(L_, _status);                                                              // L_: api status
+        lua_setfield(L_, -2, _name);                                                               // L_: api
+    }
+    STACK_CHECK(L_, 1);
+    return 1;
+}
+
+#endif // LUAJIT_FLAVOR()
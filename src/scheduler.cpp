@@ -0,0 +1,242 @@
+/*
+ * SCHEDULER.CPP             Copyright (c) 2024-, Benoit Germain
+ *
+ * M:N scheduling of lanes on a fixed set of worker threads
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "scheduler.h"
+
+#include "lane.h"
+#include "threading.h"
+
+// #################################################################################################
+// #################################################################################################
+// ################################### Scheduler implementation ####################################
+// #################################################################################################
+// #################################################################################################
+
+void* Scheduler::operator new(size_t size_, Universe* U_) noexcept
+{
+    return U_->internalAllocator.alloc(size_);
+}
+
+// #################################################################################################
+
+void Scheduler::operator delete(void* p_, Universe* U_)
+{
+    U_->internalAllocator.free(p_, sizeof(Scheduler));
+}
+
+// #################################################################################################
+
+void Scheduler::operator delete(void* p_)
+{
+    static_cast<Scheduler*>(p_)->U->internalAllocator.free(p_, sizeof(Scheduler));
+}
+
+// #################################################################################################
+
+Scheduler::Scheduler(Universe* const U_, int const nbThreads_)
+: U{ U_ }
+{
+    int const _nbThreads{ (nbThreads_ > 0) ? nbThreads_ : std::max(1, static_cast<int>(std::thread::hardware_concurrency())) };
+    workers.reserve(_nbThreads);
+    for (int _i{ 0 }; _i < _nbThreads; ++_i) {
+        workers.emplace_back([this]() { workerMain(); });
+    }
+}
+
+// #################################################################################################
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard _guard{ mutex };
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    // joins all the workers
+    workers.clear();
+}
+
+// #################################################################################################
+
+// a blocking operation resumed after a park starts over: its timeout becomes whatever remains until the deadline it parked with
+void Scheduler::AdjustTimeout(lua_State* const L_, int const idx_)
+{
+    if (lua_type(L_, idx_) != LUA_TNUMBER) { // no timeout, or an infinite one
+        return;
+    }
+    Lane* const _lane{ kLanePointerRegKey.readLightUserDataValue<Lane>(L_) };
+    lua_Duration const _remaining{ std::max(_lane->parkUntil - Clock::now(), Clock::duration::zero()) };
+    lua_pushnumber(L_, _remaining.count());
+    lua_replace(L_, idx_);
+}
+
+// #################################################################################################
+
+// the scheduler is created when the first scheduled lane is launched
+Scheduler* Scheduler::Get(Universe* const U_)
+{
+    std::call_once(U_->schedulerOnce, [U_]() { U_->scheduler.store(new (U_) Scheduler{ U_, U_->nbSchedulerThreads }, std::memory_order_release); });
+    return U_->scheduler.load(std::memory_order_relaxed);
+}
+
+// #################################################################################################
+
+// wakes up the threads waiting on cv_, as well as the scheduled lanes parked on it
+void Scheduler::NotifyAll(Universe* const U_, std::condition_variable& cv_)
+{
+    cv_.notify_all();
+    if (Scheduler* const _scheduler{ U_->scheduler.load(std::memory_order_acquire) }) {
+        _scheduler->wake(cv_);
+    }
+}
+
+// #################################################################################################
+
+// returns the lane if L_ runs a scheduled lane body that can yield back to its worker
+Lane* Scheduler::ParkableLane(lua_State* const L_)
+{
+#if HAVE_LANE_SCHEDULER()
+    // a coroutine created by the lane body would yield to its own resumer instead of the worker
+    Lane* const _lane{ kLanePointerRegKey.readLightUserDataValue<Lane>(L_) };
+    return (_lane != nullptr && _lane->coroutine == L_ && lua_isyieldable(L_)) ? _lane : nullptr;
+#else // HAVE_LANE_SCHEDULER()
+    return nullptr;
+#endif // HAVE_LANE_SCHEDULER()
+}
+
+// #################################################################################################
+
+// must be called by the blocking operation while it still holds the lock that protects the notification of cv_, right before it yields
+void Scheduler::Park(Lane* const lane_, std::condition_variable& cv_, TimePoint const until_)
+{
+    Scheduler* const _scheduler{ lane_->U->scheduler.load(std::memory_order_relaxed) };
+    std::lock_guard _guard{ _scheduler->mutex };
+    lane_->parkState = ParkState::Parking;
+    lane_->parkUntil = until_;
+    lane_->parkedOnIt = _scheduler->parkedOn.emplace(&cv_, lane_);
+    // no need to tell the workers about the deadline: the one running the lane checks them before picking another lane
+    lane_->parkedUntilIt = (until_ == TimePoint::max()) ? _scheduler->parkedUntil.end() : _scheduler->parkedUntil.emplace(until_, lane_);
+}
+
+// #################################################################################################
+
+// mutex must be locked
+void Scheduler::requeue(Lane* const lane_)
+{
+    lane_->parkState = ParkState::Running;
+    runQueue.push_back(lane_);
+    workAvailable.notify_one();
+}
+
+// #################################################################################################
+
+void Scheduler::schedule(Lane* const lane_)
+{
+    std::lock_guard _guard{ mutex };
+    requeue(lane_);
+}
+
+// #################################################################################################
+
+// the worker is done with a lane that yielded. mutex must be locked
+void Scheduler::suspended(Lane* const lane_)
+{
+    if (lane_->parkState == ParkState::Parking) {
+        lane_->parkState = ParkState::Parked;
+    } else {
+        // Woken: the signal came before we got here
+        // Running: a plain coroutine.yield() from the lane body, that lets the other lanes run for a while
+        requeue(lane_);
+    }
+}
+
+// #################################################################################################
+
+// the signal or the deadline the lane waited for has come. mutex must be locked
+void Scheduler::unpark(Lane* const lane_)
+{
+    parkedOn.erase(lane_->parkedOnIt);
+    if (lane_->parkedUntilIt != parkedUntil.end()) {
+        parkedUntil.erase(lane_->parkedUntilIt);
+        lane_->parkedUntilIt = parkedUntil.end();
+    }
+    if (lane_->parkState == ParkState::Parked) {
+        requeue(lane_);
+    } else {
+        // its worker will requeue it as soon as it notices the yield
+        lane_->parkState = ParkState::Woken;
+    }
+}
+
+// #################################################################################################
+
+void Scheduler::wake(std::condition_variable const& cv_)
+{
+    std::lock_guard _guard{ mutex };
+    auto [_it, _end] = parkedOn.equal_range(&cv_);
+    while (_it != _end) {
+        // unpark() erases the entry
+        Lane* const _lane{ (_it++)->second };
+        unpark(_lane);
+    }
+}
+
+// #################################################################################################
+
+void Scheduler::workerMain()
+{
+    THREAD_SETNAME("lanes-scheduler");
+    std::unique_lock _guard{ mutex };
+    while (!stopping) {
+        // the lanes whose deadline has passed can run again
+        TimePoint const _now{ Clock::now() };
+        while (!parkedUntil.empty() && parkedUntil.begin()->first <= _now) {
+            unpark(parkedUntil.begin()->second);
+        }
+        if (runQueue.empty()) {
+            if (parkedUntil.empty()) {
+                workAvailable.wait(_guard);
+            } else {
+                workAvailable.wait_until(_guard, parkedUntil.begin()->first);
+            }
+            continue;
+        }
+        Lane* const _lane{ runQueue.front() };
+        runQueue.pop_front();
+        _guard.unlock();
+        bool const _ended{ _lane->resume() };
+        _guard.lock();
+        if (!_ended) {
+            suspended(_lane);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "compat.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// forwards
+class Lane;
+class Universe;
+
+// #################################################################################################
+
+// runs the lanes launched with the 'scheduled' option as coroutines on a fixed set of worker threads
+// a scheduled lane that blocks on a linda operation, lanes.sleep() or a join gives its worker back until it can run again
+class Scheduler
+{
+    public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = std::chrono::time_point<Clock>;
+    // the lanes waiting for a signal, and those waiting for a deadline
+    using ParkedOn = std::multimap<std::condition_variable const*, Lane*>;
+    using ParkedUntil = std::multimap<TimePoint, Lane*>;
+
+    enum class ParkState
+    {
+        Running, // queued or being resumed by a worker
+        Parking, // about to yield, still owned by its worker
+        Parked, // yielded, waiting for its signal or its deadline
+        Woken // signalled before its worker noticed it had yielded
+    };
+
+    private:
+    Universe* const U;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::deque<Lane*> runQueue; // protected by mutex
+    ParkedOn parkedOn; // protected by mutex
+    ParkedUntil parkedUntil; // protected by mutex
+    bool stopping{ false }; // protected by mutex
+    std::vector<std::jthread> workers;
+
+    public:
+    [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept;
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete(void* p_, Universe* U_);
+    // this one is for us, to make sure memory is freed by the correct allocator
+    static void operator delete(void* p_);
+
+    Scheduler(Universe* U_, int nbThreads_);
+    ~Scheduler();
+    Scheduler() = delete;
+    // non-copyable, non-movable
+    Scheduler(Scheduler const&) = delete;
+    Scheduler(Scheduler const&&) = delete;
+    Scheduler& operator=(Scheduler const&) = delete;
+    Scheduler& operator=(Scheduler const&&) = delete;
+
+    private:
+    void requeue(Lane* lane_);
+    void suspended(Lane* lane_);
+    void unpark(Lane* lane_);
+    void wake(std::condition_variable const& cv_);
+    void workerMain();
+
+    public:
+    static void AdjustTimeout(lua_State* L_, int idx_);
+    [[nodiscard]] static Scheduler* Get(Universe* U_);
+    static void NotifyAll(Universe* U_, std::condition_variable& cv_);
+    [[nodiscard]] static Lane* ParkableLane(lua_State* L_);
+    static void Park(Lane* lane_, std::condition_variable& cv_, TimePoint until_);
+    void schedule(Lane* lane_);
+};
@@ -136,7 +136,7 @@ namespace {
 
         kConfigRegKey.pushValue(L1_);                                                              // L1_: config
         // copy settings from from source to destination registry
-        InterCopyContext _c{ U_, L2_, L1_, {}, {}, {}, {}, {} };
+        InterCopyContext<LookupMode::LaneBody> _c{ U_, L2_, L1_, {}, {}, {}, {} };
         if (_c.inter_move(1) != InterCopyResult::Success) {                                        // L1_:                                           L2_: config
             raise_luaL_error(L1_, "failed to copy settings when loading " kLanesCoreLibName);
         }
@@ -253,18 +253,8 @@ namespace state {
 
     // #############################################################################################
 
-    /*
-     * Like 'luaL_openlibs()' but allows the set of libraries be selected
-     *
-     *   nullptr    no libraries, not even base
-     *   ""      base library only
-     *   "io,string"     named libraries
-     *   "*"     all libraries
-     *
-     * Base ("unpack", "print" etc.) is always added, unless 'libs' is nullptr.
-     *
-     */
-    lua_State* NewLaneState(Universe* U_, SourceState from_, std::optional<std::string_view> const& libs_)
+    // the part of NewLaneState() that needs from_: create the state, and copy the settings if InitializeLaneState() is going to need them
+    lua_State* CreateLaneState(Universe* U_, SourceState from_, std::optional<std::string_view> const& libs_)
     {
         DestState const _L{ CreateState(U_, from_) };
 
@@ -286,11 +276,38 @@ namespace state {
             return _L;
         }
 
+        // copy settings (for example because it may contain a Lua on_state_create function)
+        CopyOneTimeSettings(U_, from_, _L);
+        STACK_CHECK(_L, 0);
+        return _L;
+    }
+
+    // #############################################################################################
+
+    /*
+     * Like 'luaL_openlibs()' but allows the set of libraries be selected
+     *
+     *   nullptr    no libraries, not even base
+     *   ""      base library only
+     *   "io,string"     named libraries
+     *   "*"     all libraries
+     *
+     * Base ("unpack", "print" etc.) is always added, unless 'libs' is nullptr.
+     * on_state_create() errors are raised in errL_
+     */
+    void InitializeLaneState(Universe* U_, lua_State* L_, lua_State* errL_, std::optional<std::string_view> const& libs_)
+    {
+        DestState const _L{ L_ };
+        // neither libs (not even 'base') nor special init func: nothing to do
+        if (!libs_.has_value() && U_->onStateCreateFunc == nullptr) {
+            return;
+        }
+
         DEBUGSPEW_CODE(DebugSpew(U_) << "luaG_newstate()" << std::endl);
         DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ U_ });
 
-        // copy settings (for example because it may contain a Lua on_state_create function)
-        CopyOneTimeSettings(U_, from_, _L);
+        STACK_GROW(_L, 2);
+        STACK_CHECK_START_REL(_L, 0);
 
         // 'lua.c' stops GC during initialization so perhaps it is a good idea. :)
         lua_gc(_L, LUA_GCSTOP, 0);
@@ -348,8 +365,8 @@ namespace state {
         tools::SerializeRequire(_L);
 
         // call this after the base libraries are loaded and GC is restarted
-        // will raise an error in from_ in case of problem
-        CallOnStateCreate(U_, _L, from_, LookupMode::LaneBody);
+        // will raise an error in errL_ in case of problem
+        CallOnStateCreate(U_, _L, errL_, LookupMode::LaneBody);
 
         STACK_CHECK(_L, 0);
         // after all this, register everything we find in our name<->function database
@@ -384,9 +401,48 @@ namespace state {
         }
 
         STACK_CHECK(_L, 0);
+    }
+
+    // #############################################################################################
+
+    lua_State* NewLaneState(Universe* U_, SourceState from_, std::optional<std::string_view> const& libs_)
+    {
+        lua_State* const _L{ CreateLaneState(U_, from_, libs_) };
+        InitializeLaneState(U_, _L, from_, libs_);
         return _L;
     }
 
+    // #############################################################################################
+
+    // require a module in L2_ and register the functions it exports in its lookup database. errors are propagated to L_
+    void RequireModule(Universe* const U_, lua_State* const L_, lua_State* const L2_, std::string_view const& name_)
+    {
+        DEBUGSPEW_CODE(DebugSpew(U_) << "require '" << name_ << "'" << std::endl);
+        STACK_CHECK_START_REL(L2_, 0);
+        lua_getglobal(L2_, "require");                                                             // L_:                                            L2: require()?
+        if (lua_isnil(L2_, -1)) {
+            lua_pop(L2_, 1);                                                                       // L_:                                            L2:
+            raise_luaL_error(L_, "cannot pre-require modules without loading 'package' library first");
+        }
+        std::ignore = lua_pushstringview(L2_, name_);                                              // L_:                                            L2: require() name
+        LuaError const _rc{ lua_pcall(L2_, 1, 1, 0) };                                             // L_:                                            L2: ret/errcode
+        if (_rc != LuaError::OK) {
+            // a lane that prepares its own state already has the error where it must be raised
+            if (L_ == L2_) {
+                raise_lua_error(L2_);
+            }
+            // propagate error to main state if any
+            InterCopyContext<LookupMode::LaneBody> _c{ U_, DestState{ L_ }, SourceState{ L2_ }, {}, {}, {}, {} };
+            std::ignore = _c.inter_move(1);                                                        // L_: error                                      L2:
+            raise_lua_error(L_);
+        }
+        // here the module was successfully required                                               // L_:                                            L2: ret
+        // after requiring the module, register the functions it exported in our name<->function database
+        tools::PopulateFuncLookupTable(L2_, -1, name_);
+        lua_pop(L2_, 1);                                                                           // L_:                                            L2:
+        STACK_CHECK(L2_, 0);
+    }
+
     // #############################################################################################
     // #############################################################################################
 } // namespace state
@@ -10,8 +10,11 @@ class Universe;
 namespace state {
 
     void CallOnStateCreate(Universe* U_, lua_State* L_, lua_State* from_, LookupMode mode_);
+    [[nodiscard]] lua_State* CreateLaneState(Universe* U_, SourceState from_, std::optional<std::string_view> const& libs_);
     [[nodiscard]] lua_State* CreateState(Universe* U_, lua_State* from_);
+    void InitializeLaneState(Universe* U_, lua_State* L_, lua_State* errL_, std::optional<std::string_view> const& libs_);
     void InitializeOnStateCreate(Universe* U_, lua_State* L_);
     [[nodiscard]] lua_State* NewLaneState(Universe* U_, SourceState from_, std::optional<std::string_view> const& libs_);
+    void RequireModule(Universe* U_, lua_State* L_, lua_State* L2_, std::string_view const& name_);
 
 } // namespace state
@@ -0,0 +1,382 @@
+/*
+ * STATEPOOL.CPP                 Copyright (c) 2024-, Benoit Germain
+ *
+ * Recycling of the lua_States of finished lanes
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "statepool.h"
+
+#include "tools.h"
+
+#include <ranges>
+
+// must be a #define instead of a constexpr to work with lua_pushliteral (until I templatize it)
+#define kStatePoolMetatableName "StatePool"
+
+// xxh64 of string "kStatePoolBaselineRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kStatePoolBaselineRegKey{ 0x60E574EF5CE5B116ull }; // a shallow copy of the globals of a pooled state
+
+// xxh64 of string "kStatePoolBaselineMtRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kStatePoolBaselineMtRegKey{ 0xDE99F1A18F21ED9Dull }; // the metatable of the globals of a pooled state
+
+// #################################################################################################
+// #################################################################################################
+namespace {
+    // #############################################################################################
+    // #############################################################################################
+
+    // brings the globals of a state back to what they were when StatePoolStorage::SaveBaseline() was called, and collects everything else
+    // only the global table itself is restored: changes made inside the tables it references (string, package.loaded...) remain
+    // called through lua_pcall by ResetState(), because the collection runs finalizers that can raise errors
+    [[nodiscard]] static int ResetStateProtected(lua_State* const L_)
+    {
+        lua_settop(L_, 0);                                                                         // L_:
+        STACK_GROW(L_, 5);
+        lua_pushglobaltable(L_);                                                                   // L_: _G
+        kStatePoolBaselineRegKey.pushValue(L_);                                                    // L_: _G baseline
+        // remove the globals that didn't exist in the baseline (clearing fields during traversal is allowed)
+        lua_pushnil(L_);                                                                           // L_: _G baseline nil
+        while (lua_next(L_, 1)) {                                                                  // L_: _G baseline k v
+            lua_pop(L_, 1);                                                                        // L_: _G baseline k
+            lua_pushvalue(L_, -1);                                                                 // L_: _G baseline k k
+            lua_rawget(L_, 2);                                                                     // L_: _G baseline k v|nil
+            if (lua_isnil(L_, -1)) {
+                lua_pushvalue(L_, -2);                                                             // L_: _G baseline k nil k
+                lua_pushnil(L_);                                                                   // L_: _G baseline k nil k nil
+                lua_rawset(L_, 1);                                                                 // L_: _G baseline k nil
+            }
+            lua_pop(L_, 1);                                                                        // L_: _G baseline k
+        }                                                                                          // L_: _G baseline
+        // restore the values of those that did
+        lua_pushnil(L_);                                                                           // L_: _G baseline nil
+        while (lua_next(L_, 2)) {                                                                  // L_: _G baseline k v
+            lua_pushvalue(L_, -2);                                                                 // L_: _G baseline k v k
+            lua_insert(L_, -2);                                                                    // L_: _G baseline k k v
+            lua_rawset(L_, 1);                                                                     // L_: _G baseline k
+        }                                                                                          // L_: _G baseline
+        kStatePoolBaselineMtRegKey.pushValue(L_);                                                  // L_: _G baseline mt|nil
+        lua_setmetatable(L_, 1);                                                                   // L_: _G baseline
+        lua_settop(L_, 0);                                                                         // L_:
+        lua_gc(L_, LUA_GCCOLLECT, 0);
+        return 0;
+    }
+
+    // #############################################################################################
+
+    // returns false if the reset raised an error, in which case the state is in an unknown condition and must not be reused
+    [[nodiscard]] static bool ResetState(lua_State* const L_)
+    {
+        lua_settop(L_, 0);                                                                         // L_:
+        lua_pushcfunction(L_, ResetStateProtected);                                                // L_: ResetStateProtected
+        LuaError const _rc{ lua_pcall(L_, 0, 0, 0) };                                              // L_: err?
+        lua_settop(L_, 0);                                                                         // L_:
+        return _rc == LuaError::OK;
+    }
+
+    // #############################################################################################
+
+    [[nodiscard]] static StatePool* ToStatePool(lua_State* const L_, int const idx_)
+    {
+        StatePool* const _pool{ static_cast<StatePool*>(StatePoolFactory::Instance.toDeep(L_, idx_)) };
+        luaL_argcheck(L_, _pool != nullptr, idx_, "expecting a state pool"); // doesn't return if _pool is nullptr
+        return _pool;
+    }
+
+    // #############################################################################################
+    // #############################################################################################
+} // namespace
+// #################################################################################################
+// #################################################################################################
+
+// #################################################################################################
+// #################################################################################################
+// ############################# StatePoolStorage implementation ###################################
+// #################################################################################################
+// #################################################################################################
+
+StatePoolStorage* StatePoolStorage::Create(Universe* const U_, int const capacity_)
+{
+    void* const _mem{ U_->internalAllocator.alloc(sizeof(StatePoolStorage) + capacity_ * sizeof(lua_State*)) };
+    return _mem ? new (_mem) StatePoolStorage{ capacity_ } : nullptr;
+}
+
+// #################################################################################################
+
+// closes the idle states. states given after that are closed immediately
+void StatePoolStorage::close()
+{
+    int _count{ 0 };
+    {
+        std::lock_guard<std::mutex> _guard{ mutex };
+        closed = true;
+        _count = std::exchange(idleCount, 0);
+    }
+    for (lua_State* const _L : std::views::counted(idle(), _count)) {
+        lua_close(_L);
+    }
+}
+
+// #################################################################################################
+
+int StatePoolStorage::getIdleCount()
+{
+    std::lock_guard<std::mutex> _guard{ mutex };
+    return idleCount;
+}
+
+// #################################################################################################
+
+// a lane is done with L_: keep it for another lane if it ran to completion and there is room for it, else close it
+void StatePoolStorage::giveState(lua_State* const L_, bool const reusable_)
+{
+    auto _hasRoom = [this]() {
+        std::lock_guard<std::mutex> _guard{ mutex };
+        return !closed && idleCount < capacity;
+    };
+    // resetting the state can run finalizers: don't do it under the lock
+    if (reusable_ && _hasRoom() && ResetState(L_)) {
+        std::lock_guard<std::mutex> _guard{ mutex };
+        if (!closed && idleCount < capacity) {
+            idle()[idleCount++] = L_;
+            recycled.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    discarded.fetch_add(1, std::memory_order_relaxed);
+    lua_close(L_);
+}
+
+// #################################################################################################
+
+void StatePoolStorage::release(Universe* const U_)
+{
+    if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        close();
+        size_t const _allocSize{ sizeof(StatePoolStorage) + capacity * sizeof(lua_State*) };
+        this->~StatePoolStorage();
+        U_->internalAllocator.free(this, _allocSize);
+    }
+}
+
+// #################################################################################################
+
+// to be called once the state is ready to run a lane body, so that it can be restored to that point after the lane is done
+void StatePoolStorage::SaveBaseline(lua_State* const L_)
+{
+    STACK_GROW(L_, 4);
+    STACK_CHECK_START_REL(L_, 0);
+    lua_newtable(L_);                                                                              // L_: baseline
+    lua_pushglobaltable(L_);                                                                       // L_: baseline _G
+    lua_pushnil(L_);                                                                               // L_: baseline _G nil
+    while (lua_next(L_, -2)) {                                                                     // L_: baseline _G k v
+        lua_pushvalue(L_, -2);                                                                     // L_: baseline _G k v k
+        lua_insert(L_, -2);                                                                        // L_: baseline _G k k v
+        lua_rawset(L_, -5);                                                                        // L_: baseline _G k
+    }                                                                                              // L_: baseline _G
+    if (!lua_getmetatable(L_, -1)) {                                                               // L_: baseline _G mt|
+        lua_pushnil(L_);                                                                           // L_: baseline _G nil
+    }
+    kStatePoolBaselineMtRegKey.setValue(L_, [](lua_State* L_) { lua_pushvalue(L_, -2); });         // L_: baseline _G mt|nil
+    lua_pop(L_, 2);                                                                                // L_: baseline
+    kStatePoolBaselineRegKey.setValue(L_, [](lua_State* L_) { lua_pushvalue(L_, -2); });           // L_: baseline
+    lua_pop(L_, 1);                                                                                // L_:
+    STACK_CHECK(L_, 0);
+}
+
+// #################################################################################################
+
+// a state of the pool, ready to run a lane body, or nullptr if there is none
+lua_State* StatePoolStorage::takeState()
+{
+    {
+        std::lock_guard<std::mutex> _guard{ mutex };
+        if (idleCount > 0) {
+            reused.fetch_add(1, std::memory_order_relaxed);
+            return idle()[--idleCount];
+        }
+    }
+    created.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+// #################################################################################################
+// #################################################################################################
+// ################################# StatePool implementation ######################################
+// #################################################################################################
+// #################################################################################################
+
+StatePool::StatePool(Universe* const U_, StatePoolStorage* const storage_)
+: DeepPrelude{ StatePoolFactory::Instance }
+, U{ U_ }
+, storage{ storage_ }
+{
+    storage->acquire();
+}
+
+// #################################################################################################
+
+StatePool::~StatePool()
+{
+    // the pool can no longer be given to a new lane: don't keep idle states around
+    storage->close();
+    storage->release(U);
+}
+
+// #################################################################################################
+// #################################################################################################
+// #################################### StatePoolFactory ###########################################
+// #################################################################################################
+// #################################################################################################
+
+void StatePoolFactory::createMetatable(lua_State* L_) const
+{
+    STACK_CHECK_START_REL(L_, 0);
+    lua_newtable(L_);
+    // metatable is its own index
+    lua_pushvalue(L_, -1);
+    lua_setfield(L_, -2, "__index");
+
+    // protect metatable from external access
+    lua_pushliteral(L_, kStatePoolMetatableName);
+    lua_setfield(L_, -2, "__metatable");
+
+    luaG_registerlibfuncs(L_, mStatePoolMT);
+    STACK_CHECK(L_, 1);
+}
+
+// #################################################################################################
+
+void StatePoolFactory::deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const
+{
+    StatePool* const _pool{ static_cast<StatePool*>(o_) };
+    LUA_ASSERT(L_, _pool);
+    delete _pool; // operator delete overload ensures things go as expected
+}
+
+// #################################################################################################
+
+std::string_view StatePoolFactory::moduleName() const
+{
+    // same as lindas: lanes is necessarily loaded by the time we get here
+    return std::string_view{};
+}
+
+// #################################################################################################
+
+// lanes.state_pool(capacity)
+DeepPrelude* StatePoolFactory::newDeepObjectInternal(lua_State* L_) const
+{
+    Universe* const _U{ Universe::Get(L_) };
+    StatePoolStorage* const _storage{ StatePoolStorage::Create(_U, static_cast<int>(lua_tointeger(L_, 1))) };
+    if (_storage == nullptr) {
+        return nullptr;
+    }
+    StatePool* const _pool{ new (_U) StatePool{ _U, _storage } };
+    // the StatePool holds its own reference
+    _storage->release(_U);
+    return _pool;
+}
+
+// #################################################################################################
+// #################################################################################################
+// ########################################## Lua API ##############################################
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * {} = pool:stats()
+ *
+ * capacity, idle: the maximum and current number of states in the pool
+ * created, reused: the number of lanes that had to create their state, or were given one from the pool
+ * recycled, discarded: the number of finished lanes whose state went back in the pool, or was closed
+ * hit_rate: reused / (created + reused)
+ */
+LUAG_FUNC(state_pool_stats)
+{
+    StatePoolStorage* const _storage{ ToStatePool(L_, 1)->storage };
+    int const _created{ _storage->created.load(std::memory_order_relaxed) };
+    int const _reused{ _storage->reused.load(std::memory_order_relaxed) };
+    lua_createtable(L_, 0, 7);                                                                     // L_: pool {}
+    lua_pushinteger(L_, _storage->getCapacity());                                                  // L_: pool {} capacity
+    lua_setfield(L_, -2, "capacity");                                                              // L_: pool {}
+    lua_pushinteger(L_, _storage->getIdleCount());                                                 // L_: pool {} idle
+    lua_setfield(L_, -2, "idle");                                                                  // L_: pool {}
+    lua_pushinteger(L_, _created);                                                                 // L_: pool {} created
+    lua_setfield(L_, -2, "created");                                                               // L_: pool {}
+    lua_pushinteger(L_, _reused);                                                                  // L_: pool {} reused
+    lua_setfield(L_, -2, "reused");                                                                // L_: pool {}
+    lua_pushinteger(L_, _storage->recycled.load(std::memory_order_relaxed));                       // L_: pool {} recycled
+    lua_setfield(L_, -2, "recycled");                                                              // L_: pool {}
+    lua_pushinteger(L_, _storage->discarded.load(std::memory_order_relaxed));                      // L_: pool {} discarded
+    lua_setfield(L_, -2, "discarded");                                                             // L_: pool {}
+    lua_pushnumber(L_, (_created + _reused) > 0 ? static_cast<lua_Number>(_reused) / (_created + _reused) : 0.0); // L_: pool {} hit_rate
+    lua_setfield(L_, -2, "hit_rate");                                                              // L_: pool {}
+    return 1;
+}
+
+// #################################################################################################
+
+namespace {
+    namespace local {
+        static luaL_Reg const sStatePoolMT[] = {
+            { "stats", LG_state_pool_stats },
+            { nullptr, nullptr }
+        };
+    } // namespace local
+} // namespace
+/*static*/ StatePoolFactory StatePoolFactory::Instance{ local::sStatePoolMT };
+
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * bool = lanes.core.state_pool_bind(pool)
+ *
+ * called by lanes.gen() for the generator that receives the pool. returns false if the pool already belongs to another generator
+ */
+LUAG_FUNC(state_pool_bind)
+{
+    lua_pushboolean(L_, ToStatePool(L_, 1)->storage->bind() ? 1 : 0);
+    return 1;
+}
+
+// #################################################################################################
+
+/*
+ * pool = lanes.state_pool(capacity)
+ *
+ * returns a pool that keeps up to 'capacity' states of finished lanes, for use by the generator that receives it with the 'pool' option
+ */
+LUAG_FUNC(state_pool)
+{
+    luaL_argcheck(L_, lua_gettop(L_) == 1, 1, "expected a single argument");
+    lua_Integer const _capacity{ luaL_checkinteger(L_, 1) };
+    luaL_argcheck(L_, _capacity >= 1 && _capacity <= 1024, 1, "capacity must be in [1, 1024]");
+    return StatePoolFactory::Instance.pushDeepUserdata(DestState{ L_ }, 0);
+}
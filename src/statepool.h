@@ -0,0 +1,103 @@
+#pragma once
+
+#include "deep.h"
+#include "universe.h"
+
+#include <mutex>
+
+// #################################################################################################
+
+// the lua_States of finished lanes, kept around so that later lanes can skip their creation and initialization
+// refcounted, because lanes keep using it after the Lua-side pool object is gone
+class StatePoolStorage
+{
+    private:
+    std::atomic<int> refcount{ 1 };
+    std::mutex mutex;
+    int const capacity{ 0 };
+    int idleCount{ 0 }; // protected by mutex
+    bool closed{ false }; // protected by mutex
+    std::atomic<bool> bound{ false }; // set by the generator that owns the pool
+
+    StatePoolStorage(int capacity_)
+    : capacity{ capacity_ }
+    {
+    }
+    ~StatePoolStorage() = default;
+
+    [[nodiscard]] lua_State** idle() { return std::bit_cast<lua_State**>(this + 1); }
+
+    public:
+    // statistics
+    std::atomic<int> created{ 0 }; // lanes that had to create their state
+    std::atomic<int> reused{ 0 }; // lanes that were given a pooled state
+    std::atomic<int> recycled{ 0 }; // states that went back in the pool
+    std::atomic<int> discarded{ 0 }; // states closed instead of recycled
+
+    // non-copyable, non-movable
+    StatePoolStorage(StatePoolStorage const&) = delete;
+    StatePoolStorage(StatePoolStorage const&&) = delete;
+    StatePoolStorage& operator=(StatePoolStorage const&) = delete;
+    StatePoolStorage& operator=(StatePoolStorage const&&) = delete;
+
+    [[nodiscard]] static StatePoolStorage* Create(Universe* U_, int capacity_);
+    static void SaveBaseline(lua_State* L_);
+    void acquire() { refcount.fetch_add(1, std::memory_order_relaxed); }
+    [[nodiscard]] bool bind() { return !bound.exchange(true, std::memory_order_relaxed); }
+    void close();
+    [[nodiscard]] int getCapacity() const { return capacity; }
+    [[nodiscard]] int getIdleCount();
+    void giveState(lua_State* L_, bool reusable_);
+    void release(Universe* U_);
+    [[nodiscard]] lua_State* takeState();
+};
+
+// #################################################################################################
+
+// what lanes.state_pool() returns
+class StatePool
+: public DeepPrelude // Deep userdata MUST start with this header
+{
+    public:
+    Universe* const U{ nullptr }; // the universe this pool belongs to
+    StatePoolStorage* const storage{ nullptr };
+
+    public:
+    [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept { return U_->internalAllocator.alloc(size_); }
+    // always embedded somewhere else or "in-place constructed" as a full userdata
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete(void* p_, Universe* U_) { U_->internalAllocator.free(p_, sizeof(StatePool)); }
+    // this one is for us, to make sure memory is freed by the correct allocator
+    static void operator delete(void* p_) { static_cast<StatePool*>(p_)->U->internalAllocator.free(p_, sizeof(StatePool)); }
+
+    ~StatePool();
+    StatePool(Universe* U_, StatePoolStorage* storage_);
+    StatePool() = delete;
+    // non-copyable, non-movable
+    StatePool(StatePool const&) = delete;
+    StatePool(StatePool const&&) = delete;
+    StatePool& operator=(StatePool const&) = delete;
+    StatePool& operator=(StatePool const&&) = delete;
+};
+
+// #################################################################################################
+
+class StatePoolFactory
+: public DeepFactory
+{
+    public:
+    static StatePoolFactory Instance;
+
+    StatePoolFactory(luaL_Reg const statePoolMT_[])
+    : mStatePoolMT{ statePoolMT_ }
+    {
+    }
+
+    private:
+    luaL_Reg const* const mStatePoolMT{ nullptr };
+
+    void createMetatable(lua_State* L_) const override;
+    void deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const override;
+    [[nodiscard]] std::string_view moduleName() const override;
+    [[nodiscard]] DeepPrelude* newDeepObjectInternal(lua_State* L_) const override;
+};
@@ -0,0 +1,160 @@
+/*
+ * STATEREAPER.CPP             Copyright (c) 2024-, Benoit Germain
+ *
+ * Background lua_close() of the states of the lanes that have ended
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "statereaper.h"
+
+#include "threading.h"
+#include "universe.h"
+
+// #################################################################################################
+// #################################################################################################
+// ################################# StateReaper implementation ####################################
+// #################################################################################################
+// #################################################################################################
+
+void* StateReaper::operator new(size_t size_, Universe* U_) noexcept
+{
+    return U_->internalAllocator.alloc(size_);
+}
+
+// #################################################################################################
+
+void StateReaper::operator delete(void* p_, Universe* U_)
+{
+    U_->internalAllocator.free(p_, sizeof(StateReaper));
+}
+
+// #################################################################################################
+
+void StateReaper::operator delete(void* p_)
+{
+    static_cast<StateReaper*>(p_)->U->internalAllocator.free(p_, sizeof(StateReaper));
+}
+
+// #################################################################################################
+
+StateReaper::StateReaper(Universe* const U_, int const capacity_)
+: U{ U_ }
+, capacity{ capacity_ }
+{
+    thread = std::jthread{ [this]() { workerMain(); } };
+}
+
+// #################################################################################################
+
+StateReaper::~StateReaper()
+{
+    {
+        std::lock_guard _guard{ mutex };
+        stopping = true;
+    }
+    workAvailable.notify_one();
+    // the states still in the queue are closed before the thread exits
+    thread.join();
+}
+
+// #################################################################################################
+
+// hands the state to the reaper if there is one with some room in its queue, else closes it right away
+void StateReaper::Close(Universe* const U_, lua_State* const L_)
+{
+    if (StateReaper* const _reaper{ U_->stateReaper }; _reaper != nullptr) {
+        {
+            std::lock_guard _guard{ _reaper->mutex };
+            if (!_reaper->stopping && static_cast<int>(_reaper->queue.size()) < _reaper->capacity) {
+                _reaper->queue.push_back(L_);
+                _reaper->workAvailable.notify_one();
+                return;
+            }
+        }
+        _reaper->overflowed.fetch_add(1, std::memory_order_relaxed);
+    }
+    lua_close(L_);
+}
+
+// #################################################################################################
+
+int StateReaper::getPendingCount()
+{
+    std::lock_guard _guard{ mutex };
+    return static_cast<int>(queue.size());
+}
+
+// #################################################################################################
+
+void StateReaper::workerMain()
+{
+    THREAD_SETNAME("lanes-reaper");
+    std::unique_lock _guard{ mutex };
+    while (true) {
+        workAvailable.wait(_guard, [this]() { return stopping || !queue.empty(); });
+        // when stopping, we only leave once everything is closed
+        if (queue.empty()) {
+            break;
+        }
+        lua_State* const _L{ queue.front() };
+        queue.pop_front();
+        _guard.unlock();
+        lua_close(_L);
+        reaped.fetch_add(1, std::memory_order_relaxed);
+        _guard.lock();
+    }
+}
+
+// #################################################################################################
+// #################################################################################################
+// ########################################## Lua API ##############################################
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * {} = lanes.reaper_stats()
+ *
+ * capacity: the maximum number of states waiting to be closed (0 when the reaper is disabled)
+ * pending: the number of states waiting to be closed
+ * reaped: the number of states the reaper has closed
+ * overflowed: the number of states closed by whoever gave them, because the queue was full
+ */
+LUAG_FUNC(reaper_stats)
+{
+    StateReaper* const _reaper{ Universe::Get(L_)->stateReaper };
+    lua_createtable(L_, 0, 4);                                                                     // L_: {}
+    lua_pushinteger(L_, _reaper ? _reaper->getCapacity() : 0);                                     // L_: {} capacity
+    lua_setfield(L_, -2, "capacity");                                                              // L_: {}
+    lua_pushinteger(L_, _reaper ? _reaper->getPendingCount() : 0);                                 // L_: {} pending
+    lua_setfield(L_, -2, "pending");                                                               // L_: {}
+    lua_pushinteger(L_, _reaper ? _reaper->reaped.load(std::memory_order_relaxed) : 0);            // L_: {} reaped
+    lua_setfield(L_, -2, "reaped");                                                                // L_: {}
+    lua_pushinteger(L_, _reaper ? _reaper->overflowed.load(std::memory_order_relaxed) : 0);        // L_: {} overflowed
+    lua_setfield(L_, -2, "overflowed");                                                            // L_: {}
+    return 1;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "compat.h"
+#include "macros_and_utils.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// forwards
+class Universe;
+
+// #################################################################################################
+
+// closes the states of the lanes that have ended on a thread of its own, so that joining or collecting a lane doesn't wait for the lua_close() of a big heap
+// when the queue is full, the state is closed right away by whoever gave it, as if there were no reaper
+class StateReaper
+{
+    private:
+    Universe* const U;
+    int const capacity; // maximum number of states waiting to be closed
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::deque<lua_State*> queue; // protected by mutex
+    bool stopping{ false }; // protected by mutex
+    std::jthread thread;
+
+    public:
+    // statistics
+    std::atomic<int> reaped{ 0 }; // states closed by the reaper thread
+    std::atomic<int> overflowed{ 0 }; // states closed by the caller because the queue was full
+
+    [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept;
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete(void* p_, Universe* U_);
+    // this one is for us, to make sure memory is freed by the correct allocator
+    static void operator delete(void* p_);
+
+    StateReaper(Universe* U_, int capacity_);
+    ~StateReaper();
+    StateReaper() = delete;
+    // non-copyable, non-movable
+    StateReaper(StateReaper const&) = delete;
+    StateReaper(StateReaper const&&) = delete;
+    StateReaper& operator=(StateReaper const&) = delete;
+    StateReaper& operator=(StateReaper const&&) = delete;
+
+    private:
+    void workerMain();
+
+    public:
+    static void Close(Universe* U_, lua_State* L_);
+    [[nodiscard]] int getCapacity() const { return capacity; }
+    [[nodiscard]] int getPendingCount();
+};
@@ -0,0 +1,388 @@
+/*
+ * STATETEMPLATE.CPP             Copyright (c) 2024-, Benoit Germain
+ *
+ * Per-generator template states, from which the required modules of new lanes are cloned
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "statetemplate.h"
+
+#include "intercopycontext.h"
+#include "state.h"
+#include "tools.h"
+
+// must be a #define instead of a constexpr to work with lua_pushliteral (until I templatize it)
+#define kStateTemplateMetatableName "StateTemplate"
+
+// xxh64 of string "kStateTemplateNativeRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kStateTemplateNativeRegKey{ 0xBB88CC4B58C768F9ull }; // the modules of the template state that can't be cloned
+
+// #################################################################################################
+// #################################################################################################
+namespace {
+    // #############################################################################################
+    // #############################################################################################
+
+    // some modules also declare a global
+    // L_: ... module                                                                              L2: ... copy
+    static void CopyGlobal(lua_State* const L_, lua_State* const L2_, std::string_view const& name_)
+    {
+        STACK_CHECK_START_REL(L_, 0);
+        STACK_CHECK_START_REL(L2_, 0);
+        lua_pushglobaltable(L_);                                                                   // L_: ... module _G                              L2: ... copy
+        std::ignore = luaG_getfield(L_, -1, name_);                                                // L_: ... module _G _G.name                      L2: ... copy
+        if (lua_rawequal(L_, -1, -3)) {
+            lua_pushvalue(L2_, -1);                                                                // L_: ... module _G _G.name                      L2: ... copy copy
+            lua_setglobal(L2_, name_.data());                                                      // L_: ... module _G _G.name                      L2: ... copy
+        }
+        lua_pop(L_, 2);                                                                            // L_: ... module                                 L2: ... copy
+        STACK_CHECK(L2_, 0);
+        STACK_CHECK(L_, 0);
+    }
+
+    // #############################################################################################
+
+    // the modules of the template state L_ that L2_ already has are reused as they are when a clone references them
+    // L_: ... _R._LOADED                                                                          L2: ... _R._LOADED
+    static void SeedCloneCache(lua_State* const L_, lua_State* const L2_, CacheIndex const cacheIdx_)
+    {
+        STACK_CHECK_START_REL(L_, 0);
+        STACK_CHECK_START_REL(L2_, 0);
+        lua_pushnil(L_);                                                                           // L_: ... _R._LOADED nil                         L2: ... _R._LOADED
+        while (lua_next(L_, -2) != 0) {                                                            // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED
+            LuaType const _type{ lua_type_as_enum(L_, -1) };
+            if (lua_type(L_, -2) == LUA_TSTRING && (_type == LuaType::TABLE || _type == LuaType::FUNCTION)) {
+                if (luaG_getfield(L2_, -1, lua_tostringview(L_, -2)) == _type) {                   // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED module
+                    // replaces anything a previous clone that failed might have left there
+                    lua_pushlightuserdata(L2_, const_cast<void*>(lua_topointer(L_, -1)));          // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED module p
+                    lua_insert(L2_, -2);                                                           // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED p module
+                    lua_rawset(L2_, cacheIdx_);                                                    // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED
+                } else {
+                    lua_pop(L2_, 1);                                                               // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED
+                }
+            }
+            lua_pop(L_, 1);                                                                        // L_: ... _R._LOADED "name"                      L2: ... _R._LOADED
+        }                                                                                          // L_: ... _R._LOADED                             L2: ... _R._LOADED
+        STACK_CHECK(L2_, 0);
+        STACK_CHECK(L_, 0);
+    }
+
+    // #############################################################################################
+
+    // the modules of the template state L_ that a clone copied in L2_ are registered there, so that require() returns the same copy
+    // L_: ... _R._LOADED                                                                          L2: ... _R._LOADED
+    static void PublishClonedModules(lua_State* const L_, lua_State* const L2_, CacheIndex const cacheIdx_)
+    {
+        STACK_CHECK_START_REL(L_, 0);
+        STACK_CHECK_START_REL(L2_, 0);
+        lua_pushnil(L_);                                                                           // L_: ... _R._LOADED nil                         L2: ... _R._LOADED
+        while (lua_next(L_, -2) != 0) {                                                            // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED
+            LuaType const _type{ lua_type_as_enum(L_, -1) };
+            if (lua_type(L_, -2) == LUA_TSTRING && (_type == LuaType::TABLE || _type == LuaType::FUNCTION)) {
+                std::string_view const _name{ lua_tostringview(L_, -2) };
+                int const _top2{ lua_gettop(L2_) };
+                lua_pushlightuserdata(L2_, const_cast<void*>(lua_topointer(L_, -1)));              // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED p
+                lua_rawget(L2_, cacheIdx_);                                                        // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED copy|nil
+                // a module that L2_ loaded by itself is left alone
+                bool const _copied{ lua_type_as_enum(L2_, -1) == _type && luaG_getfield(L2_, -2, _name) == LuaType::NIL };
+                if (_copied) {                                                                     // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED copy nil
+                    lua_pop(L2_, 1);                                                               // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED copy
+                    lua_pushvalue(L2_, -1);                                                        // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED copy copy
+                    lua_setfield(L2_, -3, _name.data());                                           // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED copy
+                    CopyGlobal(L_, L2_, _name);
+                    tools::PopulateFuncLookupTable(L2_, -1, _name);
+                }
+                lua_settop(L2_, _top2);                                                            // L_: ... _R._LOADED "name" module               L2: ... _R._LOADED
+            }
+            lua_pop(L_, 1);                                                                        // L_: ... _R._LOADED "name"                      L2: ... _R._LOADED
+        }                                                                                          // L_: ... _R._LOADED                             L2: ... _R._LOADED
+        STACK_CHECK(L2_, 0);
+        STACK_CHECK(L_, 0);
+    }
+
+    // #############################################################################################
+
+    // runs protected in the template state: L_: L2 "name" cacheIdx
+    [[nodiscard]] static int CloneModuleProtected(lua_State* const L_)
+    {
+        lua_State* const _L2{ static_cast<lua_State*>(lua_touserdata(L_, 1)) };
+        std::string_view const _name{ lua_tostringview(L_, 2) };
+        CacheIndex const _cacheIdx{ static_cast<int>(lua_tointeger(L_, 3)) };
+        STACK_GROW(L_, 6);
+        STACK_GROW(_L2, 6);
+        STACK_CHECK_START_REL(_L2, 0);
+        std::ignore = luaL_getsubtable(L_, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);                    // L_: L2 "name" cacheIdx _R._LOADED              L2:
+        std::ignore = luaL_getsubtable(_L2, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);                   // L_: L2 "name" cacheIdx _R._LOADED              L2: _R._LOADED
+        // the dependencies of the module that L2 already loaded are not copied again
+        SeedCloneCache(L_, _L2, _cacheIdx);
+        std::ignore = luaG_getfield(L_, 4, _name);                                                 // L_: L2 "name" cacheIdx _R._LOADED module       L2: _R._LOADED
+        // errors are raised in L_, where they are caught by the caller
+        InterCopyContext<LookupMode::LaneBody> _c{ Universe::Get(L_), DestState{ _L2 }, SourceState{ L_ }, _cacheIdx, SourceIndex{ 5 }, VT::NORMAL, _name.data(), {} };
+        if (!_c.inter_copy_one()) {                                                                // L_: L2 "name" cacheIdx _R._LOADED module       L2: _R._LOADED module
+            raise_luaL_error(L_, "failed to clone module '%s'", _name.data());
+        }
+        lua_pushvalue(_L2, -1);                                                                    // L_: L2 "name" cacheIdx _R._LOADED module       L2: _R._LOADED module module
+        lua_setfield(_L2, -3, _name.data());                                                       // L_: L2 "name" cacheIdx _R._LOADED module       L2: _R._LOADED module
+        CopyGlobal(L_, _L2, _name);
+        lua_remove(_L2, -2);                                                                       // L_: L2 "name" cacheIdx _R._LOADED module       L2: module
+        lua_pop(L_, 1);                                                                            // L_: L2 "name" cacheIdx _R._LOADED              L2: module
+        // the dependencies that came along with the module
+        std::ignore = luaL_getsubtable(_L2, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);                   // L_: L2 "name" cacheIdx _R._LOADED              L2: module _R._LOADED
+        PublishClonedModules(L_, _L2, _cacheIdx);
+        lua_pop(_L2, 1);                                                                           // L_: L2 "name" cacheIdx _R._LOADED              L2: module
+        STACK_CHECK(_L2, 1);
+        return 0;
+    }
+
+    // #############################################################################################
+
+    // copies package.loaded[name_] of the template state L_ in L2_. returns false if the module should be required in L2_ instead
+    [[nodiscard]] static bool CloneModule(lua_State* const L_, lua_State* const L2_, CacheIndex const cacheIdx_, std::string_view const& name_)
+    {
+        STACK_GROW(L_, 5);
+        STACK_CHECK_START_REL(L_, 0);
+        STACK_CHECK_START_REL(L2_, 0);
+        // a module that L2_ already knows (a library, or a dependency of a previous module) doesn't need a copy
+        LuaType const _loaded{ luaG_getmodule(L2_, name_) };                                       // L_:                                            L2: module|nil
+        lua_pop(L2_, 1);                                                                           // L_:                                            L2:
+        if (_loaded != LuaType::NIL) {
+            return false;
+        }
+        kStateTemplateNativeRegKey.pushValue(L_);                                                  // L_: {native}                                   L2:
+        LuaType const _native{ luaG_getfield(L_, -1, name_) };                                     // L_: {native} true|nil                          L2:
+        lua_pop(L_, 1);                                                                            // L_: {native}                                   L2:
+        if (_native != LuaType::NIL) {
+            lua_pop(L_, 1);                                                                        // L_:                                            L2:
+            return false;
+        }
+        int const _top2{ lua_gettop(L2_) };
+        lua_pushcfunction(L_, CloneModuleProtected);                                               // L_: {native} CloneModuleProtected              L2:
+        lua_pushlightuserdata(L_, L2_);                                                            // L_: {native} CloneModuleProtected L2           L2:
+        std::ignore = lua_pushstringview(L_, name_);                                               // L_: {native} CloneModuleProtected L2 "name"    L2:
+        lua_pushinteger(L_, cacheIdx_);                                                            // L_: {native} CloneModuleProtected L2 "name" i  L2:
+        if (ToLuaError(lua_pcall(L_, 3, 0, 0)) != LuaError::OK) {                                  // L_: {native} err                               L2: ?
+            // something in the module can't be transferred (native functions, coroutines...): from now on, the lanes will require it themselves
+            DEBUGSPEW_CODE(DebugSpew(Universe::Get(L_)) << "module '" << name_ << "' can't be cloned: " << lua_tostringview(L_, -1) << std::endl);
+            lua_settop(L2_, _top2);                                                                // L_: {native} err                               L2:
+            lua_pushboolean(L_, 1);                                                                // L_: {native} err true                          L2:
+            lua_setfield(L_, -3, name_.data());                                                    // L_: {native} err                               L2:
+            lua_pop(L_, 2);                                                                        // L_:                                            L2:
+            STACK_CHECK(L_, 0);
+            STACK_CHECK(L2_, 0);
+            return false;
+        }                                                                                          // L_: {native}                                   L2: module
+        lua_pop(L_, 1);                                                                            // L_:                                            L2: module
+        // register the functions of the clone in L2_'s name<->function database, just as if L2_ had required it
+        tools::PopulateFuncLookupTable(L2_, -1, name_);
+        lua_pop(L2_, 1);                                                                           // L_:                                            L2:
+        STACK_CHECK(L_, 0);
+        STACK_CHECK(L2_, 0);
+        return true;
+    }
+
+    // #############################################################################################
+    // #############################################################################################
+} // namespace
+// #################################################################################################
+// #################################################################################################
+
+// #################################################################################################
+// #################################################################################################
+// ############################### StateTemplate implementation ####################################
+// #################################################################################################
+// #################################################################################################
+
+StateTemplate::StateTemplate(Universe* const U_)
+: DeepPrelude{ StateTemplateFactory::Instance }
+, U{ U_ }
+{
+}
+
+// #################################################################################################
+
+StateTemplate::~StateTemplate()
+{
+    // the lanes don't reference anything that lives in the template states: they can go away whenever
+    for (lua_State* const _L : idle) {
+        lua_close(_L);
+    }
+}
+
+// #################################################################################################
+
+// a template state that no lane is cloning from, or a new one prepared from the 'package' and 'required' arguments of lane_new() if they are all busy
+[[nodiscard]] lua_State* StateTemplate::acquire(lua_State* const L_, std::optional<std::string_view> const& libs_, int const packageIdx_, int const requiredIdx_)
+{
+    {
+        std::lock_guard<std::mutex> _guard{ mutex };
+        if (!idle.empty()) {
+            lua_State* const _L{ idle.back() };
+            idle.pop_back();
+            return _L;
+        }
+    }
+
+    // the state is built without holding the lock, since requiring modules can raise errors
+    class OnExit
+    {
+        public:
+        lua_State* L{ nullptr };
+
+        ~OnExit()
+        {
+            if (L) {
+                lua_close(L);
+            }
+        }
+    } _onExit{ state::NewLaneState(U, SourceState{ L_ }, libs_) };
+    lua_State* const _L{ _onExit.L };
+    STACK_CHECK_START_REL(L_, 0);
+    STACK_CHECK_START_REL(_L, 0);
+    if (packageIdx_ != 0) {
+        InterCopyContext<LookupMode::LaneBody> _c{ U, DestState{ _L }, SourceState{ L_ }, {}, SourceIndex{ packageIdx_ }, {}, {} };
+        [[maybe_unused]] InterCopyResult const _ret{ _c.inter_copy_package() };
+        LUA_ASSERT(L_, _ret == InterCopyResult::Success); // either all went well, or we should not even get here
+    }
+    // lane_new() raises an error about anything else than strings in the list when it processes it afterwards
+    int const _count{ static_cast<int>(lua_rawlen(L_, requiredIdx_)) };
+    for (int _i{ 1 }; _i <= _count; ++_i) {
+        lua_rawgeti(L_, requiredIdx_, _i);                                                         // L_: "modname"
+        if (lua_type(L_, -1) == LUA_TSTRING) {
+            state::RequireModule(U, L_, _L, lua_tostringview(L_, -1));
+        }
+        lua_pop(L_, 1);                                                                            // L_:
+    }
+    kStateTemplateNativeRegKey.setValue(_L, [](lua_State* L_) { lua_newtable(L_); });
+    STACK_CHECK(_L, 0);
+    STACK_CHECK(L_, 0);
+    return std::exchange(_onExit.L, nullptr);
+}
+
+// #################################################################################################
+
+// the lanes created at the same time clone from different template states, the one they got is kept for the next ones
+void StateTemplate::release(lua_State* const L_)
+{
+    std::lock_guard<std::mutex> _guard{ mutex };
+    idle.push_back(L_);
+}
+
+// #################################################################################################
+// #################################################################################################
+// ################################### StateTemplate::Lease ########################################
+// #################################################################################################
+// #################################################################################################
+
+StateTemplate::Lease::Lease(StateTemplate& owner_, lua_State* const L_, lua_State* const L2_, std::optional<std::string_view> const& libs_, int const packageIdx_, int const requiredIdx_)
+: owner{ owner_ }
+, L{ owner_.acquire(L_, libs_, packageIdx_, requiredIdx_) }
+, L2{ L2_ }
+{
+    lua_newtable(L2);                                                                              // L2: ... {cache}
+    cacheIdx = lua_gettop(L2);
+}
+
+// #################################################################################################
+
+StateTemplate::Lease::~Lease()
+{
+    lua_remove(L2, cacheIdx);                                                                      // L2: ...
+    owner.release(L);
+}
+
+// #################################################################################################
+
+// gives L2 a module required by the template, either cloned from there or actually required
+void StateTemplate::Lease::requireModule(lua_State* const L_, std::string_view const& name_) const
+{
+    // the template state belongs to us: the lock isn't held during the copy
+    if (!CloneModule(L, L2, CacheIndex{ cacheIdx }, name_)) {
+        state::RequireModule(owner.U, L_, L2, name_);
+    }
+}
+
+// #################################################################################################
+// #################################################################################################
+// ################################## StateTemplateFactory #########################################
+// #################################################################################################
+// #################################################################################################
+
+/*static*/ StateTemplateFactory StateTemplateFactory::Instance{};
+
+// #################################################################################################
+
+void StateTemplateFactory::createMetatable(lua_State* L_) const
+{
+    STACK_CHECK_START_REL(L_, 0);
+    lua_newtable(L_);
+    // protect metatable from external access
+    lua_pushliteral(L_, kStateTemplateMetatableName);
+    lua_setfield(L_, -2, "__metatable");
+    STACK_CHECK(L_, 1);
+}
+
+// #################################################################################################
+
+void StateTemplateFactory::deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const
+{
+    StateTemplate* const _template{ static_cast<StateTemplate*>(o_) };
+    LUA_ASSERT(L_, _template);
+    delete _template; // operator delete overload ensures things go as expected
+}
+
+// #################################################################################################
+
+std::string_view StateTemplateFactory::moduleName() const
+{
+    // same as lindas: lanes is necessarily loaded by the time we get here
+    return std::string_view{};
+}
+
+// #################################################################################################
+
+DeepPrelude* StateTemplateFactory::newDeepObjectInternal(lua_State* L_) const
+{
+    Universe* const _U{ Universe::Get(L_) };
+    return new (_U) StateTemplate{ _U };
+}
+
+// #################################################################################################
+// #################################################################################################
+// ########################################## Lua API ##############################################
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * template = lanes.core.state_template()
+ *
+ * returns an empty template, for lanes.gen() to pass to all the lanes of a generator created with the 'template' option
+ */
+LUAG_FUNC(state_template)
+{
+    return StateTemplateFactory::Instance.pushDeepUserdata(DestState{ L_ }, 0);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "deep.h"
+#include "universe.h"
+
+#include <mutex>
+#include <vector>
+
+// #################################################################################################
+
+// states prepared for a generator (libraries, package, required modules), from which the required modules of each new lane are cloned
+// there are as many of them as lanes of the generator that were ever created at the same time, usually one
+class StateTemplate
+: public DeepPrelude // Deep userdata MUST start with this header
+{
+    public:
+    Universe* const U{ nullptr }; // the universe this template belongs to
+
+    // a template state, for the exclusive use of a lane while it clones its required modules from it
+    class Lease
+    {
+        public:
+        StateTemplate& owner;
+        lua_State* const L;
+        lua_State* const L2; // the state of the lane
+        int cacheIdx{ 0 }; // in L2: what was already copied in L2, so that modules sharing something still share it in L2
+
+        Lease(StateTemplate& owner_, lua_State* L_, lua_State* L2_, std::optional<std::string_view> const& libs_, int packageIdx_, int requiredIdx_);
+        ~Lease();
+        // non-copyable, non-movable
+        Lease(Lease const&) = delete;
+        Lease(Lease const&&) = delete;
+        Lease& operator=(Lease const&) = delete;
+        Lease& operator=(Lease const&&) = delete;
+
+        void requireModule(lua_State* L_, std::string_view const& name_) const;
+    };
+
+    private:
+    std::mutex mutex;
+    std::vector<lua_State*> idle; // protected by mutex: the template states that no lane is cloning from
+
+    [[nodiscard]] lua_State* acquire(lua_State* L_, std::optional<std::string_view> const& libs_, int packageIdx_, int requiredIdx_);
+    void release(lua_State* L_);
+
+    public:
+    [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept { return U_->internalAllocator.alloc(size_); }
+    // always embedded somewhere else or "in-place constructed" as a full userdata
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete(void* p_, Universe* U_) { U_->internalAllocator.free(p_, sizeof(StateTemplate)); }
+    // this one is for us, to make sure memory is freed by the correct allocator
+    static void operator delete(void* p_) { static_cast<StateTemplate*>(p_)->U->internalAllocator.free(p_, sizeof(StateTemplate)); }
+
+    ~StateTemplate();
+    StateTemplate(Universe* U_);
+    StateTemplate() = delete;
+    // non-copyable, non-movable
+    StateTemplate(StateTemplate const&) = delete;
+    StateTemplate(StateTemplate const&&) = delete;
+    StateTemplate& operator=(StateTemplate const&) = delete;
+    StateTemplate& operator=(StateTemplate const&&) = delete;
+};
+
+// #################################################################################################
+
+class StateTemplateFactory
+: public DeepFactory
+{
+    public:
+    static StateTemplateFactory Instance;
+
+    private:
+    void createMetatable(lua_State* L_) const override;
+    void deleteDeepObjectInternal(lua_State* L_, DeepPrelude* o_) const override;
+    [[nodiscard]] std::string_view moduleName() const override;
+    [[nodiscard]] DeepPrelude* newDeepObjectInternal(lua_State* L_) const override;
+};
@@ -0,0 +1,351 @@
+/*
+ * THREADCACHE.CPP             Copyright (c) 2024-, Benoit Germain
+ *
+ * Allocator with per-thread caches of small blocks, for the states of the lanes
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "threadcache.h"
+
+#include "universe.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+
+// #################################################################################################
+
+// the blocks of a thread, for the allocator it is bound to
+// a thread allocating for the states of several universes moves its cache from one allocator to the other as needed
+class ThreadCacheAllocator::ThreadCache
+{
+    public:
+    std::atomic<ThreadCacheAllocator*> owner{ nullptr }; // written under the registry mutex
+    int shard{ 0 };
+    ThreadCache* prev{ nullptr }; // links in the owner's list of caches, protected by the registry mutex
+    ThreadCache* next{ nullptr };
+    FreeList lists[kClassCount];
+
+    ThreadCache() = default;
+    ~ThreadCache();
+    void unbind();
+};
+
+// protects the binding of the thread caches to the allocators, that don't live as long as the threads
+static std::mutex sRegistryMutex;
+static thread_local ThreadCacheAllocator::ThreadCache tCache;
+
+// #################################################################################################
+// #################################################################################################
+
+// when the thread exits, its blocks go back to the allocator, if it is still around
+ThreadCacheAllocator::ThreadCache::~ThreadCache()
+{
+    std::lock_guard _guard{ sRegistryMutex };
+    unbind();
+}
+
+// #################################################################################################
+
+// under the registry mutex
+void ThreadCacheAllocator::ThreadCache::unbind()
+{
+    ThreadCacheAllocator* const _owner{ owner.load(std::memory_order_relaxed) };
+    if (_owner == nullptr) {
+        return;
+    }
+    for (int _i{ 0 }; _i < kClassCount; ++_i) {
+        _owner->giveBack(*this, _i, lists[_i].count);
+    }
+    if (prev != nullptr) {
+        prev->next = next;
+    } else {
+        _owner->caches = next;
+    }
+    if (next != nullptr) {
+        next->prev = prev;
+    }
+    prev = next = nullptr;
+    owner.store(nullptr, std::memory_order_relaxed);
+}
+
+// #################################################################################################
+// #################################################################################################
+
+// the states that used this allocator are all closed: the caches still bound to it only hold blocks of its spans
+ThreadCacheAllocator::~ThreadCacheAllocator()
+{
+    std::lock_guard _guard{ sRegistryMutex };
+    for (ThreadCache* _cache{ caches }; _cache != nullptr;) {
+        ThreadCache* const _next{ _cache->next };
+        for (FreeList& _list : _cache->lists) {
+            _list = FreeList{};
+        }
+        _cache->prev = _cache->next = nullptr;
+        _cache->owner.store(nullptr, std::memory_order_relaxed);
+        _cache = _next;
+    }
+    caches = nullptr;
+    for (int _i{ 0 }; _i < spanCount; ++_i) {
+        std::ignore = sourceF(sourceUD, spans[_i], kSpanSize, 0);
+    }
+    if (spans != nullptr) {
+        std::ignore = sourceF(sourceUD, spans, spanCapacity * sizeof(std::byte*), 0);
+    }
+}
+
+// #################################################################################################
+
+[[nodiscard]] void* ThreadCacheAllocator::allocate(size_t const size_)
+{
+    if (size_ > kMaxSmallSize) {
+        return sourceF(sourceUD, nullptr, 0, size_);
+    }
+    int const _class{ ClassOf(size_) };
+    ThreadCache& _cache{ bind() };
+    FreeList& _list{ _cache.lists[_class] };
+    if (_list.head == nullptr) {
+        refill(_cache, _class);
+        if (_list.head == nullptr) {
+            return nullptr;
+        }
+    }
+    FreeBlock* const _block{ _list.head };
+    _list.head = _block->next;
+    --_list.count;
+    return _block;
+}
+
+// #################################################################################################
+
+// the cache of the calling thread, bound to this allocator
+[[nodiscard]] ThreadCacheAllocator::ThreadCache& ThreadCacheAllocator::bind()
+{
+    ThreadCache& _cache{ tCache };
+    if (_cache.owner.load(std::memory_order_relaxed) != this) [[unlikely]] {
+        std::lock_guard _guard{ sRegistryMutex };
+        // the blocks of another allocator go back to it
+        _cache.unbind();
+        _cache.shard = nextShard.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+        _cache.next = caches;
+        if (caches != nullptr) {
+            caches->prev = &_cache;
+        }
+        caches = &_cache;
+        _cache.owner.store(this, std::memory_order_relaxed);
+    }
+    return _cache;
+}
+
+// #################################################################################################
+
+// under the shard mutex: cuts a new span into blocks of the class
+void ThreadCacheAllocator::carve(Shard& shard_, int const class_)
+{
+    std::byte* const _mem{ static_cast<std::byte*>(sourceF(sourceUD, nullptr, 0, kSpanSize)) };
+    if (_mem == nullptr) {
+        return;
+    }
+    if (!recordSpan(_mem)) {
+        std::ignore = sourceF(sourceUD, _mem, kSpanSize, 0);
+        return;
+    }
+    size_t const _blockSize{ (class_ + 1) * kGranularity };
+    FreeList& _list{ shard_.lists[class_] };
+    for (size_t _offset{ 0 }; _offset + _blockSize <= kSpanSize; _offset += _blockSize) {
+        _list.head = new (_mem + _offset) FreeBlock{ _list.head };
+        ++_list.count;
+    }
+}
+
+// #################################################################################################
+
+void ThreadCacheAllocator::deallocate(void* const ptr_, size_t const size_)
+{
+    if (size_ > kMaxSmallSize) {
+        std::ignore = sourceF(sourceUD, ptr_, size_, 0);
+        return;
+    }
+    int const _class{ ClassOf(size_) };
+    ThreadCache& _cache{ bind() };
+    FreeList& _list{ _cache.lists[_class] };
+    _list.head = new (ptr_) FreeBlock{ _list.head };
+    if (++_list.count > kCacheCapacity) {
+        giveBack(_cache, _class, kCacheCapacity / 2);
+    }
+}
+
+// #################################################################################################
+
+// moves count_ blocks of the class from the thread cache to its shard
+void ThreadCacheAllocator::giveBack(ThreadCache& cache_, int const class_, int const count_)
+{
+    if (count_ == 0) {
+        return;
+    }
+    FreeList& _from{ cache_.lists[class_] };
+    // find the end of the sublist that moves, then splice it in one go
+    FreeBlock* const _first{ _from.head };
+    FreeBlock* _last{ _first };
+    for (int _i{ 1 }; _i < count_; ++_i) {
+        _last = _last->next;
+    }
+    _from.head = _last->next;
+    _from.count -= count_;
+
+    Shard& _shard{ shards[cache_.shard] };
+    std::lock_guard _guard{ _shard.mutex };
+    FreeList& _to{ _shard.lists[class_] };
+    _last->next = _to.head;
+    _to.head = _first;
+    _to.count += count_;
+}
+
+// #################################################################################################
+
+// a small block comes from a span, unless it is a block of the source allocator that Lua shrank
+[[nodiscard]] bool ThreadCacheAllocator::isSourceBlock(void* const ptr_)
+{
+    if (smallSourceBlocks.load(std::memory_order_relaxed) == 0) [[likely]] {
+        return false;
+    }
+    std::byte* const _ptr{ static_cast<std::byte*>(ptr_) };
+    std::lock_guard _guard{ spansMutex };
+    // the last span that starts at or before the block is the only one that can contain it
+    std::byte** const _end{ spans + spanCount };
+    std::byte** const _it{ std::upper_bound(spans, _end, _ptr, std::less<>{}) };
+    return _it == spans || !std::less<>{}(_ptr, *(_it - 1) + kSpanSize);
+}
+
+// #################################################################################################
+
+// inserts a new span in the sorted array of spans, returns false if the array can't grow
+[[nodiscard]] bool ThreadCacheAllocator::recordSpan(std::byte* const span_)
+{
+    std::lock_guard _guard{ spansMutex };
+    if (spanCount == spanCapacity) {
+        int const _capacity{ std::max(2 * spanCapacity, 16) };
+        void* const _spans{ sourceF(sourceUD, spans, spanCapacity * sizeof(std::byte*), _capacity * sizeof(std::byte*)) };
+        if (_spans == nullptr) {
+            return false;
+        }
+        spans = static_cast<std::byte**>(_spans);
+        spanCapacity = _capacity;
+    }
+    std::byte** const _end{ spans + spanCount };
+    std::byte** const _it{ std::upper_bound(spans, _end, span_, std::less<>{}) };
+    std::copy_backward(_it, _end, _end + 1);
+    *_it = span_;
+    ++spanCount;
+    return true;
+}
+
+// #################################################################################################
+
+// moves a batch of blocks of the class from the shard of the thread cache to it, carving a new span if the shard has none left
+void ThreadCacheAllocator::refill(ThreadCache& cache_, int const class_)
+{
+    Shard& _shard{ shards[cache_.shard] };
+    std::lock_guard _guard{ _shard.mutex };
+    FreeList& _from{ _shard.lists[class_] };
+    if (_from.head == nullptr) {
+        carve(_shard, class_);
+    }
+    FreeList& _to{ cache_.lists[class_] };
+    while (_from.head != nullptr && _to.count < kBatchSize) {
+        FreeBlock* const _block{ _from.head };
+        _from.head = _block->next;
+        --_from.count;
+        _block->next = _to.head;
+        _to.head = _block;
+        ++_to.count;
+    }
+}
+
+// #################################################################################################
+
+void ThreadCacheAllocator::initFrom(AllocatorDefinition const& source_)
+{
+    sourceF = source_.allocF;
+    sourceUD = source_.allocUD;
+}
+
+// #################################################################################################
+
+[[nodiscard]] AllocatorDefinition ThreadCacheAllocator::makeDefinition()
+{
+    return AllocatorDefinition{ threadcache_lua_Alloc, this };
+}
+
+// #################################################################################################
+
+[[nodiscard]] void* ThreadCacheAllocator::threadcache_lua_Alloc(void* const ud_, void* const ptr_, size_t const osize_, size_t const nsize_)
+{
+    ThreadCacheAllocator* const _allocator{ static_cast<ThreadCacheAllocator*>(ud_) };
+    if (ptr_ == nullptr) {
+        // osize_ is the type of the object being created, we don't care
+        return (nsize_ == 0) ? nullptr : _allocator->allocate(nsize_);
+    }
+    // a block of the source allocator that Lua shrank to a small size remains one until it is freed, or grows big again
+    if (osize_ <= kMaxSmallSize && _allocator->isSourceBlock(ptr_)) {
+        void* const _new{ _allocator->sourceF(_allocator->sourceUD, ptr_, osize_, nsize_) };
+        if (nsize_ == 0 || (_new != nullptr && nsize_ > kMaxSmallSize)) {
+            _allocator->smallSourceBlocks.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return _new;
+    }
+    if (nsize_ == 0) {
+        _allocator->deallocate(ptr_, osize_);
+        return nullptr;
+    }
+    if (osize_ > kMaxSmallSize && nsize_ > kMaxSmallSize) {
+        return _allocator->sourceF(_allocator->sourceUD, ptr_, osize_, nsize_);
+    }
+    if (osize_ <= kMaxSmallSize && nsize_ <= kMaxSmallSize && ClassOf(osize_) == ClassOf(nsize_)) {
+        return ptr_;
+    }
+    // the block moves to another size class, or between the caches and the source allocator
+    void* const _new{ _allocator->allocate(nsize_) };
+    if (_new == nullptr) {
+        if (nsize_ > osize_) {
+            return nullptr;
+        }
+        // Lua expects shrinking to succeed
+        if (osize_ > kMaxSmallSize) {
+            // the block stays with the source allocator (a lua_Alloc doesn't fail when shrinking), that will get it back when it is freed
+            _allocator->smallSourceBlocks.fetch_add(1, std::memory_order_relaxed);
+            return _allocator->sourceF(_allocator->sourceUD, ptr_, osize_, nsize_);
+        }
+        // a block of a bigger class is big enough
+        return ptr_;
+    }
+    memcpy(_new, ptr_, std::min(osize_, nsize_));
+    _allocator->deallocate(ptr_, osize_);
+    return _new;
+}
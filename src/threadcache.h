@@ -0,0 +1,93 @@
+#pragma once
+
+#include "compat.h"
+#include "macros_and_utils.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+class AllocatorDefinition;
+
+// #################################################################################################
+
+// allocator for the states of the lanes and keepers when allocator="threadcache"
+// the small blocks Lua allocates come from a cache that belongs to the calling thread, without any lock
+// each size class of a cache is refilled from (and overflows into) one of several shards of a central heap, that carve them from spans obtained from the source allocator
+// a block can be freed by any thread: it simply goes in the cache of that thread
+// big blocks go straight to the source allocator
+class ThreadCacheAllocator
+{
+    public:
+    static constexpr size_t kGranularity{ 16 }; // also the alignment of all blocks
+    static constexpr size_t kMaxSmallSize{ 512 }; // bigger blocks are not cached
+    static constexpr int kClassCount{ static_cast<int>(kMaxSmallSize / kGranularity) };
+    static constexpr int kShardCount{ 8 };
+    static constexpr size_t kSpanSize{ 64 * 1024 }; // how much memory a shard obtains from the source allocator at once
+    static constexpr int kBatchSize{ 32 }; // how many blocks move at once between a thread cache and a shard
+    static constexpr int kCacheCapacity{ 4 * kBatchSize }; // how many blocks of each class a thread cache keeps at most
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct FreeList
+    {
+        FreeBlock* head{ nullptr };
+        int count{ 0 };
+    };
+
+    class ThreadCache;
+
+    private:
+    // not alignas(64): the allocator is a member of the Universe, which lives in a full userdata that is only as aligned as the Lua allocator makes it
+    // the padding keeps the hot part of neighbouring shards on different cache lines all the same
+    struct Shard
+    {
+        std::mutex mutex;
+        FreeList lists[kClassCount]; // protected by mutex
+        char padding[64];
+    };
+
+    // where the spans and the big blocks come from (must be thread-safe)
+    lua_Alloc sourceF{ nullptr };
+    void* sourceUD{ nullptr };
+    Shard shards[kShardCount];
+    ThreadCache* caches{ nullptr }; // the thread caches bound to this allocator, protected by the registry mutex
+    std::atomic<int> nextShard{ 0 };
+    // the start of all the spans carved so far, sorted by address, released when the allocator goes away
+    // the array itself comes from the source allocator too, so that growing it can fail like any allocation
+    std::mutex spansMutex;
+    std::byte** spans{ nullptr }; // protected by spansMutex
+    int spanCount{ 0 }; // protected by spansMutex
+    int spanCapacity{ 0 }; // protected by spansMutex
+    // how many blocks of the source allocator Lua shrank to a small size: only then must a small block be checked against the spans
+    std::atomic<int> smallSourceBlocks{ 0 };
+
+    public:
+    ThreadCacheAllocator() = default;
+    ~ThreadCacheAllocator();
+    // non-copyable, non-movable
+    ThreadCacheAllocator(ThreadCacheAllocator const&) = delete;
+    ThreadCacheAllocator(ThreadCacheAllocator const&&) = delete;
+    ThreadCacheAllocator& operator=(ThreadCacheAllocator const&) = delete;
+    ThreadCacheAllocator& operator=(ThreadCacheAllocator const&&) = delete;
+
+    private:
+    [[nodiscard]] static void* threadcache_lua_Alloc(void* ud_, void* ptr_, size_t osize_, size_t nsize_);
+    [[nodiscard]] static int ClassOf(size_t size_) { return static_cast<int>((size_ - 1) / kGranularity); }
+
+    [[nodiscard]] void* allocate(size_t size_);
+    [[nodiscard]] ThreadCache& bind();
+    void carve(Shard& shard_, int class_);
+    void deallocate(void* ptr_, size_t size_);
+    void giveBack(ThreadCache& cache_, int class_, int count_);
+    [[nodiscard]] bool isSourceBlock(void* ptr_);
+    [[nodiscard]] bool recordSpan(std::byte* span_);
+    void refill(ThreadCache& cache_, int class_);
+
+    public:
+    void initFrom(AllocatorDefinition const& source_);
+    [[nodiscard]] AllocatorDefinition makeDefinition();
+};
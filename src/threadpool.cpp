@@ -0,0 +1,187 @@
+/*
+ * THREADPOOL.CPP             Copyright (c) 2024-, Benoit Germain
+ *
+ * OS threads reused from one lane to the next
+ */
+
+/*
+===============================================================================
+
+Copyright (C) 2024- benoit Germain <bnt.germain@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+===============================================================================
+*/
+
+#include "threadpool.h"
+
+#include "threading.h"
+#include "universe.h"
+
+// #################################################################################################
+// #################################################################################################
+// ################################## ThreadPool implementation ####################################
+// #################################################################################################
+// #################################################################################################
+
+void* ThreadPool::operator new(size_t size_, Universe* U_) noexcept
+{
+    return U_->internalAllocator.alloc(size_);
+}
+
+// #################################################################################################
+
+void ThreadPool::operator delete(void* p_, Universe* U_)
+{
+    U_->internalAllocator.free(p_, sizeof(ThreadPool));
+}
+
+// #################################################################################################
+
+void ThreadPool::operator delete(void* p_)
+{
+    static_cast<ThreadPool*>(p_)->U->internalAllocator.free(p_, sizeof(ThreadPool));
+}
+
+// #################################################################################################
+
+ThreadPool::ThreadPool(Universe* const U_, int const capacity_, lua_Duration const idleTimeout_)
+: U{ U_ }
+, capacity{ capacity_ }
+, idleTimeout{ idleTimeout_ }
+{
+}
+
+// #################################################################################################
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock _guard{ mutex };
+        stopping = true;
+        workAvailable.notify_all();
+        // the lanes are all gone, but their threads might not have noticed yet
+        workerRetired.wait(_guard, [this]() { return workers.empty(); });
+    }
+    // joins all the threads
+    retired.clear();
+}
+
+// #################################################################################################
+
+int ThreadPool::getIdleCount()
+{
+    std::lock_guard _guard{ mutex };
+    return idleCount;
+}
+
+// #################################################################################################
+
+void ThreadPool::launch(Job const job_, Lane* const lane_, int const priority_)
+{
+    // declared before the lock so that the retired threads are joined after it is released
+    Workers _retired;
+    std::lock_guard _guard{ mutex };
+    _retired.splice(_retired.end(), retired);
+    if (idleCount > static_cast<int>(tasks.size())) {
+        tasks.push_back(Task{ job_, lane_, priority_ });
+        workAvailable.notify_one();
+        reused.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        // the new thread needs to know where it is stored so that it can move itself to the retired list when it leaves
+        Workers::iterator const _it{ workers.emplace(workers.end()) };
+        *_it = std::jthread{ [this, _it, _task = Task{ job_, lane_, priority_ }]() { workerMain(_it, _task); } };
+        created.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// #################################################################################################
+
+void ThreadPool::run(Task const& task_) const
+{
+    if (task_.priority != kThreadPrioDefault) {
+        THREAD_SET_PRIORITY(task_.priority, U->sudo);
+    }
+    task_.job(task_.lane);
+    // don't let the next lane inherit the priority and the name of this one
+    if (task_.priority != kThreadPrioDefault) {
+        THREAD_SET_PRIORITY(0, U->sudo);
+    }
+    THREAD_SETNAME("lanes-pool");
+}
+
+// #################################################################################################
+
+void ThreadPool::workerMain(Workers::iterator const self_, Task task_)
+{
+    THREAD_SETNAME("lanes-pool");
+    std::unique_lock _guard{ mutex, std::defer_lock };
+    while (true) {
+        run(task_);
+        _guard.lock();
+        if (stopping || idleCount >= capacity) {
+            break;
+        }
+        ++idleCount;
+        std::ignore = workAvailable.wait_for(_guard, idleTimeout, [this]() { return stopping || !tasks.empty(); });
+        --idleCount;
+        // a task pushed while we were idle is ours even if the pool is stopping
+        if (tasks.empty()) {
+            break;
+        }
+        task_ = tasks.front();
+        tasks.pop_front();
+        _guard.unlock();
+    }
+    // we can't join ourselves: the next launch or the pool destruction does it
+    retired.splice(retired.end(), workers, self_);
+    retiredCount.fetch_add(1, std::memory_order_relaxed);
+    workerRetired.notify_all();
+}
+
+// #################################################################################################
+// #################################################################################################
+// ########################################## Lua API ##############################################
+// #################################################################################################
+// #################################################################################################
+
+/*
+ * {} = lanes.thread_pool_stats()
+ *
+ * capacity, idle: the maximum and current number of idle threads in the pool (capacity is 0 when the pool is disabled)
+ * created, reused: the number of lanes that had to start a thread, or were given an idle one
+ * retired: the number of threads that left the pool
+ */
+LUAG_FUNC(thread_pool_stats)
+{
+    ThreadPool* const _pool{ Universe::Get(L_)->threadPool };
+    lua_createtable(L_, 0, 5);                                                                     // L_: {}
+    lua_pushinteger(L_, _pool ? _pool->getCapacity() : 0);                                         // L_: {} capacity
+    lua_setfield(L_, -2, "capacity");                                                              // L_: {}
+    lua_pushinteger(L_, _pool ? _pool->getIdleCount() : 0);                                        // L_: {} idle
+    lua_setfield(L_, -2, "idle");                                                                  // L_: {}
+    lua_pushinteger(L_, _pool ? _pool->created.load(std::memory_order_relaxed) : 0);               // L_: {} created
+    lua_setfield(L_, -2, "created");                                                               // L_: {}
+    lua_pushinteger(L_, _pool ? _pool->reused.load(std::memory_order_relaxed) : 0);                // L_: {} reused
+    lua_setfield(L_, -2, "reused");                                                                // L_: {}
+    lua_pushinteger(L_, _pool ? _pool->retiredCount.load(std::memory_order_relaxed) : 0);          // L_: {} retired
+    lua_setfield(L_, -2, "retired");                                                               // L_: {}
+    return 1;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "compat.h"
+#include "macros_and_utils.h"
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+
+// forwards
+class Lane;
+class Universe;
+
+// #################################################################################################
+
+// OS threads kept around after the lane they ran has ended, so that the next lanes don't pay for a thread creation
+// a thread that stays idle longer than the timeout, or finds the pool full, retires
+class ThreadPool
+{
+    public:
+    using Job = void (*)(Lane*);
+
+    private:
+    struct Task
+    {
+        Job job;
+        Lane* lane;
+        int priority;
+    };
+    using Workers = std::list<std::jthread>;
+
+    Universe* const U;
+    int const capacity; // maximum number of idle threads
+    lua_Duration const idleTimeout;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workerRetired;
+    std::deque<Task> tasks; // protected by mutex
+    int idleCount{ 0 }; // protected by mutex
+    bool stopping{ false }; // protected by mutex
+    Workers workers; // protected by mutex
+    Workers retired; // protected by mutex, threads that left and wait to be joined
+
+    public:
+    // statistics
+    std::atomic<int> created{ 0 }; // threads started because none was idle
+    std::atomic<int> reused{ 0 }; // lanes handed to an idle thread
+    std::atomic<int> retiredCount{ 0 }; // threads that left the pool
+
+    [[nodiscard]] static void* operator new(size_t size_, Universe* U_) noexcept;
+    // can't actually delete the operator because the compiler generates stack unwinding code that could call it in case of exception
+    static void operator delete(void* p_, Universe* U_);
+    // this one is for us, to make sure memory is freed by the correct allocator
+    static void operator delete(void* p_);
+
+    ThreadPool(Universe* U_, int capacity_, lua_Duration idleTimeout_);
+    ~ThreadPool();
+    ThreadPool() = delete;
+    // non-copyable, non-movable
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool(ThreadPool const&&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&&) = delete;
+
+    private:
+    void run(Task const& task_) const;
+    void workerMain(Workers::iterator self_, Task task_);
+
+    public:
+    [[nodiscard]] int getCapacity() const { return capacity; }
+    [[nodiscard]] int getIdleCount();
+    void launch(Job job_, Lane* lane_, int priority_);
+};
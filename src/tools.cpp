@@ -42,6 +42,9 @@ DEBUGSPEW_CODE(std::string_view const DebugSpewIndentScope::debugspew_indent{ "-
 // xxh64 of string "kLookupCacheRegKey" generated at https://www.pelock.com/products/hash-calculator
 static constexpr RegistryUniqueKey kLookupCacheRegKey{ 0x9BF75F84E54B691Bull };
 
+// xxh64 of string "kLookupPendingRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kLookupPendingRegKey{ 0x17B0AB2043D3967Bull }; // modules registered but not scanned yet
+
 // #################################################################################################
 
 static constexpr int kWriterReturnCode{ 666 };
@@ -89,6 +92,21 @@ static constexpr int kWriterReturnCode{ 666 };
 
 // #################################################################################################
 
+[[nodiscard]] lua_CFunction luaG_tolightcfunction(lua_State* const L_, int const i_)
+{
+    lua_CFunction const _f{ lua_tocfunction(L_, i_) };
+    if (_f == nullptr) {
+        return nullptr;
+    }
+    if (lua_getupvalue(L_, i_, 1) != nullptr) {                                                    // L_: ... upvalue
+        lua_pop(L_, 1);                                                                            // L_: ...
+        return nullptr;
+    }
+    return _f;
+}
+
+// #################################################################################################
+
 namespace tools {
 
     // inspired from tconcat() in ltablib.c
@@ -118,6 +136,28 @@ namespace tools {
 
 // #################################################################################################
 
+// a native function without upvalues is exchanged under the name the Universe-wide index gives it, whatever name this state found
+// record it under that name, so that this state can resolve it when it receives it
+static void update_func_index(Universe* const U_, lua_State* const L_, int const i_, std::string_view const& name_)
+{
+    lua_CFunction const _f{ luaG_tolightcfunction(L_, i_) };
+    if (_f == nullptr) {
+        return;
+    }
+    int const _i{ lua_absindex(L_, i_) };
+    std::string_view const _name{ U_->funcLookupIndex.add(_f, name_) };
+    STACK_GROW(L_, 3);
+    STACK_CHECK_START_REL(L_, 0);
+    std::ignore = kLookupIndexRegKey.getSubTable(L_, 0, 0);                                        // L_: ... {index}
+    std::ignore = lua_pushstringview(L_, _name);                                                   // L_: ... {index} "name"
+    lua_pushvalue(L_, _i);                                                                         // L_: ... {index} "name" f
+    lua_rawset(L_, -3);                                                                            // L_: ... {index}
+    lua_pop(L_, 1);                                                                                // L_: ...
+    STACK_CHECK(L_, 0);
+}
+
+// #################################################################################################
+
 /*
  * receives 2 arguments: a name k and an object o
  * add two entries ["fully.qualified.name"] = o
@@ -126,14 +166,14 @@ namespace tools {
  * if we already had an entry of type [o] = ..., replace the name if the new one is shorter
  * pops the processed object from the stack
  */
-static void update_lookup_entry(lua_State* L_, int ctxBase_, int depth_)
+static void update_lookup_entry(Universe* const U_, lua_State* L_, int ctxBase_, int depth_)
 {
     // slot 1 in the stack contains the table that receives everything we found
     int const _dest{ ctxBase_ };
     // slot 2 contains a table that, when concatenated, produces the fully qualified name of scanned elements in the table provided at slot _i
     int const _fqn{ ctxBase_ + 1 };
 
-    DEBUGSPEW_CODE(Universe* const _U{ Universe::Get(L_) });
+    DEBUGSPEW_CODE(Universe* const _U{ U_ });
     DEBUGSPEW_CODE(DebugSpew(_U) << "update_lookup_entry()" << std::endl);
     DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
 
@@ -149,6 +189,7 @@ static void update_lookup_entry(lua_State* L_, int ctxBase_, int depth_)
     lua_rawseti(L_, _fqn, depth_);                                                                 // L_: ... {bfc} k o name?
     // generate name
     std::string_view const _newName{ tools::PushFQN(L_, _fqn, depth_) };                           // L_: ... {bfc} k o name? "f.q.n"
+    update_func_index(U_, L_, -3, _newName);
     // Lua 5.2 introduced a hash randomizer seed which causes table iteration to yield a different key order
     // on different VMs even when the tables are populated the exact same way.
     // When Lua is built with compatibility options (such as LUA_COMPAT_ALL),
@@ -193,14 +234,14 @@ static void update_lookup_entry(lua_State* L_, int ctxBase_, int depth_)
 
 // #################################################################################################
 
-static void populate_func_lookup_table_recur(lua_State* L_, int dbIdx_, int i_, int depth_)
+static void populate_func_lookup_table_recur(Universe* const U_, lua_State* L_, int dbIdx_, int i_, int depth_)
 {
     // slot dbIdx_ contains the lookup database table
     // slot dbIdx_ + 1 contains a table that, when concatenated, produces the fully qualified name of scanned elements in the table provided at slot i_
     int const _fqn{ dbIdx_ + 1 };
     // slot dbIdx_ + 2 contains a cache that stores all already visited tables to avoid infinite recursion loops
     int const _cache{ dbIdx_ + 2 };
-    DEBUGSPEW_CODE(Universe* const _U{ Universe::Get(L_) });
+    DEBUGSPEW_CODE(Universe* const _U{ U_ });
     DEBUGSPEW_CODE(DebugSpew(_U) << "populate_func_lookup_table_recur()" << std::endl);
     DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
 
@@ -254,11 +295,11 @@ static void populate_func_lookup_table_recur(lua_State* L_, int dbIdx_, int i_,
             lua_pushvalue(L_, -2);                                                                 // L_: ... {i_} {bfc} k {} k {}
             lua_rawset(L_, breadthFirstCache);                                                     // L_: ... {i_} {bfc} k {}
             // generate a name, and if we already had one name, keep whichever is the shorter
-            update_lookup_entry(L_, dbIdx_, depth_);                                               // L_: ... {i_} {bfc} k
+            update_lookup_entry(U_, L_, dbIdx_, depth_);                                           // L_: ... {i_} {bfc} k
         } else if (lua_isfunction(L_, -1) && (luaG_getfuncsubtype(L_, -1) != FuncSubType::Bytecode)) {
             // generate a name, and if we already had one name, keep whichever is the shorter
             // this pops the function from the stack
-            update_lookup_entry(L_, dbIdx_, depth_);                                               // L_: ... {i_} {bfc} k
+            update_lookup_entry(U_, L_, dbIdx_, depth_);                                           // L_: ... {i_} {bfc} k
         } else {
             lua_pop(L_, 1); // L_: ... {i_} {bfc} k
         }
@@ -287,7 +328,7 @@ static void populate_func_lookup_table_recur(lua_State* L_, int dbIdx_, int i_,
         // push table name in fqn stack (note that concatenation will crash if name is a not string!)
         lua_pushvalue(L_, -2);                                                                     // L_: ... {i_} {bfc} k {} k
         lua_rawseti(L_, _fqn, depth_);                                                             // L_: ... {i_} {bfc} k {}
-        populate_func_lookup_table_recur(L_, dbIdx_, lua_gettop(L_), depth_);
+        populate_func_lookup_table_recur(U_, L_, dbIdx_, lua_gettop(L_), depth_);
         lua_pop(L_, 1);                                                                            // L_: ... {i_} {bfc} k
         STACK_CHECK(L_, 2);
     }
@@ -301,58 +342,174 @@ static void populate_func_lookup_table_recur(lua_State* L_, int dbIdx_, int i_,
     // we are done                                                                                 // L_: ... {i_} {bfc}
 }
 
+// #################################################################################################
+
+// create a "fully.qualified.name" <-> function equivalence database
+static void scan_func_lookup_table(lua_State* const L_, int const i_, std::string_view const& name_)
+{
+    int const _in_base{ lua_absindex(L_, i_) };
+    Universe* const _U{ Universe::Get(L_) };
+    std::string_view _name{ name_.empty() ? std::string_view{} : name_ };
+    DEBUGSPEW_CODE(DebugSpew(_U) << L_ << ": scan_func_lookup_table('" << _name << "')" << std::endl);
+    DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
+    STACK_GROW(L_, 3);
+    STACK_CHECK_START_REL(L_, 0);
+    kLookupRegKey.pushValue(L_);                                                                   // L_: {}
+    int const _dbIdx{ lua_gettop(L_) };
+    STACK_CHECK(L_, 1);
+    LUA_ASSERT(L_, lua_istable(L_, -1));
+    if (lua_type(L_, _in_base) == LUA_TFUNCTION) { // for example when a module is a simple function
+        if (_name.empty()) {
+            _name = "nullptr";
+        }
+        lua_pushvalue(L_, _in_base);                                                               // L_: {} f
+        std::ignore = lua_pushstringview(L_, _name);                                               // L_: {} f name_
+        lua_rawset(L_, -3);                                                                        // L_: {}
+        std::ignore = lua_pushstringview(L_, _name);                                               // L_: {} name_
+        lua_pushvalue(L_, _in_base);                                                               // L_: {} name_ f
+        lua_rawset(L_, -3);                                                                        // L_: {}
+        lua_pop(L_, 1);                                                                            // L_:
+        update_func_index(_U, L_, _in_base, _name);
+    } else if (lua_type(L_, _in_base) == LUA_TTABLE) {
+        lua_newtable(L_);                                                                          // L_: {} {fqn}
+        int _startDepth{ 0 };
+        if (!_name.empty()) {
+            STACK_CHECK(L_, 2);
+            std::ignore = lua_pushstringview(L_, _name);                                           // L_: {} {fqn} "name"
+            // generate a name, and if we already had one name, keep whichever is the shorter
+            lua_pushvalue(L_, _in_base);                                                           // L_: {} {fqn} "name" t
+            update_lookup_entry(_U, L_, _dbIdx, _startDepth);                                      // L_: {} {fqn} "name"
+            // don't forget to store the name at the bottom of the fqn stack
+            lua_rawseti(L_, -2, ++_startDepth);                                                    // L_: {} {fqn}
+            STACK_CHECK(L_, 2);
+        }
+        // retrieve the cache, create it if we haven't done it yet
+        std::ignore = kLookupCacheRegKey.getSubTable(L_, 0, 0);                                    // L_: {} {fqn} {cache}
+        // process everything we find in that table, filling in lookup data for all functions and tables we see there
+        populate_func_lookup_table_recur(_U, L_, _dbIdx, _in_base, _startDepth);
+        lua_pop(L_, 3);                                                                            // L_:
+    } else {
+        lua_pop(L_, 1);                                                                            // L_:
+        raise_luaL_error(L_, "unsupported module type %s", lua_typename(L_, lua_type(L_, _in_base)));
+    }
+    STACK_CHECK(L_, 0);
+}
+
+
 // #################################################################################################
 
 namespace tools {
 
-    // create a "fully.qualified.name" <-> function equivalence database
+    // the actual scan is deferred until some transfer fails to find what it needs in the lookup database, see ScanNextPendingLookup()
     void PopulateFuncLookupTable(lua_State* const L_, int const i_, std::string_view const& name_)
     {
         int const _in_base{ lua_absindex(L_, i_) };
-        DEBUGSPEW_CODE(Universe* _U = Universe::Get(L_));
-        std::string_view _name{ name_.empty() ? std::string_view{} : name_ };
-        DEBUGSPEW_CODE(DebugSpew(_U) << L_ << ": PopulateFuncLookupTable('" << _name << "')" << std::endl);
-        DEBUGSPEW_CODE(DebugSpewIndentScope _scope{ _U });
+        if (lua_type(L_, _in_base) != LUA_TFUNCTION && lua_type(L_, _in_base) != LUA_TTABLE) {
+            raise_luaL_error(L_, "unsupported module type %s", lua_typename(L_, lua_type(L_, _in_base)));
+        }
+        // unnamed modules (i.e. _G) are scanned right away: a deferred scan would also see the modules loaded in the meantime, and give them longer names
+        // but first, scan whatever was registered before, so that the order is preserved
+        if (name_.empty()) {
+            while (ScanNextPendingLookup(L_)) {}
+            scan_func_lookup_table(L_, _in_base, name_);
+            return;
+        }
         STACK_GROW(L_, 3);
         STACK_CHECK_START_REL(L_, 0);
-        kLookupRegKey.pushValue(L_);                                                               // L_: {}
-        int const _dbIdx{ lua_gettop(L_) };
-        STACK_CHECK(L_, 1);
-        LUA_ASSERT(L_, lua_istable(L_, -1));
-        if (lua_type(L_, _in_base) == LUA_TFUNCTION) { // for example when a module is a simple function
-            if (_name.empty()) {
-                _name = "nullptr";
-            }
-            lua_pushvalue(L_, _in_base);                                                           // L_: {} f
-            std::ignore = lua_pushstringview(L_, _name);                                           // L_: {} f name_
-            lua_rawset(L_, -3);                                                                    // L_: {}
-            std::ignore = lua_pushstringview(L_, _name);                                           // L_: {} name_
-            lua_pushvalue(L_, _in_base);                                                           // L_: {} name_ f
-            lua_rawset(L_, -3);                                                                    // L_: {}
+        // pending modules are stored as name, module pairs in registration order
+        // 'head' is the index of the next pair to scan, 'tail' the one where the next pair goes (scanned pairs leave holes, so the length of the table is meaningless)
+        // table modules are also keys of the pending table, so that a table lookup miss can tell if a scan could ever find it
+        if (!kLookupPendingRegKey.getSubTable(L_, 0, 2)) {                                         // L_: {pending}
+            lua_pushinteger(L_, 1);                                                                // L_: {pending} 1
+            lua_setfield(L_, -2, "head");                                                          // L_: {pending}
+            lua_pushinteger(L_, 1);                                                                // L_: {pending} 1
+            lua_setfield(L_, -2, "tail");                                                          // L_: {pending}
+        }
+        std::ignore = luaG_getfield(L_, -1, "tail");                                               // L_: {pending} tail
+        int const _tail{ static_cast<int>(lua_tointeger(L_, -1)) };
+        lua_pop(L_, 1);                                                                            // L_: {pending}
+        std::ignore = lua_pushstringview(L_, name_);                                               // L_: {pending} "name"
+        lua_rawseti(L_, -2, _tail);                                                                // L_: {pending}
+        lua_pushvalue(L_, _in_base);                                                               // L_: {pending} module
+        lua_rawseti(L_, -2, _tail + 1);                                                            // L_: {pending}
+        if (lua_istable(L_, _in_base)) {
+            lua_pushvalue(L_, _in_base);                                                           // L_: {pending} module
+            lua_pushboolean(L_, 1);                                                                // L_: {pending} module true
+            lua_rawset(L_, -3);                                                                    // L_: {pending}
+        }
+        lua_pushinteger(L_, _tail + 2);                                                            // L_: {pending} tail
+        lua_setfield(L_, -2, "tail");                                                              // L_: {pending}
+        lua_pop(L_, 1);                                                                            // L_:
+        STACK_CHECK(L_, 0);
+    }
+
+    // #############################################################################################
+
+    // scan the oldest module registered with PopulateFuncLookupTable() that wasn't scanned yet
+    // modules are scanned in registration order, so that the names we generate are the same as if everything had been scanned upfront
+    // returns false if there was nothing left to scan, i.e. a lookup miss is final
+    [[nodiscard]] bool ScanNextPendingLookup(lua_State* const L_)
+    {
+        STACK_GROW(L_, 3);
+        STACK_CHECK_START_REL(L_, 0);
+        kLookupPendingRegKey.pushValue(L_);                                                        // L_: {pending}|nil
+        if (lua_isnil(L_, -1)) {
             lua_pop(L_, 1);                                                                        // L_:
-        } else if (lua_type(L_, _in_base) == LUA_TTABLE) {
-            lua_newtable(L_);                                                                      // L_: {} {fqn}
-            int _startDepth{ 0 };
-            if (!_name.empty()) {
-                STACK_CHECK(L_, 2);
-                std::ignore = lua_pushstringview(L_, _name);                                       // L_: {} {fqn} "name"
-                // generate a name, and if we already had one name, keep whichever is the shorter
-                lua_pushvalue(L_, _in_base);                                                       // L_: {} {fqn} "name" t
-                update_lookup_entry(L_, _dbIdx, _startDepth);                                      // L_: {} {fqn} "name"
-                // don't forget to store the name at the bottom of the fqn stack
-                lua_rawseti(L_, -2, ++_startDepth);                                                // L_: {} {fqn}
-                STACK_CHECK(L_, 2);
-            }
-            // retrieve the cache, create it if we haven't done it yet
-            std::ignore = kLookupCacheRegKey.getSubTable(L_, 0, 0);                                // L_: {} {fqn} {cache}
-            // process everything we find in that table, filling in lookup data for all functions and tables we see there
-            populate_func_lookup_table_recur(L_, _dbIdx, _in_base, _startDepth);
-            lua_pop(L_, 3);                                                                        // L_:
-        } else {
+            STACK_CHECK(L_, 0);
+            return false;
+        }
+        std::ignore = luaG_getfield(L_, -1, "head");                                               // L_: {pending} head
+        int const _first{ static_cast<int>(lua_tointeger(L_, -1)) };
+        std::ignore = luaG_getfield(L_, -2, "tail");                                               // L_: {pending} head tail
+        int const _tail{ static_cast<int>(lua_tointeger(L_, -1)) };
+        lua_pop(L_, 2);                                                                            // L_: {pending}
+        if (_first >= _tail) {
             lua_pop(L_, 1);                                                                        // L_:
-            raise_luaL_error(L_, "unsupported module type %s", lua_typename(L_, lua_type(L_, _in_base)));
+            // everything was scanned: drop the list so that the next misses are settled with a single registry access
+            kLookupPendingRegKey.setValue(L_, [](lua_State* L_) { lua_pushnil(L_); });
+            STACK_CHECK(L_, 0);
+            return false;
+        }
+        lua_rawgeti(L_, -1, _first);                                                               // L_: {pending} "name"
+        lua_rawgeti(L_, -2, _first + 1);                                                           // L_: {pending} "name" module
+        // forget this module before scanning it, it won't be pending anymore whatever happens
+        lua_pushnil(L_);                                                                           // L_: {pending} "name" module nil
+        lua_rawseti(L_, -4, _first + 1);                                                           // L_: {pending} "name" module
+        lua_pushnil(L_);                                                                           // L_: {pending} "name" module nil
+        lua_rawseti(L_, -4, _first);                                                               // L_: {pending} "name" module
+        lua_pushinteger(L_, _first + 2);                                                           // L_: {pending} "name" module head
+        lua_setfield(L_, -4, "head");                                                              // L_: {pending} "name" module
+        if (lua_istable(L_, -1)) {
+            lua_pushvalue(L_, -1);                                                                 // L_: {pending} "name" module module
+            lua_pushnil(L_);                                                                       // L_: {pending} "name" module module nil
+            lua_rawset(L_, -5);                                                                    // L_: {pending} "name" module
+        }
+        scan_func_lookup_table(L_, -1, lua_tostringview(L_, -2));
+        lua_pop(L_, 3);                                                                            // L_:
+        STACK_CHECK(L_, 0);
+        return true;
+    }
+
+    // #############################################################################################
+
+    // a table lookup miss is only worth a scan if the table is a module that wasn't scanned yet
+    // (the tables found inside a module are only known once it is scanned, but then so is the module itself)
+    [[nodiscard]] bool IsPendingLookupModule(lua_State* const L_, int const i_)
+    {
+        int const _i{ lua_absindex(L_, i_) };
+        STACK_GROW(L_, 2);
+        STACK_CHECK_START_REL(L_, 0);
+        kLookupPendingRegKey.pushValue(L_);                                                        // L_: {pending}|nil
+        bool _pending{ false };
+        if (lua_istable(L_, -1)) {
+            lua_pushvalue(L_, _i);                                                                 // L_: {pending} t
+            lua_rawget(L_, -2);                                                                    // L_: {pending} true|nil
+            _pending = lua_toboolean(L_, -1);
+            lua_pop(L_, 1);                                                                        // L_: {pending}
         }
+        lua_pop(L_, 1);                                                                            // L_:
         STACK_CHECK(L_, 0);
+        return _pending;
     }
 
 } // namespace tools
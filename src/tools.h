@@ -19,6 +19,8 @@ enum class FuncSubType
 };
 
 [[nodiscard]] FuncSubType luaG_getfuncsubtype(lua_State* L_, int _i);
+// returns the native function at the given index if it has no upvalues (so that it is fully identified by its address), else nullptr
+[[nodiscard]] lua_CFunction luaG_tolightcfunction(lua_State* L_, int i_);
 
 // #################################################################################################
 
@@ -28,10 +30,15 @@ static constexpr RegistryUniqueKey kConfigRegKey{ 0x608379D20A398046ull }; // re
 // xxh64 of string "kLookupRegKey" generated at https://www.pelock.com/products/hash-calculator
 static constexpr RegistryUniqueKey kLookupRegKey{ 0xBF1FC5CF3C6DD47Bull }; // registry key to access the lookup database
 
+// xxh64 of string "kLookupIndexRegKey" generated at https://www.pelock.com/products/hash-calculator
+static constexpr RegistryUniqueKey kLookupIndexRegKey{ 0x76A2FE9F320F9789ull }; // Universe-wide name -> native function of this state, see FuncLookupIndex
+
 // #################################################################################################
 
 namespace tools {
     void PopulateFuncLookupTable(lua_State* const L_, int const i_, std::string_view const& name_);
     [[nodiscard]] std::string_view PushFQN(lua_State* L_, int t_, int last_);
+    [[nodiscard]] bool ScanNextPendingLookup(lua_State* L_);
+    [[nodiscard]] bool IsPendingLookupModule(lua_State* L_, int i_);
     void SerializeRequire(lua_State* L_);
 } // namespace tools
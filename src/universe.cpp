@@ -34,6 +34,9 @@ THE SOFTWARE.
 #include "intercopycontext.h"
 #include "keeper.h"
 #include "lane.h"
+#include "scheduler.h"
+#include "statereaper.h"
+#include "threadpool.h"
 #include "state.h"
 
 #include <ranges>
@@ -47,6 +50,98 @@ static constexpr RegistryUniqueKey kUniverseFullRegKey{ 0x1C2D76870DD9DD9Full };
 
 // #################################################################################################
 
+[[nodiscard]] std::string_view FuncLookupIndex::find(lua_CFunction const f_) const
+{
+    std::shared_lock _guard{ mutex };
+    auto const _it{ index.find(f_) };
+    return (_it != index.end()) ? _it->second : std::string_view{};
+}
+
+// #################################################################################################
+
+[[nodiscard]] std::string_view FuncLookupIndex::add(lua_CFunction const f_, std::string_view const& name_)
+{
+    {
+        // most of the time, the function is already known because another state scanned the same module
+        std::shared_lock _guard{ mutex };
+        if (auto const _it{ index.find(f_) }; _it != index.end()) {
+            return _it->second;
+        }
+    }
+    std::unique_lock _guard{ mutex };
+    auto const [_it, _inserted] = index.try_emplace(f_);
+    if (_inserted) {
+        _it->second = names.emplace_back(name_);
+    }
+    return _it->second;
+}
+
+// #################################################################################################
+
+void CTypeRegistry::add(std::string_view const& name_, std::string_view const& declaration_)
+{
+    std::unique_lock _guard{ mutex };
+    std::string_view const _name{ internLocked(name_) };
+    std::string_view const _declaration{ declaration_.empty() ? std::string_view{} : internLocked(declaration_) };
+    auto const [_it, _inserted] = declarations.try_emplace(_name, _declaration);
+    // registering again without a declaration doesn't forget the one we already have
+    if (!_inserted && !_declaration.empty()) {
+        _it->second = _declaration;
+    }
+}
+
+// #################################################################################################
+
+[[nodiscard]] std::optional<std::string_view> CTypeRegistry::findDeclaration(std::string_view const& name_) const
+{
+    std::shared_lock _guard{ mutex };
+    auto const _it{ declarations.find(name_) };
+    return (_it != declarations.end()) ? std::optional<std::string_view>{ _it->second } : std::nullopt;
+}
+
+// #################################################################################################
+
+[[nodiscard]] std::string_view CTypeRegistry::intern(std::string_view const& string_)
+{
+    {
+        std::shared_lock _guard{ mutex };
+        auto const _it{ interned.find(string_) };
+        if (_it != interned.end()) {
+            return _it->second;
+        }
+    }
+    std::unique_lock _guard{ mutex };
+    return internLocked(string_);
+}
+
+// #################################################################################################
+
+[[nodiscard]] std::string_view CTypeRegistry::internLocked(std::string_view const& string_)
+{
+    auto const _it{ interned.find(string_) };
+    if (_it != interned.end()) {
+        return _it->second;
+    }
+    std::string_view const _stored{ strings.emplace_back(string_) };
+    interned.emplace(_stored, _stored);
+    return _stored;
+}
+
+// #################################################################################################
+
+[[nodiscard]] std::vector<std::string_view> CTypeRegistry::registeredNames() const
+{
+    std::shared_lock _guard{ mutex };
+    std::vector<std::string_view> _names;
+    _names.reserve(declarations.size());
+    for (auto const& [_name, _declaration] : declarations) {
+        _names.push_back(_name);
+    }
+    return _names;
+}
+
+// #################################################################################################
+
 Universe::Universe()
 {
     //---
@@ -92,6 +187,10 @@ Universe::Universe()
     int const _keepers_gc_threshold{ static_cast<int>(lua_tointeger(L_, -1)) };
     lua_pop(L_, 1);                                                                                // L_: settings
     STACK_CHECK(L_, 0);
+    std::ignore = luaG_getfield(L_, 1, "keepers_offload_threshold");                               // L_: settings keepers_offload_threshold
+    int const _keepers_offload_threshold{ static_cast<int>(lua_tointeger(L_, -1)) };
+    lua_pop(L_, 1);                                                                                // L_: settings
+    STACK_CHECK(L_, 0);
 
     Universe* const _U{ new (L_) Universe{} };                                                     // L_: settings universe
     STACK_CHECK(L_, 1);
@@ -119,6 +218,12 @@ Universe::Universe()
     std::ignore = luaG_getfield(L_, 1, "demote_full_userdata");                                    // L_: settings demote_full_userdata
     _U->demoteFullUserdata = lua_toboolean(L_, -1) ? true : false;
     lua_pop(L_, 1);                                                                                // L_: settings
+    std::ignore = luaG_getfield(L_, 1, "nb_scheduler_threads");                                    // L_: settings nb_scheduler_threads
+    _U->nbSchedulerThreads = static_cast<int>(lua_tointeger(L_, -1));
+    lua_pop(L_, 1);                                                                                // L_: settings
+    std::ignore = luaG_getfield(L_, 1, "yield_capacity");                                          // L_: settings yield_capacity
+    _U->yieldCapacity = static_cast<int>(lua_tointeger(L_, -1));
+    lua_pop(L_, 1);                                                                                // L_: settings
 
     // tracking
     std::ignore = luaG_getfield(L_, 1, "track_lanes");                                             // L_: settings track_lanes
@@ -132,6 +237,21 @@ Universe::Universe()
     _U->initializeAllocatorFunction(L_);
     state::InitializeOnStateCreate(_U, L_);
     _U->keepers.initialize(*_U, L_, _nbUserKeepers, _keepers_gc_threshold);
+    _U->keepers.offload_threshold = _keepers_offload_threshold;
+    // the thread pool is allocated with the internal allocator, so it must exist first
+    std::ignore = luaG_getfield(L_, 1, "thread_pool_size");                                        // L_: settings thread_pool_size
+    if (int const _poolSize{ static_cast<int>(lua_tointeger(L_, -1)) }; _poolSize > 0) {
+        std::ignore = luaG_getfield(L_, 1, "thread_pool_idle_timeout");                            // L_: settings thread_pool_size thread_pool_idle_timeout
+        _U->threadPool = new (_U) ThreadPool{ _U, _poolSize, lua_Duration{ lua_tonumber(L_, -1) } };
+        lua_pop(L_, 1);                                                                            // L_: settings thread_pool_size
+    }
+    lua_pop(L_, 1);                                                                                // L_: settings
+    // same for the state reaper
+    std::ignore = luaG_getfield(L_, 1, "reaper_queue_size");                                       // L_: settings reaper_queue_size
+    if (int const _queueSize{ static_cast<int>(lua_tointeger(L_, -1)) }; _queueSize > 0) {
+        _U->stateReaper = new (_U) StateReaper{ _U, _queueSize };
+    }
+    lua_pop(L_, 1);                                                                                // L_: settings
     STACK_CHECK(L_, 0);
 
     // Initialize 'timerLinda'; a common Linda object shared by all states
@@ -177,12 +297,22 @@ Universe::Universe()
 
 // #################################################################################################
 
+[[nodiscard]] static int luaG_provide_threadcache_allocator(lua_State* const L_)
+{
+    Universe* const _U{ Universe::Get(L_) };
+    // push a new full userdata on the stack, giving access to the universe's thread-caching allocator
+    [[maybe_unused]] AllocatorDefinition* const _def{ new (L_) AllocatorDefinition{ _U->threadCacheAllocator.makeDefinition() } };
+    return 1;
+}
+
+// #################################################################################################
+
 // called once at the creation of the universe (therefore L_ is the master Lua state everything originates from)
 // Do I need to disable this when compiling for LuaJIT to prevent issues?
 void Universe::initializeAllocatorFunction(lua_State* const L_)
 {
     STACK_CHECK_START_REL(L_, 1);                                                                  // L_: settings
-    if (luaG_getfield(L_, -1, "allocator") != LuaType::NIL) {                                      // L_: settings allocator|nil|"protected"
+    if (luaG_getfield(L_, -1, "allocator") != LuaType::NIL) {                                      // L_: settings allocator|nil|"protected"|"threadcache"
         // store C function pointer in an internal variable
         provideAllocator = lua_tocfunction(L_, -1);                                                // L_: settings allocator
         if (provideAllocator != nullptr) {
@@ -195,13 +325,20 @@ void Universe::initializeAllocatorFunction(lua_State* const L_)
             // when we transfer the config table in newly created Lua states
             lua_pushnil(L_);                                                                       // L_: settings allocator nil
             lua_setfield(L_, -3, "allocator");                                                     // L_: settings allocator
-        } else if (lua_type(L_, -1) == LUA_TSTRING) { // should be "protected"
-            LUA_ASSERT(L_, strcmp(lua_tostring(L_, -1), "protected") == 0);
+        } else if (lua_type(L_, -1) == LUA_TSTRING) { // should be "protected" or "threadcache"
+            std::string_view const _name{ lua_tostringview(L_, -1) };
+            LUA_ASSERT(L_, _name == "protected" || _name == "threadcache");
             // set the original allocator to call from inside protection by the mutex
             protectedAllocator.initFrom(L_);
             protectedAllocator.installIn(L_);
-            // before a state is created, this function will be called to obtain the allocator
-            provideAllocator = luaG_provide_protected_allocator;
+            if (_name == "threadcache") {
+                // the master state keeps the protected allocator, the thread caches obtain their memory from it too
+                threadCacheAllocator.initFrom(protectedAllocator.makeDefinition());
+                provideAllocator = luaG_provide_threadcache_allocator;
+            } else {
+                // before a state is created, this function will be called to obtain the allocator
+                provideAllocator = luaG_provide_protected_allocator;
+            }
         }
     } else {
         // just grab whatever allocator was provided to lua_newstate
@@ -214,7 +351,7 @@ void Universe::initializeAllocatorFunction(lua_State* const L_)
     std::string_view const _allocator{ lua_tostringview(L_, -1) };
     if (_allocator == "libc") {
         internalAllocator = AllocatorDefinition{ libc_lua_Alloc, nullptr };
-    } else if (provideAllocator == luaG_provide_protected_allocator) {
+    } else if (provideAllocator == luaG_provide_protected_allocator || provideAllocator == luaG_provide_threadcache_allocator) {
         // user wants mutex protection on the state's allocator. Use protection for our own allocations too, just in case.
         internalAllocator = protectedAllocator.makeDefinition();
     } else {
@@ -251,60 +388,53 @@ int Universe::InitializeFinalizer(lua_State* const L_)
 
 void Universe::terminateFreeRunningLanes(lua_State* const L_, lua_Duration const shutdownTimeout_, CancelOp const op_)
 {
-    if (selfdestructFirst != SELFDESTRUCT_END) {
-        // Signal _all_ still running threads to exit (including the timer thread)
-        {
-            std::lock_guard<std::mutex> _guard{ selfdestructMutex };
-            Lane* _lane{ selfdestructFirst };
-            while (_lane != SELFDESTRUCT_END) {
-                // attempt the requested cancel with a small timeout.
-                // if waiting on a linda, they will raise a cancel_error.
-                // if a cancellation hook is desired, it will be installed to try to raise an error
-                if (_lane->thread.joinable()) {
-                    std::ignore = thread_cancel(_lane, op_, 1, std::chrono::steady_clock::now() + 1us, true);
-                }
-                _lane = _lane->selfdestruct_next;
+    if (selfdestructFirst != SELFDESTRUCT_END || detachedFirst != nullptr) {
+        std::unique_lock<std::mutex> _guard{ selfdestructMutex };
+        // Signal _all_ still running threads to exit (including the timer thread), in a single pass
+        // attempt the requested cancel without waiting: if a cancellation hook is desired, it will be installed to try to raise an error
+        auto const _cancel = [op_, this](Lane* const lane_) {
+            if (lane_->isLaunched()) {
+                std::ignore = thread_cancel(lane_, op_, 1, std::chrono::steady_clock::now(), false);
+            }
+            // count the cancelled lanes, that we will wait for
+            if (lane_->cancelRequest != CancelRequest::None) {
+                ++terminatingPendingCount;
             }
+        };
+        for (Lane* _lane{ selfdestructFirst }; _lane != SELFDESTRUCT_END; _lane = _lane->selfdestruct_next) {
+            _cancel(_lane);
+        }
+        // the detached lanes too
+        for (Lane* _lane{ detachedFirst }; _lane != nullptr; _lane = _lane->detached_next) {
+            _cancel(_lane);
+        }
+        // now that they all have their cancel request, the ones waiting on a linda can raise a cancel_error
+        // (the lanes can't leave the chains while we hold the mutex, so the lindas they wait on are still alive)
+        CancelWaker _waker;
+        for (Lane* _lane{ selfdestructFirst }; _lane != SELFDESTRUCT_END; _lane = _lane->selfdestruct_next) {
+            _waker.wake(_lane);
         }
+        for (Lane* _lane{ detachedFirst }; _lane != nullptr; _lane = _lane->detached_next) {
+            _waker.wake(_lane);
+        }
+        terminating = true;
 
-        // When noticing their cancel, the lanes will remove themselves from the selfdestruct chain.
-        {
-            std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(shutdownTimeout_) };
-
-            while (selfdestructFirst != SELFDESTRUCT_END) {
-                // give threads time to act on their cancel
-                std::this_thread::yield();
-                // count the number of cancelled thread that didn't have the time to act yet
-                int _n{ 0 };
-                {
-                    std::lock_guard<std::mutex> _guard{ selfdestructMutex };
-                    Lane* _lane{ selfdestructFirst };
-                    while (_lane != SELFDESTRUCT_END) {
-                        if (_lane->cancelRequest != CancelRequest::None)
-                            ++_n;
-                        _lane = _lane->selfdestruct_next;
-                    }
-                }
-                // if timeout elapsed, or we know all threads have acted, stop waiting
-                std::chrono::time_point<std::chrono::steady_clock> _now = std::chrono::steady_clock::now();
-                if (_n == 0 || (_now >= _until)) {
-                    DEBUGSPEW_CODE(DebugSpew(this) << _n << " uncancelled lane(s) remain after waiting " << shutdownTimeout_.count() << "s at process end." << std::endl);
-                    break;
-                }
-            }
+        // When noticing their cancel, the lanes will remove themselves from the selfdestruct (or detached) chain, each time decrementing the count.
+        // The last one wakes us up, unless the timeout elapses first.
+        std::chrono::time_point<std::chrono::steady_clock> _until{ std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(shutdownTimeout_) };
+        if (!selfdestructCondVar.wait_until(_guard, _until, [this]() { return terminatingPendingCount == 0; })) {
+            DEBUGSPEW_CODE(DebugSpew(this) << terminatingPendingCount << " uncancelled lane(s) remain after waiting " << shutdownTimeout_.count() << "s at process end." << std::endl);
         }
 
         // If some lanes are currently cleaning after themselves, wait until they are done.
         // They are no longer listed in the selfdestruct chain, but they still have to lua_close().
-        while (selfdestructingCount.load(std::memory_order_acquire) > 0) {
-            std::this_thread::yield();
-        }
+        selfdestructCondVar.wait(_guard, [this]() { return selfdestructingCount.load(std::memory_order_acquire) == 0; });
     }
 
     // If after all this, we still have some free-running lanes, it's an external user error, they should have stopped appropriately
     {
         std::lock_guard<std::mutex> _guard{ selfdestructMutex };
-        Lane* _lane{ selfdestructFirst };
+        Lane* _lane{ (selfdestructFirst != SELFDESTRUCT_END) ? selfdestructFirst : (detachedFirst != nullptr) ? detachedFirst : SELFDESTRUCT_END };
         if (_lane != SELFDESTRUCT_END) {
             // this causes a leak because we don't call U's destructor (which could be bad if the still running lanes are accessing it)
             raise_luaL_error(L_, "Zombie thread '%s' refuses to die!", _lane->debugName.data());
@@ -322,6 +452,8 @@ LUAG_FUNC(universe_gc)
     STACK_CHECK_START_ABS(L_, 1);
     Universe* const _U{ lua_tofulluserdata<Universe>(L_, 1) };                                     // L_: U
     _U->terminateFreeRunningLanes(L_, _shutdown_timeout, which_cancel_op(_op_string));
+    // the states of the lanes that have ended may still reference the timer linda and use the keepers: close them before these go away
+    delete std::exchange(_U->stateReaper, nullptr);
 
     // invoke the function installed by lanes.finally()
     kFinalizerRegKey.pushValue(L_);                                                                // L_: U finalizer|nil
@@ -343,6 +475,11 @@ LUAG_FUNC(universe_gc)
         _U->timerLinda = nullptr;
     }
 
+    // the scheduled lanes are all gone too, so the workers are idle
+    delete _U->scheduler.exchange(nullptr);
+    // same for the lanes that ran on pooled threads
+    delete std::exchange(_U->threadPool, nullptr);
+
     _U->keepers.close();
 
     // remove the protected allocator, if any
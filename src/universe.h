@@ -11,11 +11,19 @@ extern "C"
 
 #include "keeper.h"
 #include "lanesconf.h"
+#include "threadcache.h"
 #include "tracker.h"
 #include "uniquekey.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // #################################################################################################
 
@@ -23,6 +31,9 @@ extern "C"
 enum class CancelOp;
 struct DeepPrelude;
 class Lane;
+class Scheduler;
+class StateReaper;
+class ThreadPool;
 
 // #################################################################################################
 
@@ -109,6 +120,50 @@ class ProtectedAllocator
 
 // #################################################################################################
 
+// Universe-wide index of the native functions without upvalues, that are fully identified by their address
+// each function gets a single name, the first one any state found for it, that all states use to exchange it
+class FuncLookupIndex
+{
+    private:
+    mutable std::shared_mutex mutex;
+    // names are never modified nor removed once stored, so that the string_views we hand out remain valid
+    std::deque<std::string> names;
+    std::unordered_map<lua_CFunction, std::string_view> index;
+
+    public:
+    // returns an empty string if no state found the function yet
+    [[nodiscard]] std::string_view find(lua_CFunction f_) const;
+    // returns the name of the function, that is name_ unless a state found the function before
+    [[nodiscard]] std::string_view add(lua_CFunction f_, std::string_view const& name_);
+};
+
+// #################################################################################################
+
+// Universe-wide registry of the LuaJIT FFI ctypes whose cdata can be transferred by value
+// (built-in scalar types and arrays of them don't need to be registered)
+class CTypeRegistry
+{
+    private:
+    mutable std::shared_mutex mutex;
+    // strings are never modified nor removed once stored, so that the string_views we hand out remain valid
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, std::string_view> interned;
+    // registered ctype name -> declaration to cdef in the states that don't know the ctype yet (can be empty)
+    std::unordered_map<std::string_view, std::string_view> declarations;
+
+    [[nodiscard]] std::string_view internLocked(std::string_view const& string_);
+
+    public:
+    void add(std::string_view const& name_, std::string_view const& declaration_);
+    // returns an empty optional if the ctype is not registered
+    [[nodiscard]] std::optional<std::string_view> findDeclaration(std::string_view const& name_) const;
+    // returns a view on a copy of the string that remains valid as long as the Universe exists
+    [[nodiscard]] std::string_view intern(std::string_view const& string_);
+    [[nodiscard]] std::vector<std::string_view> registeredNames() const;
+};
+
+// #################################################################################################
+
 // xxh64 of string "kUniverseLightRegKey" generated at https://www.pelock.com/products/hash-calculator
 static constexpr RegistryUniqueKey kUniverseLightRegKey{ 0x48BBE9CEAB0BA04Full };
 
@@ -145,6 +200,10 @@ class Universe
     // contains a mutex and the original allocator definition
     ProtectedAllocator protectedAllocator;
 
+    // if allocator="threadcache" is found in the configuration settings, the states of the lanes and keepers allocate their small blocks from per-thread caches
+    // refilled from the protected allocator, that must outlive it
+    ThreadCacheAllocator threadCacheAllocator;
+
     AllocatorDefinition internalAllocator;
 
     Keepers keepers;
@@ -157,21 +216,55 @@ class Universe
 
     // Protects modifying the selfdestruct chain
     std::mutex selfdestructMutex;
+    // signalled when a lane leaves the selfdestruct or detached chain, or is done cleaning after itself, for the terminal shutdown to wait on
+    std::condition_variable selfdestructCondVar;
+
+    // signalled whenever a lane ends, for lanes.wait_any() and lanes.wait_all() that don't wait on a single lane
+    std::mutex completionMutex;
+    std::condition_variable completionCondVar;
+    // the number of lanes that have ended, that gives each its Lane::completionOrder
+    std::atomic<lua_Integer> completionCount{ 0 };
 
     // require() serialization
     std::recursive_mutex requireMutex;
 
-    // metatable unique identifiers
+    // native function -> name, shared by all states
+    FuncLookupIndex funcLookupIndex;
+
+    // LuaJIT FFI ctypes that can be transferred
+    CTypeRegistry ctypeRegistry;
+
+    // metatable unique identifiers, each state resolves them through a table of its own (the metatables themselves are per-state)
     std::atomic<lua_Integer> nextMetatableId{ 1 };
 
+    // the worker threads that run the scheduled lanes, created when the first one is launched
+    std::atomic<Scheduler*> scheduler{ nullptr };
+    std::once_flag schedulerOnce;
+    // 0 means as many workers as the hardware can run threads concurrently
+    int nbSchedulerThreads{ 0 };
+
+    // how many lanes.yield() a lane can do before it has to wait for its handle's iterator to read them
+    int yieldCapacity{ 16 };
+
+    // the threads kept around by the lanes that ended, for the next ones to run on (nullptr if thread_pool_size is 0)
+    ThreadPool* threadPool{ nullptr };
+
+    // the thread that closes the states of the lanes that have ended (nullptr if reaper_queue_size is 0)
+    StateReaper* stateReaper{ nullptr };
+
 #if USE_DEBUG_SPEW()
     std::atomic<int> debugspewIndentDepth{ 0 };
 #endif // USE_DEBUG_SPEW()
 
     Lane* volatile selfdestructFirst{ nullptr };
+    // the detached lanes that are still running, protected by selfdestructMutex
+    Lane* detachedFirst{ nullptr };
     // After a lane has removed itself from the chain, it still performs some processing.
     // The terminal desinit sequence should wait for all such processing to terminate before force-killing threads
     std::atomic<int> selfdestructingCount{ 0 };
+    // during the terminal shutdown, the number of lanes of both chains that were asked to cancel and haven't left yet (protected by selfdestructMutex)
+    bool terminating{ false };
+    int terminatingPendingCount{ 0 };
 
     public:
     [[nodiscard]] static void* operator new([[maybe_unused]] size_t size_, lua_State* L_) noexcept { return lua_newuserdatauv<Universe>(L_, 0); };
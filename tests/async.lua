@@ -0,0 +1,84 @@
+--
+-- ASYNC.LUA
+--
+-- Lanes of a generator with the 'async' option prepare their own state, and report preparation errors through their handle.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false }
+
+local fmt = string.format
+local upval = { x = 1, y = { z = "zz" } }
+local linda = lanes.linda()
+
+local body = function(a_, b_, c_, l_)
+    -- the body's upvalues and arguments, including C functions, tables and lindas
+    assert(fmt("%d", 42) == "42")
+    assert(upval.x == 1 and upval.y.z == "zz")
+    assert(a_ == 1 and b_ == nil and c_.k == "v")
+    l_:send("k", "hello")
+    -- the globals and the required modules
+    assert(G1 == "g1" and G2.t == 2 and G3 == print)
+    assert(package.loaded.lanes ~= nil)
+    assert(package.path == "async_path;" .. PATH)
+    return a_, c_.k
+end
+
+-- the basics
+local g = lanes.gen("*", { async = true, globals = { G1 = "g1", G2 = { t = 2 }, G3 = print, PATH = package.path }, required = { "lanes" }, package = { path = "async_path;" .. package.path } }, body)
+local h = {}
+for i = 1, 20 do
+    h[i] = g(1, nil, { k = "v" }, linda)
+end
+for i = 1, 20 do
+    local a, k = h[i]:join()
+    assert(a == 1 and k == "v", "lane " .. i .. " failed: " .. tostring(a) .. " " .. tostring(k))
+    local _, v = linda:receive(0, "k")
+    assert(v == "hello")
+end
+
+-- a lane body given as a string
+local s = lanes.gen("*", { async = true }, "local a, b = ... return string.rep(a, b)")
+assert(s("ab", 3)[1] == "ababab")
+
+-- preparation errors are reported like errors raised by the lane body
+local e = lanes.gen("*", { async = true, required = { "this_module_does_not_exist" } }, function() return "should not run" end)
+local he = e()
+local r, err = he:join()
+assert(r == nil and he.status == "error")
+assert(string.find(tostring(err), "this_module_does_not_exist"), tostring(err))
+
+local syntax = lanes.gen("*", { async = true }, "this is not valid lua")
+local hs = syntax()
+r, err = hs:join()
+assert(r == nil and hs.status == "error")
+
+-- errors in the arguments are still raised by the caller
+local ok, msg = pcall(g, 1, nil, { k = "v" }, linda, coroutine.create(function() end))
+assert(not ok and string.find(msg, "tried to copy unsupported types"), msg)
+ok, msg = pcall(lanes.gen, "*", { async = 1 }, body)
+assert(not ok and string.find(msg, "Bad 'async' option"), msg)
+ok, msg = pcall(lanes.gen("*", { async = true, template = true, required = { "lanes" } }, body))
+assert(not ok and string.find(msg, "state template"), msg)
+
+-- works together with the state pool, the scheduler and the thread pool
+local pool = lanes.state_pool(2)
+local p = lanes.gen("*", { async = true, pool = pool, globals = { N = 5 } }, function(i_)
+    N = N + i_
+    return N
+end)
+for i = 1, 10 do
+    assert(p(i)[1] == 5 + i)
+end
+if _VERSION ~= "Lua 5.1" then
+    local sc = lanes.gen("*", { async = true, scheduled = true, globals = { N = 7 } }, function(i_) return N * i_ end)
+    for i = 1, 10 do
+        assert(sc(i)[1] == 7 * i)
+    end
+end
+
+-- a free running lane cleans up after itself
+lanes.gen("*", { async = true }, function(l_) l_:send("done", true) end)(linda)
+assert(linda:receive(1, "done") == "done")
+
+print "TEST OK"
@@ -490,6 +490,23 @@ else
     assert(d==nil)
 end
 
+-- nil arguments to linda operations
+local nils = lanes.linda("nils")
+-- a nil limit removes the limit
+nils:limit("key", 1)
+assert.failsnot(function() nils:limit("key", nil) end)
+assert(nils:send(0, "key", 1, 2, 3) == true)
+assert(nils:count("key") == 3)
+-- a nil count reads a single value
+assert(nils:get("key", nil) == 1)
+-- a nil max reads exactly min values
+local k, v1, v2, v3 = nils:receive(0, nils.batched, "key", 2, nil)
+assert(k == "key" and v1 == 1 and v2 == 2 and v3 == nil)
+-- a nil value is stored as such
+nils:set("other", nil)
+assert(nils:count("other") == 1)
+assert(select('#', nils:get("other")) == 1 and nils:get("other") == nil)
+
 local nameof_type, nameof_name = lanes.nameof(print)
 PRINT("name of " .. nameof_type .. " print = '" .. nameof_name .. "'")
 -- install a finalizer that gets called upon Lanes's internal Universe is GCed.
@@ -0,0 +1,56 @@
+--
+-- BUFFER.LUA
+--
+-- Tests that buffers share their bytes between lanes instead of copying them.
+--
+
+local lanes = require "lanes"
+lanes.configure()
+
+-- a buffer made from a string is sealed
+local payload = string.rep("0123456789", 100000)
+local buf = lanes.buffer(payload)
+assert(getmetatable(buf) == "Buffer")
+assert(#buf == #payload and buf:sealed())
+assert(tostring(buf) == payload)
+assert(buf:tostring(1, 10) == "0123456789" and buf:tostring(-3) == "789" and buf:tostring(5, 4) == "")
+assert(not pcall(buf.append, buf, "more"))
+
+-- slices view the same bytes
+local slice = buf:slice(11, 20)
+assert(#slice == 10 and tostring(slice) == "0123456789")
+local subslice = slice:slice(-2)
+assert(tostring(subslice) == "89")
+assert(#buf:slice(5, 4) == 0)
+
+-- append-once buffers
+local log = lanes.buffer(16)
+assert(#log == 0 and log:capacity() == 16 and not log:sealed())
+assert(log:append("hello", " ") == 6)
+local view = log:slice()
+assert(log:append("world") == 11)
+assert(tostring(log) == "hello world")
+-- a slice is a fixed view, that doesn't see later appends
+assert(tostring(view) == "hello ")
+assert(not pcall(view.append, view, "!"))
+-- can't overflow the capacity
+assert(not pcall(log.append, log, "0123456789"))
+assert(tostring(log) == "hello world")
+log:seal()
+assert(log:sealed() and not pcall(log.append, log, "!"))
+
+-- lanes see the same bytes
+local reader = lanes.gen("base", function(b_, s_)
+    return #b_, b_:tostring(-5), tostring(s_)
+end)
+local h = reader(buf, slice)
+local len, tail, s = h:join()
+assert(len == #payload and tail == "56789" and s == "0123456789")
+
+-- through a linda too
+local linda = lanes.linda()
+linda:send("k", buf:slice(1, 5))
+local _, got = linda:receive("k")
+assert(tostring(got) == "01234")
+
+print "TEST OK"
@@ -0,0 +1,70 @@
+--
+-- CDATA.LUA
+--
+-- Transfer of LuaJIT FFI cdata by value, through lindas and as lane arguments and results.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false }
+
+local ffi = jit and require "ffi"
+if not ffi then
+    print "cdata transfer requires LuaJIT, skipped"
+    print "TEST OK"
+    return
+end
+
+local decl = "typedef struct { double x, y; int tag; } point_t;"
+ffi.cdef(decl)
+-- the lanes don't declare point_t themselves: they receive the declaration with the registration
+lanes.register_ctype("point_t", decl)
+
+-- built-in scalar types and arrays don't need any registration
+local linda = lanes.linda "cdata"
+linda:send("k", ffi.new("int64_t", 1234567890123), ffi.new("double[4]", 1, 2, 3, 4), ffi.new("uint8_t[?]", 3, { 7, 8, 9 }))
+local _, i64 = linda:receive("k")
+assert(ffi.istype("int64_t", i64) and tonumber(i64) == 1234567890123)
+local _, d4 = linda:receive("k")
+assert(ffi.sizeof(d4) == 32 and d4[0] == 1 and d4[3] == 4)
+local _, vla = linda:receive("k")
+assert(ffi.sizeof(vla) == 3 and vla[0] == 7 and vla[2] == 9)
+
+-- the copy is independent from the original
+local p = ffi.new("point_t", 1.5, 2.5, 42)
+linda:send("p", p)
+p.x = 100
+local _, q = linda:receive("p")
+assert(ffi.istype("point_t", q) and q.x == 1.5 and q.y == 2.5 and q.tag == 42)
+
+-- lane arguments and results
+local f = lanes.gen("*", function(pt, pts)
+    local ffi = require "ffi"
+    assert(ffi.sizeof(pt) == ffi.sizeof("point_t"))
+    local r = ffi.new("point_t", pt.x + pts[1].x, pt.y + pts[1].y, pt.tag + pts[1].tag)
+    return r, ffi.new("point_t[2]", r, pt)
+end)
+local h = f(ffi.new("point_t", 1, 2, 3), ffi.new("point_t[2]", { { 0, 0, 0 }, { 10, 20, 30 } }))
+local r, arr = h[1], h[2]
+assert(ffi.istype("point_t", r) and r.x == 11 and r.y == 22 and r.tag == 33, "lane failed: " .. tostring(h[1]))
+assert(ffi.sizeof(arr) == 2 * ffi.sizeof("point_t") and arr[0].x == 11 and arr[1].tag == 3)
+
+-- pointers are refused
+assert(not pcall(linda.send, linda, "k", ffi.new("int[1]") + 0))
+-- so are aggregates that were not registered
+ffi.cdef "struct unregistered { int a; };"
+assert(not pcall(linda.send, linda, "k", ffi.new("struct unregistered")))
+-- aggregates with pointer or reference members, even nested ones, can't be registered
+ffi.cdef "typedef struct { int a; struct { double d; char const* s; } inner; } hidden_ptr_t;"
+local ok, err = pcall(lanes.register_ctype, "hidden_ptr_t")
+assert(not ok and err:find("contains pointers"), err)
+ok, err = pcall(lanes.register_ctype, "hidden_ref_t", "typedef struct { int a; union { int i; int (*f)(int); }; } hidden_ref_t;")
+assert(not ok and err:find("contains pointers"), err)
+-- but pointer-free nested aggregates, arrays, enums and bit fields are fine
+lanes.register_ctype("nested_t", "typedef struct { point_t pts[2]; union { int i; float f; }; enum { A, B } e; int bits:3; } nested_t;")
+local nested = ffi.new("nested_t")
+nested.pts[1].tag, nested.i, nested.e, nested.bits = 6, 7, 1, 2
+linda:send("n", nested)
+local _, n = linda:receive("n")
+assert(n.pts[1].tag == 6 and n.i == 7 and n.e == 1 and n.bits == 2)
+
+print "TEST OK"
@@ -0,0 +1,45 @@
+--
+-- COPY_PERF.LUA
+--
+-- Measures how long it takes to copy typical linda messages in and out of a keeper.
+-- The cost of each message is compared to the round trip of a single number through the same linda, measured in the same run, so that the results don't depend on the machine.
+-- usage: lua copy_perf.lua [loop count]
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false }
+
+local N = tonumber((...)) or 100000
+
+local linda = lanes.linda "copy_perf"
+
+local round_trips = function(msg_)
+    local start = os.clock()
+    for i = 1, N do
+        linda:send("k", msg_)
+        local _, v = linda:receive("k")
+    end
+    return os.clock() - start
+end
+
+-- the entries of a flat table are copied without going through the generic copy of each value:
+-- a flat table of n entries must cost less than n round trips of a single number
+-- nested tables have no bound, they are only measured
+local messages = {
+    { "string", "some status message" },
+    { "flat array", { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 }, 16 },
+    { "flat record", { id = 1234, name = "sensor", value = 3.14159, ok = true, unit = "K", min = -40, max = 120, ts = 1700000000, x = 1.5, y = 2.5, z = 3.5, owner = "me", ttl = 60, ack = false, seq = 42, src = "probe" }, 16 },
+    { "nested record", { id = 1234, pos = { x = 1.5, y = 2.5, z = 3.5 }, tags = { "a", "b", "c" }, meta = { owner = "me", ttl = 60 } } },
+}
+
+local baseline = round_trips(42)
+print(string.format("%-14s %8.3f s %10.0f msg/s", "number", baseline, N / baseline))
+for _, entry in ipairs(messages) do
+    local label, msg, max_ratio = entry[1], entry[2], entry[3]
+    local elapsed = round_trips(msg)
+    local ratio = elapsed / baseline
+    print(string.format("%-14s %8.3f s %10.0f msg/s %6.2f x number", label, elapsed, N / elapsed, ratio))
+    assert(not max_ratio or ratio < max_ratio, label .. " costs " .. ratio .. " round trips of a number, expected less than " .. tostring(max_ratio))
+end
+
+print "TEST OK"
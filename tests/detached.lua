@@ -0,0 +1,88 @@
+--
+-- DETACHED.LUA
+--
+-- Detached lanes have no handle: their results are discarded and they clean up after themselves when they end.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, nb_scheduler_threads = 2 }
+
+local linda = lanes.linda()
+
+-- the generator returns nothing
+local job = lanes.gen("*", { detached = true }, function(i_)
+    linda:send("done", i_)
+    return "discarded"
+end)
+assert(select('#', job(0)) == 0)
+local k, v = linda:receive(5, "done")
+assert(k == "done" and v == 0)
+
+-- lots of them
+local n = 200
+for i = 1, n do
+    job(i)
+end
+local sum = 0
+for _ = 1, n do
+    k, v = linda:receive(5, "done")
+    assert(k == "done")
+    sum = sum + v
+end
+assert(sum == n * (n + 1) / 2)
+
+-- errors are discarded too, but finalizers still see them
+lanes.gen("*", { detached = true }, function()
+    set_finalizer(function(err_) linda:send("error", tostring(err_)) end)
+    error "oops"
+end)()
+k, v = linda:receive(5, "error")
+assert(k == "error" and string.find(v, "oops"), tostring(v))
+
+-- they can't stream values, as there is no handle to iterate on
+lanes.gen("*", { detached = true }, function()
+    local lanes = require "lanes"
+    linda:send("yield", (pcall(lanes.yield, 1)))
+end)()
+k, v = linda:receive(5, "yield")
+assert(k == "yield" and v == false)
+
+-- their states can go back to a pool
+local pool = lanes.state_pool(2)
+local pooled = lanes.gen("*", { detached = true, pool = pool }, function(i_)
+    linda:send("pooled", i_)
+end)
+for i = 1, 10 do
+    pooled(i)
+    k, v = linda:receive(5, "pooled")
+    assert(k == "pooled" and v == i)
+end
+
+-- they can be scheduled
+if _VERSION ~= "Lua 5.1" then
+    local scheduled = lanes.gen("*", { detached = true, scheduled = true }, function(i_)
+        linda:send("scheduled", i_)
+    end)
+    for i = 1, 20 do
+        scheduled(i)
+    end
+    sum = 0
+    for _ = 1, 20 do
+        k, v = linda:receive(5, "scheduled")
+        assert(k == "scheduled")
+        sum = sum + v
+    end
+    assert(sum == 210)
+end
+
+-- options that need a handle are refused
+assert(not pcall(lanes.gen, "*", { detached = true, gc_cb = print }, function() end))
+local ok, msg = pcall(lanes.spawn_many, job, 2)
+assert(not ok and string.find(msg, "detached"), msg)
+
+-- a detached lane still running at shutdown is cancelled like the others
+lanes.gen("*", { detached = true }, function()
+    linda:receive("never")
+end)()
+
+print "TEST OK"
@@ -0,0 +1,102 @@
+--
+-- FREEZE.LUA
+--
+-- Tests that frozen tables are shared between lanes without being copied, and can't be modified.
+--
+
+local lanes = require "lanes"
+lanes.configure()
+
+local source = {
+    "one", "two", "three",
+    name = "routes",
+    enabled = true,
+    ratio = 0.5,
+    [2.5] = "float key",
+    [true] = "boolean key",
+    nested = { depth = 1, deeper = { depth = 2 } },
+}
+source.shared1 = source.nested.deeper
+source.shared2 = source.nested.deeper
+
+local frozen = lanes.freeze(source)
+assert(type(frozen) == "userdata")
+assert(getmetatable(frozen) == "FrozenTable")
+assert(lanes.freeze(frozen) == frozen)
+
+-- read access
+assert(#frozen == 3)
+assert(frozen[1] == "one" and frozen[3] == "three" and frozen[4] == nil)
+assert(frozen[2.0] == "two")
+assert(frozen.name == "routes" and frozen.enabled == true and frozen.ratio == 0.5)
+assert(frozen[2.5] == "float key" and frozen[true] == "boolean key")
+assert(frozen.nested.depth == 1 and frozen.nested.deeper.depth == 2)
+assert(frozen.missing == nil and frozen[{}] == nil)
+-- a sub-table referenced several times is frozen once, and the proxy is cached per state
+assert(frozen.shared1 == frozen.shared2 and frozen.shared1 == frozen.nested.deeper)
+
+-- the frozen table is a snapshot
+source.name = "changed"
+assert(frozen.name == "routes")
+
+-- iteration: lanes.frozen_pairs() everywhere, pairs() where __pairs is honored (not Lua 5.1 and LuaJIT)
+local count_entries = function(iterate_, t_)
+    local count, previous = 0, 0
+    for k, v in iterate_(t_) do
+        count = count + 1
+        assert(t_[k] == v)
+        -- the array part comes first, in order
+        if count <= #t_ then
+            assert(k == previous + 1)
+            previous = k
+        end
+    end
+    return count
+end
+local count = count_entries(lanes.frozen_pairs, frozen)
+assert(count == 11, "found " .. count .. " entries")
+assert(count_entries(lanes.frozen_pairs, frozen.nested.deeper) == 1)
+assert(count_entries(lanes.frozen_pairs, lanes.freeze{}) == 0)
+assert(not pcall(lanes.frozen_pairs, {}))
+if _VERSION ~= "Lua 5.1" then
+    assert(count_entries(pairs, frozen) == 11)
+end
+
+-- write access
+assert(not pcall(function() frozen.name = "oops" end))
+assert(not pcall(function() frozen[1] = "oops" end))
+assert(frozen.name == "routes")
+
+-- invalid contents
+assert(not pcall(lanes.freeze, { print }))
+assert(not pcall(lanes.freeze, { [{}] = true }))
+local cyclic = {}
+cyclic.self = cyclic
+assert(not pcall(lanes.freeze, cyclic))
+-- frozen tables can be nested in other frozen tables
+local outer = lanes.freeze{ inner = frozen }
+assert(outer.inner == frozen)
+
+-- lanes see the same data
+local frozen_pairs = lanes.frozen_pairs
+local reader = lanes.gen("*", function(t_)
+    assert(t_.nested.deeper.depth == 2)
+    local n = 0
+    for _ in frozen_pairs(t_) do
+        n = n + 1
+    end
+    return #t_, t_.name, n, tostring(t_)
+end)
+local h = reader(frozen)
+local len, name, n, str = h:join()
+assert(len == 3 and name == "routes" and n == 11)
+-- it's the same deep object on both sides
+assert(str == tostring(frozen))
+
+-- through a linda too
+local linda = lanes.linda()
+linda:set("k", frozen)
+local got = linda:get("k")
+assert(tostring(got) == tostring(frozen) and got.nested.deeper.depth == 2)
+
+print "TEST OK"
@@ -0,0 +1,136 @@
+--
+-- GROUP.LUA
+--
+-- The lanes of a group are cancelled together with a single timeout, and joined in the order they ended.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, nb_scheduler_threads = 2 }
+
+local linda = lanes.linda()
+
+-- lanes join a group through their generator, or explicitly
+local g = lanes.group()
+assert(#g == 0)
+local waiter = lanes.gen("*", { group = g }, function(i_)
+    linda:receive("go" .. i_)
+    return i_
+end)
+local n = 5
+for i = 1, n do
+    waiter(i)
+end
+assert(#g == n)
+local extra = lanes.gen("*", function() return "extra" end)()
+assert(g:add(extra) == extra)
+-- adding a lane twice doesn't make it a member twice
+g:add(extra)
+assert(#g == n + 1)
+assert(not pcall(g.add, g, {}))
+
+-- join returns the lanes that ended, in the order they did, and they leave the group
+extra:join()
+local ended, timeout = g:join(0)
+assert(timeout == "timeout" and #ended == 1 and ended[1] == extra)
+assert(#g == n)
+for _, i in ipairs{ 3, 1, 5, 2, 4 } do
+    linda:send("go" .. i, true)
+    -- make sure they end in that order
+    lanes.sleep(0.05)
+end
+ended, timeout = g:join(5)
+assert(timeout == nil and #ended == n)
+for k, i in ipairs{ 3, 1, 5, 2, 4 } do
+    assert(ended[k][1] == i, "lane " .. i .. " isn't number " .. k)
+end
+assert(#g == 0)
+assert(#g:join() == 0)
+
+-- cancelling a whole group waits for all of them together, not one timeout after the other
+local blocked = lanes.gen("*", { group = g }, function()
+    linda:receive("never")
+end)
+local many = 200
+for i = 1, many do
+    blocked()
+end
+assert(#g == many)
+local t0 = lanes.now_secs()
+assert(g:cancel("hard", 10) == true)
+local elapsed = lanes.now_secs() - t0
+ended = g:join()
+assert(#ended == many)
+for _, h in ipairs(ended) do
+    assert(h.status == "cancelled", h.status)
+end
+print("cancelled " .. many .. " blocked lanes in " .. elapsed .. "s")
+
+-- a soft cancel is noticed by the lanes that look for it, the others make the group time out
+local polite = lanes.gen("*", { group = g }, function()
+    repeat until cancel_test()
+    return "polite"
+end)
+local stubborn = lanes.gen("*", { group = g }, function()
+    -- hooks don't run in code compiled by LuaJIT
+    if jit then
+        jit.off()
+    end
+    local i = 0
+    while true do
+        i = i + 1
+    end
+end)
+for i = 1, 3 do
+    polite()
+end
+local s = stubborn()
+local ok, reason = g:cancel("soft", 0.2)
+assert(ok == false and reason == "timeout")
+ended, timeout = g:join(0)
+assert(#ended == 3 and timeout == "timeout" and #g == 1)
+for _, h in ipairs(ended) do
+    assert(h[1] == "polite")
+end
+-- a hook-based cancel takes care of the last one
+assert(g:cancel("count", 100, 5) == true)
+assert(s.status == "cancelled")
+assert(#g:join() == 1 and #g == 0)
+
+-- spawn_many() adds the lanes it launches too
+local squares = lanes.gen("*", { group = g }, function(i_) return i_ * i_ end)
+local handles = lanes.spawn_many(squares, 10, function(i_) return i_ end)
+assert(#handles == 10 and #g == 10)
+ended = g:join()
+local sum = 0
+for _, h in ipairs(ended) do
+    sum = sum + h[1]
+end
+assert(sum == 385)
+
+-- a scheduled lane gives its worker back while it joins a group
+if _VERSION ~= "Lua 5.1" then
+    local parent = lanes.gen("*", { scheduled = true }, function(m_)
+        local lanes = require "lanes"
+        local sub = lanes.group()
+        local child = lanes.gen("*", { scheduled = true, group = sub }, function(i_)
+            lanes.sleep(0.01)
+            return i_
+        end)
+        for i = 1, m_ do
+            child(i)
+        end
+        local total = 0
+        for _, h in ipairs(sub:join()) do
+            total = total + h[1]
+        end
+        return total
+    end)
+    local p1, p2 = parent(20), parent(20)
+    assert(p1[1] == 210 and p2[1] == 210)
+end
+
+-- detached lanes have no handle to put in a group
+assert(not pcall(lanes.gen, "*", { detached = true, group = g }, function() end))
+assert(not pcall(lanes.gen, "*", { group = {} }, function() end))
+
+print "TEST OK"
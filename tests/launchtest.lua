@@ -4,11 +4,13 @@
 -- Tests launching speed of N threads
 --
 -- Usage:
---      [time] lua -lstrict launchtest.lua [threads] [-libs[=io,os,math,...]]
+--      [time] lua -lstrict launchtest.lua [threads] [-libs[=io,os,math,...]] [-pool[=size]] [-rounds=n]
 --
 --      threads: number of threads to launch (like: 2000) :)
 --      libs: combination of "os","io","math","package", ...
 --            just "-libs" for all libraries
+--      pool: reuse the OS threads of the lanes that ended (thread_pool_size, just "-pool" for 64)
+--      rounds: how many times the threads are launched then joined (default 1)
 --
 -- Note:
 --      One _can_ reach the system threading level, ie. doing 10000 on 
@@ -29,9 +31,11 @@
 local N= 1000   -- threads/loops to use
 local M= 1000   -- sieves from 1..M
 local LIBS= nil -- default: load no libraries
+local POOL= 0   -- default: no thread pool
+local ROUNDS= 1 -- launch/join cycles
 
 local function HELP()
-    io.stderr:write( "Usage: lua launchtest.lua [threads] [-libs[=io,os,math,...]]\n" )
+    io.stderr:write( "Usage: lua launchtest.lua [threads] [-libs[=io,os,math,...]] [-pool[=size]] [-rounds=n]\n" )
     exit(1)
 end
 
@@ -41,12 +45,14 @@ local argtable= assert(m.argtable)
 for k,v in pairs( argtable(...) ) do
     if k==1 then            N= tonumber(v) or HELP()
     elseif k=="libs" then   LIBS= (v==true) and "*" or v
+    elseif k=="pool" then   POOL= (v==true) and 64 or tonumber(v) or HELP()
+    elseif k=="rounds" then ROUNDS= tonumber(v) or HELP()
     else                    HELP()
     end
 end
 
 local lanes = require "lanes"
-lanes.configure()
+lanes.configure{ thread_pool_size = POOL }
 
 local g= lanes.gen( LIBS, function(i) 
                         --io.stderr:write( i.."\t" )
@@ -54,6 +60,9 @@ local g= lanes.gen( LIBS, function(i)
                     end )
 
 local t= {}
+local t0= lanes.now_secs()
+
+for round=1,ROUNDS do
 
 for i=1,N do
     t[i]= g(i)
@@ -77,3 +86,8 @@ else
     io.stderr:write( N.." lanes finished.\n" )
 end
 
+end -- rounds
+
+local stats= lanes.thread_pool_stats()
+io.stderr:write( string.format( "%d lanes in %.3fs (threads created: %d, reused: %d)\n", N*ROUNDS, lanes.now_secs()-t0, stats.created, stats.reused ) )
+
@@ -0,0 +1,123 @@
+--
+-- LINDA_BULK.LUA
+--
+-- linda:send_array() and linda:receive_into() move whole arrays through a linda without unpacking them on the stack.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, keepers_offload_threshold = 16 }
+
+local linda = lanes.linda "bulk"
+
+-- an array much larger than what table.unpack() could push on the stack
+local N = 100000
+local big = {}
+for i = 1, N do
+    big[i] = i
+end
+assert(linda:send_array("big", big) == true)
+assert(linda:count("big") == N)
+local into = {}
+local total = 0
+while total < N do
+    local n = linda:receive_into(0, "big", into, 4096)
+    for i = 1, n do
+        assert(into[i] == total + i)
+    end
+    total = total + n
+end
+assert(linda:count("big") == 0)
+local r, err = linda:receive_into(0, "big", into, 10)
+assert(r == nil and err == "timeout")
+
+-- each element is a separate value, received in order after those already there, whatever their type
+local long = string.rep("l", 100)
+local t = { "x" }
+linda:send("mix", "first")
+assert(linda:send_array("mix", { 1, true, 2.5, "short", long, t, t }))
+linda:send("mix", "last")
+assert(linda:count("mix") == 9)
+local _, v = linda:receive(0, "mix")
+assert(v == "first")
+into = { "stale", "stale", "stale", "stale", "stale", "stale", "stale", "stale", "stale", "stale" }
+assert(linda:receive_into(0, "mix", into, 100) == 8)
+assert(into[1] == 1 and into[2] == true and into[3] == 2.5 and into[4] == "short" and into[5] == long)
+-- repeated tables are distinct messages, hence distinct copies
+assert(type(into[6]) == "table" and into[6][1] == "x" and into[6] ~= into[7])
+assert(into[8] == "last")
+-- entries beyond the received ones are left alone
+assert(into[9] == "stale" and into[10] == "stale")
+
+-- nil values in the linda come out as holes
+linda:send("holes", 1, nil, 3)
+into = {}
+assert(linda:receive_into(0, "holes", into, 3) == 3)
+assert(into[1] == 1 and into[2] == nil and into[3] == 3)
+
+-- an empty array is a no-op
+assert(linda:send_array("empty", {}) == true)
+assert(linda:count("empty") == nil or linda:count("empty") == 0)
+
+-- limits apply to the whole array
+linda:limit("lim", 3)
+assert(linda:send_array(0, "lim", { 1, 2, 3, 4 }) == false)
+assert(linda:count("lim") == nil or linda:count("lim") == 0)
+assert(linda:send_array(0, "lim", { 1, 2 }) == true)
+assert(linda:send_array(0, "lim", { 3, 4 }) == false)
+assert(linda:send_array(0, "lim", { 3 }) == true)
+assert(linda:receive_into(0, "lim", into, 2) == 2 and into[1] == 1 and into[2] == 2)
+assert(linda:count("lim") == 1)
+
+-- a failed copy leaves the linda unchanged
+assert(not pcall(linda.send_array, linda, "bad", { 1, coroutine.create(print) }))
+assert(linda:count("bad") == nil or linda:count("bad") == 0)
+
+-- a value that can't be copied out of the linda leaves both the table and the linda unchanged
+local sender = lanes.gen("*", function()
+    local lanes = require "lanes"
+    -- file methods aren't found by the scan of the global namespace: only this lane knows that name
+    local m = { read = io.stdout.read }
+    lanes.register("linda_bulk_lane_only", m)
+    return linda:send_array("unknown", { 1, 2, m.read, 4 })
+end)
+assert(sender()[1] == true)
+into = { "stale", "stale", "stale", "stale", "stale" }
+assert(not pcall(linda.receive_into, linda, 0, "unknown", into, 5))
+for i = 1, 5 do
+    assert(into[i] == "stale", "into[" .. i .. "] was overwritten")
+end
+assert(linda:count("unknown") == 4)
+
+-- bad arguments
+assert(not pcall(linda.send_array, linda, "k", 1))
+assert(not pcall(linda.receive_into, linda, "k", {}))
+assert(not pcall(linda.receive_into, linda, "k", {}, 0))
+
+-- across lanes, with a limit to make the producer wait for the consumer
+local producer = lanes.gen("*", function(n, chunk)
+    local batch = {}
+    for i = 1, n, chunk do
+        for j = 1, chunk do
+            batch[j] = i + j - 1
+        end
+        if linda:send_array(1, "p", batch) ~= true then
+            return false
+        end
+    end
+    return true
+end)
+linda:limit("p", 1000)
+local p = producer(N, 100)
+total = 0
+into = {}
+while total < N do
+    local n = linda:receive_into(1, "p", into, 256)
+    assert(n, "timeout")
+    for i = 1, n do
+        assert(into[i] == total + i)
+    end
+    total = total + n
+end
+assert(p[1] == true)
+
+print "TEST OK"
@@ -0,0 +1,107 @@
+--
+-- LINDA_FFI.LUA
+--
+-- Linda traffic through the FFI-callable entry points, and how it compares with the regular linda methods once LuaJIT compiles the loops.
+-- usage: luajit linda_ffi.lua [loop count]
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, keepers_offload_threshold = 64 }
+
+local ffi = jit and require "ffi"
+if not ffi then
+    print "linda FFI entry points require LuaJIT, skipped"
+    print "TEST OK"
+    return
+end
+
+local N = tonumber((...)) or 200000
+
+local C = lanes.linda_ffi()
+local linda = lanes.linda "linda_ffi"
+local h = linda:deep()
+local num = ffi.new("double[1]")
+local len = ffi.new("size_t[1]")
+local str = ffi.new("char[?]", 256)
+
+-- the FFI side and the Lua side see the same data
+assert(C.send_number(h, "n", 1.5, -1) == C.OK)
+local _, v = linda:receive("n")
+assert(v == 1.5)
+linda:send("n", 2.5)
+assert(C.receive_number(h, "n", num, -1) == C.OK and num[0] == 2.5)
+assert(C.receive_number(h, "n", num, 0) == C.TIMEOUT)
+
+-- strings, offloaded or not, and buffers, all come out as strings
+local long = string.rep("x", 100)
+assert(C.send_string(h, "s", "short", 5, -1) == C.OK)
+assert(C.send_string(h, "s", long, #long, -1) == C.OK)
+local buffer = lanes.buffer("buffer contents")
+assert(C.send_buffer(h, "s", buffer:deep(), -1) == C.OK)
+_, v = linda:receive("s")
+assert(v == "short")
+_, v = linda:receive("s")
+assert(v == long)
+assert(C.receive_string(h, "s", str, 256, len, -1) == C.OK and ffi.string(str, len[0]) == "buffer contents")
+
+-- values that don't fit the request stay in the linda
+linda:send("m", "not a number")
+assert(C.receive_number(h, "m", num, 0) == C.MISMATCH)
+assert(C.receive_string(h, "m", str, 4, len, 0) == C.TOO_SMALL and len[0] == 12)
+assert(linda:count("m") == 1)
+assert(C.receive_string(h, "m", str, 256, len, 0) == C.OK and ffi.string(str, len[0]) == "not a number")
+
+-- limits block the sender until the timeout expires
+linda:limit("l", 1)
+assert(C.send_number(h, "l", 1, 0) == C.OK)
+assert(C.send_number(h, "l", 2, 0.01) == C.TIMEOUT)
+linda:limit("l")
+
+-- a producer lane that only talks through the FFI, throttled by a limit
+local producer = lanes.gen("*", function(n)
+    local lanes = require "lanes"
+    local C = lanes.linda_ffi()
+    local h = linda:deep()
+    for i = 1, n do
+        if C.send_number(h, "p", i, -1) ~= C.OK then
+            return false
+        end
+    end
+    return true
+end)
+linda:limit("p", 64)
+local sum = 0
+local wall = lanes.now_secs()
+local p = producer(N)
+for i = 1, N do
+    assert(C.receive_number(h, "p", num, -1) == C.OK)
+    sum = sum + num[0]
+end
+assert(p[1] == true)
+assert(sum == N * (N + 1) / 2)
+wall = lanes.now_secs() - wall
+print(string.format("%-22s %8.3f s %12.0f msg/s", "ffi producer/consumer", wall, N / wall))
+
+-- same thread send/receive loops, through the linda methods, then through the FFI
+local elapsed = function(label, loop)
+    local start = os.clock()
+    loop()
+    local t = os.clock() - start
+    print(string.format("%-22s %8.3f s %12.0f msg/s", label, t, N / t))
+    return t
+end
+local t_lua = elapsed("linda methods", function()
+    for i = 1, N do
+        linda:send("k", i)
+        local _, v = linda:receive("k")
+    end
+end)
+local t_ffi = elapsed("ffi entry points", function()
+    for i = 1, N do
+        C.send_number(h, "k", i, -1)
+        C.receive_number(h, "k", num, -1)
+    end
+end)
+print(string.format("speedup: %.2f", t_lua / t_ffi))
+
+print "TEST OK"
@@ -0,0 +1,97 @@
+--
+-- LINDA_SCALARS.LUA
+--
+-- Nil, boolean, number and short string values take a shortcut through lindas: check that nothing changes from the outside.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, keepers_offload_threshold = 16 }
+
+local linda = lanes.linda "scalars"
+
+-- all scalar types survive the trip
+local values = { true, false, 42, -1.5, 2^53, "", "short", string.rep("s", 15) }
+for _, v in ipairs(values) do
+    linda:send("k", v)
+end
+for _, v in ipairs(values) do
+    local k, r = linda:receive(0, "k")
+    assert(k == "k" and r == v, tostring(v))
+    -- integers remain integers
+    assert(not math.type or math.type(r) == math.type(v))
+end
+assert(linda:count("k") == 0)
+
+-- nil is received as nil
+linda:send("n", nil)
+local k, v = linda:receive(0, "n")
+assert(k == "n" and v == nil)
+k, v = linda:receive(0, "n")
+assert(k == nil and v == "timeout")
+
+-- order is preserved when scalars and other values are mixed, and beyond the native storage of a key
+local long = string.rep("l", 100)
+local expected = {}
+for i = 1, 40 do
+    local x = (i % 7 == 0) and { i } or (i % 11 == 0) and long or i
+    expected[i] = x
+    linda:send("mix", x)
+end
+assert(linda:count("mix") == 40)
+-- peeking sees everything in order
+local first = linda:get("mix", 3)
+assert(first == 1)
+for i = 1, 40 do
+    local _, r = linda:receive(0, "mix")
+    if type(expected[i]) == "table" then
+        assert(type(r) == "table" and r[1] == i)
+    else
+        assert(r == expected[i], i)
+    end
+end
+
+-- multiple values in a single send, with batched and multi-key receive
+linda:send("m", 1, 2, 3)
+linda:send("m", "a", "b")
+assert(linda:count("m") == 5)
+local _, a, b, c = linda:receive(0, linda.batched, "m", 3)
+assert(a == 1 and b == 2 and c == 3)
+k, v = linda:receive(0, "other", "m")
+assert(k == "m" and v == "a")
+k, v = linda:receive(0, "m")
+assert(k == "m" and v == "b")
+
+-- limits count values stored natively
+linda:limit("lim", 2)
+assert(linda:send(0, "lim", 1) == true)
+assert(linda:send(0, "lim", 2) == true)
+assert(linda:send(0, "lim", 3) == false)
+assert(linda:count("lim") == 2)
+linda:set("lim", "x")
+assert(linda:count("lim") == 1)
+k, v = linda:receive(0, "lim")
+assert(v == "x")
+
+-- dump shows values stored natively too
+linda:send("d", 1, "two")
+local dump = linda:dump()
+assert(dump.d.count == 2 and dump.d.fifo[dump.d.first] == 1 and dump.d.fifo[dump.d.first + 1] == "two")
+linda:set("d")
+
+-- across lanes
+local N = 1000
+local producer = lanes.gen("*", function()
+    for i = 1, N do
+        linda:send("p", i, i % 2 == 0, "s" .. i)
+    end
+    return true
+end)()
+for i = 1, N do
+    local _, n = linda:receive(1, "p")
+    local _, even = linda:receive(1, "p")
+    local _, s = linda:receive(1, "p")
+    assert(n == i and even == (i % 2 == 0) and s == "s" .. i)
+end
+assert(producer[1] == true)
+
+print "TEST OK"
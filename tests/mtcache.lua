@@ -0,0 +1,36 @@
+--
+-- MTCACHE.LUA
+--
+-- Checks that metatables keep their identity when objects travel between states.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false }
+
+local Point = {}
+Point.__index = Point
+local function new_point(x, y)
+    return setmetatable({ x = x, y = y }, Point)
+end
+
+-- objects of the same class sent together or in separate messages share the same metatable on the other side
+local linda = lanes.linda "mtcache"
+local f = lanes.gen("", function()
+    local _, a, b = linda:receive(linda.batched, "k", 2)
+    local _, c = linda:receive("k")
+    assert(getmetatable(a) == getmetatable(b))
+    assert(getmetatable(a) == getmetatable(c))
+    -- send them back, along with a new object of the same class
+    local d = setmetatable({ x = 7, y = 8 }, getmetatable(a))
+    return a, b, c, d
+end)
+local h = f()
+linda:send("k", new_point(1, 2), new_point(3, 4))
+linda:send("k", new_point(5, 6))
+local a, b, c, d = h[1], h[2], h[3], h[4]
+assert(a and b and c and d, "lane failed")
+-- the metatable came back home: we should get the original one, not a copy
+assert(getmetatable(a) == Point and getmetatable(b) == Point and getmetatable(c) == Point and getmetatable(d) == Point)
+assert(a.x == 1 and b.y == 4 and c.x == 5 and d.y == 8)
+
+print "TEST OK"
@@ -0,0 +1,57 @@
+--
+-- OFFLOAD.LUA
+--
+-- Tests that large strings stored out of the keeper states come back unchanged.
+--
+
+local lanes = require "lanes"
+lanes.configure{ keepers_offload_threshold = 1024 }
+
+local linda = lanes.linda()
+
+local small = string.rep("s", 1023)
+local big = string.rep("0123456789abcdef", 4096)
+local bigkey = string.rep("k", 2048)
+
+-- plain values
+linda:send("x", small, big)
+local k, v = linda:receive("x")
+assert(k == "x" and v == small)
+k, v = linda:receive("x")
+assert(k == "x" and v == big and type(v) == "string")
+
+-- inside tables, and as keys of those tables
+linda:set("t", { big, nested = { [bigkey] = big } })
+local t = linda:get("t")
+assert(t[1] == big and t.nested[bigkey] == big)
+-- get() doesn't consume the value, it must still be intact
+t = linda:get("t")
+assert(t[1] == big)
+
+-- as a linda key
+linda:set(bigkey, big)
+assert(linda:get(bigkey) == big)
+local dump = linda:dump()[bigkey]
+assert(dump.count == 1 and dump.fifo[dump.first] == big)
+
+-- batched receive
+linda:send("b", big .. "1", big .. "2", big .. "3")
+local _, a1, a2, a3 = linda:receive(linda.batched, "b", 3)
+assert(a1 == big .. "1" and a2 == big .. "2" and a3 == big .. "3")
+
+-- lots of traffic between lanes, so that keeper GC has to reclaim the offloaded strings
+local producer = lanes.gen("base,string", function(n_)
+    for i = 1, n_ do
+        linda:send("pipe", string.rep(tostring(i % 10), 100000))
+    end
+    return true
+end)
+local N = 200
+local h = producer(N)
+for i = 1, N do
+    local _, msg = linda:receive("pipe")
+    assert(#msg == 100000 and msg:sub(1, 1) == tostring(i % 10))
+end
+assert(h:join() == true)
+
+print "TEST OK"
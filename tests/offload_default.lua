@@ -0,0 +1,30 @@
+--
+-- OFFLOAD_DEFAULT.LUA
+--
+-- Tests that large strings are stored out of the keeper states without configuring keepers_offload_threshold.
+--
+
+local lanes = require "lanes"
+-- keeper GC is only there to tell if the big strings went into the keeper's heap: it would raise an error if they did
+lanes.configure{ with_timers = false, keepers_gc_threshold = 1024 }
+
+local linda = lanes.linda()
+
+-- strings shorter than the default threshold are stored in the keeper as usual
+local small = string.rep("s", 1000)
+linda:send("small", small)
+local k, v = linda:receive("small")
+assert(k == "small" and v == small)
+
+-- 100 strings of 64 KB, left in the linda, are way above the keeper GC threshold
+local N = 100
+for i = 1, N do
+    assert(linda:send("big", string.rep(tostring(i % 10), 65536)))
+end
+assert(linda:count("big") == N)
+for i = 1, N do
+    k, v = linda:receive("big")
+    assert(k == "big" and #v == 65536 and v:sub(1, 1) == tostring(i % 10))
+end
+
+print "TEST OK"
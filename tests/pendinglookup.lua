@@ -0,0 +1,37 @@
+--
+-- PENDINGLOOKUP.LUA
+--
+-- Test when the modules still pending in the lookup database are scanned
+--
+local lanes = require "lanes"
+lanes.configure{with_timers = false}
+
+local linda = lanes.linda()
+
+-- registered modules are only scanned when a transfer misses something
+local m = {}
+lanes.register("pendinglookup_m", m)
+
+-- a plain table isn't found in the lookup database, but that miss must not scan the pending module when the table goes to a lane
+assert(lanes.gen("*", function(t_) return t_[3][1] end)({1, 2, {3}})[1] == 3)
+
+-- file methods are native functions that the scan of the global namespace doesn't reach
+-- if the module was scanned above, it was empty at the time, and the function can't be found
+m.read = io.stdout.read
+local ok, err = pcall(linda.send, linda, "k", m.read)
+assert(ok and err == true, tostring(err))
+
+-- a table sent to a linda can be a sub-table of a pending module: that miss scans the module
+-- the module is captured as it is at that time, not when it was registered
+local m2 = { sub = {} }
+lanes.register("pendinglookup_m2", m2)
+assert(linda:send("k", {1, 2, {3}}))
+m2.write = io.stdout.write
+ok, err = pcall(linda.send, linda, "k", m2.write)
+assert(not ok and err:find("not found"), tostring(err))
+
+-- since it was scanned, the sub-table is found, and comes back out of the linda as itself
+linda:set("sub", m2.sub)
+assert(linda:get("sub") == m2.sub)
+
+print "TEST OK"
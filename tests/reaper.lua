@@ -0,0 +1,71 @@
+--
+-- REAPER.LUA
+--
+-- With a reaper, the states of the lanes that have ended are closed on a thread of its own instead of by whoever joins or collects them.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, reaper_queue_size = 4 }
+
+local stats = lanes.reaper_stats()
+assert(stats.capacity == 4 and stats.pending == 0 and stats.reaped == 0 and stats.overflowed == 0)
+
+-- each lane leaves a big heap behind it
+local heavy = lanes.gen("*", function(n_)
+    local lanes = require "lanes"
+    big = {}
+    for i = 1, n_ do
+        big[i] = { i, tostring(i) }
+    end
+    -- the reaper must cope with deep userdata too
+    keep_linda = lanes.linda()
+    keep_linda:set("k", n_)
+    return n_
+end)
+
+local wait_drained = function(expected_)
+    local s
+    repeat
+        s = lanes.reaper_stats()
+        if s.pending > 0 or s.reaped + s.overflowed < expected_ then
+            lanes.sleep(0.01)
+        end
+    until s.pending == 0 and s.reaped + s.overflowed == expected_
+    return s
+end
+
+-- states handed over by join
+local n = 10
+for i = 1, n do
+    local h = heavy(20000)
+    assert(h:join() == 20000)
+end
+stats = wait_drained(n)
+assert(stats.reaped > 0)
+
+-- states handed over by the collection of the handles
+do
+    local h = {}
+    for i = 1, n do
+        h[i] = heavy(1000)
+    end
+    lanes.wait_all(h)
+end
+collectgarbage()
+collectgarbage()
+wait_drained(2 * n)
+
+-- lanes still running at shutdown, whose state is closed by the reaper when they end
+local linda = lanes.linda()
+local blocked = lanes.gen("*", function()
+    big = {}
+    for i = 1, 1000 do
+        big[i] = i
+    end
+    linda:receive("never")
+end)
+for i = 1, 3 do
+    blocked()
+end
+
+print "TEST OK"
@@ -31,4 +31,25 @@ local gen= lanes.gen( "math,package,string,table", {package={}},a_lane )
 local h= gen()
 local ret= h[1]
 assert( ret==true )
+
+-- a native function that another state registered under a shorter name can still be sent to states that don't know that name
+lanes.gen( "*", function()
+    local lanes = require "lanes"
+    lanes.register( "a", { p = string.rep })
+    -- a lookup miss scans the pending modules
+    return {}
+end)():join()
+local rep= lanes.gen( "*", function( f_) return f_( "x", 3) end)
+assert( rep( string.rep)[1] == "xxx")
+local linda= lanes.linda()
+linda:set( "rep", string.rep)
+assert( lanes.gen( "*", function( l_) return l_:get( "rep")( "y", 2) end)( linda)[1] == "yy")
+
+-- modules registered between lookups are scanned when needed, so that their tables keep their identity through a linda
+for i = 1, 4 do
+    local m = { id = i }
+    lanes.register( "m" .. i, m)
+    linda:set( "m", m)
+    assert( linda:get( "m") == m, "module " .. i .. " was cloned")
+end
 print "TEST OK"
\ No newline at end of file
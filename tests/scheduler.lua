@@ -0,0 +1,155 @@
+--
+-- SCHEDULER.LUA
+--
+-- Lanes of a generator with the 'scheduled' option run on a few worker threads, and park instead of blocking them.
+--
+
+-- scheduled lanes park by yielding across C calls, which needs Lua 5.3 or later
+if _VERSION == "Lua 5.1" or _VERSION == "Lua 5.2" then
+    print("scheduled lanes are not supported by " .. _VERSION .. ", skipping")
+    print "TEST OK"
+    return
+end
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, nb_scheduler_threads = 2 }
+
+local linda = lanes.linda "scheduler"
+
+-- many more lanes than workers can wait on a linda at the same time
+local N = 200
+local receiver = lanes.gen("*", { scheduled = true }, function(linda_, i_)
+    local key, v = linda_:receive("in" .. i_)
+    linda_:send("out", v * 2)
+    return v
+end)
+local h = {}
+for i = 1, N do
+    h[i] = receiver(linda, i)
+end
+for i = 1, N do
+    linda:send("in" .. i, i)
+end
+local sum = 0
+for i = 1, N do
+    local key, v = linda:receive(5, "out")
+    assert(key == "out", "lane " .. i .. " didn't answer")
+    sum = sum + v
+end
+assert(sum == N * (N + 1))
+for i = 1, N do
+    assert(h[i]:join() == i)
+    assert(h[i].status == "done")
+end
+
+-- ping-pong between scheduled lanes, with a limited linda slot so that the sender parks too
+linda:limit("pp", 1)
+local pinger = lanes.gen("*", { scheduled = true }, function(linda_, n_)
+    for i = 1, n_ do
+        linda_:send("pp", i)
+    end
+    return true
+end)
+local ponger = lanes.gen("*", { scheduled = true }, function(linda_, n_)
+    local total = 0
+    for i = 1, n_ do
+        local _, v = linda_:receive("pp")
+        total = total + v
+    end
+    return total
+end)
+local ping, pong = pinger(linda, 1000), ponger(linda, 1000)
+assert(ping:join() == true)
+assert(pong:join() == 500500)
+
+-- timeouts still apply to parked lanes
+local timeouter = lanes.gen("*", { scheduled = true }, function(linda_)
+    return linda_:receive(0.1, "nothing")
+end)
+for i = 1, 10 do
+    h[i] = timeouter(linda)
+end
+for i = 1, 10 do
+    local key, err = h[i]:join()
+    assert(key == nil and err == "timeout")
+end
+
+-- lanes.sleep() parks too: 20 lanes sleeping 0.2s on 2 workers take about 0.2s, not 2s
+local sleeper = lanes.gen("*", { scheduled = true }, function()
+    lanes.sleep(0.2)
+    return true
+end)
+local t0 = lanes.now_secs()
+for i = 1, 20 do
+    h[i] = sleeper()
+end
+for i = 1, 20 do
+    assert(h[i]:join() == true)
+end
+local elapsed = lanes.now_secs() - t0
+assert(elapsed < 1.5, "sleeping lanes blocked their workers (" .. elapsed .. "s)")
+
+-- scheduled lanes joining other scheduled lanes park while they wait
+local joiner = lanes.gen("*", { scheduled = true }, function(gen_, linda_, i_)
+    return gen_(linda_, i_):join()
+end)
+local j = {}
+for i = 1, 10 do
+    j[i] = joiner(receiver, linda, "j" .. i)
+end
+for i = 1, 10 do
+    linda:send("inj" .. i, i)
+    assert(linda:receive(5, "out"))
+end
+for i = 1, 10 do
+    assert(j[i]:join() == i)
+end
+
+-- a parked lane can be cancelled
+local waiter = lanes.gen("*", { scheduled = true }, function(linda_)
+    return linda_:receive("never")
+end)
+h[1], h[2] = waiter(linda), waiter(linda)
+repeat lanes.sleep(0.01) until h[1].status == "waiting" and h[2].status == "waiting"
+assert(h[1]:cancel("soft", 1, true) == true)
+assert(h[1].status == "done") -- the body returned nil, cancel_error
+assert(h[2]:cancel("hard", 1, true) == true)
+assert(h[2].status == "cancelled")
+
+-- a coroutine.yield() at the top level of the lane body lets other lanes run
+local yielder = lanes.gen("*", { scheduled = true }, function(n_)
+    for i = 1, n_ do
+        coroutine.yield()
+    end
+    return n_
+end)
+for i = 1, 10 do
+    h[i] = yielder(i * 10)
+end
+for i = 1, 10 do
+    assert(h[i]:join() == i * 10)
+end
+
+-- coroutines inside a scheduled lane still work as usual, their blocking calls block the worker
+local nested = lanes.gen("*", { scheduled = true }, function(linda_)
+    local co = coroutine.wrap(function(a_)
+        local b = coroutine.yield(a_ + 1)
+        return linda_:receive(0, "nothing") or b
+    end)
+    return co(1), co(42)
+end)
+local a, b = nested(linda):join()
+assert(a == 2 and b == 42)
+
+-- errors are reported like with any other lane
+local failer = lanes.gen("*", { scheduled = true }, function(linda_)
+    linda_:receive(0.01, "nothing")
+    error "boom"
+end)
+local _, err = failer(linda):join()
+assert(tostring(err):find("boom"))
+
+-- bad options are refused
+assert(not pcall(lanes.gen, { scheduled = 1 }, function() end))
+
+print "TEST OK"
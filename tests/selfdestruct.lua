@@ -0,0 +1,54 @@
+--
+-- SELFDESTRUCT.LUA
+--
+-- Lanes whose handle is collected while they run clean up after themselves when they end, in any order.
+-- Those still running at shutdown are all cancelled, and Lanes waits for them to be gone.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, shutdown_timeout = 10 }
+
+local linda = lanes.linda()
+
+-- lanes that end in an order unrelated to the one they were listed in
+local g = lanes.gen("*", function(i_)
+    linda:receive("go" .. (i_ % 7))
+    linda:send("done", i_)
+end)
+local n = 700
+do
+    local h = {}
+    for i = 1, n do
+        h[i] = g(i)
+    end
+end
+-- the handles are collected while the lanes wait: they go in the selfdestruct chain
+collectgarbage()
+collectgarbage()
+for k = 6, 0, -1 do
+    for _ = 1, n / 7 do
+        linda:send("go" .. k, true)
+    end
+end
+local sum = 0
+for _ = 1, n do
+    local key, v = linda:receive(10, "done")
+    assert(key == "done")
+    sum = sum + v
+end
+assert(sum == n * (n + 1) / 2)
+
+-- lanes that are still listed at shutdown, some of them ending on their own in the meantime
+local blocked = lanes.gen("*", function(i_)
+    if i_ % 3 == 0 then
+        return
+    end
+    linda:receive("never")
+end)
+for i = 1, 300 do
+    blocked(i)
+end
+collectgarbage()
+collectgarbage()
+
+print "TEST OK"
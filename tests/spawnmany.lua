@@ -0,0 +1,131 @@
+--
+-- SPAWNMANY.LUA
+--
+-- lanes.spawn_many() launches many lanes of a generator at once, and lets them run only when they are all ready.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false }
+
+local linda = lanes.linda()
+
+local g = lanes.gen("*", { globals = { K = 10 } }, function(a_, b_, c_)
+    linda:send("started", a_)
+    return K + a_, b_, c_
+end)
+
+-- arguments produced by a function
+local h = lanes.spawn_many(g, 50, function(i_) return i_, nil, "c" .. i_ end)
+assert(#h == 50)
+for i = 1, 50 do
+    local r, b, c = h[i]:join()
+    assert(r == 10 + i and b == nil and c == "c" .. i)
+end
+assert(linda:count("started") == 50)
+linda:set("started")
+
+-- arguments taken from an array: a table is an argument list, anything else is a single argument
+local args = { { 1, "x", "y" }, 2, { n = 3, 3, nil, "z" } }
+h = lanes.spawn_many(g, 3, args)
+local r, b, c = h[1]:join()
+assert(r == 11 and b == "x" and c == "y")
+r, b, c = h[2]:join()
+assert(r == 12 and b == nil and c == nil)
+r, b, c = h[3]:join()
+assert(r == 13 and b == nil and c == "z")
+
+-- a single table argument is wrapped in args_tbl, args_func returns it as is
+local tbl = lanes.gen("*", function(t_, ...) return t_.x, select('#', ...) end)
+h = lanes.spawn_many(tbl, 1, { { { x = "a" } } })
+r, b = h[1]:join()
+assert(r == "a" and b == 0)
+h = lanes.spawn_many(tbl, 1, function() return { x = "b" } end)
+r, b = h[1]:join()
+assert(r == "b" and b == 0)
+
+-- without arguments, and with no lanes at all
+local noargs = lanes.gen("*", function(...) return select('#', ...) end)
+h = lanes.spawn_many(noargs, 5)
+for i = 1, 5 do
+    assert(h[i][1] == 0)
+end
+assert(next(lanes.spawn_many(noargs, 0)) == nil)
+
+-- none of the lanes starts before they are all ready
+local gate = lanes.gen("*", function(i_)
+    -- the last lane's arguments aren't even computed yet when the first lanes are created
+    return linda:count("last")
+end)
+h = lanes.spawn_many(gate, 20, function(i_)
+    if i_ == 20 then
+        linda:set("last", 1)
+    end
+    return i_
+end)
+for i = 1, 20 do
+    assert(h[i][1] == 1, "lane " .. i .. " started before the others were ready")
+end
+
+-- a failure releases the lanes already created without running them
+local started = lanes.gen("*", function() linda:send("ran", true) end)
+linda:set("ran")
+local ok, msg = pcall(lanes.spawn_many, started, 10, function(i_)
+    if i_ == 6 then
+        error("stop at 6")
+    end
+end)
+assert(not ok and string.find(msg, "stop at 6"), msg)
+assert(linda:count("ran") == nil, "some lanes ran")
+ok, msg = pcall(lanes.spawn_many, started, 3, { 1, 2, coroutine.create(function() end) })
+assert(not ok and string.find(msg, "tried to copy unsupported types"), msg)
+assert(linda:count("ran") == nil, "some lanes ran")
+
+-- bad calls
+ok, msg = pcall(lanes.spawn_many, function() end, 3)
+assert(not ok and string.find(msg, "Not a lane generator"), msg)
+ok, msg = pcall(lanes.spawn_many, g, -1)
+assert(not ok and string.find(msg, "invalid lane count"), msg)
+ok, msg = pcall(lanes.spawn_many, g, 2, "nope")
+assert(not ok and string.find(msg, "expected lane arguments"), msg)
+
+-- a generator transferred to another lane can launch many lanes there too
+local shared = { base = 100 }
+local sg = lanes.gen("*", function(i_, f_) return shared.base + f_(i_) end)
+local outer = lanes.gen("*", function(g_, n_)
+    local lanes = require "lanes"
+    local h = lanes.spawn_many(g_, n_, function(i_) return i_, function(x_) return x_ * 3 end end)
+    local sum = 0
+    for i = 1, n_ do
+        sum = sum + h[i][1]
+    end
+    return sum
+end)
+assert(outer(sg, 10)[1] == 10 * 100 + 3 * 55)
+
+-- an args_func can launch lanes of its own, with spawn_many() too
+h = lanes.spawn_many(sg, 3, function(i_)
+    local inner = lanes.spawn_many(sg, 2, function(j_) return j_, function(x_) return x_ end end)
+    return inner[1][1] + inner[2][1], function(x_) return x_ * i_ end
+end)
+for i = 1, 3 do
+    assert(h[i][1] == 100 + 203 * i)
+end
+
+-- detached lanes have no handle to return
+ok, msg = pcall(lanes.spawn_many, lanes.gen("*", { detached = true }, function() end), 2)
+assert(not ok and string.find(msg, "can't launch detached lanes"), msg)
+
+-- works with the other generator options
+local opts = { { async = true }, { pool = lanes.state_pool(4) } }
+if _VERSION ~= "Lua 5.1" then
+    opts[#opts + 1] = { scheduled = true }
+end
+for _, opt in ipairs(opts) do
+    local og = lanes.gen("*", opt, function(i_) return i_ * 2 end)
+    h = lanes.spawn_many(og, 30, function(i_) return i_ end)
+    for i = 1, 30 do
+        assert(h[i][1] == i * 2)
+    end
+end
+
+print "TEST OK"
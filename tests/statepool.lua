@@ -0,0 +1,123 @@
+--
+-- STATEPOOL.LUA
+--
+-- Lanes of a generator with a 'pool' option run in the recycled states of the previous ones.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false }
+
+local pool = lanes.state_pool(2)
+
+-- each lane must see a state as if it was freshly created
+local body = function(i)
+    assert(LEAKED == nil, "global leaked from a previous lane")
+    assert(G == "global" and type(string.format) == "function")
+    LEAKED = i
+    G = "changed"
+    -- a finalizer must not survive its lane
+    set_finalizer(function() FINALIZED = (FINALIZED or 0) + 1 end)
+    assert(FINALIZED == nil)
+    -- given a linda, wait until cancelled
+    if type(i) == "userdata" then
+        i:receive("never")
+    end
+    if i < 0 then
+        error("lane error " .. i)
+    end
+    return i
+end
+local g = lanes.gen("*", { pool = pool, globals = { G = "global" } }, body)
+
+-- sequential lanes all run in the same state, but for the first one
+for i = 1, 20 do
+    assert(g(i)[1] == i)
+end
+local stats = pool:stats()
+assert(stats.capacity == 2 and stats.idle == 1)
+assert(stats.created == 1 and stats.reused == 19 and stats.recycled == 20 and stats.discarded == 0)
+assert(stats.hit_rate == 19 / 20)
+
+-- a lane that ended with an error gives its state back too
+local _, err = g(-1):join()
+assert(err:find("lane error %-1"))
+assert(g(21)[1] == 21)
+assert(pool:stats().reused == 21)
+
+-- the states of cancelled lanes are not reused
+local linda = lanes.linda()
+local h = g(linda)
+while h.status ~= "waiting" do lanes.sleep(0.001) end
+assert(h:cancel("hard", 1))
+h:join()
+h = nil
+collectgarbage()
+assert(pool:stats().discarded == 1)
+
+-- concurrent lanes: states that don't fit in the pool are closed
+local lanes_h = {}
+for i = 1, 5 do
+    lanes_h[i] = g(i)
+end
+for i = 1, 5 do
+    assert(lanes_h[i][1] == i)
+end
+lanes_h = nil
+collectgarbage()
+stats = pool:stats()
+assert(stats.idle == 2)
+-- every finished lane gave its state back or closed it
+assert(stats.created + stats.reused == 28 and stats.recycled + stats.discarded == 28)
+
+-- the pool can be transferred to other lanes along with its generator
+local outer = lanes.gen("*", function(g_)
+    local r = 0
+    for i = 1, 3 do
+        r = r + g_(i)[1]
+    end
+    return r
+end)
+assert(outer(g)[1] == 6)
+
+-- a pool can't be shared by generators prepared differently, not even in another lane
+local ok, err = pcall(lanes.gen, "*", { pool = pool }, body)
+assert(not ok and err:find("already belongs to another generator"))
+local other = lanes.gen("*", function(pool_)
+    local lanes = require "lanes"
+    return pcall(lanes.gen, "*", { pool = pool_ }, function() end)
+end)
+assert(other(pool)[1] == false)
+
+-- a finalizer that raises an error when the state is reset doesn't take the process down: the state is closed instead
+local gcpool = lanes.state_pool(1)
+local gcg = lanes.gen("*", { pool = gcpool }, function()
+    local boom = function() error("boom in __gc") end
+    if newproxy then
+        GC_BOMB = newproxy(true)
+        getmetatable(GC_BOMB).__gc = boom
+    else
+        GC_BOMB = setmetatable({}, { __gc = boom })
+    end
+    return true
+end)
+h = gcg()
+assert(h[1] == true)
+h = nil
+collectgarbage()
+stats = gcpool:stats()
+-- Lua 5.4 turns the errors of finalizers into warnings, the reset succeeds
+if _VERSION == "Lua 5.4" then
+    assert(stats.recycled == 1 and stats.idle == 1)
+else
+    assert(stats.discarded == 1 and stats.idle == 0)
+end
+
+-- bad pool values are refused
+assert(not pcall(lanes.gen, { pool = {} }, body))
+assert(not pcall(lanes.state_pool, 0))
+
+-- a pool whose generator is gone closes its states
+g = nil
+collectgarbage()
+
+print "TEST OK"
@@ -0,0 +1,107 @@
+--
+-- STATETEMPLATE.LUA
+--
+-- Lanes of a generator with the 'template' option get the required modules cloned from a state prepared once.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false }
+
+-- the ids of the modules seen by each lane
+local ids = function(h_)
+    local lua_ids, native_ids = {}, {}
+    for _, h in ipairs(h_) do
+        local lua_id, native_id = h:join()
+        lua_ids[lua_id] = true
+        native_ids[native_id] = true
+    end
+    local count = function(t_)
+        local n = 0
+        for _ in pairs(t_) do
+            n = n + 1
+        end
+        return n
+    end
+    return count(lua_ids), count(native_ids)
+end
+
+local body = function(v_)
+    local m = package.loaded.statetemplate_lua
+    -- each lane has its own copy of the module, whose functions still share their tables
+    assert(m.count() == 0)
+    assert(m.add(v_) == 1 and m.count() == 1)
+    assert(m.fmt("%d", v_) == tostring(v_))
+    assert(require "statetemplate_lua" == m)
+    -- the dependencies of the module are the ones require() returns
+    local dep = require "statetemplate_dep"
+    assert(m.dep == dep, "statetemplate_dep was cloned twice")
+    m.dep.set("v", v_)
+    assert(dep.values.v == v_)
+    local native = require "statetemplate_native"
+    assert(type(native.co) == "thread")
+    return m.id, native.id
+end
+local required = { "statetemplate_lua", "statetemplate_native" }
+
+-- without a template, each lane loads the modules
+local plain = lanes.gen("*", { required = required }, body)
+local h = {}
+for i = 1, 10 do
+    h[i] = plain(i)
+end
+local lua_count, native_count = ids(h)
+assert(lua_count == 10 and native_count == 10)
+
+-- with a template, clonable modules are loaded only once, in the template state
+local g = lanes.gen("*", { required = required, template = true }, body)
+for i = 1, 10 do
+    h[i] = g(i)
+end
+lua_count, native_count = ids(h)
+assert(lua_count == 1, "statetemplate_lua loaded " .. lua_count .. " times")
+assert(native_count == 10, "statetemplate_native loaded " .. native_count .. " times")
+
+-- the generator, and its template, can be transferred to other lanes
+local outer = lanes.gen("*", function(g_)
+    local lua_id
+    for i = 1, 3 do
+        local id = g_(i)[1]
+        assert(lua_id == nil or id == lua_id)
+        lua_id = id
+    end
+    return lua_id
+end)
+assert(outer(g)[1] == g(1)[1])
+
+-- lanes created at the same time by several lanes don't wait for each other to get their modules
+local spawner = lanes.gen("*", function(g_)
+    for i = 1, 20 do
+        assert(g_(i)[1])
+    end
+    return true
+end)
+local spawners = {}
+for i = 1, 4 do
+    spawners[i] = spawner(g)
+end
+for i = 1, 4 do
+    assert(spawners[i][1])
+end
+
+-- a template and a pool work together
+local pooled = lanes.gen("*", { required = required, template = true, pool = lanes.state_pool(1) }, function() return package.loaded.statetemplate_lua.add(1) end)
+for i = 1, 3 do
+    assert(pooled()[1] == i, "pooled state keeps its module")
+end
+
+-- errors while building the template are propagated to the lane creator
+local broken = lanes.gen("*", { required = { "statetemplate_missing" }, template = true }, body)
+local ok, err = pcall(broken)
+assert(not ok and tostring(err):find("statetemplate_missing"))
+ok, err = pcall(broken)
+assert(not ok and tostring(err):find("statetemplate_missing"))
+
+-- bad options are refused
+assert(not pcall(lanes.gen, { template = 1 }, body))
+
+print "TEST OK"
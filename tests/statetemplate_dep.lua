@@ -0,0 +1,4 @@
+-- a pure Lua module required by statetemplate_lua.lua: a lane that gets a copy of statetemplate_lua must get the same copy of this one from require()
+local D = { values = {} }
+D.set = function(k_, v_) D.values[k_] = v_ end
+return D
@@ -0,0 +1,11 @@
+-- a pure Lua module used by statetemplate.lua: lanes of a generator with a template get a copy of the instance loaded in the template
+local items = {}
+local M = {}
+-- unique to each instance of the module
+M.id = tostring(items)
+M.add = function(v_) items[#items + 1] = v_ return #items end
+M.count = function() return #items end
+M.fmt = function(...) return string.format(...) end
+-- the lanes that clone this module must also know its dependencies
+M.dep = require "statetemplate_dep"
+return M
@@ -0,0 +1,2 @@
+-- a module used by statetemplate.lua: a coroutine can't be transferred, so each lane has to load it
+return { co = coroutine.create(print), id = tostring({}) }
@@ -0,0 +1,111 @@
+--
+-- THREADCACHE.LUA
+--
+-- With allocator="threadcache", the states of the lanes allocate their small blocks from caches that belong to the threads running them.
+-- Blocks are often freed by another thread than the one that allocated them: by whoever joins or collects a lane, the reaper, or a keeper.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, allocator = "threadcache", reaper_queue_size = 4 }
+
+local linda = lanes.linda()
+
+-- lots of small blocks of all sizes, some of them resized, some of them sent through a linda
+local churn = lanes.gen("*", function(id_, n_)
+    local t = {}
+    for i = 1, n_ do
+        t[i] = { id_, i, string.rep("x", i % 600) }
+        if i % 3 == 0 then
+            t[i - 1] = nil
+        end
+    end
+    local grow = {}
+    for i = 1, n_ do
+        grow[#grow + 1] = i
+    end
+    linda:send("churn", { id_, #grow, t[n_][3] })
+    return id_, #grow
+end)
+
+-- states closed by join
+local handles = {}
+for i = 1, 8 do
+    handles[i] = churn(i, 20000)
+end
+for i, h in ipairs(handles) do
+    local id, n = h:join()
+    assert(id == i and n == 20000)
+end
+for i = 1, 8 do
+    local _, msg = linda:receive("churn")
+    assert(#msg[3] == 20000 % 600)
+end
+
+-- states closed by the garbage collector of the master state, from lanes nobody waits for
+for i = 1, 8 do
+    churn(i, 5000)
+end
+for i = 1, 8 do
+    linda:receive("churn")
+end
+collectgarbage()
+collectgarbage()
+
+-- states closed by the reaper, and by the lanes themselves
+local stats = lanes.reaper_stats()
+local before = stats.reaped + stats.overflowed
+for i = 1, 12 do
+    churn(i, 5000):join()
+end
+repeat
+    stats = lanes.reaper_stats()
+    local drained = stats.pending == 0 and stats.reaped + stats.overflowed >= before + 12
+    if not drained then
+        lanes.sleep(0.01)
+    end
+until drained
+local detached = lanes.gen("*", { detached = true }, function(i_)
+    local t = {}
+    for i = 1, 5000 do
+        t[i] = tostring(i)
+    end
+    linda:send("detached", i_)
+end)
+for i = 1, 8 do
+    detached(i)
+end
+for i = 1, 8 do
+    assert(linda:receive(3, "detached"))
+end
+
+-- states recycled by a pool keep the blocks of their previous lane
+local pool = lanes.state_pool(2)
+local pooled = lanes.gen("*", { pool = pool }, function(i_)
+    local s = {}
+    for i = 1, 2000 do
+        s[i] = { i_, i }
+    end
+    return #s
+end)
+for i = 1, 10 do
+    assert(pooled(i)[1] == 2000)
+end
+
+-- lanes spawned by lanes, that end on other threads than the ones that created their state
+local parent = lanes.gen("*", function(n_)
+    local lanes = require "lanes"
+    local child = lanes.gen("*", function(i_) return string.rep("y", i_) end)
+    local h = {}
+    for i = 1, n_ do
+        h[i] = child(i)
+    end
+    local total = 0
+    for i = 1, n_ do
+        total = total + #h[i][1]
+    end
+    return total
+end)
+local p1, p2 = parent(50), parent(50)
+assert(p1[1] == 1275 and p2[1] == 1275)
+
+print "TEST OK"
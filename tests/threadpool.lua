@@ -0,0 +1,83 @@
+--
+-- THREADPOOL.LUA
+--
+-- With thread_pool_size > 0, the OS threads of the lanes that ended run the next ones.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, thread_pool_size = 4, thread_pool_idle_timeout = 0.2 }
+
+local stats = lanes.thread_pool_stats()
+assert(stats.capacity == 4 and stats.idle == 0 and stats.created == 0)
+
+local linda = lanes.linda "threadpool"
+
+local echo = lanes.gen("*", function(i_, linda_)
+    set_debug_threadname("echo " .. i_)
+    -- wait until all the lanes of the round are launched, so that none can run on the thread of another
+    if linda_ then
+        linda_:receive("go")
+    end
+    return i_
+end)
+
+-- several launch/join rounds: only the first one should have to start threads
+local h = {}
+for round = 1, 5 do
+    for i = 1, 4 do
+        h[i] = echo(i, linda)
+    end
+    for i = 1, 4 do
+        linda:send("go", true)
+    end
+    for i = 1, 4 do
+        assert(h[i]:join() == i)
+    end
+    -- let the threads get back in the pool before the next round
+    repeat lanes.sleep(0.01) until lanes.thread_pool_stats().idle == 4
+end
+stats = lanes.thread_pool_stats()
+assert(stats.created == 4, "created " .. stats.created .. " threads")
+assert(stats.reused == 16, "reused " .. stats.reused .. " threads")
+
+-- more lanes than the pool capacity: the extra threads leave when their lane ends
+for i = 1, 20 do
+    h[i] = echo(i)
+end
+for i = 1, 20 do
+    assert(h[i]:join() == i)
+end
+repeat lanes.sleep(0.01) until lanes.thread_pool_stats().idle == 4
+
+-- priorities, errors and cancellation behave as usual
+local prio = lanes.gen("*", { priority = 1 }, function() return "prio" end)
+assert(prio():join() == "prio")
+local _, err = lanes.gen("*", function() error "boom" end)():join()
+assert(tostring(err):find("boom"))
+local waiter = lanes.gen("*", function(linda_) return linda_:receive("never") end)(linda)
+repeat lanes.sleep(0.01) until waiter.status == "waiting"
+assert(waiter:cancel("soft", 1, true) == true)
+
+-- a lane whose handle is collected while it runs cleans up after itself on its pooled thread
+do
+    local free = lanes.gen("*", function(linda_)
+        linda_:receive(1, "go")
+        linda_:send("freed", true)
+    end)(linda)
+end
+collectgarbage()
+collectgarbage()
+linda:send("go", true)
+assert(linda:receive(5, "freed"))
+
+-- idle threads retire after the timeout
+lanes.sleep(0.5)
+stats = lanes.thread_pool_stats()
+assert(stats.idle == 0, "still " .. stats.idle .. " idle threads")
+assert(stats.retired == stats.created, stats.retired .. " retired out of " .. stats.created)
+
+-- and the pool starts new ones when needed
+assert(echo(1):join() == 1)
+assert(lanes.thread_pool_stats().created == stats.created + 1)
+
+print "TEST OK"
@@ -0,0 +1,86 @@
+--
+-- WAITLANES.LUA
+--
+-- lanes.wait_any() and lanes.wait_all() wait for several lanes at once, without reading their results.
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, nb_scheduler_threads = 1 }
+
+local linda = lanes.linda()
+
+-- each lane ends when told to
+local g = lanes.gen("*", function(i_)
+    linda:receive("go" .. i_)
+    return i_ * 10
+end)
+
+local h = {}
+for i = 1, 5 do
+    h[i] = g(i)
+end
+
+-- nothing is done yet
+local t0 = lanes.now_secs()
+local indices, timeout = lanes.wait_any(h, 0.2)
+assert(#indices == 0 and timeout == "timeout")
+assert(lanes.now_secs() - t0 >= 0.15)
+
+-- the first lane to end wakes us up
+linda:send("go3", true)
+indices, timeout = lanes.wait_any(h)
+assert(#indices == 1 and indices[1] == 3 and timeout == nil)
+-- its results weren't read: they are still there
+assert(h[3].status == "done" and h[3][1] == 30)
+
+-- wait_all times out with the indices of the lanes that have ended so far
+linda:send("go1", true)
+lanes.wait_any({ h[1] })
+indices, timeout = lanes.wait_all(h, 0.1)
+assert(#indices == 2 and indices[1] == 1 and indices[2] == 3 and timeout == "timeout")
+
+-- and returns all of them once they have all ended
+for i = 1, 5 do
+    linda:send("go" .. i, true)
+end
+indices, timeout = lanes.wait_all(h)
+assert(#indices == 5 and timeout == nil)
+for i = 1, 5 do
+    assert(indices[i] == i and h[i][1] == i * 10)
+end
+
+-- lanes that end with an error or are cancelled count as ended too
+local e = lanes.gen("*", function() error("oops") end)()
+local c = lanes.gen("*", function() linda:receive("never") end)()
+c:cancel()
+indices = lanes.wait_all({ e, c }, 5)
+assert(#indices == 2 and e.status == "error" and c.status == "cancelled")
+
+-- edge cases
+indices, timeout = lanes.wait_any({})
+assert(#indices == 0 and timeout == nil)
+local ok, msg = pcall(lanes.wait_any, { h[1], "nope" })
+assert(not ok and string.find(msg, "is not a lane"), msg)
+ok, msg = pcall(lanes.wait_all, h, -1)
+assert(not ok and string.find(msg, "duration cannot be < 0"), msg)
+
+-- a scheduled lane can wait without blocking its worker
+if _VERSION ~= "Lua 5.1" then
+    local sg = lanes.gen("*", { scheduled = true }, function(n_)
+        local lanes = require "lanes"
+        local w = {}
+        for i = 1, n_ do
+            w[i] = lanes.gen("*", { scheduled = true }, function(i_) return i_ end)(i)
+        end
+        -- with a single worker, those lanes can only run if we park
+        local indices = lanes.wait_all(w)
+        local sum = 0
+        for _, i in ipairs(indices) do
+            sum = sum + w[i][1]
+        end
+        return sum
+    end)
+    assert(sg(10)[1] == 55)
+end
+
+print "TEST OK"
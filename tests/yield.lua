@@ -0,0 +1,169 @@
+--
+-- YIELD.LUA
+--
+-- A lane sends values to its handle with lanes.yield(), that the parent reads with "for ... in h:iter()".
+--
+
+local lanes = require "lanes"
+lanes.configure{ with_timers = false, nb_scheduler_threads = 1, yield_capacity = 4 }
+
+-- lanes.yield() is only for lanes
+assert(not pcall(lanes.yield, 1))
+
+-- the values come out in order, even when the lane has to wait for the iterator to read them
+local counter = lanes.gen("*", function(n_)
+    for i = 1, n_ do
+        lanes.yield(i)
+    end
+    return "end"
+end)
+
+local h = counter(100)
+local expected = 0
+for v in h:iter() do
+    expected = expected + 1
+    assert(v == expected)
+end
+assert(expected == 100)
+-- the results of the lane are still there
+assert(h[1] == "end")
+-- iterating again on an ended lane doesn't loop
+for _ in h:iter() do
+    error "should not get here"
+end
+
+-- lanes.yield() refuses what the loop would take for its end
+h = lanes.gen("*", function()
+    local ok1 = pcall(lanes.yield)
+    local ok2 = pcall(lanes.yield, nil, 1)
+    return ok1, ok2
+end)()
+for _ in h:iter() do
+    error "should not get here"
+end
+local ok1, ok2 = h:join()
+assert(ok1 == false and ok2 == false)
+
+-- several values per lanes.yield(), including nils and tables
+local multi = lanes.gen("*", function()
+    lanes.yield(1, nil, "x")
+    lanes.yield("t", { a = 1, b = { 2, 3 } })
+end)
+h = multi()
+local it = h:iter()
+local a, b, c = it()
+assert(a == 1 and b == nil and c == "x")
+local d, t = it()
+assert(d == "t" and t.a == 1 and t.b[2] == 3)
+assert(it() == nil)
+
+-- a lane that never yields just ends the loop
+h = lanes.gen("*", function() return 42 end)()
+for _ in h:iter() do
+    error "should not get here"
+end
+assert(h[1] == 42)
+
+-- the error of the lane is raised once the values it sent before are read
+h = lanes.gen("*", function()
+    lanes.yield "before"
+    error "boom"
+end)()
+local got = {}
+local ok, err = pcall(function()
+    for v in h:iter() do
+        got[#got + 1] = v
+    end
+end)
+assert(not ok and tostring(err):find("boom"), tostring(err))
+assert(got[1] == "before" and #got == 1)
+
+-- values that can't be transferred
+h = lanes.gen("*", function()
+    lanes.yield(coroutine.create(function() end))
+end)()
+ok, err = pcall(function()
+    for _ in h:iter() do end
+end)
+assert(not ok and tostring(err):find("unsupported"), tostring(err))
+
+-- a lane waiting for room in its channel can be cancelled
+local blocked = lanes.gen("*", function()
+    local i = 0
+    while true do
+        i = i + 1
+        local r = lanes.yield(i)
+        if r == lanes.cancel_error then
+            return "soft", i
+        end
+    end
+end)
+h = blocked()
+while h.status ~= "waiting" do
+    lanes.sleep(0.01)
+end
+assert(h:cancel("soft", 1, true))
+local how, i = h:join()
+assert(how == "soft" and i == 5, tostring(i))
+
+h = blocked()
+while h.status ~= "waiting" do
+    lanes.sleep(0.01)
+end
+assert(h:cancel("hard", 1, true))
+assert(h.status == "cancelled")
+
+-- the batches wait in a keeper: those nobody reads go away with the lane
+do
+    local unread = lanes.gen("*", function()
+        lanes.yield("a", { 1 })
+        lanes.yield("b")
+        return true
+    end)()
+    assert(unread[1] == true)
+    unread = nil
+    collectgarbage()
+    collectgarbage()
+    -- the keepers are still usable, and a new lane starts with an empty channel
+    local fresh = lanes.gen("*", function()
+        lanes.yield "c"
+    end)()
+    local seen = {}
+    for v in fresh:iter() do
+        seen[#seen + 1] = v
+    end
+    assert(#seen == 1 and seen[1] == "c")
+end
+
+-- a scheduled lane gives its worker back while its channel is full, and so does one that iterates on another lane
+if _VERSION ~= "Lua 5.1" then
+    local scheduled = lanes.gen("*", { scheduled = true }, function(n_)
+        for i = 1, n_ do
+            lanes.yield(i * 2)
+        end
+        return n_
+    end)
+    local sh = scheduled(20)
+    local consumer = lanes.gen("*", { scheduled = true }, function(n_)
+        local lanes = require "lanes"
+        local sum = 0
+        local g = lanes.gen("*", { scheduled = true }, function(m_)
+            for i = 1, m_ do
+                lanes.yield(i)
+            end
+        end)
+        for v in g(n_):iter() do
+            sum = sum + v
+        end
+        return sum
+    end)
+    local ch = consumer(50)
+    local sum = 0
+    for v in sh:iter() do
+        sum = sum + v
+    end
+    assert(sum == 420 and sh[1] == 20)
+    assert(ch[1] == 1275, tostring(ch[1]))
+end
+
+print "TEST OK"